@@ -0,0 +1,710 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <threads.h>
+#include "models/game.h"
+#include "models/command-parser.h"
+#include "models/session-store.h"
+#include "models/world.h"
+#include "models/world-builder.h"
+#include "services/worker-pool.h"
+#include "utils/clock.h"
+#include "utils/cpu.h"
+#include "utils/frame.h"
+#include "utils/metrics.h"
+
+/*
+ * [[ Бенчмарки горячих путей движка ]]
+ *
+ * Микро: новая партия, ExecuteAction по типам действий, HasItem и проверка
+ * победы, разбор текстовой команды, отрисовка локации в кадр. Макро: полные прохождения в одном
+ * потоке и на всех ядрах, запись и восстановление хранилища партий. Каждый замер повторяется BENCH_RUNS раз,
+ * берётся лучший прогон - так результаты стабильнее между запусками.
+ *
+ * Вывод: таблица (по умолчанию) или JSON по строке на бенчмарк
+ * (--format json) для отслеживания регрессий между релизами.
+ */
+
+#define BENCH_RUNS 5
+
+/* [[ Подсчёт выделений памяти ]] */
+/*
+ * С BENCH_COUNT_ALLOCATIONS бенчмарк линкуется с --wrap=malloc/calloc/realloc
+ * и считает вызовы аллокатора в текущем потоке. Без него счётчик недоступен.
+ */
+static _Thread_local uint64_t allocationCount;
+
+#ifdef BENCH_COUNT_ALLOCATIONS
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t count, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+
+void *__wrap_malloc(size_t size) {
+    allocationCount++;
+    return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t count, size_t size) {
+    allocationCount++;
+    return __real_calloc(count, size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size) {
+    allocationCount++;
+    return __real_realloc(ptr, size);
+}
+#endif
+
+/* [[ Контекст и результаты ]] */
+
+typedef struct {
+    const World *mansion;
+    const World *synthetic;
+    GameSession *session;
+    FrameBuffer frame;
+    uint64_t bytes;       // выведено байт за прогон
+    uint64_t sink;        // не даёт компилятору выбросить работу
+} BenchContext;
+
+typedef void (*BenchFunction)(BenchContext *ctx, uint64_t iterations);
+typedef void (*BenchSetup)(BenchContext *ctx);
+
+typedef struct {
+    const char *name;
+    BenchSetup setup;
+    BenchFunction run;
+    uint64_t iterations;
+} Benchmark;
+
+typedef struct {
+    const char *name;
+    int threads;
+    uint64_t iterations;
+    double nsPerOp;
+    double allocsPerOp;     // < 0 - не измерялось
+    double bytesPerOp;
+} BenchResult;
+
+/* Прохождение особняка: столовая, библиотека, ключ, инвентарь, чердак, манускрипт */
+static const int walkthrough[] = {1, 1, 2, 0, 4, 1};
+
+/* Индексы действий синтетического мира (см. BuildSyntheticWorld) */
+enum {
+    SYN_MOVE = 0,
+    SYN_TAKE = 1,
+    SYN_TEXT = 2,
+    SYN_REQUIRES = 3,
+    SYN_REQUIRES_MISSING = 4
+};
+
+/* [[ Синтетический мир ]] */
+
+/*
+ * Маленький мир, где есть действие каждого типа: переход, взять предмет,
+ * только текст, действие с выполненным и невыполненным требованием.
+ */
+static const World* BuildSyntheticWorld() {
+    WorldBuilder *b = CreateWorldBuilder();
+    if (b == NULL) {
+        return NULL;
+    }
+    int hall = WorldBuilderAddLocation(b, "Зал", "Пустой зал для замеров.");
+    int yard = WorldBuilderAddLocation(b, "Двор", "Пустой двор для замеров.");
+    int lamp = WorldBuilderAddItem(b, hall, "Лампа", "Обычная лампа");
+    int coin = WorldBuilderAddItem(b, yard, "Монета", "Обычная монета");
+
+    WorldBuilderAddAction(b, hall, "Во двор", yard, NO_ITEM, "Вы выходите во двор.", NO_ITEM, true);
+    WorldBuilderAddAction(b, hall, "Взять лампу", NO_LOCATION, NO_ITEM, "Лампа у вас.", lamp, true);
+    WorldBuilderAddAction(b, hall, "Осмотреться", NO_LOCATION, NO_ITEM, "Ничего интересного.", NO_ITEM, true);
+    WorldBuilderAddAction(b, hall, "Зажечь лампу", NO_LOCATION, lamp, "Стало светло.", NO_ITEM, true);
+    WorldBuilderAddAction(b, hall, "Бросить монету", NO_LOCATION, coin, "Орёл.", NO_ITEM, true);
+    WorldBuilderAddAction(b, yard, "В зал", hall, NO_ITEM, "Вы возвращаетесь в зал.", NO_ITEM, true);
+    WorldBuilderSetWinItem(b, coin);
+
+    size_t size = 0;
+    void *image = WorldBuilderFinish(b, &size);
+    DestroyWorldBuilder(b);
+    if (image == NULL) {
+        return NULL;
+    }
+    World *world = LoadWorldImage(image, size);
+    if (world == NULL) {
+        free(image);
+    }
+    return world;
+}
+
+/* [[ Подготовка ]] */
+
+static void UseSession(BenchContext *ctx, const World *world) {
+    DestroyGameSession(ctx->session);
+    ctx->session = CreateGameSession(world);
+}
+
+static void SetupMansion(BenchContext *ctx) {
+    UseSession(ctx, ctx->mansion);
+}
+
+static void SetupSynthetic(BenchContext *ctx) {
+    UseSession(ctx, ctx->synthetic);
+}
+
+static void SetupSyntheticWithLamp(BenchContext *ctx) {
+    UseSession(ctx, ctx->synthetic);
+    ExecuteAction(ctx->session, SYN_TAKE);
+}
+
+static void SetupSyntheticDialog(BenchContext *ctx) {
+    UseSession(ctx, ctx->synthetic);
+    FrameReset(&ctx->frame);
+    BeginDialog(ctx->session, &ctx->frame);
+}
+
+static void SetupMansionDining(BenchContext *ctx) {
+    UseSession(ctx, ctx->mansion);
+    StepGameSession(ctx->session, 1);   // кухня -> столовая
+}
+
+static void SetupMansionInventory(BenchContext *ctx) {
+    UseSession(ctx, ctx->mansion);
+    StepGameSession(ctx->session, 2);   // газета
+    StepGameSession(ctx->session, 1);   // столовая
+    StepGameSession(ctx->session, 5);   // карта
+}
+
+/* [[ Микробенчмарки ]] */
+
+static void BenchSessionLifecycle(BenchContext *ctx, uint64_t iterations) {
+    for (uint64_t i = 0; i < iterations; i++) {
+        GameSession *session = CreateGameSession(ctx->mansion);
+        ctx->sink += (uintptr_t)session & 1u;
+        DestroyGameSession(session);
+    }
+}
+
+static void BenchNewGame(BenchContext *ctx, uint64_t iterations) {
+    for (uint64_t i = 0; i < iterations; i++) {
+        InitGameModel(ctx->session);
+        ctx->sink += (uint64_t)GetCurrentLocationId(ctx->session);
+    }
+}
+
+static void BenchExecuteMove(BenchContext *ctx, uint64_t iterations) {
+    // В обеих локациях синтетического мира переход - действие 0
+    for (uint64_t i = 0; i < iterations; i++) {
+        ctx->sink += ExecuteAction(ctx->session, SYN_MOVE);
+    }
+}
+
+static void BenchExecuteTake(BenchContext *ctx, uint64_t iterations) {
+    for (uint64_t i = 0; i < iterations; i++) {
+        InitGameModel(ctx->session);
+        ctx->sink += ExecuteAction(ctx->session, SYN_TAKE);
+    }
+}
+
+static void BenchExecuteText(BenchContext *ctx, uint64_t iterations) {
+    for (uint64_t i = 0; i < iterations; i++) {
+        ctx->sink += ExecuteAction(ctx->session, SYN_TEXT);
+    }
+}
+
+static void BenchExecuteRequirementMet(BenchContext *ctx, uint64_t iterations) {
+    for (uint64_t i = 0; i < iterations; i++) {
+        ctx->sink += ExecuteAction(ctx->session, SYN_REQUIRES);
+    }
+}
+
+static void BenchExecuteRequirementMissing(BenchContext *ctx, uint64_t iterations) {
+    for (uint64_t i = 0; i < iterations; i++) {
+        ctx->sink += ExecuteAction(ctx->session, SYN_REQUIRES_MISSING);
+    }
+}
+
+static void BenchHasItem(BenchContext *ctx, uint64_t iterations) {
+    for (uint64_t i = 0; i < iterations; i++) {
+        ctx->sink += HasItem(ctx->session, (int)(i & 1));
+    }
+}
+
+static void BenchWinCheck(BenchContext *ctx, uint64_t iterations) {
+    for (uint64_t i = 0; i < iterations; i++) {
+        ctx->sink += CheckWinCondition(ctx->session);
+    }
+}
+
+/* Цена пробы метрик; в сборке без GAME_METRICS измеряется пустой цикл */
+static void BenchMetricCounter(BenchContext *ctx, uint64_t iterations) {
+    for (uint64_t i = 0; i < iterations; i++) {
+        METRIC_ADD(COUNTER_BYTES_RENDERED, i & 1);
+    }
+    ctx->sink += iterations;
+}
+
+static void BenchMetricTimer(BenchContext *ctx, uint64_t iterations) {
+    for (uint64_t i = 0; i < iterations; i++) {
+        METRIC_START(TIMER_WIN_CHECK, started);
+        METRIC_STOP(TIMER_WIN_CHECK, started);
+    }
+    ctx->sink += iterations;
+}
+
+static void BenchParseText(BenchContext *ctx, uint64_t iterations) {
+    // Столовая: пять действий, разбор со словом-сокращением и служебным словом
+    static const char *const lines[] = {"идти в библиотеку", "вернуться на кухню", "библ", "выйти в сад"};
+    TextCommand command;
+    for (uint64_t i = 0; i < iterations; i++) {
+        ParseTextCommand(ctx->session, lines[i & 3], &command);
+        ctx->sink += (uint64_t)command.choice;
+    }
+}
+
+static void BenchRenderLocation(BenchContext *ctx, uint64_t iterations) {
+    for (uint64_t i = 0; i < iterations; i++) {
+        FrameReset(&ctx->frame);
+        RenderLocation(ctx->session, &ctx->frame);
+        ctx->bytes += ctx->frame.size;
+    }
+}
+
+static void BenchRenderInventory(BenchContext *ctx, uint64_t iterations) {
+    for (uint64_t i = 0; i < iterations; i++) {
+        FrameReset(&ctx->frame);
+        RenderInventory(ctx->session, &ctx->frame);
+        ctx->bytes += ctx->frame.size;
+    }
+}
+
+static void BenchUndo(BenchContext *ctx, uint64_t iterations) {
+    // Ход вперёд и откат: запись снимка в историю и восстановление из неё
+    for (uint64_t i = 0; i < iterations; i++) {
+        StepGameSession(ctx->session, SYN_MOVE + 1);
+        ctx->sink += UndoTurns(ctx->session, 1);
+    }
+}
+
+static void BenchDialogTurn(BenchContext *ctx, uint64_t iterations) {
+    // Полный ход через пошаговый диалог: разбор строки, ход, экран в кадр
+    for (uint64_t i = 0; i < iterations; i++) {
+        FrameReset(&ctx->frame);
+        ctx->sink += StepDialog(ctx->session, "1\n", &ctx->frame);
+        ctx->bytes += ctx->frame.size;
+    }
+}
+
+/* [[ Макробенчмарки ]] */
+
+static uint64_t PlayThrough(GameSession *session, uint64_t games) {
+    uint64_t wins = 0;
+    for (uint64_t g = 0; g < games; g++) {
+        InitGameModel(session);
+        for (size_t i = 0; i < sizeof walkthrough / sizeof walkthrough[0]; i++) {
+            StepGameSession(session, walkthrough[i]);
+        }
+        wins += IsGameWon(session);
+    }
+    return wins;
+}
+
+static void BenchPlaythrough(BenchContext *ctx, uint64_t iterations) {
+    ctx->sink += PlayThrough(ctx->session, iterations);
+}
+
+typedef struct {
+    const World *world;
+    uint64_t games;
+    uint64_t wins;
+    uint64_t allocations;
+} PlaythroughWorker;
+
+static int PlaythroughThread(void *arg) {
+    PlaythroughWorker *worker = arg;
+    uint64_t before = allocationCount;
+    GameSession *session = CreateGameSession(worker->world);
+    if (session != NULL) {
+        worker->wins = PlayThrough(session, worker->games);
+        DestroyGameSession(session);
+    }
+    worker->allocations = allocationCount - before;
+    return 0;
+}
+
+/*
+ * Все ядра: каждый поток ведёт свою сессию над общим миром.
+ * ns/op - стенное время на одно прохождение по всем потокам вместе.
+ */
+static BenchResult RunParallelPlaythrough(const World *world, uint64_t gamesPerThread, int threads) {
+    BenchResult best = {"playthrough_parallel", threads, gamesPerThread * (uint64_t)threads, 0, 0, 0};
+    PlaythroughWorker *workers = calloc((size_t)threads, sizeof *workers);
+    thrd_t *handles = calloc((size_t)threads, sizeof *handles);
+
+    if (workers == NULL || handles == NULL) {
+        free(workers);
+        free(handles);
+        best.nsPerOp = -1;
+        return best;
+    }
+
+    for (int run = 0; run < BENCH_RUNS; run++) {
+        uint64_t started = NowNanoseconds();
+        int spawned = 0;
+        for (int t = 0; t < threads; t++) {
+            workers[t] = (PlaythroughWorker){world, gamesPerThread, 0, 0};
+            if (thrd_create(&handles[t], PlaythroughThread, &workers[t]) != thrd_success) {
+                break;
+            }
+            spawned++;
+        }
+        uint64_t allocations = 0;
+        for (int t = 0; t < spawned; t++) {
+            thrd_join(handles[t], NULL);
+            allocations += workers[t].allocations;
+        }
+        uint64_t elapsed = NowNanoseconds() - started;
+        uint64_t total = gamesPerThread * (uint64_t)spawned;
+        double nsPerOp = total > 0 ? (double)elapsed / (double)total : -1;
+
+        if (run == 0 || (nsPerOp >= 0 && nsPerOp < best.nsPerOp)) {
+            best.nsPerOp = nsPerOp;
+            best.threads = spawned;
+            best.iterations = total;
+            best.allocsPerOp = total > 0 ? (double)allocations / (double)total : 0;
+        }
+    }
+
+    free(workers);
+    free(handles);
+#ifndef BENCH_COUNT_ALLOCATIONS
+    best.allocsPerOp = -1;
+#endif
+    return best;
+}
+
+/*
+ * Пул рабочих: POOL_SESSIONS синтетических сессий, у каждой полная очередь
+ * переходов. Ходы ставятся до запуска потоков, замеряется только их
+ * выполнение - от StartWorkerPool до опустошения очередей.
+ */
+#define POOL_SESSIONS 4096
+
+static BenchResult RunPoolScaling(const World *world, int threads, double scale) {
+    BenchResult best = {"pool_turns", threads, 0, -1, -1, 0};
+    int sessions = (int)(POOL_SESSIONS * scale);
+    if (sessions < 1) {
+        sessions = 1;
+    }
+    GameSession **games = calloc((size_t)sessions, sizeof *games);
+    PoolSession **pooled = calloc((size_t)sessions, sizeof *pooled);
+    if (games == NULL || pooled == NULL) {
+        free(games);
+        free(pooled);
+        return best;
+    }
+    for (int i = 0; i < sessions; i++) {
+        games[i] = CreateGameSession(world);
+    }
+
+    for (int run = 0; run < BENCH_RUNS; run++) {
+        WorkerPool *pool = CreateWorkerPool(threads);
+        if (pool == NULL) {
+            break;
+        }
+        uint64_t submitted = 0;
+        for (int i = 0; i < sessions; i++) {
+            if (games[i] == NULL) {
+                continue;
+            }
+            pooled[i] = AttachPoolSession(pool, games[i], NULL, NULL);
+            while (pooled[i] != NULL && SubmitTurn(pooled[i], SYN_MOVE + 1)) {
+                submitted++;
+            }
+        }
+
+        uint64_t allocationsBefore = allocationCount;
+        uint64_t started = NowNanoseconds();
+        if (StartWorkerPool(pool)) {
+            WaitWorkerPoolIdle(pool);
+        }
+        uint64_t elapsed = NowNanoseconds() - started;
+        uint64_t allocations = allocationCount - allocationsBefore;
+
+        DestroyWorkerPool(pool);
+        for (int i = 0; i < sessions; i++) {
+            DetachPoolSession(pooled[i]);
+            pooled[i] = NULL;
+        }
+
+        double nsPerOp = submitted > 0 ? (double)elapsed / (double)submitted : -1;
+        if (best.nsPerOp < 0 || (nsPerOp >= 0 && nsPerOp < best.nsPerOp)) {
+            best.nsPerOp = nsPerOp;
+            best.iterations = submitted;
+            best.allocsPerOp = submitted > 0 ? (double)allocations / (double)submitted : 0;
+        }
+    }
+
+    for (int i = 0; i < sessions; i++) {
+        DestroyGameSession(games[i]);
+    }
+    free(games);
+    free(pooled);
+#ifndef BENCH_COUNT_ALLOCATIONS
+    best.allocsPerOp = -1;
+#endif
+    return best;
+}
+
+/*
+ * Хранилище партий: запись партии в слот после хода и открытие файла
+ * с STORE_SESSIONS сохранёнными партиями особняка - то, что делает
+ * сервер при перезапуске. ns/op открытия - на одну найденную партию.
+ * Файл только что записан и лежит в страничном кэше, как после
+ * падения процесса.
+ */
+#define STORE_SESSIONS 262144
+#define STORE_PATH "bench-sessions.tmp"
+
+static BenchResult RunStoreSave(const World *world, double scale) {
+    BenchResult best = {"session_store_save", 1, 0, -1, -1, 0};
+    uint64_t iterations = (uint64_t)(5000000.0 * scale);
+    remove(STORE_PATH);
+    SessionStore *store = OpenSessionStore(STORE_PATH, world, 64);
+    GameSession *session = CreateGameSession(world);
+    SessionCode code;
+    int slot = store != NULL ? NewStoredSession(store, &code) : -1;
+
+    if (slot >= 0 && session != NULL && iterations > 0) {
+        StepGameSession(session, 2);   // газета
+        for (int run = 0; run < BENCH_RUNS; run++) {
+            uint64_t started = NowNanoseconds();
+            for (uint64_t i = 0; i < iterations; i++) {
+                SaveStoredSession(store, slot, GetSessionState(session));
+            }
+            double nsPerOp = (double)(NowNanoseconds() - started) / (double)iterations;
+            if (best.nsPerOp < 0 || nsPerOp < best.nsPerOp) {
+                best.nsPerOp = nsPerOp;
+                best.iterations = iterations;
+            }
+        }
+    }
+    DestroyGameSession(session);
+    CloseSessionStore(store);
+    remove(STORE_PATH);
+    return best;
+}
+
+static BenchResult RunStoreRecovery(const World *world, double scale) {
+    BenchResult best = {"session_store_open", 1, 0, -1, -1, 0};
+    uint32_t sessions = (uint32_t)(STORE_SESSIONS * scale);
+    if (sessions < 1) {
+        sessions = 1;
+    }
+    remove(STORE_PATH);
+    SessionStore *store = OpenSessionStore(STORE_PATH, world, sessions);
+    GameSession *session = CreateGameSession(world);
+    if (store == NULL || session == NULL) {
+        DestroyGameSession(session);
+        CloseSessionStore(store);
+        remove(STORE_PATH);
+        return best;
+    }
+    StepGameSession(session, 2);   // газета
+    for (uint32_t i = 0; i < sessions; i++) {
+        SessionCode code;
+        int slot = NewStoredSession(store, &code);
+        SaveStoredSession(store, slot, GetSessionState(session));
+        ReleaseStoredSession(store, slot, true);
+    }
+    CloseSessionStore(store);
+    DestroyGameSession(session);
+
+    for (int run = 0; run < BENCH_RUNS; run++) {
+        uint64_t allocationsBefore = allocationCount;
+        uint64_t started = NowNanoseconds();
+        store = OpenSessionStore(STORE_PATH, world, sessions);
+        uint64_t elapsed = NowNanoseconds() - started;
+        if (store == NULL) {
+            break;
+        }
+        SessionStoreStats stats = GetSessionStoreStats(store);
+        CloseSessionStore(store);
+        double nsPerOp = stats.recovered > 0 ? (double)elapsed / (double)stats.recovered : -1;
+        if (best.nsPerOp < 0 || (nsPerOp >= 0 && nsPerOp < best.nsPerOp)) {
+            best.nsPerOp = nsPerOp;
+            best.iterations = stats.recovered;
+            best.allocsPerOp = stats.recovered > 0 ?
+                               (double)(allocationCount - allocationsBefore) / (double)stats.recovered : 0;
+        }
+    }
+    remove(STORE_PATH);
+#ifndef BENCH_COUNT_ALLOCATIONS
+    best.allocsPerOp = -1;
+#endif
+    return best;
+}
+
+/* [[ Запуск ]] */
+
+static const Benchmark benchmarks[] = {
+    {"session_create_destroy",       SetupMansion,           BenchSessionLifecycle,          2000000},
+    {"new_game",                     SetupMansion,           BenchNewGame,                   20000000},
+    {"execute_move",                 SetupSynthetic,         BenchExecuteMove,               20000000},
+    {"execute_take_item+reset",      SetupSynthetic,         BenchExecuteTake,               20000000},
+    {"execute_text",                 SetupSynthetic,         BenchExecuteText,               20000000},
+    {"execute_requirement_met",      SetupSyntheticWithLamp, BenchExecuteRequirementMet,     20000000},
+    {"execute_requirement_missing",  SetupSynthetic,         BenchExecuteRequirementMissing, 20000000},
+    {"step_and_undo",                SetupSynthetic,         BenchUndo,                      20000000},
+    {"has_item",                     SetupSyntheticWithLamp, BenchHasItem,                   50000000},
+    {"win_check",                    SetupMansion,           BenchWinCheck,                  50000000},
+    {"metric_counter",               SetupMansion,           BenchMetricCounter,             50000000},
+    {"metric_timer",                 SetupMansion,           BenchMetricTimer,               20000000},
+    {"dialog_turn",                  SetupSyntheticDialog,   BenchDialogTurn,                2000000},
+    {"parse_text_command",           SetupMansionDining,     BenchParseText,                 5000000},
+    {"render_location",              SetupMansionDining,     BenchRenderLocation,            2000000},
+    {"render_inventory",             SetupMansionInventory,  BenchRenderInventory,           2000000},
+    {"playthrough",                  SetupMansion,           BenchPlaythrough,               2000000},
+};
+
+static BenchResult RunBenchmark(BenchContext *ctx, const Benchmark *bench, double scale) {
+    BenchResult best = {bench->name, 1, 0, 0, 0, 0};
+    uint64_t iterations = (uint64_t)((double)bench->iterations * scale);
+    if (iterations == 0) {
+        iterations = 1;
+    }
+    best.iterations = iterations;
+
+    bench->setup(ctx);
+    bench->run(ctx, iterations / 10 + 1);  // прогрев
+
+    for (int run = 0; run < BENCH_RUNS; run++) {
+        bench->setup(ctx);
+        ctx->bytes = 0;
+        uint64_t allocationsBefore = allocationCount;
+        uint64_t started = NowNanoseconds();
+        bench->run(ctx, iterations);
+        uint64_t elapsed = NowNanoseconds() - started;
+        double nsPerOp = (double)elapsed / (double)iterations;
+
+        if (run == 0 || nsPerOp < best.nsPerOp) {
+            best.nsPerOp = nsPerOp;
+            best.allocsPerOp = (double)(allocationCount - allocationsBefore) / (double)iterations;
+            best.bytesPerOp = (double)ctx->bytes / (double)iterations;
+        }
+    }
+#ifndef BENCH_COUNT_ALLOCATIONS
+    best.allocsPerOp = -1;
+#endif
+    return best;
+}
+
+static void PrintResult(const BenchResult *result, bool json) {
+    double opsPerSec = result->nsPerOp > 0 ? 1e9 / result->nsPerOp : 0;
+
+    if (json) {
+        printf("{\"name\":\"%s\",\"threads\":%d,\"iterations\":%llu,\"ns_per_op\":%.3f,"
+               "\"ops_per_sec\":%.0f,\"allocs_per_op\":%.3f,\"bytes_per_op\":%.1f}\n",
+               result->name, result->threads, (unsigned long long)result->iterations,
+               result->nsPerOp, opsPerSec, result->allocsPerOp, result->bytesPerOp);
+    } else {
+        char allocs[32];
+        if (result->allocsPerOp < 0) {
+            snprintf(allocs, sizeof allocs, "%s", "n/a");
+        } else {
+            snprintf(allocs, sizeof allocs, "%.3f", result->allocsPerOp);
+        }
+        printf("%-30s %4d %12llu %12.2f %14.0f %10s %10.1f\n", result->name, result->threads,
+               (unsigned long long)result->iterations, result->nsPerOp, opsPerSec, allocs,
+               result->bytesPerOp);
+    }
+    fflush(stdout);
+}
+
+static void PrintUsage(const char *program) {
+    fprintf(stderr,
+            "Usage: %s [--format text|json] [--filter SUBSTRING] [--scale FACTOR] [--threads N]\n",
+            program);
+}
+
+int main(int argc, char **argv) {
+    bool json = false;
+    const char *filter = NULL;
+    double scale = 1.0;
+    int threads = GetCpuCount();
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--format") == 0 && i + 1 < argc) {
+            json = strcmp(argv[++i], "json") == 0;
+        } else if (strcmp(argv[i], "--filter") == 0 && i + 1 < argc) {
+            filter = argv[++i];
+        } else if (strcmp(argv[i], "--scale") == 0 && i + 1 < argc) {
+            scale = strtod(argv[++i], NULL);
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            threads = atoi(argv[++i]);
+        } else {
+            PrintUsage(argv[0]);
+            return 2;
+        }
+    }
+    if (scale <= 0 || threads <= 0) {
+        PrintUsage(argv[0]);
+        return 2;
+    }
+
+    BenchContext ctx;
+    memset(&ctx, 0, sizeof ctx);
+    FrameInit(&ctx.frame);
+    ctx.mansion = LoadDefaultWorld();
+    ctx.synthetic = BuildSyntheticWorld();
+    if (ctx.mansion == NULL || ctx.synthetic == NULL) {
+        fprintf(stderr, "cannot build benchmark worlds\n");
+        return 1;
+    }
+
+    if (!json) {
+        printf("%-30s %4s %12s %12s %14s %10s %10s\n", "benchmark", "thr", "iterations", "ns/op",
+               "ops/sec", "allocs/op", "bytes/op");
+    }
+
+    for (size_t i = 0; i < sizeof benchmarks / sizeof benchmarks[0]; i++) {
+        if (filter != NULL && strstr(benchmarks[i].name, filter) == NULL) {
+            continue;
+        }
+        BenchResult result = RunBenchmark(&ctx, &benchmarks[i], scale);
+        PrintResult(&result, json);
+    }
+
+    if (filter == NULL || strstr("playthrough_parallel", filter) != NULL) {
+        uint64_t perThread = (uint64_t)(2000000.0 * scale);
+        BenchResult result = RunParallelPlaythrough(ctx.mansion, perThread > 0 ? perThread : 1, threads);
+        PrintResult(&result, json);
+    }
+
+    // Масштабирование пула: 1, 2, 4 ... потока и все ядра
+    if (filter == NULL || strstr("pool_turns", filter) != NULL) {
+        for (int t = 1;; t *= 2) {
+            if (t > threads) {
+                t = threads;
+            }
+            BenchResult result = RunPoolScaling(ctx.synthetic, t, scale);
+            PrintResult(&result, json);
+            if (t == threads) {
+                break;
+            }
+        }
+    }
+
+    if (filter == NULL || strstr("session_store_save", filter) != NULL) {
+        BenchResult result = RunStoreSave(ctx.mansion, scale);
+        PrintResult(&result, json);
+    }
+    if (filter == NULL || strstr("session_store_open", filter) != NULL) {
+        BenchResult result = RunStoreRecovery(ctx.mansion, scale);
+        PrintResult(&result, json);
+    }
+
+    DestroyGameSession(ctx.session);
+    FrameFree(&ctx.frame);
+    UnloadWorld((World *)ctx.synthetic);
+    return ctx.sink == 42 ? 3 : 0;
+}
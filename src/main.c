@@ -1,5 +1,9 @@
 #include <stdbool.h>
+#include <errno.h>
+#include <limits.h>
 #include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
 #include <locale.h>
 #ifdef _WIN32
 #include <windows.h>
@@ -7,6 +11,10 @@
 #include <fcntl.h>
 #endif
 #include "services/game-service.h"
+#include "services/batch-service.h"
+#include "services/server-service.h"
+#include "models/world.h"
+#include "utils/metrics.h"
 
 /*
  * @brief Инициализация консоли и кодировки для Windows
@@ -31,8 +39,224 @@ void InitConsole() {
     setlocale(LC_CTYPE, "Russian");
 }
 
-int main() {
+/*
+ * @brief Подсказка по параметрам командной строки
+ */
+static void PrintUsage(const char *program) {
+    fprintf(stderr,
+            "Использование: %s [--world файл.world [--world-cache КиБ]] [--batch файл|-]\n"
+            "               [--output none|transcript|summary] [--repeat N]\n"
+            "               [--serve порт [--bind адрес] [--max-clients N]\n"
+            "                [--protocol text|json|binary]\n"
+            "                [--sessions файл [--session-slots N]]]\n"
+            "               [--journal файл] [--stats секунды]\n"
+            "\n"
+            "  --world   мир из двоичного файла (по умолчанию встроенный особняк)\n"
+            "  --world-cache  тексты мира читать по требованию, держа в памяти\n"
+            "            не больше N КиБ (для очень больших миров)\n"
+            "  --batch   безголовый режим: команды из файла или stdin, без пауз\n"
+            "  --output  что печатать в безголовом режиме (по умолчанию summary)\n"
+            "  --repeat  сколько раз проиграть сценарий\n"
+            "  --serve   сетевой режим: telnet-подключения на порту (только Linux);\n"
+            "            SIGHUP перечитывает файл --world без остановки партий;\n"
+            "            файл заменять целиком (world-compiler пишет во временный\n"
+            "            и переименовывает), а не переписывать на месте\n"
+            "  --bind    адрес сетевого режима (по умолчанию 127.0.0.1)\n"
+            "  --max-clients  предел одновременных подключений (по умолчанию 10000)\n"
+            "  --protocol  что получают клиенты: экраны telnet (text, по умолчанию)\n"
+            "            или изменения состояния строками JSON либо двоичными кадрами\n"
+            "  --sessions  хранилище партий сетевого режима: партии переживают\n"
+            "            обрыв и перезапуск, продолжить - /resume КОД\n"
+            "  --session-slots  слотов в новом хранилище (по умолчанию 65536)\n"
+            "  --journal журнал действий на дозапись (проверяется journal-replay)\n"
+            "  --stats   отчёт метрик в stderr каждые N секунд и при выходе\n"
+            "            (0 - только при выходе); в игре и по сети - команда /stats\n",
+            program);
+}
+
+/*
+ * @brief Целое число из аргумента командной строки
+ * @return false, если аргумент не число целиком или не помещается в long
+ */
+static bool ParseNumber(const char *text, long *value) {
+    char *end;
+    errno = 0;
+    *value = strtol(text, &end, 10);
+    return end != text && *end == '\0' && errno == 0;
+}
+
+int main(int argc, char **argv) {
+   const char *worldPath = NULL;
+   const char *journalPath = NULL;
+   const char *sessionsPath = NULL;
+   long sessionSlots = 0;
+   int statsInterval = -1;
+   long worldCache = 0;
+   BatchOptions batch = { NULL, BATCH_OUTPUT_SUMMARY, 1, NULL };
+   ServerOptions server = { NULL, 0, 0, NULL, SERVER_PROTOCOL_TEXT, NULL, 0, NULL };
+
+   for (int i = 1; i < argc; i++) {
+       if (strcmp(argv[i], "--world") == 0 && i + 1 < argc) {
+           worldPath = argv[++i];
+       } else if (strcmp(argv[i], "--world-cache") == 0 && i + 1 < argc) {
+           worldCache = strtol(argv[++i], NULL, 10);
+           if (worldCache <= 0) {
+               PrintUsage(argv[0]);
+               return 1;
+           }
+       } else if (strcmp(argv[i], "--batch") == 0 && i + 1 < argc) {
+           batch.scriptPath = argv[++i];
+       } else if (strcmp(argv[i], "--output") == 0 && i + 1 < argc) {
+           const char *mode = argv[++i];
+           if (strcmp(mode, "none") == 0) {
+               batch.output = BATCH_OUTPUT_NONE;
+           } else if (strcmp(mode, "transcript") == 0) {
+               batch.output = BATCH_OUTPUT_TRANSCRIPT;
+           } else if (strcmp(mode, "summary") == 0) {
+               batch.output = BATCH_OUTPUT_SUMMARY;
+           } else {
+               PrintUsage(argv[0]);
+               return 1;
+           }
+       } else if (strcmp(argv[i], "--repeat") == 0 && i + 1 < argc) {
+           if (!ParseNumber(argv[++i], &batch.repeat) || batch.repeat <= 0) {
+               PrintUsage(argv[0]);
+               return 1;
+           }
+       } else if (strcmp(argv[i], "--serve") == 0 && i + 1 < argc) {
+           server.port = atoi(argv[++i]);
+           if (server.port <= 0 || server.port > 65535) {
+               PrintUsage(argv[0]);
+               return 1;
+           }
+       } else if (strcmp(argv[i], "--bind") == 0 && i + 1 < argc) {
+           server.address = argv[++i];
+       } else if (strcmp(argv[i], "--max-clients") == 0 && i + 1 < argc) {
+           long maxClients;
+           if (!ParseNumber(argv[++i], &maxClients) || maxClients <= 0 || maxClients > INT_MAX) {
+               PrintUsage(argv[0]);
+               return 1;
+           }
+           server.maxClients = (int)maxClients;
+       } else if (strcmp(argv[i], "--protocol") == 0 && i + 1 < argc) {
+           const char *protocol = argv[++i];
+           if (strcmp(protocol, "text") == 0) {
+               server.protocol = SERVER_PROTOCOL_TEXT;
+           } else if (strcmp(protocol, "json") == 0) {
+               server.protocol = SERVER_PROTOCOL_JSON;
+           } else if (strcmp(protocol, "binary") == 0) {
+               server.protocol = SERVER_PROTOCOL_BINARY;
+           } else {
+               PrintUsage(argv[0]);
+               return 1;
+           }
+       } else if (strcmp(argv[i], "--sessions") == 0 && i + 1 < argc) {
+           sessionsPath = argv[++i];
+       } else if (strcmp(argv[i], "--session-slots") == 0 && i + 1 < argc) {
+           sessionSlots = strtol(argv[++i], NULL, 10);
+           if (sessionSlots <= 0 || sessionSlots > SESSION_STORE_MAX_SLOTS) {
+               PrintUsage(argv[0]);
+               return 1;
+           }
+       } else if (strcmp(argv[i], "--journal") == 0 && i + 1 < argc) {
+           journalPath = argv[++i];
+       } else if (strcmp(argv[i], "--stats") == 0 && i + 1 < argc) {
+           // 0 - отчёт только при выходе
+           long seconds;
+           if (!ParseNumber(argv[++i], &seconds) || seconds < 0 || seconds > INT_MAX) {
+               PrintUsage(argv[0]);
+               return 1;
+           }
+           statsInterval = (int)seconds;
+       } else {
+           PrintUsage(argv[0]);
+           return 1;
+       }
+   }
+
+   if (sessionsPath != NULL && server.port == 0) {
+       // Партии сохраняются только в сетевом режиме
+       PrintUsage(argv[0]);
+       return 1;
+   }
+
    InitConsole();
-   GameInit();
-   return 0;
+
+   // Мир из файла отображается в память; без файла - встроенный особняк.
+   // Сервер перечитывает файл по SIGHUP, поэтому держит копию образа
+   World *loaded = NULL;
+   const World *world;
+   if (worldPath != NULL && server.port != 0) {
+       loaded = LoadWorldFileCopy(worldPath, (size_t)worldCache * 1024);
+       world = loaded;
+   } else if (worldPath != NULL && worldCache > 0) {
+       loaded = LoadWorldFilePaged(worldPath, (size_t)worldCache * 1024);
+       world = loaded;
+   } else if (worldPath != NULL) {
+       loaded = LoadWorldFile(worldPath);
+       world = loaded;
+   } else {
+       world = LoadDefaultWorld();
+   }
+   if (world == NULL) {
+       return 1;
+   }
+
+   // Журнал пишется своим потоком, ходы диск не ждут
+   Journal *journal = NULL;
+   if (journalPath != NULL) {
+       journal = OpenJournal(journalPath, world);
+       if (journal == NULL) {
+           UnloadWorld(loaded);
+           return 1;
+       }
+   }
+   // Партии прошлых запусков: файл отображается заново, без разбора
+   SessionStore *sessions = NULL;
+   if (sessionsPath != NULL) {
+       sessions = OpenSessionStore(sessionsPath, world, (uint32_t)sessionSlots);
+       if (sessions == NULL) {
+           CloseJournal(journal);
+           UnloadWorld(loaded);
+           return 1;
+       }
+   }
+   batch.journal = journal;
+   server.journal = journal;
+   server.worldPath = worldPath;
+   server.worldCache = (size_t)worldCache * 1024;
+   server.sessions = sessions;
+
+   if (statsInterval > 0) {
+       StartMetricsReporter(statsInterval);
+   }
+
+   int status = 0;
+   if (batch.scriptPath != NULL) {
+       status = RunBatch(world, &batch);
+   } else if (server.port != 0) {
+       // Версии мира, включая эту, выгружает сервер
+       status = RunServer(world, &server);
+       loaded = NULL;
+   } else {
+       GameInit(world, journal);
+   }
+   if (statsInterval >= 0) {
+       StopMetricsReporter();
+       FrameBuffer report;
+       FrameInit(&report);
+       RenderMetrics(&report);
+       fwrite(report.data, 1, report.size, stderr);
+       FrameFree(&report);
+   }
+   CloseSessionStore(sessions);
+   if (journal != NULL) {
+       JournalStats stats = GetJournalStats(journal);
+       CloseJournal(journal);
+       if (stats.dropped > 0) {
+           fprintf(stderr, "journal: %llu records dropped\n", (unsigned long long)stats.dropped);
+       }
+   }
+   UnloadWorld(loaded);
+   return status;
 }
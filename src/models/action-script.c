@@ -0,0 +1,406 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <errno.h>
+#include "action-script.h"
+
+/* [[ Внутренние структуры ]] */
+
+typedef struct {
+    const char *cursor;
+    char token[SCRIPT_NAME_BYTES];
+    ScriptBuffer *out;
+    ScriptResolver resolve;
+    void *context;
+    int depth;             // глубина стека условия в точке разбора
+    bool failed;
+} ScriptParser;
+
+/* [[ Прототипы внутренних функций ]] */
+static bool ReadToken(ScriptParser *p);
+static bool PeekToken(ScriptParser *p, const char *word);
+static bool ParseOr(ScriptParser *p);
+static bool ParseAnd(ScriptParser *p);
+static bool ParseFactor(ScriptParser *p);
+static bool ParseEffect(ScriptParser *p);
+static bool ReadSymbol(ScriptParser *p, ScriptSymbolKind kind, uint32_t *index);
+static bool ReadNumber(ScriptParser *p, int32_t *value);
+static bool Emit(ScriptParser *p, uint32_t word);
+static bool Push(ScriptParser *p);
+static bool Error(ScriptParser *p, const char *message, const char *detail);
+
+/* [[ Функции сценариев ]] */
+
+/*
+ * @brief Компиляция условия
+ * @param out Сюда дописывается код (без SCRIPT_END)
+ * @param resolve Перевод имён в индексы
+ * @return false при ошибке, текст - в out->error
+ */
+bool CompileCondition(ScriptBuffer *out, const char *text, ScriptResolver resolve, void *context) {
+    ScriptParser p = {text, {0}, out, resolve, context, 0, false};
+
+    if (!ParseOr(&p)) {
+        return false;
+    }
+    if (ReadToken(&p)) {
+        return Error(&p, "лишнее в условии", p.token);
+    }
+    return !p.failed;
+}
+
+/*
+ * @brief Компиляция последствий: список через запятую
+ */
+bool CompileEffects(ScriptBuffer *out, const char *text, ScriptResolver resolve, void *context) {
+    ScriptParser p = {text, {0}, out, resolve, context, 0, false};
+
+    do {
+        if (!ParseEffect(&p)) {
+            return false;
+        }
+        if (!ReadToken(&p)) {
+            return !p.failed;
+        }
+    } while (strcmp(p.token, ",") == 0);
+    return Error(&p, "ожидалась запятая", p.token);
+}
+
+void FreeScriptBuffer(ScriptBuffer *buffer) {
+    free(buffer->code);
+    memset(buffer, 0, sizeof *buffer);
+}
+
+/*
+ * @brief Проверка программы в таблице кода
+ * Операции и операнды в пределах мира, число следует за операцией со
+ * счётчиком, программа кончается SCRIPT_END. У условия стек не выходит
+ * за SCRIPT_STACK_DEPTH и в конце на нём ровно одно значение.
+ *
+ * @param offset Начало программы, 0 - пустая программа
+ * @param condition true - условие, false - последствия
+ * @return NULL или текст ошибки
+ */
+const char* CheckScript(const uint32_t *code, uint32_t codeCount, uint32_t offset, bool condition,
+                        const ScriptLimits *limits) {
+    int depth = 0;
+
+    if (offset == 0) {
+        return NULL;
+    }
+    for (uint32_t at = offset; at < codeCount; at++) {
+        uint32_t op = SCRIPT_OP(code[at]);
+        uint32_t operand = SCRIPT_OPERAND(code[at]);
+        uint32_t limit = 0;
+        bool immediate = false;
+
+        if (op == SCRIPT_END) {
+            return !condition || depth == 1 ? NULL : "condition leaves a wrong stack";
+        }
+        switch ((ScriptOp)op) {
+            case SCRIPT_HAS:         limit = limits->items;     break;
+            case SCRIPT_VISITED:     limit = limits->locations; break;
+            case SCRIPT_FLAG:        limit = limits->flags;     break;
+            case SCRIPT_COUNTER_EQ:
+            case SCRIPT_COUNTER_LT:
+            case SCRIPT_COUNTER_GT:  limit = limits->counters; immediate = true; break;
+            case SCRIPT_NOT:         limit = 1; break;
+            case SCRIPT_AND:
+            case SCRIPT_OR:          limit = 1; break;
+            case SCRIPT_SET_FLAG:
+            case SCRIPT_CLEAR_FLAG:  limit = limits->flags; break;
+            case SCRIPT_ADD_COUNTER:
+            case SCRIPT_SET_COUNTER: limit = limits->counters; immediate = true; break;
+            case SCRIPT_UNLOCK:
+            case SCRIPT_LOCK:        limit = limits->actions; break;
+            case SCRIPT_GIVE:
+            case SCRIPT_TAKE:        limit = limits->items; break;
+            case SCRIPT_END:         break;
+        }
+        bool isCondition = op >= SCRIPT_HAS && op <= SCRIPT_OR;
+        if (limit == 0 || isCondition != condition) {
+            return "script has an unknown or misplaced operation";
+        }
+        if (operand >= limit) {
+            return "script operand out of range";
+        }
+        if (immediate && ++at >= codeCount) {
+            return "script is cut short";
+        }
+        if (!condition) {
+            continue;
+        }
+        if (op == SCRIPT_AND || op == SCRIPT_OR) {
+            if (depth < 2) {
+                return "condition stack underflow";
+            }
+            depth--;
+        } else if (op == SCRIPT_NOT) {
+            if (depth < 1) {
+                return "condition stack underflow";
+            }
+        } else if (++depth > SCRIPT_STACK_DEPTH) {
+            return "condition is nested too deep";
+        }
+    }
+    return "script is cut short";
+}
+
+/* [[ Разбор условия ]] */
+
+static bool ParseOr(ScriptParser *p) {
+    if (!ParseAnd(p)) {
+        return false;
+    }
+    while (PeekToken(p, "or")) {
+        ReadToken(p);
+        if (!ParseAnd(p) || !Emit(p, SCRIPT_WORD(SCRIPT_OR, 0))) {
+            return false;
+        }
+        p->depth--;
+    }
+    return true;
+}
+
+static bool ParseAnd(ScriptParser *p) {
+    if (!ParseFactor(p)) {
+        return false;
+    }
+    while (PeekToken(p, "and")) {
+        ReadToken(p);
+        if (!ParseFactor(p) || !Emit(p, SCRIPT_WORD(SCRIPT_AND, 0))) {
+            return false;
+        }
+        p->depth--;
+    }
+    return true;
+}
+
+static bool ParseFactor(ScriptParser *p) {
+    uint32_t index;
+
+    if (!ReadToken(p)) {
+        return Error(p, "условие оборвано", NULL);
+    }
+    if (strcmp(p->token, "not") == 0) {
+        return ParseFactor(p) && Emit(p, SCRIPT_WORD(SCRIPT_NOT, 0));
+    }
+    if (strcmp(p->token, "(") == 0) {
+        if (!ParseOr(p)) {
+            return false;
+        }
+        if (!ReadToken(p) || strcmp(p->token, ")") != 0) {
+            return Error(p, "ожидалась )", NULL);
+        }
+        return true;
+    }
+    if (strcmp(p->token, "has") == 0) {
+        return ReadSymbol(p, SCRIPT_SYMBOL_ITEM, &index) && Push(p) && Emit(p, SCRIPT_WORD(SCRIPT_HAS, index));
+    }
+    if (strcmp(p->token, "visited") == 0) {
+        return ReadSymbol(p, SCRIPT_SYMBOL_LOCATION, &index) && Push(p) &&
+               Emit(p, SCRIPT_WORD(SCRIPT_VISITED, index));
+    }
+    if (strcmp(p->token, "flag") == 0) {
+        return ReadSymbol(p, SCRIPT_SYMBOL_FLAG, &index) && Push(p) && Emit(p, SCRIPT_WORD(SCRIPT_FLAG, index));
+    }
+    if (strcmp(p->token, "counter") == 0) {
+        // >=, <=, != - отрицание обратного сравнения
+        static const struct {
+            const char *text;
+            ScriptOp op;
+            bool negate;
+        } comparisons[] = {
+            {"=", SCRIPT_COUNTER_EQ, false}, {"==", SCRIPT_COUNTER_EQ, false}, {"!=", SCRIPT_COUNTER_EQ, true},
+            {"<", SCRIPT_COUNTER_LT, false}, {">=", SCRIPT_COUNTER_LT, true},
+            {">", SCRIPT_COUNTER_GT, false}, {"<=", SCRIPT_COUNTER_GT, true},
+        };
+        int32_t value;
+        if (!ReadSymbol(p, SCRIPT_SYMBOL_COUNTER, &index)) {
+            return false;
+        }
+        if (!ReadToken(p)) {
+            return Error(p, "ожидалось сравнение", NULL);
+        }
+        for (size_t i = 0; i < sizeof comparisons / sizeof comparisons[0]; i++) {
+            if (strcmp(p->token, comparisons[i].text) == 0) {
+                return ReadNumber(p, &value) && Push(p) && Emit(p, SCRIPT_WORD(comparisons[i].op, index)) &&
+                       Emit(p, (uint32_t)value) &&
+                       (!comparisons[i].negate || Emit(p, SCRIPT_WORD(SCRIPT_NOT, 0)));
+            }
+        }
+        return Error(p, "неизвестное сравнение", p->token);
+    }
+    return Error(p, "неизвестное условие", p->token);
+}
+
+/* [[ Разбор последствий ]] */
+
+static bool ParseEffect(ScriptParser *p) {
+    static const struct {
+        const char *text;
+        ScriptOp op;
+        ScriptSymbolKind kind;
+    } effects[] = {
+        {"set", SCRIPT_SET_FLAG, SCRIPT_SYMBOL_FLAG},
+        {"clear", SCRIPT_CLEAR_FLAG, SCRIPT_SYMBOL_FLAG},
+        {"add", SCRIPT_ADD_COUNTER, SCRIPT_SYMBOL_COUNTER},
+        {"reset", SCRIPT_SET_COUNTER, SCRIPT_SYMBOL_COUNTER},
+        {"unlock", SCRIPT_UNLOCK, SCRIPT_SYMBOL_ACTION},
+        {"lock", SCRIPT_LOCK, SCRIPT_SYMBOL_ACTION},
+        {"give", SCRIPT_GIVE, SCRIPT_SYMBOL_ITEM},
+        {"take", SCRIPT_TAKE, SCRIPT_SYMBOL_ITEM},
+    };
+    uint32_t index;
+
+    if (!ReadToken(p)) {
+        return Error(p, "ожидалось последствие", NULL);
+    }
+    for (size_t i = 0; i < sizeof effects / sizeof effects[0]; i++) {
+        if (strcmp(p->token, effects[i].text) != 0) {
+            continue;
+        }
+        if (!ReadSymbol(p, effects[i].kind, &index) || !Emit(p, SCRIPT_WORD(effects[i].op, index))) {
+            return false;
+        }
+        if (effects[i].op == SCRIPT_ADD_COUNTER) {
+            int32_t value;
+            return ReadNumber(p, &value) && Emit(p, (uint32_t)value);
+        }
+        if (effects[i].op == SCRIPT_SET_COUNTER) {
+            // reset <счётчик> - в ноль; число необязательно
+            int32_t value = 0;
+            if (ReadToken(p) && strcmp(p->token, ",") != 0) {
+                char *end;
+                errno = 0;
+                long parsed = strtol(p->token, &end, 10);
+                if (*end != '\0' || errno != 0 || parsed < INT32_MIN || parsed > INT32_MAX) {
+                    return Error(p, "ожидалось число", p->token);
+                }
+                value = (int32_t)parsed;
+            } else if (strcmp(p->token, ",") == 0) {
+                p->cursor--;   // запятую разберёт CompileEffects
+            }
+            return Emit(p, (uint32_t)value);
+        }
+        return true;
+    }
+    return Error(p, "неизвестное последствие", p->token);
+}
+
+/* [[ Внутренние функции ]] */
+
+/* Лексема: скобка, запятая, знак сравнения или слово до разделителя */
+static bool ReadToken(ScriptParser *p) {
+    const char *s = p->cursor;
+    while (*s == ' ' || *s == '\t') {
+        s++;
+    }
+    p->token[0] = '\0';
+    if (*s == '\0') {
+        p->cursor = s;
+        return false;
+    }
+
+    const char *start = s;
+    if (*s == '(' || *s == ')' || *s == ',') {
+        s++;
+    } else if (strchr("=!<>", *s) != NULL) {
+        while (*s != '\0' && strchr("=!<>", *s) != NULL) {
+            s++;
+        }
+    } else {
+        while (*s != '\0' && strchr(" \t(),=!<>", *s) == NULL) {
+            s++;
+        }
+    }
+    size_t length = (size_t)(s - start);
+    if (length >= SCRIPT_NAME_BYTES) {
+        length = SCRIPT_NAME_BYTES - 1;
+        Error(p, "слишком длинное имя", NULL);
+    }
+    memcpy(p->token, start, length);
+    p->token[length] = '\0';
+    p->cursor = s;
+    return true;
+}
+
+static bool PeekToken(ScriptParser *p, const char *word) {
+    const char *saved = p->cursor;
+    bool match = ReadToken(p) && strcmp(p->token, word) == 0;
+    p->cursor = saved;
+    return match;
+}
+
+static bool ReadSymbol(ScriptParser *p, ScriptSymbolKind kind, uint32_t *index) {
+    static const char *const kinds[] = {"предмет", "локация", "действие", "флаг", "счётчик"};
+    static const char *const unknown[] = {"неизвестный предмет", "неизвестная локация", "неизвестное действие",
+                                          "неизвестный флаг", "неизвестный счётчик"};
+
+    if (!ReadToken(p) || strchr("(),=!<>", p->token[0]) != NULL) {
+        return Error(p, "ожидалось имя:", kinds[kind]);
+    }
+    int resolved = p->resolve(p->context, kind, p->token);
+    if (resolved < 0) {
+        return Error(p, unknown[kind], p->token);
+    }
+    if ((uint32_t)resolved >= SCRIPT_OPERAND_LIMIT) {
+        return Error(p, "слишком большой индекс", p->token);
+    }
+    *index = (uint32_t)resolved;
+    return true;
+}
+
+static bool ReadNumber(ScriptParser *p, int32_t *value) {
+    char *end;
+
+    if (!ReadToken(p)) {
+        return Error(p, "ожидалось число", NULL);
+    }
+    errno = 0;
+    long parsed = strtol(p->token, &end, 10);
+    if (*end != '\0' || end == p->token || errno != 0 || parsed < INT32_MIN || parsed > INT32_MAX) {
+        return Error(p, "ожидалось число", p->token);
+    }
+    *value = (int32_t)parsed;
+    return true;
+}
+
+static bool Emit(ScriptParser *p, uint32_t word) {
+    ScriptBuffer *out = p->out;
+    if (p->failed) {
+        return false;
+    }
+    if (out->count == out->capacity) {
+        size_t capacity = out->capacity > 0 ? out->capacity * 2 : 16;
+        uint32_t *grown = realloc(out->code, capacity * sizeof(uint32_t));
+        if (grown == NULL) {
+            return Error(p, "не хватает памяти", NULL);
+        }
+        out->code = grown;
+        out->capacity = capacity;
+    }
+    out->code[out->count++] = word;
+    return true;
+}
+
+/* Значение на стек условия */
+static bool Push(ScriptParser *p) {
+    if (++p->depth > SCRIPT_STACK_DEPTH) {
+        return Error(p, "слишком сложное условие", NULL);
+    }
+    return true;
+}
+
+static bool Error(ScriptParser *p, const char *message, const char *detail) {
+    if (!p->failed) {
+        p->failed = true;
+        if (detail != NULL) {
+            snprintf(p->out->error, sizeof p->out->error, "%s %s", message, detail);
+        } else {
+            snprintf(p->out->error, sizeof p->out->error, "%s", message);
+        }
+    }
+    return false;
+}
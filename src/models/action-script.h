@@ -0,0 +1,61 @@
+#ifndef ACTION_SCRIPT_H
+#define ACTION_SCRIPT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "world.h"
+
+/*
+ * [[ Язык сценариев действий ]]
+ *
+ * Условие (ключ when):
+ *   has <предмет> | visited <локация> | flag <флаг>
+ *   counter <счётчик> =|!=|<|<=|>|>= <число>
+ *   not X, X and Y, X or Y, скобки; and связывает сильнее or
+ *
+ * Последствия (ключ do), через запятую:
+ *   set <флаг>, clear <флаг>, add <счётчик> <число>, reset <счётчик> [число],
+ *   unlock <действие>, lock <действие>, give <предмет>, take <предмет>
+ *
+ * Исходник компилируется в байткод (см. ScriptOp в world.h) при сборке
+ * образа; имена в индексы переводит вызывающий через ScriptResolver.
+ */
+#define SCRIPT_NAME_BYTES 64
+
+typedef enum {
+    SCRIPT_SYMBOL_ITEM,
+    SCRIPT_SYMBOL_LOCATION,
+    SCRIPT_SYMBOL_ACTION,
+    SCRIPT_SYMBOL_FLAG,
+    SCRIPT_SYMBOL_COUNTER
+} ScriptSymbolKind;
+
+/* Индекс имени или -1, если имя неизвестно */
+typedef int (*ScriptResolver)(void *context, ScriptSymbolKind kind, const char *name);
+
+/* Код программы без завершающего SCRIPT_END */
+typedef struct {
+    uint32_t *code;
+    size_t count;
+    size_t capacity;
+    char error[160];
+} ScriptBuffer;
+
+/* Пределы индексов для проверки байткода */
+typedef struct {
+    uint32_t items;
+    uint32_t locations;
+    uint32_t actions;
+    uint32_t flags;
+    uint32_t counters;
+} ScriptLimits;
+
+/* [[ Функции сценариев ]] */
+bool CompileCondition(ScriptBuffer *out, const char *text, ScriptResolver resolve, void *context);
+bool CompileEffects(ScriptBuffer *out, const char *text, ScriptResolver resolve, void *context);
+void FreeScriptBuffer(ScriptBuffer *buffer);
+const char* CheckScript(const uint32_t *code, uint32_t codeCount, uint32_t offset, bool condition,
+                        const ScriptLimits *limits);
+
+#endif
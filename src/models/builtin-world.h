@@ -0,0 +1,16 @@
+#ifndef BUILTIN_WORLD_H
+#define BUILTIN_WORLD_H
+
+#include <stddef.h>
+
+/*
+ * [[ Встроенный мир ]]
+ * Образ мира по умолчанию, вкомпилированный в программу. Исходник
+ * генерирует при сборке world-compiler --c-source из worlds/mansion.txt:
+ * таблицы и пул строк - static const, то есть лежат в .rodata,
+ * делятся между процессами и подгружаются страницами по требованию.
+ */
+extern const void *const builtinWorldImage;
+extern const size_t builtinWorldSize;
+
+#endif
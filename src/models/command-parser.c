@@ -0,0 +1,126 @@
+#include <string.h>
+#include <stdint.h>
+#include "command-parser.h"
+#include "lexicon.h"
+
+/* [[ Прототипы внутренних функций ]] */
+static size_t ReadTerms(const Lexicon *lexicon, const char *line, uint32_t *terms, TextCommand *command);
+static bool HasAllTerms(const Lexicon *lexicon, int actionId, const uint32_t *terms, size_t count);
+
+/* [[ Функции разбора ]] */
+
+/*
+ * @brief Разбор строки свободного ввода
+ * Если все слова - встроенные команды, это инвентарь или осмотр.
+ * Иначе подходят действия, у которых есть все введённые термы
+ * (служебные слова вроде "в" и "на" пропускаются).
+ *
+ * @param line Строка ввода в UTF-8
+ * @param command Сюда записывается итог разбора
+ */
+void ParseTextCommand(const GameSession *session, const char *line, TextCommand *command) {
+    const World *world = GetSessionWorld(session);
+    const Lexicon *lexicon = &world->lexicon;
+    uint32_t terms[TEXT_MAX_TERMS];
+
+    memset(command, 0, sizeof *command);
+    if (lexicon->nodes == NULL) {
+        command->kind = TEXT_NO_LEXICON;
+        return;
+    }
+
+    size_t count = ReadTerms(lexicon, line, terms, command);
+    if (command->kind == TEXT_UNKNOWN_WORD) {
+        return;
+    }
+    if (count == 0) {
+        command->kind = TEXT_EMPTY;
+        return;
+    }
+    // Термы отсортированы: встроенные - самые младшие
+    if (terms[count - 1] < LEXICON_FIRST_TERM) {
+        command->kind = terms[0] == LEXICON_TERM_INVENTORY ? TEXT_INVENTORY : TEXT_LOOK;
+        return;
+    }
+
+    const Location *loc = GetCurrentLocation(session);
+    int matches = 0;
+    for (uint32_t i = 0; i < loc->actionCount; i++) {
+        int actionId = GetLocationActionId(world, loc, (int)i);
+        if (!IsActionAvailable(session, actionId) || !HasAllTerms(lexicon, actionId, terms, count)) {
+            continue;
+        }
+        if (matches < TEXT_MAX_CHOICES) {
+            command->choices[matches] = (int)i + 1;
+        }
+        matches++;
+    }
+
+    if (matches == 0) {
+        command->kind = TEXT_NO_MATCH;
+    } else if (matches == 1) {
+        command->kind = TEXT_ACTION;
+        command->choice = command->choices[0];
+    } else {
+        command->kind = TEXT_AMBIGUOUS;
+        command->choiceCount = matches < TEXT_MAX_CHOICES ? matches : TEXT_MAX_CHOICES;
+    }
+}
+
+/* [[ Внутренние функции ]] */
+
+/*
+ * Термы строки по возрастанию без повторов; лишние сверх TEXT_MAX_TERMS
+ * отбрасываются. Первое незнакомое слово - TEXT_UNKNOWN_WORD.
+ */
+static size_t ReadTerms(const Lexicon *lexicon, const char *line, uint32_t *terms, TextCommand *command) {
+    char stem[LEXICON_STEM_BYTES];
+    const char *word;
+    size_t wordLength;
+    size_t count = 0;
+
+    while (NextLexiconWord(&line, stem, &word, &wordLength)) {
+        if (stem[0] == '\0') {
+            continue;
+        }
+        uint32_t term = LookupLexicon(lexicon, stem);
+        if (term == LEXICON_NO_TERM) {
+            command->kind = TEXT_UNKNOWN_WORD;
+            command->word = word;
+            command->wordLength = wordLength;
+            return 0;
+        }
+
+        size_t at = count;
+        while (at > 0 && terms[at - 1] > term) {
+            at--;
+        }
+        if ((at > 0 && terms[at - 1] == term) || count == TEXT_MAX_TERMS) {
+            continue;
+        }
+        memmove(terms + at + 1, terms + at, (count - at) * sizeof(uint32_t));
+        terms[at] = term;
+        count++;
+    }
+    return count;
+}
+
+/* Слияние двух отсортированных списков: все ли термы ввода есть у действия */
+static bool HasAllTerms(const Lexicon *lexicon, int actionId, const uint32_t *terms, size_t count) {
+    const ActionTerms *slice = &lexicon->actionTerms[actionId];
+    if (slice->firstTerm > lexicon->termCount || slice->termCount > lexicon->termCount - slice->firstTerm) {
+        return false;
+    }
+
+    const uint32_t *own = lexicon->terms + slice->firstTerm;
+    uint32_t i = 0;
+    for (size_t t = 0; t < count; t++) {
+        while (i < slice->termCount && own[i] < terms[t]) {
+            i++;
+        }
+        if (i == slice->termCount || own[i] != terms[t]) {
+            return false;
+        }
+    }
+    return true;
+}
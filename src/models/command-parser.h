@@ -0,0 +1,43 @@
+#ifndef COMMAND_PARSER_H
+#define COMMAND_PARSER_H
+
+#include <stddef.h>
+#include "game.h"
+
+/*
+ * [[ Разбор текстовых команд ]]
+ *
+ * Свободный ввод вида "взять ключ", "идти в библиотеку", "библ":
+ * слова сводятся к термам словаря мира (см. lexicon.h), затем среди
+ * доступных действий текущей локации ищутся те, у которых есть все
+ * введённые термы. Просматриваются только действия локации, поэтому
+ * стоимость разбора не зависит от размера мира.
+ */
+#define TEXT_MAX_TERMS 8
+#define TEXT_MAX_CHOICES 8
+
+/* [[ Итог разбора ]] */
+typedef enum {
+    TEXT_ACTION,        // одно подходящее действие, см. choice
+    TEXT_INVENTORY,     // встроенная команда: инвентарь
+    TEXT_LOOK,          // встроенная команда: осмотреться
+    TEXT_UNKNOWN_WORD,  // слова нет в словаре, см. word
+    TEXT_NO_MATCH,      // слова известны, но здесь так сделать нельзя
+    TEXT_AMBIGUOUS,     // подходит несколько действий, см. choices
+    TEXT_EMPTY,         // в строке нет значимых слов
+    TEXT_NO_LEXICON     // у мира нет словаря
+} TextCommandKind;
+
+typedef struct {
+    TextCommandKind kind;
+    int choice;                       // номер действия, как при вводе числа
+    int choiceCount;                  // TEXT_AMBIGUOUS: сколько номеров в choices
+    int choices[TEXT_MAX_CHOICES];
+    const char *word;                 // TEXT_UNKNOWN_WORD: слово во входной строке
+    size_t wordLength;
+} TextCommand;
+
+/* [[ Функции разбора ]] */
+void ParseTextCommand(const GameSession *session, const char *line, TextCommand *command);
+
+#endif
@@ -2,437 +2,1209 @@
 #include <string.h>
 #include <stdlib.h>
 #include <stddef.h>
+#include <stdarg.h>
 #include "game.h"
-#include "../utils/console.h"
+#include "command-parser.h"
+#include "../utils/bitset.h"
+#include "../utils/clock.h"
+#include "../utils/hash.h"
+#include "../utils/layout.h"
+#include "../utils/metrics.h"
 
-static void CopyStringSafe(char *dest, size_t destSize, const char *src) {
-    if (dest == NULL || destSize == 0) {
-        return;
+/* Без байтов выравнивания: хеш и сравнение идут по памяти целиком */
+_Static_assert(sizeof(GameState) == 16, "GameState header must have no padding");
+
+_Static_assert((GAME_HISTORY_DEPTH & (GAME_HISTORY_DEPTH - 1)) == 0, "history depth must be a power of two");
+
+/* [[ Игровая сессия ]] */
+/*
+ * История - кольцо снимков GameState после каждого принятого хода.
+ * Снимок и есть дельта партии (пара десятков байт на малый мир), поэтому
+ * хранить его целиком дешевле, чем собирать из покомандных изменений,
+ * а откат на любой ход в окне - одно копирование.
+ *
+ * Размер состояния известен только по миру, поэтому состояние и кольцо
+ * лежат сразу за структурой в том же блоке. Блоки одного мира одинаковы
+ * и берутся из его пула (World.sessions): создание и уничтожение сессии -
+ * O(1) без malloc, пока пул не растёт.
+ */
+struct GameSession {
+    const World *world;
+    FrameBuffer *output;   // куда пишутся сообщения хода, NULL - никуда
+    GameState *state;
+    size_t stateSize;      // GameStateSize(world)
+    int turn;              // номер хода, 0 - начало партии
+    int lastTurn;          // последний записанный ход (после отката > turn)
+    int firstTurn;         // раньше истории нет: начало партии или перенос в новую версию мира
+    Journal *journal;      // NULL - ходы не записываются
+    uint64_t journalId;
+    uint32_t journalSequence;
+    uint8_t dialogOptions; // DIALOG_*
+    uint8_t dialogPhase;   // DialogPhase
+    uint16_t textWidth;    // ширина переноса описаний в колонках
+    unsigned char *history;  // GAME_HISTORY_DEPTH снимков, слот t % глубина - после хода t
+};
+
+/* [[ Фазы диалога ]] */
+typedef enum {
+    PHASE_COMMAND,     // ждём команду
+    PHASE_PAUSE,       // ждём Enter после сообщения
+    PHASE_WIN_PAUSE,   // ждём Enter после экрана победы
+    PHASE_DONE
+} DialogPhase;
+
+/* [[ Прототипы внутренних функций ]] */
+static GameState* HistorySlot(const GameSession *session, int turn);
+static void ResetHistory(GameSession *session);
+static uint32_t MoveBitset(const World *from, const World *to, WorldKeyKind kind, const uint64_t *bits, int count,
+                           uint64_t *target);
+static StepResult StepTurn(GameSession *session, int choice);
+static ExpectedInput RunCommand(GameSession *session, const char *line, FrameBuffer *out);
+static ExpectedInput AfterMessage(GameSession *session, FrameBuffer *out);
+static ExpectedInput AfterPause(GameSession *session, FrameBuffer *out);
+static ExpectedInput ShowWin(GameSession *session, FrameBuffer *out);
+static ExpectedInput FinishGame(GameSession *session, FrameBuffer *out);
+static ExpectedInput RenderScreen(GameSession *session, FrameBuffer *out);
+static ExpectedInput RunTextCommand(GameSession *session, const char *line, FrameBuffer *out);
+static void Say(GameSession *session, const char *format, ...);
+static bool CheckCondition(const GameSession *session, uint32_t offset);
+static void ApplyEffects(GameSession *session, uint32_t offset);
+static void WriteJournal(GameSession *session, JournalKind kind, int argument, int result, uint32_t flags,
+                         uint32_t outputHash);
+
+/* [[ Функции сессии ]] */
+
+/*
+ * @brief Создание новой игровой сессии
+ * Берёт блок из пула мира под независимое состояние партии и сразу
+ * инициализирует его.
+ *
+ * @param world Общий неизменяемый мир, должен жить дольше сессии
+ * @return Указатель на сессию или NULL, если не хватило памяти
+ */
+GameSession* CreateGameSession(const World *world) {
+    size_t stateSize = GameStateSize(world);
+    GameSession *session = PoolTake(world->sessions, sizeof(GameSession) + stateSize * (1 + GAME_HISTORY_DEPTH));
+    if (session == NULL) {
+        return NULL;
     }
-    if (src == NULL) {
-        dest[0] = '\0';
+    session->world = world;
+    session->stateSize = stateSize;
+    session->state = (GameState *)(session + 1);
+    session->history = (unsigned char *)session->state + stateSize;
+    session->output = NULL;
+    session->journal = NULL;
+    session->journalId = 0;
+    session->journalSequence = 0;
+    session->dialogOptions = 0;
+    session->dialogPhase = PHASE_COMMAND;
+    session->textWidth = LAYOUT_DEFAULT_WIDTH;
+    InitGameModel(session);
+    METRIC_ADD(COUNTER_SESSIONS_CREATED, 1);
+    return session;
+}
+
+/*
+ * @brief Уничтожение игровой сессии
+ * Блок возвращается в пул мира; память освобождается с миром.
+ *
+ * @param session Сессия (NULL допустим)
+ */
+void DestroyGameSession(GameSession *session) {
+    if (session == NULL) {
         return;
     }
-    strncpy(dest, src, destSize - 1);
-    dest[destSize - 1] = '\0';
+    METRIC_ADD(COUNTER_SESSIONS_DESTROYED, 1);
+    PoolGive(session->world->sessions, session);
+}
+
+/*
+ * @brief Один ход сессии
+ * Выполняет выбор игрока без ожидания ввода и без очистки экрана:
+ * паузы и отрисовка остаются на совести фронтенда (см. GameLoop).
+ *
+ * @param session Сессия
+ * @param choice Выбор игрока: 0 - инвентарь, 1..N - номер действия
+ * @return Результат хода
+ */
+StepResult StepGameSession(GameSession *session, int choice) {
+    // Журналу нужен хеш только того, что дописал этот ход
+    size_t outputStart = session->output != NULL ? session->output->size : 0;
+    METRIC_START(TIMER_STEP, stepStarted);
+    StepResult result = StepTurn(session, choice);
+    METRIC_STOP(TIMER_STEP, stepStarted);
+    METRIC_ADD(COUNTER_TURNS, 1);
+
+    if (session->journal != NULL) {
+        uint32_t flags = 0;
+        uint32_t outputHash = 0;
+        if (session->output != NULL && !session->output->failed) {
+            flags = JOURNAL_FLAG_OUTPUT;
+            outputHash = HashBytes(session->output->data + outputStart, session->output->size - outputStart,
+                                   HASH_SEED);
+        }
+        WriteJournal(session, JOURNAL_STEP, choice, result, flags, outputHash);
+    }
+    return result;
+}
+
+/*
+ * @brief Короткое имя результата хода для журналов и стенограмм
+ */
+const char* StepResultName(StepResult result) {
+    switch (result) {
+        case STEP_OK:        return "ok";
+        case STEP_INVENTORY: return "inventory";
+        case STEP_INVALID:   return "invalid";
+        case STEP_BLOCKED:   return "blocked";
+        case STEP_WON:       return "won";
+        case STEP_FINISHED:  return "finished";
+    }
+    return "?";
 }
 
-/* [[ Глобальное состояние игры ]] */
-static GameState game;
+const World* GetSessionWorld(const GameSession *session) {
+    return session->world;
+}
 
-/* [[ Прототипы внутренних функций ]] */
-static void InitializeLocations();
-static void InitializeItems();
-static Item* CreateItem(const char *name, const char *description);
-static void AddActionToLocation(LocationType loc, const char *text, int targetLoc, 
-                                bool requiresItem, const char *reqItem, 
-                                const char *resultText, Item* givesItem);
+const GameState* GetSessionState(const GameSession *session) {
+    return session->state;
+}
+
+/*
+ * @brief Размер GameState вместе с битовыми множествами мира
+ * Столько байт копировать, сравнивать и хешировать.
+ */
+size_t GameStateSize(const World *world) {
+    return sizeof(GameState) + world->stateWords * sizeof(uint64_t);
+}
+
+/*
+ * @brief Выполнено ли в состоянии условие победы мира
+ * Для утилит, перебирающих состояния без сессии.
+ */
+bool IsWinState(const World *world, const GameState *state) {
+    return world->winItem != NO_ITEM && BitsetTest(state->bits + world->inventoryWord, world->winItem);
+}
+
+/*
+ * @brief Заменить дельту сессии готовым состоянием
+ * Нужна утилитам, перебирающим состояния мира без повторного проигрывания
+ * ходов. История ходов начинается заново с этого состояния.
+ * Состояние другого мира или с локацией вне мира не принимается.
+ *
+ * @return true если состояние установлено
+ */
+bool SetSessionState(GameSession *session, const GameState *state) {
+    if (state->words != session->world->stateWords ||
+        state->currentLocation >= (uint32_t)session->world->locationCount) {
+        return false;
+    }
+    memcpy(session->state, state, session->stateSize);
+    ResetHistory(session);
+    return true;
+}
+
+/*
+ * @brief Перенести партию в другую версию мира
+ * Записи сопоставляются по стабильным ключам (см. WorldKeyKind): игрок
+ * остаётся в той же локации, с теми же предметами, флагами и счётчиками.
+ * Действия, чья доступность в партии не менялась, берут её из нового
+ * мира, изменённые - переносятся. Чего в новом мире нет, пропадает;
+ * исчезнувшая локация - переход в стартовую.
+ *
+ * Номер хода сохраняется, но откатиться можно только до переноса.
+ * Журнал не переносится: он привязан к версии мира.
+ *
+ * @param world Новый мир с индексом ключей (IndexWorldKeys)
+ * @return Новая сессия вместо session (старая уничтожена) или NULL -
+ *         не хватило памяти или нет индекса, session не тронута
+ */
+GameSession* MoveGameSession(GameSession *session, const World *world) {
+    if (world->keyIndex == NULL) {
+        return NULL;
+    }
+    GameSession *moved = CreateGameSession(world);
+    if (moved == NULL) {
+        return NULL;
+    }
+    const World *from = session->world;
+    const GameState *old = session->state;
+    GameState *state = moved->state;
+
+    int location = FindWorldKey(world, WORLD_KEY_LOCATION,
+                                GetWorldKey(from, WORLD_KEY_LOCATION, (int)old->currentLocation));
+    state->currentLocation = (uint32_t)(location >= 0 ? location : world->startLocation);
+    state->flags = old->flags;
+    MoveBitset(from, world, WORLD_KEY_LOCATION, old->bits + from->visitedWord, from->locationCount,
+               state->bits + world->visitedWord);
+    BitsetSet(state->bits + world->visitedWord, (int)state->currentLocation);
+    MoveBitset(from, world, WORLD_KEY_ITEM, old->bits + from->collectedWord, from->itemCount,
+               state->bits + world->collectedWord);
+    state->inventoryCount = MoveBitset(from, world, WORLD_KEY_ITEM, old->bits + from->inventoryWord,
+                                       from->itemCount, state->bits + world->inventoryWord);
+    MoveBitset(from, world, WORLD_KEY_FLAG, old->bits + from->flagWord, from->flagCount,
+               state->bits + world->flagWord);
+
+    // Доступность: только то, что партия изменила относительно начала
+    const uint64_t *available = old->bits + from->availableWord;
+    for (size_t w = 0; w < BITSET_WORDS(from->actionCount); w++) {
+        uint64_t changed = available[w] ^ from->initialAvailable[w];
+        while (changed != 0) {
+            int action = (int)(w * 64) + LowestBit64(changed);
+            changed &= changed - 1;
+            int target = FindWorldKey(world, WORLD_KEY_ACTION, GetWorldKey(from, WORLD_KEY_ACTION, action));
+            if (target < 0) {
+                continue;
+            }
+            if (BitsetTest(available, action)) {
+                BitsetSet(state->bits + world->availableWord, target);
+            } else {
+                BitsetClear(state->bits + world->availableWord, target);
+            }
+        }
+    }
+    for (int c = 0; c < from->counterCount; c++) {
+        int target = old->bits[from->counterWord + (uint32_t)c] != 0 ?
+                     FindWorldKey(world, WORLD_KEY_COUNTER, GetWorldKey(from, WORLD_KEY_COUNTER, c)) : -1;
+        if (target >= 0) {
+            state->bits[world->counterWord + (uint32_t)target] = old->bits[from->counterWord + (uint32_t)c];
+        }
+    }
+
+    moved->output = session->output;
+    moved->dialogOptions = session->dialogOptions;
+    moved->dialogPhase = session->dialogPhase;
+    moved->textWidth = session->textWidth;
+    moved->turn = session->turn;
+    moved->lastTurn = session->turn;
+    moved->firstTurn = session->turn;
+    memcpy(HistorySlot(moved, moved->turn), state, moved->stateSize);
+    DestroyGameSession(session);
+    return moved;
+}
+
+/*
+ * @brief Куда писать сообщения хода (результаты действий, подсказки)
+ * По умолчанию сообщения отбрасываются: безголовый режим и симуляции
+ * не тратят время на форматирование.
+ *
+ * @param output Кадр фронтенда или NULL
+ */
+void SetSessionOutput(GameSession *session, FrameBuffer *output) {
+    session->output = output;
+}
+
+/* [[ Пошаговый диалог ]] */
+/*
+ * Партия как конечный автомат: фронтенд передаёт строку ввода, диалог
+ * дописывает ответ в кадр и сообщает, какой ввод ждёт дальше. Диалог
+ * не читает stdin, не пишет в stdout и никогда не блокируется, поэтому
+ * его одинаково ведут терминал, цикл событий сервера или пул потоков.
+ */
+
+/*
+ * @brief Настройки диалога (DIALOG_*)
+ * Терминал включает паузы и очистку экрана, сервер - перезапуск партии.
+ */
+void SetDialogOptions(GameSession *session, unsigned options) {
+    session->dialogOptions = (uint8_t)options;
+}
+
+/*
+ * @brief Ширина экрана для переноса описаний
+ * @param columns Колонки терминала; 0 - по умолчанию (LAYOUT_DEFAULT_WIDTH)
+ */
+void SetDialogWidth(GameSession *session, int columns) {
+    if (columns <= 0) {
+        columns = LAYOUT_DEFAULT_WIDTH;
+    }
+    session->textWidth = (uint16_t)(columns < LAYOUT_MIN_WIDTH ? LAYOUT_MIN_WIDTH :
+                                    columns > LAYOUT_MAX_WIDTH ? LAYOUT_MAX_WIDTH : columns);
+}
+
+/*
+ * @brief Первый экран диалога
+ * @param out Кадр, в конец которого дописывается ответ
+ * @return Ожидаемый ввод
+ */
+ExpectedInput BeginDialog(GameSession *session, FrameBuffer *out) {
+    if (IsGameOver(session)) {
+        session->dialogPhase = PHASE_DONE;
+        return INPUT_NONE;
+    }
+    return AfterPause(session, out);
+}
+
+/*
+ * @brief Обработать одну строку ввода
+ * @param line Строка без требований к завершающему \n
+ * @param out Кадр, в конец которого дописывается ответ
+ * @return Ожидаемый ввод (INPUT_NONE - диалог окончен)
+ */
+ExpectedInput StepDialog(GameSession *session, const char *line, FrameBuffer *out) {
+    switch ((DialogPhase)session->dialogPhase) {
+        case PHASE_COMMAND:
+            break;
+        case PHASE_PAUSE:
+            return AfterPause(session, out);
+        case PHASE_WIN_PAUSE:
+            return FinishGame(session, out);
+        case PHASE_DONE:
+            return INPUT_NONE;
+    }
+
+    // Сообщения хода идут в тот же кадр, что и ответ диалога
+    FrameBuffer *saved = session->output;
+    session->output = out;
+    ExpectedInput expect = RunCommand(session, line, out);
+    session->output = saved;
+    return expect;
+}
+
+ExpectedInput GetExpectedInput(const GameSession *session) {
+    switch ((DialogPhase)session->dialogPhase) {
+        case PHASE_COMMAND:   return INPUT_COMMAND;
+        case PHASE_PAUSE:
+        case PHASE_WIN_PAUSE: return INPUT_ENTER;
+        case PHASE_DONE:      break;
+    }
+    return INPUT_NONE;
+}
+
+/* [[ История ходов ]] */
+
+/*
+ * @brief Номер текущего хода
+ * Считаются только принятые ходы; инвентарь и отказы ходом не являются.
+ */
+int GetTurnNumber(const GameSession *session) {
+    return session->turn;
+}
+
+/*
+ * @brief Самый ранний ход, к которому ещё можно вернуться
+ */
+int GetOldestTurn(const GameSession *session) {
+    int oldest = session->lastTurn - (GAME_HISTORY_DEPTH - 1);
+    return oldest > session->firstTurn ? oldest : session->firstTurn;
+}
+
+/*
+ * @brief Отменить последние ходы
+ * @param count Сколько ходов отменить (0 - ничего)
+ * @return false если столько ходов нет в истории, состояние тогда не меняется
+ */
+bool UndoTurns(GameSession *session, int count) {
+    return count >= 0 && RewindToTurn(session, session->turn - count);
+}
+
+/*
+ * @brief Вернуть партию к состоянию после хода turn
+ * O(1): снимок берётся из кольца. После отката можно снова перейти
+ * вперёд, пока не сделан новый ход - он обрезает историю с этого места.
+ *
+ * @return false если ход вне окна истории (см. GetOldestTurn)
+ */
+bool RewindToTurn(GameSession *session, int turn) {
+    bool ok = turn >= GetOldestTurn(session) && turn <= session->lastTurn;
+
+    if (ok) {
+        memcpy(session->state, HistorySlot(session, turn), session->stateSize);
+        session->turn = turn;
+    }
+    if (session->journal != NULL) {
+        WriteJournal(session, JOURNAL_REWIND, turn, ok, 0, 0);
+    }
+    return ok;
+}
+
+/* [[ Журнал сессии ]] */
+
+/*
+ * @brief Подключить журнал действий
+ * Сессия получает новый идентификатор и пишет NEW_GAME с текущим
+ * состоянием; дальше записываются все ходы, откаты и новые партии.
+ * Состояние, подменённое через SetSessionState, в журнал не попадает.
+ *
+ * @param journal Журнал или NULL, чтобы отключить запись
+ */
+void SetSessionJournal(GameSession *session, Journal *journal) {
+    session->journal = journal;
+    session->journalSequence = 0;
+    session->journalId = journal != NULL ? NewJournalSession(journal) : 0;
+    if (journal != NULL) {
+        WriteJournal(session, JOURNAL_NEW_GAME, 0, 1, 0, 0);
+    }
+}
+
+uint64_t GetSessionJournalId(const GameSession *session) {
+    return session->journalId;
+}
+
+/*
+ * @brief Хеш состояния партии для сверки журнала
+ * Байтов выравнивания в GameState нет, поэтому хешируется вся память
+ * состояния вместе с битовыми множествами.
+ */
+uint32_t HashGameState(const GameState *state) {
+    return HashBytes(state, sizeof(GameState) + state->words * sizeof(uint64_t), HASH_SEED);
+}
 
 /* [[ Функции игры ]] */
 
 /*
  * @brief Инициализация игровой модели
- * Создаёт все локации, предметы и начальное состояние
+ * Сбрасывает дельту сессии к началу партии. Мир не перестраивается.
+ *
+ * @param session Сессия, состояние которой сбрасывается
  */
-void InitGameModel() {
-    memset(&game, 0, sizeof(GameState));
-    game.currentLocation = LOCATION_KITCHEN;
-    game.gameWon = false;
-    game.gameOver = false;
-    
-    InitializeItems();
-    InitializeLocations();
+void InitGameModel(GameSession *session) {
+    const World *world = session->world;
+    GameState *game = session->state;
+
+    memset(game, 0, session->stateSize);
+    game->words = world->stateWords;
+    game->currentLocation = (uint32_t)world->startLocation;
+    memcpy(game->bits + world->availableWord, world->initialAvailable,
+           BITSET_WORDS(world->actionCount) * sizeof(uint64_t));
+    BitsetSet(game->bits + world->visitedWord, world->startLocation);
+    ResetHistory(session);
+    if (session->journal != NULL) {
+        WriteJournal(session, JOURNAL_NEW_GAME, 0, 1, 0, 0);
+    }
 }
 
 /*
  * @brief Получить текущую локацию
  * @return Указатель на текущую локацию
  */
-Location* GetCurrentLocation() {
-    return &game.locations[game.currentLocation];
+const Location* GetCurrentLocation(const GameSession *session) {
+    return &session->world->locations[session->state->currentLocation];
+}
+
+int GetCurrentLocationId(const GameSession *session) {
+    return (int)session->state->currentLocation;
 }
 
 /*
  * @brief Проверка наличия предмета в инвентаре
- * @param itemName Имя предмета для проверки
+ * Одна проверка бита, не зависит ни от размера инвентаря, ни от имён.
+ *
+ * @param itemId Индекс предмета мира
  * @return true если предмет есть в инвентаре
  */
-bool HasItem(const char *itemName) {
-    for (int i = 0; i < game.inventoryCount; i++) {
-        if (strcmp(game.inventory[i].name, itemName) == 0) {
-            return true;
-        }
-    }
-    return false;
+bool HasItem(const GameSession *session, int itemId) {
+    return itemId >= 0 && itemId < session->world->itemCount &&
+           BitsetTest(session->state->bits + session->world->inventoryWord, itemId);
 }
 
 /*
  * @brief Добавить предмет в инвентарь
- * @param item Предмет для добавления
+ * @param itemId Индекс предмета мира
  */
-void AddToInventory(Item *item) {
-    if (game.inventoryCount >= MAX_INVENTORY_SIZE) {
-        printf("Инвентарь переполнен!\n");
+void AddToInventory(GameSession *session, int itemId) {
+    GameState *game = session->state;
+    const Item *item = GetWorldItem(session->world, itemId);
+
+    if (item == NULL) {
+        return;
+    }
+    if (game->inventoryCount >= MAX_INVENTORY_SIZE) {
+        Say(session, "Инвентарь переполнен!\n");
         return;
     }
-    
-    CopyStringSafe(game.inventory[game.inventoryCount].name, sizeof game.inventory[game.inventoryCount].name, item->name);
-    CopyStringSafe(game.inventory[game.inventoryCount].description, sizeof game.inventory[game.inventoryCount].description, item->description);
-    game.inventory[game.inventoryCount].isCollected = true;
-    game.inventoryCount++;
-    printf("✓ Добавлено в инвентарь: %s\n", item->name);
+
+    BitsetSet(game->bits + session->world->inventoryWord, itemId);
+    BitsetSet(game->bits + session->world->collectedWord, itemId);
+    game->inventoryCount++;
+    Say(session, "✓ Добавлено в инвентарь: %s\n", WorldString(session->world, item->name));
+}
+
+/*
+ * @brief Убрать предмет из инвентаря
+ * Предмет остаётся собранным: с локации он не появится снова.
+ *
+ * @param itemId Индекс предмета мира
+ */
+void RemoveFromInventory(GameSession *session, int itemId) {
+    if (!HasItem(session, itemId)) {
+        return;
+    }
+    BitsetClear(session->state->bits + session->world->inventoryWord, itemId);
+    session->state->inventoryCount--;
+    Say(session, "✗ Убрано из инвентаря: %s\n", WorldString(session->world, session->world->items[itemId].name));
 }
 
 /*
  * @brief Переместиться в другую локацию
  * @param newLocation Тип новой локации
  */
-void MoveToLocation(LocationType newLocation) {
-    if (newLocation >= 0 && newLocation < LOCATION_COUNT) {
-        game.currentLocation = newLocation;
+void MoveToLocation(GameSession *session, int newLocation) {
+    if (newLocation >= 0 && newLocation < session->world->locationCount) {
+        session->state->currentLocation = (uint32_t)newLocation;
+        BitsetSet(session->state->bits + session->world->visitedWord, newLocation);
     }
 }
 
 /*
  * @brief Отобразить инвентарь
+ * Экран собирается в кадр и выводится одной записью.
+ */
+void DisplayInventory(const GameSession *session) {
+    FrameBuffer frame;
+    FrameInit(&frame);
+    FrameClearScreen(&frame);
+    RenderInventory(session, &frame);
+    FrameFlush(&frame);
+    FrameFree(&frame);
+}
+
+/*
+ * @brief Отобразить текущую локацию
  */
-void DisplayInventory() {
-    _clearConsole();
-    printf("\n=====================================\n");
-    printf("|         INVENTORY                 |\n");
-    printf("|===================================|\n");
-    
-    if (game.inventoryCount == 0) {
-        printf("|  (pusto)                         |\n");
+void DisplayLocation(const GameSession *session) {
+    FrameBuffer frame;
+    FrameInit(&frame);
+    FrameClearScreen(&frame);
+    RenderLocation(session, &frame);
+    FrameFlush(&frame);
+    FrameFree(&frame);
+}
+
+/*
+ * @brief Отрисовать инвентарь в кадр
+ * @param frame Кадр, в конец которого дописывается экран
+ */
+void RenderInventory(const GameSession *session, FrameBuffer *frame) {
+    const World *world = session->world;
+    const GameState *game = session->state;
+    size_t renderStart = frame->size;
+    METRIC_START(TIMER_RENDER, renderStarted);
+
+    FrameAppend(frame, "\n=====================================\n");
+    FrameAppend(frame, "|         INVENTORY                 |\n");
+    FrameAppend(frame, "|===================================|\n");
+
+    if (game->inventoryCount == 0) {
+        FrameAppend(frame, "|  (pusto)                          |\n");
     } else {
-        for (int i = 0; i < game.inventoryCount; i++) {
-            printf("|  [%d] %-28s |\n", i + 1, game.inventory[i].name);
+        // Предметы перечисляются в порядке индексов мира
+        const uint64_t *inventory = game->bits + world->inventoryWord;
+        size_t words = BITSET_WORDS(world->itemCount);
+        int number = 1;
+        for (int itemId = BitsetNext(inventory, words, 0); itemId >= 0;
+             itemId = BitsetNext(inventory, words, itemId + 1)) {
+            const Item *item = GetWorldItem(world, itemId);
+            FramePrintf(frame, "|  [%d] ", number++);
+            FrameAppendPadded(frame, WorldString(world, item->name), 28);
+            FrameAppend(frame, " |\n");
         }
     }
-    
-    printf("=====================================\n");
-    WaitForEnter();
+
+    FrameAppend(frame, "=====================================\n");
+    METRIC_STOP(TIMER_RENDER, renderStarted);
+    METRIC_ADD(COUNTER_BYTES_RENDERED, frame->size - renderStart);
 }
 
 /*
- * @brief Отобразить текущую локацию
+ * @brief Отрисовать текущую локацию в кадр
+ * @param frame Кадр, в конец которого дописывается экран
  */
-void DisplayLocation() {
-    Location *loc = GetCurrentLocation();
-    
-    _clearConsole();
-    printf("\n=======================================================\n");
-    printf("|  %-53s |\n", loc->name);
-    printf("=======================================================\n\n");
-    
-    printf("%s\n\n", loc->description);
-    
+void RenderLocation(const GameSession *session, FrameBuffer *frame) {
+    const World *world = session->world;
+    const Location *loc = GetCurrentLocation(session);
+    size_t renderStart = frame->size;
+    METRIC_START(TIMER_RENDER, renderStarted);
+    // Тексты локации страничного мира могут быть ещё не загружены
+    const LocationPage *page = AcquireLocationPage(world, (int)session->state->currentLocation);
+
+    FrameAppend(frame, "\n=======================================================\n");
+    FrameAppend(frame, "|  ");
+    FrameAppendPadded(frame, PageString(world, page, loc->name), 50);
+    FrameAppend(frame, " |\n");
+    FrameAppend(frame, "=======================================================\n\n");
+
+    FrameAppendWrapped(frame, PageString(world, page, loc->description), session->textWidth);
+    FrameAppend(frame, "\n\n");
+
     // Отображаем доступные предметы
     if (loc->itemCount > 0) {
-        printf("Вы видите:\n");
-        for (int i = 0; i < loc->itemCount; i++) {
-            if (!loc->items[i].isCollected) {
-                printf("  • %s - %s\n", loc->items[i].name, loc->items[i].description);
+        FrameAppend(frame, "Вы видите:\n");
+        for (int i = 0; i < (int)loc->itemCount; i++) {
+            int itemId = GetLocationItemId(world, loc, i);
+            if (itemId != NO_ITEM && !IsItemCollected(session, itemId)) {
+                const Item *item = GetWorldItem(world, itemId);
+                FramePrintf(frame, "  • %s - %s\n", WorldString(world, item->name),
+                            WorldString(world, item->description));
             }
         }
-        printf("\n");
+        FrameAppend(frame, "\n");
     }
-    
+
     // Отображаем доступные действия
-    printf("Доступные действия:\n");
-    for (int i = 0; i < loc->actionCount; i++) {
-        if (loc->actions[i].available) {
-            printf("  [%d] %s\n", i + 1, loc->actions[i].text);
+    FrameAppend(frame, "Доступные действия:\n");
+    for (int i = 0; i < (int)loc->actionCount; i++) {
+        int actionId = GetLocationActionId(world, loc, i);
+        if (actionId >= 0 && IsActionAvailable(session, actionId)) {
+            FramePrintf(frame, "  [%d] %s\n", i + 1, PageString(world, page, world->actions[actionId].text));
         }
     }
-    
-    loc->visited = true;
+    ReleaseLocationPage(world, page);
+    METRIC_STOP(TIMER_RENDER, renderStarted);
+    METRIC_ADD(COUNTER_BYTES_RENDERED, frame->size - renderStart);
+}
+
+/*
+ * @brief Отрисовать экран победы в кадр
+ */
+void RenderWinScreen(const GameSession *session, FrameBuffer *frame) {
+    (void)session;
+    FrameAppend(frame, "\n=======================================================\n");
+    FrameAppend(frame, "|                                                   |\n");
+    FrameAppend(frame, "|          POZDRAVLYAEM! VY POBEDILI!              |\n");
+    FrameAppend(frame, "|                                                   |\n");
+    FrameAppend(frame, "=======================================================\n\n");
+
+    FrameAppend(frame, "Вы нашли древний манускрипт с секретным рецептом!\n\n");
+    FrameAppend(frame, "В манускрипте записан рецепт легендарного блюда,\n");
+    FrameAppend(frame, "которое было утеряно много лет назад.\n\n");
+    FrameAppend(frame, "Теперь вы сможете воссоздать это произведение\n");
+    FrameAppend(frame, "кулинарного искусства и прославиться как великий повар!\n\n");
+    FrameAppend(frame, "Ваше приключение завершено успешно!\n\n");
+    FrameAppend(frame, "=======================================================\n");
+    FrameAppend(frame, "|      Spasibo za igru! Do novyh vstrech!            |\n");
+    FrameAppend(frame, "=======================================================\n\n");
 }
 
 /*
  * @brief Выполнить действие
  * @param actionIndex Индекс действия
  */
-bool ExecuteAction(int actionIndex) {
-    Location *loc = GetCurrentLocation();
-    
-    if (actionIndex < 0 || actionIndex >= loc->actionCount) {
-        printf("Неверное действие!\n");
+bool ExecuteAction(GameSession *session, int actionIndex) {
+    const Location *loc = GetCurrentLocation(session);
+
+    int actionId = GetLocationActionId(session->world, loc, actionIndex);
+
+    if (actionId < 0) {
+        Say(session, "Неверное действие!\n");
         return false;
     }
-    
-    Action *action = &loc->actions[actionIndex];
-    
-    if (!action->available) {
-        printf("Это действие недоступно!\n");
+
+    const Action *action = &session->world->actions[actionId];
+
+    if (!IsActionAvailable(session, actionId)) {
+        Say(session, "Это действие недоступно!\n");
         return false;
     }
-    
+
     // Проверка требований
-    if (action->requiresItem && !HasItem(action->requiredItemName)) {
-        printf("Вам нужен предмет: %s\n", action->requiredItemName);
-        WaitForEnter();
+    if (action->requiredItem != NO_ITEM && !HasItem(session, action->requiredItem)) {
+        const Item *required = GetWorldItem(session->world, action->requiredItem);
+        Say(session, "Вам нужен предмет: %s\n", required != NULL ? WorldString(session->world, required->name) : "?");
+        return false;
+    }
+    if (action->condition != 0 && !CheckCondition(session, action->condition)) {
+        if (session->output != NULL) {
+            const LocationPage *page = AcquireLocationPage(session->world, (int)session->state->currentLocation);
+            const char *blockedText = PageString(session->world, page, action->blockedText);
+            Say(session, "%s\n", blockedText[0] != '\0' ? blockedText : "Сейчас это не получится.");
+            ReleaseLocationPage(session->world, page);
+        }
         return false;
     }
-    
-    // Вывод результата
-    if (strlen(action->resultText) > 0) {
-        printf("\n%s\n", action->resultText);
+
+    // Вывод результата; без вывода страница текстов не нужна
+    if (session->output != NULL) {
+        const LocationPage *page = AcquireLocationPage(session->world, (int)session->state->currentLocation);
+        const char *resultText = PageString(session->world, page, action->resultText);
+        if (resultText[0] != '\0') {
+            Say(session, "\n%s\n", resultText);
+        }
+        ReleaseLocationPage(session->world, page);
     }
-    
+
     // Перемещение
     if (action->targetLocation >= 0) {
-        MoveToLocation(action->targetLocation);
+        MoveToLocation(session, action->targetLocation);
     }
-    
+
     // Добавление предмета
-    if (action->givesItem != NULL && !action->givesItem->isCollected) {
-        AddToInventory(action->givesItem);
-        action->givesItem->isCollected = true;
+    if (action->givesItem != NO_ITEM && !IsItemCollected(session, action->givesItem)) {
+        AddToInventory(session, action->givesItem);
     }
-    
-    WaitForEnter();
+
+    if (action->effect != 0) {
+        ApplyEffects(session, action->effect);
+    }
+
     return true;
 }
 
 /*
  * @brief Подобрать предмет
- * @param itemName Имя предмета
- */
-bool PickUpItem(const char *itemName) {
-    Location *loc = GetCurrentLocation();
-    
-    for (int i = 0; i < loc->itemCount; i++) {
-        if (strcmp(loc->items[i].name, itemName) == 0 && !loc->items[i].isCollected) {
-            AddToInventory(&loc->items[i]);
-            loc->items[i].isCollected = true;
+ * Имя в индекс переводит фронтенд (FindWorldItem), здесь только индексы.
+ *
+ * @param itemId Индекс предмета мира
+ */
+bool PickUpItem(GameSession *session, int itemId) {
+    const Location *loc = GetCurrentLocation(session);
+
+    for (int i = 0; i < (int)loc->itemCount; i++) {
+        if (GetLocationItemId(session->world, loc, i) == itemId && !IsItemCollected(session, itemId)) {
+            AddToInventory(session, itemId);
             return true;
         }
     }
-    
-    printf("Такого предмета здесь нет!\n");
+
+    Say(session, "Такого предмета здесь нет!\n");
     return false;
 }
 
 /*
  * @brief Проверка победы
  */
-bool CheckWinCondition() {
-    // Для победы нужен манускрипт с рецептом (главная цель)
-    bool hasManuscript = HasItem("Древний манускрипт");
-    
-    // Игра считается выигранной, если у игрока есть манускрипт
-    // Это главная цель - найти секретный рецепт
-    if (hasManuscript) {
-        game.gameWon = true;
+bool CheckWinCondition(GameSession *session) {
+    // Для победы нужен предмет победы мира (в особняке - манускрипт с рецептом),
+    // проверка - один бит инвентаря
+    if (IsWinState(session->world, session->state)) {
+        session->state->flags |= GAME_FLAG_WON;
         return true;
     }
-    
+
     return false;
 }
 
-bool IsGameWon() {
-    return game.gameWon;
-}
-
-bool IsGameOver() {
-    return game.gameOver;
-}
-
-/* [[ Внутренние функции инициализации ]] */
-
-static Item* CreateItem(const char *name, const char *description) {
-    static Item items[20];
-    static int itemIndex = 0;
-    
-    if (itemIndex >= 20) return NULL;
-    
-    CopyStringSafe(items[itemIndex].name, sizeof items[itemIndex].name, name);
-    CopyStringSafe(items[itemIndex].description, sizeof items[itemIndex].description, description);
-    items[itemIndex].isCollected = false;
-    
-    return &items[itemIndex++];
-}
-
-static void InitializeItems() {
-    // Предметы будут созданы в InitializeLocations
-}
-
-static void InitializeLocations() {
-    // КУХНЯ
-    Location *kitchen = &game.locations[LOCATION_KITCHEN];
-    kitchen->id = LOCATION_KITCHEN;
-    CopyStringSafe(kitchen->name, sizeof kitchen->name, "Кухня");
-    CopyStringSafe(kitchen->description, sizeof kitchen->description, "Старая кухня, покрытая пылью и паутиной. Стол завален остатками давно испорченной еды. На полках стоят пустые банки. Странный запах старого дерева висит в воздухе.");
-    kitchen->itemCount = 1;
-    kitchen->items[0] = *CreateItem("Газета", "Старая газета с вырезкой о пропавшем поваре");
-    kitchen->items[0].isCollected = false;
-    kitchen->actionCount = 2;
-    
-    CopyStringSafe(kitchen->actions[0].text, sizeof kitchen->actions[0].text, "Идти в столовую");
-    kitchen->actions[0].available = true;
-    kitchen->actions[0].targetLocation = LOCATION_DINING_ROOM;
-    kitchen->actions[0].requiresItem = false;
-    CopyStringSafe(kitchen->actions[0].resultText, sizeof kitchen->actions[0].resultText, "Вы выходите из кухни в столовую.");
-    
-    CopyStringSafe(kitchen->actions[1].text, sizeof kitchen->actions[1].text, "Взять газету");
-    kitchen->actions[1].available = true;
-    kitchen->actions[1].targetLocation = -1;
-    kitchen->actions[1].requiresItem = false;
-    CopyStringSafe(kitchen->actions[1].resultText, sizeof kitchen->actions[1].resultText, "Вы подобрали газету. В ней написано о таинственном рецепте.");
-    kitchen->actions[1].givesItem = &kitchen->items[0];
-    
-    // СТОЛОВАЯ
-    Location *dining = &game.locations[LOCATION_DINING_ROOM];
-    dining->id = LOCATION_DINING_ROOM;
-    CopyStringSafe(dining->name, sizeof dining->name, "Столовая");
-    CopyStringSafe(dining->description, sizeof dining->description, "Просторная столовая с массивным дубовым столом посередине. На стенах висят портреты предков, которые смотрят на вас загадочными взглядами. На стене висит старая карта особняка.");
-    dining->itemCount = 1;
-    dining->items[0] = *CreateItem("Карта", "Старая карта особняка с отметками");
-    dining->items[0].isCollected = false;
-    dining->actionCount = 5;
-    
-    CopyStringSafe(dining->actions[0].text, sizeof dining->actions[0].text, "Идти в библиотеку");
-    dining->actions[0].available = true;
-    dining->actions[0].targetLocation = LOCATION_LIBRARY;
-    dining->actions[0].requiresItem = false;
-    CopyStringSafe(dining->actions[0].resultText, sizeof dining->actions[0].resultText, "Вы направляетесь в библиотеку.");
-    
-    CopyStringSafe(dining->actions[1].text, sizeof dining->actions[1].text, "Вернуться на кухню");
-    dining->actions[1].available = true;
-    dining->actions[1].targetLocation = LOCATION_KITCHEN;
-    dining->actions[1].requiresItem = false;
-    CopyStringSafe(dining->actions[1].resultText, sizeof dining->actions[1].resultText, "Вы возвращаетесь на кухню.");
-    
-    CopyStringSafe(dining->actions[2].text, sizeof dining->actions[2].text, "Идти в подвал");
-    dining->actions[2].available = true;
-    dining->actions[2].targetLocation = LOCATION_BASEMENT;
-    dining->actions[2].requiresItem = false;
-    CopyStringSafe(dining->actions[2].resultText, sizeof dining->actions[2].resultText, "Вы спускаетесь в тёмный подвал.");
-    
-    CopyStringSafe(dining->actions[3].text, sizeof dining->actions[3].text, "Выйти в сад");
-    dining->actions[3].available = true;
-    dining->actions[3].targetLocation = LOCATION_GARDEN;
-    dining->actions[3].requiresItem = false;
-    CopyStringSafe(dining->actions[3].resultText, sizeof dining->actions[3].resultText, "Вы выходите через заднюю дверь в сад.");
-    
-    CopyStringSafe(dining->actions[4].text, sizeof dining->actions[4].text, "Взять карту");
-    dining->actions[4].available = true;
-    dining->actions[4].targetLocation = -1;
-    dining->actions[4].requiresItem = false;
-    CopyStringSafe(dining->actions[4].resultText, sizeof dining->actions[4].resultText, "Карта добавлена в инвентарь.");
-    dining->actions[4].givesItem = &dining->items[0];
-    
-    // БИБЛИОТЕКА
-    Location *library = &game.locations[LOCATION_LIBRARY];
-    library->id = LOCATION_LIBRARY;
-    CopyStringSafe(library->name, sizeof library->name, "Библиотека");
-    CopyStringSafe(library->description, sizeof library->description, "Библиотека с высокими стеллажами до потолка, полными старых томов. В углу стоит деревянная лестница, ведущая наверх. На столе лежит открытая книга рецептов, а рядом блестит бронзовый ключ.");
-    library->itemCount = 2;
-    library->items[0] = *CreateItem("Ключ от чердака", "Бронзовый ключ с гравировкой");
-    library->items[1] = *CreateItem("Книга рецептов", "Старая книга с кулинарными рецептами");
-    library->items[0].isCollected = false;
-    library->items[1].isCollected = false;
-    library->actionCount = 4;
-    
-    CopyStringSafe(library->actions[0].text, sizeof library->actions[0].text, "Вернуться в столовую");
-    library->actions[0].available = true;
-    library->actions[0].targetLocation = LOCATION_DINING_ROOM;
-    library->actions[0].requiresItem = false;
-    CopyStringSafe(library->actions[0].resultText, sizeof library->actions[0].resultText, "Вы возвращаетесь в столовую.");
-    
-    CopyStringSafe(library->actions[1].text, sizeof library->actions[1].text, "Взять ключ");
-    library->actions[1].available = true;
-    library->actions[1].targetLocation = -1;
-    library->actions[1].requiresItem = false;
-    CopyStringSafe(library->actions[1].resultText, sizeof library->actions[1].resultText, "Вы взяли ключ от чердака.");
-    library->actions[1].givesItem = &library->items[0];
-    
-    CopyStringSafe(library->actions[2].text, sizeof library->actions[2].text, "Прочитать книгу рецептов");
-    library->actions[2].available = true;
-    library->actions[2].targetLocation = -1;
-    library->actions[2].requiresItem = false;
-    CopyStringSafe(library->actions[2].resultText, sizeof library->actions[2].resultText, "В книге упоминается секретный ингредиент, хранящийся в подвале.");
-    
-    CopyStringSafe(library->actions[3].text, sizeof library->actions[3].text, "Подняться на чердак");
-    library->actions[3].available = true;
-    library->actions[3].targetLocation = LOCATION_ATTIC;
-    library->actions[3].requiresItem = false;
-    CopyStringSafe(library->actions[3].resultText, sizeof library->actions[3].resultText, "Вы поднимаетесь по лестнице на чердак.");
-    
-    // ПОДВАЛ
-    Location *basement = &game.locations[LOCATION_BASEMENT];
-    basement->id = LOCATION_BASEMENT;
-    CopyStringSafe(basement->name, sizeof basement->name, "Подвал");
-    CopyStringSafe(basement->description, sizeof basement->description, "Тёмный и сырой подвал с низким потолком. Влажный воздух заставляет вас кашлять. На полках стоят банки с консервами, покрытые толстым слоем пыли. В углу стоит старый деревянный сундук.");
-    basement->itemCount = 1;
-    basement->items[0] = *CreateItem("Старый ключ", "Ржавый железный ключ");
-    basement->items[0].isCollected = false;
-    basement->actionCount = 3;
-    
-    CopyStringSafe(basement->actions[0].text, sizeof basement->actions[0].text, "Вернуться в столовую");
-    basement->actions[0].available = true;
-    basement->actions[0].targetLocation = LOCATION_DINING_ROOM;
-    basement->actions[0].requiresItem = false;
-    CopyStringSafe(basement->actions[0].resultText, sizeof basement->actions[0].resultText, "Вы поднимаетесь обратно в столовую.");
-    
-    CopyStringSafe(basement->actions[1].text, sizeof basement->actions[1].text, "Открыть сундук");
-    basement->actions[1].available = true;
-    basement->actions[1].targetLocation = -1;
-    basement->actions[1].requiresItem = false;
-    CopyStringSafe(basement->actions[1].resultText, sizeof basement->actions[1].resultText, "Сундук открыт! Внутри вы находите старый ключ.");
-    basement->actions[1].givesItem = &basement->items[0];
-    
-    CopyStringSafe(basement->actions[2].text, sizeof basement->actions[2].text, "Осмотреть банки");
-    basement->actions[2].available = true;
-    basement->actions[2].targetLocation = -1;
-    basement->actions[2].requiresItem = false;
-    CopyStringSafe(basement->actions[2].resultText, sizeof basement->actions[2].resultText, "Все банки пусты, кроме одной с загадочной этикеткой.");
-    
-    // ЧЕРДАК
-    Location *attic = &game.locations[LOCATION_ATTIC];
-    attic->id = LOCATION_ATTIC;
-    CopyStringSafe(attic->name, sizeof attic->name, "Чердак");
-    CopyStringSafe(attic->description, sizeof attic->description, "Пыльный чердак, заваленный древними вещами и сундуками. Сквозь пыльные окна пробивается тусклый свет. В центре стоит старый письменный стол, на котором лежит древний манускрипт с восковыми печатями.");
-    attic->itemCount = 1;
-    attic->items[0] = *CreateItem("Древний манускрипт", "Старинная рукопись с секретным рецептом");
-    attic->items[0].isCollected = false;
-    attic->actionCount = 2;
-    
-    CopyStringSafe(attic->actions[0].text, sizeof attic->actions[0].text, "Взять манускрипт");
-    attic->actions[0].available = true;
-    attic->actions[0].targetLocation = -1;
-    attic->actions[0].requiresItem = false;
-    CopyStringSafe(attic->actions[0].resultText, sizeof attic->actions[0].resultText, "Вы взяли древний манускрипт! В нём описан секретный рецепт!");
-    attic->actions[0].givesItem = &attic->items[0];
-    
-    CopyStringSafe(attic->actions[1].text, sizeof attic->actions[1].text, "Вернуться в библиотеку");
-    attic->actions[1].available = true;
-    attic->actions[1].targetLocation = LOCATION_LIBRARY;
-    attic->actions[1].requiresItem = false;
-    CopyStringSafe(attic->actions[1].resultText, sizeof attic->actions[1].resultText, "Вы спускаетесь обратно в библиотеку.");
-    
-    // САД
-    Location *garden = &game.locations[LOCATION_GARDEN];
-    garden->id = LOCATION_GARDEN;
-    CopyStringSafe(garden->name, sizeof garden->name, "Сад");
-    CopyStringSafe(garden->description, sizeof garden->description, "Заброшенный сад с заросшими дорожками и буйной растительностью. В центре стоит полуразрушенная беседка. Рядом растут редкие травы, которые когда-то использовались в кулинарии. В беседке лежит старая восковая свеча.");
-    garden->itemCount = 1;
-    garden->items[0] = *CreateItem("Восковая свеча", "Старая восковая свеча");
-    garden->items[0].isCollected = false;
-    garden->actionCount = 2;
-    
-    CopyStringSafe(garden->actions[0].text, sizeof garden->actions[0].text, "Взять свечу");
-    garden->actions[0].available = true;
-    garden->actions[0].targetLocation = -1;
-    garden->actions[0].requiresItem = false;
-    CopyStringSafe(garden->actions[0].resultText, sizeof garden->actions[0].resultText, "Вы взяли восковую свечу из беседки.");
-    garden->actions[0].givesItem = &garden->items[0];
-    
-    CopyStringSafe(garden->actions[1].text, sizeof garden->actions[1].text, "Вернуться в столовую");
-    garden->actions[1].available = true;
-    garden->actions[1].targetLocation = LOCATION_DINING_ROOM;
-    garden->actions[1].requiresItem = false;
-    CopyStringSafe(garden->actions[1].resultText, sizeof garden->actions[1].resultText, "Вы возвращаетесь в особняк.");
+bool IsGameWon(const GameSession *session) {
+    return (session->state->flags & GAME_FLAG_WON) != 0;
+}
+
+bool IsGameOver(const GameSession *session) {
+    return (session->state->flags & GAME_FLAG_OVER) != 0;
+}
+
+/*
+ * @brief Принудительное завершение партии (например, конец ввода)
+ */
+void SetGameOver(GameSession *session) {
+    session->state->flags |= GAME_FLAG_OVER;
+}
+
+bool IsItemCollected(const GameSession *session, int itemId) {
+    return itemId >= 0 && itemId < session->world->itemCount &&
+           BitsetTest(session->state->bits + session->world->collectedWord, itemId);
+}
+
+/* [[ Внутренние функции ]] */
+
+/* Сообщение хода в кадр сессии, если он подключён */
+static void Say(GameSession *session, const char *format, ...) {
+    if (session->output == NULL) {
+        return;
+    }
+    va_list args;
+    va_start(args, format);
+    FrameVPrintf(session->output, format, args);
+    va_end(args);
+}
+
+/*
+ * Условие действия. Стек значений - биты одного слова, без выделения
+ * памяти. Байткод проверен валидатором при сборке, но образ мог быть
+ * испорчен после: выход за таблицу кода, за пределы индексов или стека
+ * даёт "не выполнено".
+ */
+static bool CheckCondition(const GameSession *session, uint32_t offset) {
+    const World *world = session->world;
+    const uint64_t *bits = session->state->bits;
+    uint64_t stack = 0;
+    int depth = 0;
+
+    _Static_assert(SCRIPT_STACK_DEPTH <= 64, "condition stack must fit one word");
+    for (uint32_t at = offset; at < world->codeCount; at++) {
+        uint32_t word = world->code[at];
+        uint32_t operand = SCRIPT_OPERAND(word);
+        bool value;
+
+        switch (SCRIPT_OP(word)) {
+            case SCRIPT_END:
+                return depth == 1 && (stack & 1u) != 0;
+            case SCRIPT_HAS:
+                value = HasItem(session, (int)operand);
+                break;
+            case SCRIPT_VISITED:
+                value = IsLocationVisited(session, (int)operand);
+                break;
+            case SCRIPT_FLAG:
+                if (operand >= (uint32_t)world->flagCount) {
+                    return false;
+                }
+                value = BitsetTest(bits + world->flagWord, (int)operand);
+                break;
+            case SCRIPT_COUNTER_EQ:
+            case SCRIPT_COUNTER_LT:
+            case SCRIPT_COUNTER_GT: {
+                if (operand >= (uint32_t)world->counterCount || at + 1 >= world->codeCount) {
+                    return false;
+                }
+                int64_t counter = (int64_t)bits[world->counterWord + operand];
+                int64_t immediate = (int32_t)world->code[++at];
+                value = SCRIPT_OP(word) == SCRIPT_COUNTER_EQ ? counter == immediate :
+                        SCRIPT_OP(word) == SCRIPT_COUNTER_LT ? counter < immediate : counter > immediate;
+                break;
+            }
+            case SCRIPT_NOT:
+                if (depth < 1) {
+                    return false;
+                }
+                stack ^= 1u;
+                continue;
+            case SCRIPT_AND:
+            case SCRIPT_OR: {
+                if (depth < 2) {
+                    return false;
+                }
+                uint64_t right = stack & 1u;
+                stack >>= 1;
+                depth--;
+                stack = SCRIPT_OP(word) == SCRIPT_AND ? stack & (~1ull | right) : stack | right;
+                continue;
+            }
+            default:
+                return false;
+        }
+        if (depth == SCRIPT_STACK_DEPTH) {
+            return false;
+        }
+        stack = (stack << 1) | (value ? 1u : 0u);
+        depth++;
+    }
+    return false;
 }
 
+/*
+ * Последствия действия по порядку. Неизвестная операция или индекс вне
+ * мира останавливают выполнение: уже сделанное остаётся в силе.
+ */
+static void ApplyEffects(GameSession *session, uint32_t offset) {
+    const World *world = session->world;
+    uint64_t *bits = session->state->bits;
+
+    for (uint32_t at = offset; at < world->codeCount; at++) {
+        uint32_t word = world->code[at];
+        uint32_t operand = SCRIPT_OPERAND(word);
+
+        switch (SCRIPT_OP(word)) {
+            case SCRIPT_END:
+                return;
+            case SCRIPT_SET_FLAG:
+            case SCRIPT_CLEAR_FLAG:
+                if (operand >= (uint32_t)world->flagCount) {
+                    return;
+                }
+                if (SCRIPT_OP(word) == SCRIPT_SET_FLAG) {
+                    BitsetSet(bits + world->flagWord, (int)operand);
+                } else {
+                    BitsetClear(bits + world->flagWord, (int)operand);
+                }
+                break;
+            case SCRIPT_ADD_COUNTER:
+            case SCRIPT_SET_COUNTER: {
+                if (operand >= (uint32_t)world->counterCount || at + 1 >= world->codeCount) {
+                    return;
+                }
+                int64_t immediate = (int32_t)world->code[++at];
+                uint64_t *counter = &bits[world->counterWord + operand];
+                // Сложение по модулю 2^64: переполнение не UB
+                *counter = SCRIPT_OP(word) == SCRIPT_ADD_COUNTER ? *counter + (uint64_t)immediate : (uint64_t)immediate;
+                break;
+            }
+            case SCRIPT_UNLOCK:
+            case SCRIPT_LOCK:
+                if (operand >= (uint32_t)world->actionCount) {
+                    return;
+                }
+                if (SCRIPT_OP(word) == SCRIPT_UNLOCK) {
+                    BitsetSet(bits + world->availableWord, (int)operand);
+                } else {
+                    BitsetClear(bits + world->availableWord, (int)operand);
+                }
+                break;
+            case SCRIPT_GIVE:
+                if (operand >= (uint32_t)world->itemCount) {
+                    return;
+                }
+                if (!HasItem(session, (int)operand)) {
+                    AddToInventory(session, (int)operand);
+                }
+                break;
+            case SCRIPT_TAKE:
+                if (operand >= (uint32_t)world->itemCount) {
+                    return;
+                }
+                RemoveFromInventory(session, (int)operand);
+                break;
+            default:
+                return;
+        }
+    }
+}
+
+/* Снимок после хода turn в кольце истории */
+static GameState* HistorySlot(const GameSession *session, int turn) {
+    return (GameState *)(session->history + (size_t)(turn & (GAME_HISTORY_DEPTH - 1)) * session->stateSize);
+}
+
+/* История начинается с текущего состояния как хода 0 */
+static void ResetHistory(GameSession *session) {
+    session->turn = 0;
+    session->lastTurn = 0;
+    session->firstTurn = 0;
+    memcpy(HistorySlot(session, 0), session->state, session->stateSize);
+}
+
+/*
+ * Установленные биты множества одного мира - в множество другого по ключам;
+ * элементов, которых в новом мире нет, не переносит. Возвращает, сколько
+ * перенесено.
+ */
+static uint32_t MoveBitset(const World *from, const World *to, WorldKeyKind kind, const uint64_t *bits, int count,
+                           uint64_t *target) {
+    uint32_t moved = 0;
+    for (int i = BitsetNext(bits, BITSET_WORDS(count), 0); i >= 0; i = BitsetNext(bits, BITSET_WORDS(count), i + 1)) {
+        int index = FindWorldKey(to, kind, GetWorldKey(from, kind, i));
+        if (index >= 0) {
+            BitsetSet(target, index);
+            moved++;
+        }
+    }
+    return moved;
+}
+
+/* Ход без журнала: вся логика StepGameSession */
+static StepResult StepTurn(GameSession *session, int choice) {
+    if (IsGameWon(session) || IsGameOver(session)) {
+        return STEP_FINISHED;
+    }
+
+    const Location *loc = GetCurrentLocation(session);
+
+    if (choice == 0) {
+        return STEP_INVENTORY;
+    }
+    if (choice < 1 || (uint32_t)choice > loc->actionCount) {
+        return STEP_INVALID;
+    }
+    METRIC_START(TIMER_EXECUTE, executeStarted);
+    bool executed = ExecuteAction(session, choice - 1);
+    METRIC_STOP(TIMER_EXECUTE, executeStarted);
+    if (!executed) {
+        return STEP_BLOCKED;
+    }
+    METRIC_START(TIMER_WIN_CHECK, winStarted);
+    bool won = CheckWinCondition(session);
+    METRIC_STOP(TIMER_WIN_CHECK, winStarted);
+
+    session->turn++;
+    session->lastTurn = session->turn;
+    memcpy(HistorySlot(session, session->turn), session->state, session->stateSize);
+    return won ? STEP_WON : STEP_OK;
+}
+
+static void WriteJournal(GameSession *session, JournalKind kind, int argument, int result, uint32_t flags,
+                         uint32_t outputHash) {
+    JournalRecord record = {
+        .sessionId = session->journalId,
+        .timestamp = NowNanoseconds(),
+        .sequence = session->journalSequence++,
+        .argument = argument,
+        .stateHash = HashGameState(session->state),
+        .outputHash = outputHash,
+        .turn = (uint32_t)session->turn,
+        .kind = (uint8_t)kind,
+        .result = (uint8_t)result,
+        .flags = (uint8_t)flags,
+    };
+    JournalAppend(session->journal, &record);
+}
+
+bool IsActionAvailable(const GameSession *session, int actionId) {
+    return actionId >= 0 && actionId < session->world->actionCount &&
+           BitsetTest(session->state->bits + session->world->availableWord, actionId);
+}
+
+bool IsLocationVisited(const GameSession *session, int locationId) {
+    return locationId >= 0 && locationId < session->world->locationCount &&
+           BitsetTest(session->state->bits + session->world->visitedWord, locationId);
+}
+
+/* [[ Внутренние функции диалога ]] */
+
+static ExpectedInput RunCommand(GameSession *session, const char *line, FrameBuffer *out) {
+    char command[16] = {0};
+    int choice;
+
+    METRIC_START(TIMER_PARSE, parseStarted);
+    while (*line == ' ' || *line == '\t') {
+        line++;
+    }
+    sscanf(line, "%15s", command);
+    bool isNumber = sscanf(line, "%d", &choice) == 1;
+    METRIC_STOP(TIMER_PARSE, parseStarted);
+
+    if (strcmp(command, "q") == 0 || strcmp(command, "quit") == 0) {
+        SetGameOver(session);
+        FrameAppend(out, "До свидания!\n");
+        session->dialogPhase = PHASE_DONE;
+        return INPUT_NONE;
+    }
+
+    // "u" или "u N" - отмена последних ходов
+    if ((command[0] == 'u' || command[0] == 'U') && strspn(command + 1, "0123456789") == strlen(command + 1)) {
+        int count = 1;
+        sscanf(line + 1, "%d", &count);
+        if (!UndoTurns(session, count)) {
+            FrameAppend(out, "Столько ходов отменить нельзя.\n");
+            return AfterMessage(session, out);
+        }
+        return RenderScreen(session, out);
+    }
+
+    if (!isNumber) {
+        return RunTextCommand(session, line, out);
+    }
+
+    switch (StepGameSession(session, choice)) {
+        case STEP_INVENTORY:
+            if (session->dialogOptions & DIALOG_CLEAR_SCREEN) {
+                FrameAppendClearScreen(out);
+            }
+            RenderInventory(session, out);
+            break;
+        case STEP_INVALID:
+            FrameAppend(out, "Неверный выбор! Попробуйте снова.\n");
+            break;
+        case STEP_FINISHED:
+            return AfterPause(session, out);
+        case STEP_OK:
+        case STEP_BLOCKED:
+        case STEP_WON:
+            break;
+    }
+    return AfterMessage(session, out);
+}
+
+/*
+ * Свободный ввод: найденное действие выполняется так же, как ввод его
+ * номера, поэтому в журнал и историю попадает обычный выбор игрока.
+ */
+static ExpectedInput RunTextCommand(GameSession *session, const char *line, FrameBuffer *out) {
+    TextCommand command;
+
+    METRIC_START(TIMER_PARSE, parseStarted);
+    ParseTextCommand(session, line, &command);
+    METRIC_STOP(TIMER_PARSE, parseStarted);
+
+    switch (command.kind) {
+        case TEXT_ACTION:
+            if (StepGameSession(session, command.choice) == STEP_FINISHED) {
+                return AfterPause(session, out);
+            }
+            break;
+        case TEXT_INVENTORY:
+            if (StepGameSession(session, 0) == STEP_FINISHED) {
+                return AfterPause(session, out);
+            }
+            if (session->dialogOptions & DIALOG_CLEAR_SCREEN) {
+                FrameAppendClearScreen(out);
+            }
+            RenderInventory(session, out);
+            break;
+        case TEXT_LOOK:
+            return RenderScreen(session, out);
+        case TEXT_UNKNOWN_WORD:
+            FramePrintf(out, "Не знаю слова «%.*s».\n", (int)command.wordLength, command.word);
+            break;
+        case TEXT_NO_MATCH:
+            FrameAppend(out, "Здесь так сделать нельзя.\n");
+            break;
+        case TEXT_AMBIGUOUS: {
+            const Location *loc = GetCurrentLocation(session);
+            const LocationPage *page = AcquireLocationPage(session->world, (int)session->state->currentLocation);
+            FrameAppend(out, "Уточните:\n");
+            for (int i = 0; i < command.choiceCount; i++) {
+                const Action *action = GetLocationAction(session->world, loc, command.choices[i] - 1);
+                FramePrintf(out, "[%d] %s\n", command.choices[i],
+                            PageString(session->world, page, action->text));
+            }
+            ReleaseLocationPage(session->world, page);
+            break;
+        }
+        case TEXT_EMPTY:
+        case TEXT_NO_LEXICON:
+            FrameAppend(out, "Неверный ввод! Попробуйте снова.\n");
+            break;
+    }
+    return AfterMessage(session, out);
+}
+
+/* Сообщение показано: пауза или сразу следующий экран */
+static ExpectedInput AfterMessage(GameSession *session, FrameBuffer *out) {
+    if (session->dialogOptions & DIALOG_PAUSES) {
+        FrameAppend(out, "\nPress Enter to continue...");
+        session->dialogPhase = PHASE_PAUSE;
+        return INPUT_ENTER;
+    }
+    return AfterPause(session, out);
+}
+
+static ExpectedInput AfterPause(GameSession *session, FrameBuffer *out) {
+    if (IsGameOver(session)) {
+        session->dialogPhase = PHASE_DONE;
+        return INPUT_NONE;
+    }
+    if (IsGameWon(session) || CheckWinCondition(session)) {
+        return ShowWin(session, out);
+    }
+    return RenderScreen(session, out);
+}
+
+static ExpectedInput ShowWin(GameSession *session, FrameBuffer *out) {
+    if (session->dialogOptions & DIALOG_CLEAR_SCREEN) {
+        FrameAppendClearScreen(out);
+    }
+    RenderWinScreen(session, out);
+    if (session->dialogOptions & DIALOG_PAUSES) {
+        FrameAppend(out, "\nPress Enter to continue...");
+        session->dialogPhase = PHASE_WIN_PAUSE;
+        return INPUT_ENTER;
+    }
+    return FinishGame(session, out);
+}
+
+static ExpectedInput FinishGame(GameSession *session, FrameBuffer *out) {
+    if (session->dialogOptions & DIALOG_RESTART) {
+        InitGameModel(session);
+        FrameAppend(out, "\nНачинаем новую партию.\n");
+        return RenderScreen(session, out);
+    }
+    session->dialogPhase = PHASE_DONE;
+    return INPUT_NONE;
+}
+
+/* Экран локации с приглашением к вводу */
+static ExpectedInput RenderScreen(GameSession *session, FrameBuffer *out) {
+    const Location *loc = GetCurrentLocation(session);
+
+    if (session->dialogOptions & DIALOG_CLEAR_SCREEN) {
+        FrameAppendClearScreen(out);
+    }
+    RenderLocation(session, out);
+    FrameAppend(out, "\n[0] Инвентарь\n");
+    if (GetTurnNumber(session) > GetOldestTurn(session)) {
+        FrameAppend(out, "[u] Отменить ход\n");
+    }
+    FramePrintf(out, "Выберите действие (0-%d) или введите команду: ", (int)loc->actionCount);
+    session->dialogPhase = PHASE_COMMAND;
+    return INPUT_COMMAND;
+}
@@ -2,76 +2,124 @@
 #define GAME_H
 
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "world.h"
+#include "journal.h"
+#include "../utils/frame.h"
 
 #define MAX_INVENTORY_SIZE 16
-#define MAX_LOCATION_NAME 128
-#define MAX_ITEM_NAME 64
-#define MAX_DESCRIPTION 512
-#define MAX_ACTIONS 6
 
-/* [[ Типы локаций ]] */
-typedef enum {
-    LOCATION_KITCHEN,
-    LOCATION_DINING_ROOM,
-    LOCATION_LIBRARY,
-    LOCATION_BASEMENT,
-    LOCATION_ATTIC,
-    LOCATION_GARDEN,
-    LOCATION_COUNT
-} LocationType;
-
-/* [[ Структура предмета ]] */
-typedef struct {
-    char name[MAX_ITEM_NAME];
-    char description[MAX_DESCRIPTION];
-    bool isCollected;
-} Item;
-
-/* [[ Структура действия ]] */
-typedef struct {
-    char text[128];
-    bool available;
-    int targetLocation;
-    bool requiresItem;
-    char requiredItemName[MAX_ITEM_NAME];
-    char resultText[MAX_DESCRIPTION];
-    Item* givesItem;
-} Action;
+/* Сколько последних ходов можно отменить; память сессии от числа ходов не растёт */
+#define GAME_HISTORY_DEPTH 64
 
-/* [[ Структура локации ]] */
-typedef struct {
-    LocationType id;
-    char name[MAX_LOCATION_NAME];
-    char description[MAX_DESCRIPTION];
-    Item items[3];
-    int itemCount;
-    Action actions[MAX_ACTIONS];
-    int actionCount;
-    bool visited;
-} Location;
+/* [[ Флаги партии ]] */
+#define GAME_FLAG_WON  0x01
+#define GAME_FLAG_OVER 0x02
 
 /* [[ Структура игры ]] */
+/*
+ * Изменяемая часть партии - дельта относительно неизменяемого World.
+ * Тексты и структура мира сюда не копируются: состояние - несколько полей
+ * и битовые множества по биту на действие, локацию и предмет, так что
+ * его размер растёт с миром на бит на элемент, а новая игра - это
+ * копирование начальной дельты.
+ *
+ * Длина bits задаётся миром (GameStateSize), поэтому GameState не
+ * копируется присваиванием: только memcpy на GameStateSize байт.
+ * Раскладку множеств внутри bits хранит World (availableWord и т.д.).
+ */
 typedef struct {
-    Location locations[LOCATION_COUNT];
-    Item inventory[MAX_INVENTORY_SIZE];
-    int inventoryCount;
-    LocationType currentLocation;
-    bool gameWon;
-    bool gameOver;
+    uint32_t currentLocation;
+    uint32_t inventoryCount;
+    uint32_t flags;          // GAME_FLAG_*
+    uint32_t words;          // длина bits в словах, World.stateWords
+    uint64_t bits[];         // available | visited | collected | inventory
 } GameState;
 
+/* [[ Игровая сессия ]] */
+/*
+ * Непрозрачный дескриптор одной партии. Сессия хранит ссылку на общий
+ * неизменяемый World и собственный GameState, поэтому разные сессии
+ * можно выполнять параллельно из разных потоков без синхронизации.
+ * Одну и ту же сессию одновременно из двух потоков трогать нельзя.
+ */
+typedef struct GameSession GameSession;
+
+/* [[ Результат одного хода ]] */
+typedef enum {
+    STEP_OK,          // действие выполнено
+    STEP_INVENTORY,   // игрок запросил инвентарь
+    STEP_INVALID,     // неверный номер действия
+    STEP_BLOCKED,     // действие недоступно или не выполнено требование
+    STEP_WON,         // после хода выполнено условие победы
+    STEP_FINISHED     // партия уже завершена, ход не принят
+} StepResult;
+
+/* [[ Чего ждёт диалог сессии ]] */
+typedef enum {
+    INPUT_COMMAND,    // номер действия, 0 - инвентарь, "u [N]" - отмена, "q" - выход
+    INPUT_ENTER,      // пауза: любая строка продолжает
+    INPUT_NONE        // диалог окончен, ввод больше не нужен
+} ExpectedInput;
+
+/* [[ Настройки диалога ]] */
+#define DIALOG_PAUSES        0x01u  // пауза после сообщений, как в терминале
+#define DIALOG_CLEAR_SCREEN  0x02u  // ANSI-очистка перед каждым экраном
+#define DIALOG_RESTART       0x04u  // после победы сразу новая партия
+
+/* [[ Функции сессии ]] */
+GameSession* CreateGameSession(const World *world);
+void DestroyGameSession(GameSession *session);
+StepResult StepGameSession(GameSession *session, int choice);
+const char* StepResultName(StepResult result);
+const World* GetSessionWorld(const GameSession *session);
+const GameState* GetSessionState(const GameSession *session);
+size_t GameStateSize(const World *world);
+bool IsWinState(const World *world, const GameState *state);
+bool SetSessionState(GameSession *session, const GameState *state);
+GameSession* MoveGameSession(GameSession *session, const World *world);
+void SetSessionOutput(GameSession *session, FrameBuffer *output);
+
+/* [[ Пошаговый диалог ]] */
+void SetDialogOptions(GameSession *session, unsigned options);
+void SetDialogWidth(GameSession *session, int columns);
+ExpectedInput BeginDialog(GameSession *session, FrameBuffer *out);
+ExpectedInput StepDialog(GameSession *session, const char *line, FrameBuffer *out);
+ExpectedInput GetExpectedInput(const GameSession *session);
+
+/* [[ История ходов ]] */
+int GetTurnNumber(const GameSession *session);
+int GetOldestTurn(const GameSession *session);
+bool UndoTurns(GameSession *session, int count);
+bool RewindToTurn(GameSession *session, int turn);
+
+/* [[ Журнал сессии ]] */
+void SetSessionJournal(GameSession *session, Journal *journal);
+uint64_t GetSessionJournalId(const GameSession *session);
+uint32_t HashGameState(const GameState *state);
+
 /* [[ Функции игры ]] */
-void InitGameModel();
-Location* GetCurrentLocation();
-bool HasItem(const char *itemName);
-void AddToInventory(Item *item);
-void MoveToLocation(LocationType newLocation);
-void DisplayInventory();
-void DisplayLocation();
-bool ExecuteAction(int actionIndex);
-bool PickUpItem(const char *itemName);
-bool CheckWinCondition();
-bool IsGameWon();
-bool IsGameOver();
+void InitGameModel(GameSession *session);
+const Location* GetCurrentLocation(const GameSession *session);
+int GetCurrentLocationId(const GameSession *session);
+bool HasItem(const GameSession *session, int itemId);
+void AddToInventory(GameSession *session, int itemId);
+void RemoveFromInventory(GameSession *session, int itemId);
+void MoveToLocation(GameSession *session, int newLocation);
+void DisplayInventory(const GameSession *session);
+void DisplayLocation(const GameSession *session);
+void RenderInventory(const GameSession *session, FrameBuffer *frame);
+void RenderLocation(const GameSession *session, FrameBuffer *frame);
+void RenderWinScreen(const GameSession *session, FrameBuffer *frame);
+bool ExecuteAction(GameSession *session, int actionIndex);
+bool PickUpItem(GameSession *session, int itemId);
+bool CheckWinCondition(GameSession *session);
+bool IsGameWon(const GameSession *session);
+bool IsGameOver(const GameSession *session);
+void SetGameOver(GameSession *session);
+bool IsItemCollected(const GameSession *session, int itemId);
+bool IsActionAvailable(const GameSession *session, int actionId);
+bool IsLocationVisited(const GameSession *session, int locationId);
 
 #endif
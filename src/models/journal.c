@@ -0,0 +1,414 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <threads.h>
+#include <stdatomic.h>
+#include "journal.h"
+#include "world-pager.h"
+#include "../utils/hash.h"
+
+_Static_assert(sizeof(JournalHeader) == 16, "journal header layout");
+_Static_assert(sizeof(JournalRecord) == 40, "journal record layout");
+
+/* Записей в кольце одного потока; степень двойки */
+#define RING_CAPACITY 4096
+/* Как часто поток сброса просыпается сам, без сигнала писателя */
+#define FLUSH_INTERVAL_NS 10000000L
+
+_Static_assert((RING_CAPACITY & (RING_CAPACITY - 1)) == 0, "ring capacity must be a power of two");
+
+/* [[ Кольцо потока ]] */
+/*
+ * Один писатель (поток игры) и один читатель (поток сброса).
+ * head двигает только писатель, tail - только читатель, поэтому
+ * хватает пары атомарных счётчиков без блокировок.
+ */
+typedef struct JournalRing {
+    _Atomic uint64_t head;
+    _Atomic uint64_t tail;
+    _Atomic uint64_t dropped;
+    thrd_t owner;
+    struct JournalRing *next;
+    JournalRecord records[RING_CAPACITY];
+} JournalRing;
+
+/* [[ Журнал ]] */
+struct Journal {
+    FILE *file;
+    uint64_t generation;            // отличает журнал от прежнего по тому же адресу
+    uint64_t run;                   // старшие биты идентификаторов сессий
+    _Atomic uint64_t sessions;
+    mtx_t lock;                     // список колец и пробуждение потока сброса
+    cnd_t wake;
+    thrd_t flusher;
+    _Atomic(JournalRing *) rings;   // кольца только добавляются до CloseJournal
+    atomic_bool stopping;
+    _Atomic uint64_t written;
+    _Atomic uint64_t flushes;
+};
+
+/* Кэш последнего кольца потока: поиск по списку только при смене журнала */
+static _Thread_local struct {
+    uint64_t generation;
+    JournalRing *ring;
+} threadRing;
+
+static atomic_uint_fast64_t nextGeneration = 1;
+
+/* [[ Прототипы внутренних функций ]] */
+static JournalRing* GetThreadRing(Journal *journal);
+static int FlusherMain(void *arg);
+static size_t DrainRings(Journal *journal);
+static bool CheckHeader(FILE *file, uint32_t worldHash, bool *empty);
+static bool AlignTail(FILE *file);
+static uint32_t RunStamp();
+
+/* [[ Функции журнала ]] */
+
+/*
+ * @brief Открыть журнал на дозапись
+ * Новый файл получает заголовок. Существующий дописывается, только если
+ * он записан для того же мира; сессии разных запусков различаются
+ * по старшим битам идентификатора (см. SetSessionJournal).
+ *
+ * @param world Мир, в котором идут партии
+ * @return Журнал или NULL при ошибке (сообщение уже выведено)
+ */
+Journal* OpenJournal(const char *path, const World *world) {
+    uint32_t worldHash = HashWorldImage(world);
+    FILE *file = fopen(path, "ab+");
+    if (file == NULL) {
+        fprintf(stderr, "%s: cannot open journal\n", path);
+        return NULL;
+    }
+
+    bool empty;
+    if (!CheckHeader(file, worldHash, &empty)) {
+        fprintf(stderr, "%s: not a journal of this world\n", path);
+        fclose(file);
+        return NULL;
+    }
+    if (!empty && !AlignTail(file)) {
+        fprintf(stderr, "%s: cannot write journal\n", path);
+        fclose(file);
+        return NULL;
+    }
+    if (empty) {
+        JournalHeader header = {JOURNAL_MAGIC, JOURNAL_VERSION, sizeof(JournalRecord), worldHash, 0};
+        if (fwrite(&header, sizeof header, 1, file) != 1 || fflush(file) != 0) {
+            fprintf(stderr, "%s: cannot write journal\n", path);
+            fclose(file);
+            return NULL;
+        }
+    }
+
+    Journal *journal = calloc(1, sizeof(Journal));
+    if (journal == NULL) {
+        fclose(file);
+        return NULL;
+    }
+    journal->file = file;
+    journal->generation = atomic_fetch_add(&nextGeneration, 1);
+    journal->run = (uint64_t)RunStamp() << 32;
+    atomic_init(&journal->sessions, 0);
+    atomic_init(&journal->rings, NULL);
+    atomic_init(&journal->stopping, false);
+
+    if (mtx_init(&journal->lock, mtx_plain) != thrd_success) {
+        fclose(file);
+        free(journal);
+        return NULL;
+    }
+    if (cnd_init(&journal->wake) != thrd_success) {
+        mtx_destroy(&journal->lock);
+        fclose(file);
+        free(journal);
+        return NULL;
+    }
+    if (thrd_create(&journal->flusher, FlusherMain, journal) != thrd_success) {
+        cnd_destroy(&journal->wake);
+        mtx_destroy(&journal->lock);
+        fclose(file);
+        free(journal);
+        return NULL;
+    }
+    return journal;
+}
+
+/*
+ * @brief Сбросить остаток колец и закрыть журнал
+ * К этому моменту в журнал никто не должен писать.
+ *
+ * @param journal Журнал (NULL допустим)
+ */
+void CloseJournal(Journal *journal) {
+    if (journal == NULL) {
+        return;
+    }
+    mtx_lock(&journal->lock);
+    atomic_store(&journal->stopping, true);
+    cnd_signal(&journal->wake);
+    mtx_unlock(&journal->lock);
+    thrd_join(journal->flusher, NULL);
+
+    JournalRing *ring = atomic_load(&journal->rings);
+    while (ring != NULL) {
+        JournalRing *next = ring->next;
+        free(ring);
+        ring = next;
+    }
+    fclose(journal->file);
+    cnd_destroy(&journal->wake);
+    mtx_destroy(&journal->lock);
+    free(journal);
+}
+
+/*
+ * @brief Дописать запись
+ * Не блокируется и не ходит в файл: запись кладётся в кольцо потока.
+ * Если кольцо заполнено, запись теряется и учитывается как dropped.
+ */
+void JournalAppend(Journal *journal, const JournalRecord *record) {
+    JournalRing *ring = GetThreadRing(journal);
+    if (ring == NULL) {
+        return;
+    }
+
+    uint64_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    uint64_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    if (head - tail == RING_CAPACITY) {
+        // Одна уступка процессора потоку сброса, ждать дальше ход не будет
+        cnd_signal(&journal->wake);
+        thrd_yield();
+        tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+        if (head - tail == RING_CAPACITY) {
+            atomic_fetch_add_explicit(&ring->dropped, 1, memory_order_relaxed);
+            return;
+        }
+    }
+    ring->records[head & (RING_CAPACITY - 1)] = *record;
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+
+    // Кольцо наполовину полно - будим поток сброса, не дожидаясь таймера.
+    // Сигнал без блокировки может потеряться, тогда сработает таймер.
+    if (head + 1 - tail == RING_CAPACITY / 2) {
+        cnd_signal(&journal->wake);
+    }
+}
+
+/*
+ * @brief Новый идентификатор сессии
+ * Старшие 32 бита - отметка времени открытия журнала, поэтому сессии разных
+ * запусков, дописывающих один файл, не смешиваются при разборе.
+ */
+uint64_t NewJournalSession(Journal *journal) {
+    return journal->run | (atomic_fetch_add(&journal->sessions, 1) + 1);
+}
+
+JournalStats GetJournalStats(Journal *journal) {
+    JournalStats stats = {0};
+
+    stats.written = atomic_load(&journal->written);
+    stats.flushes = atomic_load(&journal->flushes);
+    for (JournalRing *ring = atomic_load(&journal->rings); ring != NULL; ring = ring->next) {
+        stats.dropped += atomic_load_explicit(&ring->dropped, memory_order_relaxed);
+    }
+    return stats;
+}
+
+/*
+ * @brief Отпечаток мира: FNV-1a по всему образу
+ * У страничного мира в памяти только индекс, остаток читается из файла.
+ */
+uint32_t HashWorldImage(const World *world) {
+    uint32_t hash = HashBytes(world->image, world->imageSize, HASH_SEED);
+    if (world->pager != NULL) {
+        hash = HashWorldPagerTail(world->pager, (uint32_t)world->imageSize, hash);
+    }
+    return hash;
+}
+
+/*
+ * @brief Прочитать журнал целиком
+ * Недописанная последняя запись (обрыв при аварии) отбрасывается;
+ * если после неё журнал дописывали, она дополнена нулями до записи
+ * с kind 0, которую читатель должен пропускать.
+ *
+ * @param header Сюда копируется заголовок
+ * @param count Сюда пишется число записей
+ * @return Массив записей в порядке файла (освобождается free) или NULL
+ */
+JournalRecord* LoadJournal(const char *path, JournalHeader *header, size_t *count) {
+    FILE *file = fopen(path, "rb");
+    if (file == NULL) {
+        return NULL;
+    }
+    if (fread(header, sizeof *header, 1, file) != 1 || header->magic != JOURNAL_MAGIC ||
+        header->version != JOURNAL_VERSION || header->recordSize != sizeof(JournalRecord)) {
+        fclose(file);
+        return NULL;
+    }
+
+    size_t capacity = 4096;
+    size_t used = 0;
+    JournalRecord *records = malloc(capacity * sizeof(JournalRecord));
+    while (records != NULL) {
+        if (used == capacity) {
+            capacity *= 2;
+            JournalRecord *grown = realloc(records, capacity * sizeof(JournalRecord));
+            if (grown == NULL) {
+                free(records);
+                records = NULL;
+                break;
+            }
+            records = grown;
+        }
+        size_t got = fread(records + used, sizeof(JournalRecord), capacity - used, file);
+        used += got;
+        if (got == 0 || used < capacity) {
+            break;
+        }
+    }
+    fclose(file);
+
+    *count = used;
+    return records;
+}
+
+/* [[ Внутренние функции ]] */
+
+/* Кольцо текущего потока в этом журнале; создаётся при первой записи */
+static JournalRing* GetThreadRing(Journal *journal) {
+    if (threadRing.generation == journal->generation) {
+        return threadRing.ring;
+    }
+
+    thrd_t self = thrd_current();
+    JournalRing *ring = NULL;
+
+    mtx_lock(&journal->lock);
+    for (JournalRing *r = atomic_load(&journal->rings); r != NULL; r = r->next) {
+        // Поток мог завершиться, а его id достаться новому - кольцо
+        // тогда переходит к новому потоку, писатель по-прежнему один
+        if (thrd_equal(r->owner, self)) {
+            ring = r;
+            break;
+        }
+    }
+    if (ring == NULL) {
+        ring = calloc(1, sizeof(JournalRing));
+        if (ring != NULL) {
+            ring->owner = self;
+            ring->next = atomic_load(&journal->rings);
+            atomic_store(&journal->rings, ring);
+        }
+    }
+    mtx_unlock(&journal->lock);
+
+    if (ring != NULL) {
+        threadRing.generation = journal->generation;
+        threadRing.ring = ring;
+    }
+    return ring;
+}
+
+static int FlusherMain(void *arg) {
+    Journal *journal = arg;
+
+    for (;;) {
+        mtx_lock(&journal->lock);
+        if (!atomic_load(&journal->stopping)) {
+            struct timespec deadline;
+            timespec_get(&deadline, TIME_UTC);
+            deadline.tv_nsec += FLUSH_INTERVAL_NS;
+            if (deadline.tv_nsec >= 1000000000L) {
+                deadline.tv_sec++;
+                deadline.tv_nsec -= 1000000000L;
+            }
+            cnd_timedwait(&journal->wake, &journal->lock, &deadline);
+        }
+        bool stopping = atomic_load(&journal->stopping);
+        mtx_unlock(&journal->lock);
+
+        // Последний проход после stopping забирает всё, что успели записать
+        if (DrainRings(journal) > 0) {
+            fflush(journal->file);
+            atomic_fetch_add(&journal->flushes, 1);
+        }
+        if (stopping) {
+            return 0;
+        }
+    }
+}
+
+/*
+ * Переписать содержимое всех колец в файл. Занятая часть кольца -
+ * не больше двух непрерывных кусков, каждый уходит одним fwrite.
+ */
+static size_t DrainRings(Journal *journal) {
+    size_t total = 0;
+
+    for (JournalRing *ring = atomic_load(&journal->rings); ring != NULL; ring = ring->next) {
+        uint64_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+        uint64_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+
+        while (tail != head) {
+            size_t start = (size_t)(tail & (RING_CAPACITY - 1));
+            size_t chunk = (size_t)(head - tail);
+            if (chunk > RING_CAPACITY - start) {
+                chunk = RING_CAPACITY - start;
+            }
+            // Ошибку записи некому вернуть: записи считаются потерянными
+            size_t put = fwrite(&ring->records[start], sizeof(JournalRecord), chunk, journal->file);
+            if (put < chunk) {
+                atomic_fetch_add_explicit(&ring->dropped, chunk - put, memory_order_relaxed);
+            }
+            tail += chunk;
+            total += put;
+        }
+        atomic_store_explicit(&ring->tail, tail, memory_order_release);
+    }
+    atomic_fetch_add(&journal->written, total);
+    return total;
+}
+
+/* Пустой файл или заголовок, совпадающий с миром и форматом */
+static bool CheckHeader(FILE *file, uint32_t worldHash, bool *empty) {
+    JournalHeader header;
+
+    rewind(file);
+    size_t got = fread(&header, sizeof header, 1, file);
+    *empty = got == 0 && feof(file) && ftell(file) == 0;
+    if (*empty) {
+        return true;
+    }
+    return got == 1 && header.magic == JOURNAL_MAGIC && header.version == JOURNAL_VERSION &&
+           header.recordSize == sizeof(JournalRecord) && header.worldHash == worldHash;
+}
+
+/*
+ * Хвост, оборванный аварией, дополняется нулями до целой записи,
+ * иначе новые записи легли бы со сдвигом
+ */
+static bool AlignTail(FILE *file) {
+    if (fseek(file, 0, SEEK_END) != 0) {
+        return false;
+    }
+    long size = ftell(file);
+    long partial = (size - (long)sizeof(JournalHeader)) % (long)sizeof(JournalRecord);
+    if (size < 0 || partial == 0) {
+        return size >= 0;
+    }
+    static const char zeros[sizeof(JournalRecord)];
+    size_t missing = sizeof(JournalRecord) - (size_t)partial;
+    return fwrite(zeros, 1, missing, file) == missing && fflush(file) == 0;
+}
+
+/* Отметка запуска: хеш настенного времени с наносекундами */
+static uint32_t RunStamp() {
+    struct timespec now;
+    timespec_get(&now, TIME_UTC);
+    uint32_t hash = HashBytes(&now.tv_sec, sizeof now.tv_sec, HASH_SEED);
+    return HashBytes(&now.tv_nsec, sizeof now.tv_nsec, hash);
+}
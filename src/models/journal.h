@@ -0,0 +1,75 @@
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "world.h"
+
+/*
+ * [[ Журнал действий ]]
+ *
+ * Двоичный файл только на дозапись: заголовок и записи фиксированного
+ * размера. Каждый поток пишет в своё кольцо без блокировок, отдельный
+ * поток сбрасывает кольца на диск пачками, поэтому ход никогда не ждёт
+ * диска. Если кольцо переполнено, запись теряется и учитывается
+ * в JournalStats.dropped - пропуск виден по номерам записей сессии.
+ *
+ * Записи разных сессий в файле перемешаны; порядок внутри сессии
+ * восстанавливается по sequence (сессия может переходить между потоками).
+ */
+#define JOURNAL_MAGIC 0x4C4E524Au   // "JRNL"
+#define JOURNAL_VERSION 1
+
+/* [[ Виды записей ]] */
+typedef enum {
+    JOURNAL_NEW_GAME = 1,   // InitGameModel или подключение журнала
+    JOURNAL_STEP = 2,       // StepGameSession, argument - выбор игрока
+    JOURNAL_REWIND = 3      // RewindToTurn/UndoTurns, argument - номер хода
+} JournalKind;
+
+#define JOURNAL_FLAG_OUTPUT 0x01u   // outputHash посчитан по выводу хода
+
+/* [[ Заголовок файла ]] */
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t recordSize;
+    uint32_t worldHash;     // отпечаток образа мира, в котором шла игра
+    uint32_t reserved;
+} JournalHeader;
+
+/* [[ Запись журнала ]] */
+typedef struct {
+    uint64_t sessionId;
+    uint64_t timestamp;     // нс монотонных часов
+    uint32_t sequence;      // номер записи внутри сессии, с 0
+    int32_t argument;
+    uint32_t stateHash;     // GameState после события
+    uint32_t outputHash;
+    uint32_t turn;          // номер хода после события
+    uint8_t kind;           // JournalKind
+    uint8_t result;         // StepResult для JOURNAL_STEP, иначе 0/1 - успех
+    uint8_t flags;          // JOURNAL_FLAG_*
+    uint8_t reserved;
+} JournalRecord;
+
+/* [[ Счётчики журнала ]] */
+typedef struct {
+    uint64_t written;       // записей на диске
+    uint64_t dropped;       // потеряно из-за переполнения колец
+    uint64_t flushes;
+} JournalStats;
+
+typedef struct Journal Journal;
+
+/* [[ Функции журнала ]] */
+Journal* OpenJournal(const char *path, const World *world);
+void CloseJournal(Journal *journal);
+void JournalAppend(Journal *journal, const JournalRecord *record);
+JournalStats GetJournalStats(Journal *journal);
+uint64_t NewJournalSession(Journal *journal);
+uint32_t HashWorldImage(const World *world);
+JournalRecord* LoadJournal(const char *path, JournalHeader *header, size_t *count);
+
+#endif
@@ -0,0 +1,496 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include "lexicon.h"
+
+/* [[ Окончания ]] */
+/* Все кириллические; сначала длинные - отбрасывается первое подходящее */
+static const char *const endings[] = {
+    "ами", "ями", "ого", "его", "ому", "ему", "ыми", "ими",
+    "ой", "ей", "ую", "юю", "ая", "яя", "ое", "ее", "ые", "ие", "ый", "ий",
+    "ом", "ем", "ах", "ях", "ам", "ям", "ов", "ев",
+    "а", "я", "о", "е", "у", "ю", "ы", "и", "ь", "й",
+};
+
+/* Слова встроенных команд: инвентарь и осмотр локации */
+static const char *const inventoryWords[] = {"инвентарь", "инв", "вещи", "inventory", "inv"};
+static const char *const lookWords[] = {"осмотреться", "оглядеться", "смотреть", "look"};
+
+#define MAX_WORD_LETTERS 32
+#define NO_NODE 0                        // корень не бывает ребёнком
+#define AMBIGUOUS_TERM (UINT32_MAX - 1)  // только при сборке
+
+/* [[ Внутренние структуры ]] */
+
+/* Узел дерева при сборке: дети - список по возрастанию байта */
+typedef struct {
+    uint32_t child;
+    uint32_t sibling;
+    uint32_t term;
+    uint8_t byte;
+} BuildNode;
+
+typedef struct {
+    uint32_t action;
+    uint32_t term;
+} ActionTerm;
+
+struct LexiconBuilder {
+    BuildNode *nodes;
+    size_t nodeCount;
+    size_t nodeCapacity;
+    ActionTerm *pairs;
+    size_t pairCount;
+    size_t pairCapacity;
+    uint32_t nextTerm;
+    bool failed;
+    char error[160];
+};
+
+/* [[ Прототипы внутренних функций ]] */
+static bool IsWordByte(const unsigned char *p);
+static int ReadLetter(const unsigned char **p);
+static size_t EncodeLetter(int letter, char *out);
+static uint32_t InsertStem(LexiconBuilder *builder, const char *stem);
+static uint32_t StemTerm(LexiconBuilder *builder, const char *stem);
+static bool AddWordsAs(LexiconBuilder *builder, const char *text, uint32_t term);
+static bool Grow(void **data, size_t *capacity, size_t count, size_t elemSize);
+static int CompareActionTerms(const void *a, const void *b);
+static uint32_t MergeTerms(uint32_t a, uint32_t b);
+static void Fail(LexiconBuilder *builder, const char *message, const char *detail);
+
+/* [[ Функции словаря ]] */
+
+/*
+ * @brief Следующее слово текста
+ *
+ * @param cursor Позиция в тексте, сдвигается за прочитанное слово
+ * @param stem Буфер на LEXICON_STEM_BYTES байт: основа или "" для служебного слова
+ * @param word Сюда - начало слова в тексте (можно NULL)
+ * @param wordLength Сюда - длина слова в байтах (можно NULL)
+ * @return false если слов больше нет
+ */
+bool NextLexiconWord(const char **cursor, char *stem, const char **word, size_t *wordLength) {
+    const unsigned char *p = (const unsigned char *)*cursor;
+    while (*p != '\0' && !IsWordByte(p)) {
+        p++;
+    }
+    if (*p == '\0') {
+        *cursor = (const char *)p;
+        return false;
+    }
+
+    // Слово в нижнем регистре; offsets[i] - начало i-й буквы
+    const unsigned char *start = p;
+    char lower[MAX_WORD_LETTERS * 2 + 1];
+    size_t offsets[MAX_WORD_LETTERS + 1];
+    size_t letters = 0;
+    size_t length = 0;
+    while (IsWordByte(p)) {
+        int letter = ReadLetter(&p);
+        if (letters < MAX_WORD_LETTERS) {
+            offsets[letters++] = length;
+            length += EncodeLetter(letter, lower + length);
+        }
+    }
+    offsets[letters] = length;
+    *cursor = (const char *)p;
+    if (word != NULL) {
+        *word = (const char *)start;
+    }
+    if (wordLength != NULL) {
+        *wordLength = (size_t)(p - start);
+    }
+
+    stem[0] = '\0';
+    if (letters < LEXICON_MIN_LETTERS) {
+        return true;
+    }
+    // Окончание - только кириллица (по 2 байта на букву), поэтому совпадение
+    // байтов всегда приходится на границу букв
+    for (size_t e = 0; e < sizeof endings / sizeof endings[0]; e++) {
+        size_t bytes = strlen(endings[e]);
+        if (letters - bytes / 2 >= LEXICON_MIN_LETTERS && bytes <= length &&
+            memcmp(lower + length - bytes, endings[e], bytes) == 0) {
+            letters -= bytes / 2;
+            break;
+        }
+    }
+    if (letters > LEXICON_STEM_LETTERS) {
+        letters = LEXICON_STEM_LETTERS;
+    }
+    memcpy(stem, lower, offsets[letters]);
+    stem[offsets[letters]] = '\0';
+    return true;
+}
+
+/*
+ * @brief Терм основы
+ * Точное совпадение с основой словаря или, если введено её начало,
+ * единственный терм среди основ с таким началом ("библ" - библиотека).
+ * Рёбра узла отсортированы, поэтому переход - двоичный поиск.
+ *
+ * @return Терм или LEXICON_NO_TERM (слова нет или начало неоднозначно)
+ */
+uint32_t LookupLexicon(const Lexicon *lexicon, const char *stem) {
+    uint32_t node = 0;
+    if (lexicon->nodes == NULL || stem[0] == '\0') {
+        return LEXICON_NO_TERM;
+    }
+    for (const unsigned char *p = (const unsigned char *)stem; *p != '\0'; p++) {
+        const LexiconNode *current = &lexicon->nodes[node];
+        uint32_t low = current->firstEdge;
+        uint32_t high = current->firstEdge + current->edgeCount;
+        if (high > lexicon->edgeCount || high < low) {
+            return LEXICON_NO_TERM;
+        }
+        while (low < high) {
+            uint32_t middle = low + (high - low) / 2;
+            if (lexicon->edges[middle].byte < *p) {
+                low = middle + 1;
+            } else {
+                high = middle;
+            }
+        }
+        if (low == current->firstEdge + current->edgeCount || lexicon->edges[low].byte != *p ||
+            lexicon->edges[low].node >= lexicon->nodeCount) {
+            return LEXICON_NO_TERM;
+        }
+        node = lexicon->edges[low].node;
+    }
+    const LexiconNode *found = &lexicon->nodes[node];
+    return found->term != LEXICON_NO_TERM ? found->term : found->prefixTerm;
+}
+
+/* [[ Сборка словаря ]] */
+
+/*
+ * @brief Создание сборщика словаря
+ * Слова встроенных команд получают свои термы сразу.
+ *
+ * @return Сборщик или NULL, если не хватило памяти
+ */
+LexiconBuilder* CreateLexiconBuilder() {
+    LexiconBuilder *builder = calloc(1, sizeof(LexiconBuilder));
+    if (builder == NULL || !Grow((void **)&builder->nodes, &builder->nodeCapacity, 1, sizeof(BuildNode))) {
+        free(builder);
+        return NULL;
+    }
+    builder->nodes[0] = (BuildNode){NO_NODE, NO_NODE, LEXICON_NO_TERM, 0};
+    builder->nodeCount = 1;
+    builder->nextTerm = LEXICON_FIRST_TERM;
+
+    for (size_t i = 0; i < sizeof inventoryWords / sizeof inventoryWords[0]; i++) {
+        AddWordsAs(builder, inventoryWords[i], LEXICON_TERM_INVENTORY);
+    }
+    for (size_t i = 0; i < sizeof lookWords / sizeof lookWords[0]; i++) {
+        AddWordsAs(builder, lookWords[i], LEXICON_TERM_LOOK);
+    }
+    if (builder->failed) {
+        DestroyLexiconBuilder(builder);
+        return NULL;
+    }
+    return builder;
+}
+
+/*
+ * @brief Освобождение сборщика (NULL допустим)
+ */
+void DestroyLexiconBuilder(LexiconBuilder *builder) {
+    if (builder == NULL) {
+        return;
+    }
+    free(builder->nodes);
+    free(builder->pairs);
+    free(builder);
+}
+
+/*
+ * @brief Синонимы слова: все слова synonym получают терм слова word
+ * Синонимы добавляются до текстов действий: основа, уже занятая другим
+ * термом, - ошибка.
+ *
+ * @return false при ошибке, см. LexiconBuilderError
+ */
+bool LexiconAddSynonym(LexiconBuilder *builder, const char *word, const char *synonym) {
+    char stem[LEXICON_STEM_BYTES];
+    const char *cursor = word;
+    if (!NextLexiconWord(&cursor, stem, NULL, NULL) || stem[0] == '\0') {
+        Fail(builder, "synonym target is not a word", word);
+        return false;
+    }
+    uint32_t term = StemTerm(builder, stem);
+    return term != LEXICON_NO_TERM && AddWordsAs(builder, synonym, term);
+}
+
+/*
+ * @brief Слова текста - термы действия
+ * @param actionId Индекс действия в таблице мира
+ */
+bool LexiconAddActionText(LexiconBuilder *builder, uint32_t actionId, const char *text) {
+    char stem[LEXICON_STEM_BYTES];
+    while (NextLexiconWord(&text, stem, NULL, NULL)) {
+        if (stem[0] == '\0') {
+            continue;
+        }
+        uint32_t term = StemTerm(builder, stem);
+        if (term == LEXICON_NO_TERM ||
+            !Grow((void **)&builder->pairs, &builder->pairCapacity, builder->pairCount + 1, sizeof(ActionTerm))) {
+            Fail(builder, "out of memory", NULL);
+            return false;
+        }
+        builder->pairs[builder->pairCount++] = (ActionTerm){actionId, term};
+    }
+    return !builder->failed;
+}
+
+/*
+ * @brief Разложить словарь в таблицу образа
+ * Узлы нумеруются обходом в ширину, так что рёбра каждого узла лежат
+ * подряд и по возрастанию байта. Единственный терм поддерева считается
+ * от листьев к корню: у детей номера всегда больше, чем у родителя.
+ *
+ * @param actionCount Число действий мира (длина таблицы ActionTerms)
+ * @param size Сюда - размер таблицы, кратный 8
+ * @return Таблица (освобождать через free) или NULL при ошибке
+ */
+void* BuildLexicon(LexiconBuilder *builder, uint32_t actionCount, size_t *size) {
+    if (builder->failed) {
+        return NULL;
+    }
+
+    // Термы действия - по возрастанию и без повторов
+    qsort(builder->pairs, builder->pairCount, sizeof(ActionTerm), CompareActionTerms);
+    size_t termCount = 0;
+    for (size_t i = 0; i < builder->pairCount; i++) {
+        if (builder->pairs[i].action >= actionCount) {
+            Fail(builder, "lexicon refers to an unknown action", NULL);
+            return NULL;
+        }
+        if (termCount == 0 || builder->pairs[i].action != builder->pairs[termCount - 1].action ||
+            builder->pairs[i].term != builder->pairs[termCount - 1].term) {
+            builder->pairs[termCount++] = builder->pairs[i];
+        }
+    }
+    builder->pairCount = termCount;
+
+    size_t nodeCount = builder->nodeCount;
+    size_t edgeCount = nodeCount - 1;
+    size_t nodesOffset = sizeof(LexiconHeader);
+    size_t edgesOffset = nodesOffset + nodeCount * sizeof(LexiconNode);
+    size_t actionsOffset = edgesOffset + edgeCount * sizeof(LexiconEdge);
+    size_t termsOffset = actionsOffset + (size_t)actionCount * sizeof(ActionTerms);
+    size_t total = (termsOffset + termCount * sizeof(uint32_t) + 7) & ~(size_t)7;
+
+    char *blob = calloc(1, total);
+    uint32_t *order = malloc(nodeCount * sizeof(uint32_t));
+    if (blob == NULL || order == NULL) {
+        free(blob);
+        free(order);
+        Fail(builder, "out of memory", NULL);
+        return NULL;
+    }
+    LexiconHeader *header = (LexiconHeader *)blob;
+    LexiconNode *nodes = (LexiconNode *)(blob + nodesOffset);
+    LexiconEdge *edges = (LexiconEdge *)(blob + edgesOffset);
+    ActionTerms *actionTerms = (ActionTerms *)(blob + actionsOffset);
+    uint32_t *terms = (uint32_t *)(blob + termsOffset);
+
+    header->nodeCount = (uint32_t)nodeCount;
+    header->edgeCount = (uint32_t)edgeCount;
+    header->termCount = (uint32_t)termCount;
+
+    // order[i] - узел сборки с номером i в таблице
+    size_t placed = 1;
+    size_t edge = 0;
+    order[0] = 0;
+    for (size_t i = 0; i < nodeCount; i++) {
+        const BuildNode *from = &builder->nodes[order[i]];
+        nodes[i].firstEdge = (uint32_t)edge;
+        nodes[i].term = from->term;
+        for (uint32_t child = from->child; child != NO_NODE; child = builder->nodes[child].sibling) {
+            edges[edge++] = (LexiconEdge){builder->nodes[child].byte, (uint32_t)placed};
+            order[placed++] = child;
+        }
+        nodes[i].edgeCount = (uint32_t)edge - nodes[i].firstEdge;
+    }
+    for (size_t i = nodeCount; i-- > 0;) {
+        uint32_t prefix = nodes[i].term;
+        for (uint32_t e = nodes[i].firstEdge; e < nodes[i].firstEdge + nodes[i].edgeCount; e++) {
+            prefix = MergeTerms(prefix, nodes[edges[e].node].prefixTerm);
+        }
+        nodes[i].prefixTerm = prefix;
+    }
+    for (size_t i = 0; i < nodeCount; i++) {
+        if (nodes[i].prefixTerm == AMBIGUOUS_TERM) {
+            nodes[i].prefixTerm = LEXICON_NO_TERM;
+        }
+    }
+
+    for (size_t i = 0; i < termCount; i++) {
+        ActionTerms *slot = &actionTerms[builder->pairs[i].action];
+        if (slot->termCount == 0) {
+            slot->firstTerm = (uint32_t)i;
+        }
+        slot->termCount++;
+        terms[i] = builder->pairs[i].term;
+    }
+
+    free(order);
+    *size = total;
+    return blob;
+}
+
+/*
+ * @brief Текст последней ошибки сборщика словаря
+ */
+const char* LexiconBuilderError(const LexiconBuilder *builder) {
+    return builder->failed ? builder->error : "";
+}
+
+/* [[ Внутренние функции ]] */
+
+/* Латиница, цифры и кириллица (U+0400-U+047F: ведущий байт D0 или D1) */
+static bool IsWordByte(const unsigned char *p) {
+    if (*p < 0x80) {
+        return (*p >= '0' && *p <= '9') || (*p >= 'a' && *p <= 'z') || (*p >= 'A' && *p <= 'Z');
+    }
+    return (*p == 0xD0 || *p == 0xD1) && (p[1] & 0xC0) == 0x80;
+}
+
+/* Буква в нижнем регистре (ё - как е); *p сдвигается за неё */
+static int ReadLetter(const unsigned char **p) {
+    const unsigned char *at = *p;
+    if (*at < 0x80) {
+        *p = at + 1;
+        return *at >= 'A' && *at <= 'Z' ? *at + ('a' - 'A') : *at;
+    }
+    int letter = ((at[0] & 0x1F) << 6) | (at[1] & 0x3F);
+    *p = at + 2;
+    if (letter >= 0x410 && letter <= 0x42F) {
+        letter += 0x20;       // А-Я
+    } else if (letter >= 0x400 && letter <= 0x40F) {
+        letter += 0x50;       // Ѐ-Џ
+    }
+    return letter == 0x451 ? 0x435 : letter;
+}
+
+static size_t EncodeLetter(int letter, char *out) {
+    if (letter < 0x80) {
+        out[0] = (char)letter;
+        return 1;
+    }
+    out[0] = (char)(0xC0 | (letter >> 6));
+    out[1] = (char)(0x80 | (letter & 0x3F));
+    return 2;
+}
+
+/* Узел основы, недостающие узлы создаются; UINT32_MAX - не хватило памяти */
+static uint32_t InsertStem(LexiconBuilder *builder, const char *stem) {
+    uint32_t node = 0;
+    for (const unsigned char *p = (const unsigned char *)stem; *p != '\0'; p++) {
+        uint32_t previous = NO_NODE;
+        uint32_t child = builder->nodes[node].child;
+        while (child != NO_NODE && builder->nodes[child].byte < *p) {
+            previous = child;
+            child = builder->nodes[child].sibling;
+        }
+        if (child == NO_NODE || builder->nodes[child].byte != *p) {
+            if (builder->nodeCount >= UINT32_MAX - 1 ||
+                !Grow((void **)&builder->nodes, &builder->nodeCapacity, builder->nodeCount + 1, sizeof(BuildNode))) {
+                Fail(builder, "out of memory", NULL);
+                return UINT32_MAX;
+            }
+            uint32_t created = (uint32_t)builder->nodeCount++;
+            builder->nodes[created] = (BuildNode){NO_NODE, child, LEXICON_NO_TERM, *p};
+            if (previous == NO_NODE) {
+                builder->nodes[node].child = created;
+            } else {
+                builder->nodes[previous].sibling = created;
+            }
+            child = created;
+        }
+        node = child;
+    }
+    return node;
+}
+
+/* Терм основы; новая основа получает новый терм */
+static uint32_t StemTerm(LexiconBuilder *builder, const char *stem) {
+    uint32_t node = InsertStem(builder, stem);
+    if (node == UINT32_MAX) {
+        return LEXICON_NO_TERM;
+    }
+    if (builder->nodes[node].term == LEXICON_NO_TERM) {
+        builder->nodes[node].term = builder->nextTerm++;
+    }
+    return builder->nodes[node].term;
+}
+
+/* Все значимые слова текста - с термом term */
+static bool AddWordsAs(LexiconBuilder *builder, const char *text, uint32_t term) {
+    char stem[LEXICON_STEM_BYTES];
+    const char *word;
+    size_t wordLength;
+    while (NextLexiconWord(&text, stem, &word, &wordLength)) {
+        if (stem[0] == '\0') {
+            continue;
+        }
+        uint32_t node = InsertStem(builder, stem);
+        if (node == UINT32_MAX) {
+            return false;
+        }
+        if (builder->nodes[node].term != LEXICON_NO_TERM && builder->nodes[node].term != term) {
+            Fail(builder, "synonym clashes with another word:", stem);
+            return false;
+        }
+        builder->nodes[node].term = term;
+    }
+    return true;
+}
+
+static bool Grow(void **data, size_t *capacity, size_t count, size_t elemSize) {
+    if (count <= *capacity) {
+        return true;
+    }
+    size_t newCapacity = *capacity > 0 ? *capacity * 2 : 64;
+    while (newCapacity < count) {
+        newCapacity *= 2;
+    }
+    void *grown = realloc(*data, newCapacity * elemSize);
+    if (grown == NULL) {
+        return false;
+    }
+    *data = grown;
+    *capacity = newCapacity;
+    return true;
+}
+
+static int CompareActionTerms(const void *a, const void *b) {
+    const ActionTerm *x = a;
+    const ActionTerm *y = b;
+    if (x->action != y->action) {
+        return x->action < y->action ? -1 : 1;
+    }
+    return (x->term > y->term) - (x->term < y->term);
+}
+
+/* Терм поддерева: LEXICON_NO_TERM - термов нет, AMBIGUOUS_TERM - их несколько */
+static uint32_t MergeTerms(uint32_t a, uint32_t b) {
+    if (a == LEXICON_NO_TERM) {
+        return b;
+    }
+    if (b == LEXICON_NO_TERM || a == b) {
+        return a;
+    }
+    return AMBIGUOUS_TERM;
+}
+
+static void Fail(LexiconBuilder *builder, const char *message, const char *detail) {
+    if (!builder->failed) {
+        builder->failed = true;
+        snprintf(builder->error, sizeof builder->error, "%s%s%s", message, detail != NULL ? " " : "",
+                 detail != NULL ? detail : "");
+    }
+}
@@ -0,0 +1,46 @@
+#ifndef LEXICON_H
+#define LEXICON_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "world.h"
+
+/*
+ * [[ Слова и основы ]]
+ *
+ * Слово - последовательность латинских букв, цифр и кириллицы в UTF-8,
+ * всё прочее - разделители. Слово приводится к нижнему регистру (ё - к е)
+ * и к основе: отбрасывается одно падежное или глагольное окончание, если
+ * после него остаётся не меньше трёх букв, и от результата берутся первые
+ * шесть букв. Так "библиотеку", "библиотека" и "библиотеке" дают одну
+ * основу. Слова короче трёх букв ("в", "на") - служебные, их основа пуста.
+ *
+ * Одной и той же функцией основы строятся при сборке словаря
+ * (world-compiler) и при разборе ввода, поэтому они всегда согласованы.
+ */
+
+#define LEXICON_STEM_LETTERS 6
+#define LEXICON_MIN_LETTERS 3
+#define LEXICON_STEM_BYTES 16   // 6 букв по 2 байта и завершающий ноль
+
+/* [[ Функции словаря ]] */
+bool NextLexiconWord(const char **cursor, char *stem, const char **word, size_t *wordLength);
+uint32_t LookupLexicon(const Lexicon *lexicon, const char *stem);
+
+/* [[ Сборка словаря ]] */
+/*
+ * Накапливает основы, синонимы и термы действий, затем раскладывает их
+ * в таблицу словаря (см. LexiconHeader в world.h). Используется
+ * сборщиком образа мира.
+ */
+typedef struct LexiconBuilder LexiconBuilder;
+
+LexiconBuilder* CreateLexiconBuilder();
+void DestroyLexiconBuilder(LexiconBuilder *builder);
+bool LexiconAddSynonym(LexiconBuilder *builder, const char *word, const char *synonym);
+bool LexiconAddActionText(LexiconBuilder *builder, uint32_t actionId, const char *text);
+void* BuildLexicon(LexiconBuilder *builder, uint32_t actionCount, size_t *size);
+const char* LexiconBuilderError(const LexiconBuilder *builder);
+
+#endif
@@ -0,0 +1,429 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#include "session-store.h"
+#include "journal.h"
+#include "../utils/clock.h"
+#include "../utils/hash.h"
+#include "../utils/random.h"
+
+_Static_assert(sizeof(SessionStoreHeader) == SESSION_STORE_LINE, "session store header layout");
+_Static_assert(sizeof(SessionRecord) == 24, "session record layout");
+
+/* [[ Состояние слота в памяти ]] */
+typedef enum {
+    SLOT_FREE,      // в списке свободных
+    SLOT_STORED,    // в файле партия, которую можно продолжить
+    SLOT_OPEN       // партию ведёт соединение
+} SlotStatus;
+
+typedef struct {
+    uint64_t secret;      // секрет открытой партии
+    uint32_t sequence;    // наибольший номер записи в слоте
+    uint8_t current;      // запись с последним целым состоянием; пишется другая
+    uint8_t status;       // SlotStatus
+} SlotState;
+
+/* [[ Хранилище ]] */
+struct SessionStore {
+    unsigned char *image;       // отображение файла целиком
+    size_t size;
+#ifndef _WIN32
+    int fd;                     // держит блокировку файла
+#endif
+    uint32_t stateSize;
+    uint32_t recordSize;
+    uint32_t slotSize;
+    uint32_t slotCount;
+    SlotState *slots;
+    uint32_t *freeSlots;        // стек: сверху слоты с меньшими номерами
+    uint32_t freeCount;
+    SessionStoreStats stats;
+};
+
+/* [[ Прототипы внутренних функций ]] */
+static SessionRecord* RecordAt(const SessionStore *store, uint32_t slot, int record);
+static uint32_t RecordChecksum(const SessionStore *store, const SessionRecord *record, uint32_t sequence);
+static bool RecordValid(const SessionStore *store, const SessionRecord *record);
+static void WriteRecord(SessionStore *store, uint32_t slot, uint64_t secret, const GameState *state);
+static void FreeSlot(SessionStore *store, uint32_t slot);
+static void ScanSlots(SessionStore *store);
+static bool MapStoreFile(SessionStore *store, const char *path, size_t createSize);
+static void UnmapStoreFile(SessionStore *store, bool sync);
+
+/* [[ Функции хранилища ]] */
+
+/*
+ * @brief Открыть хранилище партий или создать новое
+ * Существующий файл принимается, только если записан для того же мира;
+ * число слотов тогда берётся из файла. Открыть файл может один процесс.
+ *
+ * @param world Мир, в котором идут партии
+ * @param slots Слотов в новом файле (0 - SESSION_STORE_DEFAULT_SLOTS)
+ * @return Хранилище или NULL при ошибке (сообщение уже выведено)
+ */
+SessionStore* OpenSessionStore(const char *path, const World *world, uint32_t slots) {
+    uint64_t started = NowNanoseconds();
+    if (slots == 0) {
+        slots = SESSION_STORE_DEFAULT_SLOTS;
+    }
+    if (slots > SESSION_STORE_MAX_SLOTS) {
+        fprintf(stderr, "%s: too many session slots (max %u)\n", path, SESSION_STORE_MAX_SLOTS);
+        return NULL;
+    }
+    SessionStore *store = calloc(1, sizeof *store);
+    if (store == NULL) {
+        return NULL;
+    }
+    store->stateSize = (uint32_t)GameStateSize(world);
+    store->recordSize = (uint32_t)((sizeof(SessionRecord) + store->stateSize + 7) & ~(size_t)7);
+    store->slotSize = (2 * store->recordSize + SESSION_STORE_LINE - 1) & ~(uint32_t)(SESSION_STORE_LINE - 1);
+
+    if (!MapStoreFile(store, path, sizeof(SessionStoreHeader) + (size_t)slots * store->slotSize)) {
+        free(store);
+        return NULL;
+    }
+
+    // Новый файл - нули; заголовок пишется сразу, слоты свободны
+    SessionStoreHeader *header = (SessionStoreHeader *)store->image;
+    uint32_t worldHash = HashWorldImage(world);
+    if (header->magic == 0 && store->size == sizeof *header + (size_t)slots * store->slotSize) {
+        *header = (SessionStoreHeader){SESSION_STORE_MAGIC, SESSION_STORE_VERSION, sizeof *header, worldHash,
+                                       store->stateSize, store->recordSize, store->slotSize, slots, {0}};
+    }
+    if (store->size < sizeof *header || header->magic != SESSION_STORE_MAGIC ||
+        header->version != SESSION_STORE_VERSION || header->headerSize != sizeof *header ||
+        header->worldHash != worldHash || header->stateSize != store->stateSize ||
+        header->recordSize != store->recordSize || header->slotSize != store->slotSize ||
+        header->slotCount == 0 || header->slotCount > SESSION_STORE_MAX_SLOTS ||
+        store->size != sizeof *header + (size_t)header->slotCount * store->slotSize) {
+        fprintf(stderr, "%s: not a session store of this world\n", path);
+        UnmapStoreFile(store, false);
+        free(store);
+        return NULL;
+    }
+    store->slotCount = header->slotCount;
+    store->slots = calloc(store->slotCount, sizeof *store->slots);
+    store->freeSlots = malloc(store->slotCount * sizeof *store->freeSlots);
+    if (store->slots == NULL || store->freeSlots == NULL) {
+        CloseSessionStore(store);
+        return NULL;
+    }
+
+    ScanSlots(store);
+    store->stats.slots = store->slotCount;
+    store->stats.openNs = NowNanoseconds() - started;
+    return store;
+}
+
+/*
+ * @brief Сбросить хранилище на диск и закрыть
+ * Открытые партии остаются в файле, их можно продолжить после запуска.
+ */
+void CloseSessionStore(SessionStore *store) {
+    if (store == NULL) {
+        return;
+    }
+    UnmapStoreFile(store, true);
+    free(store->slots);
+    free(store->freeSlots);
+    free(store);
+}
+
+/*
+ * @brief Занять слот под новую партию
+ * Секрет берётся у генератора ОС: код другой партии по своему не угадать.
+ * В файл ничего не пишется до первого SaveStoredSession.
+ *
+ * @param code Код, по которому партию продолжат (ResumeStoredSession)
+ * @return Номер слота или -1, если свободных нет или ОС не дала секрет
+ */
+int NewStoredSession(SessionStore *store, SessionCode *code) {
+    uint64_t secret = 0;
+    if (store->freeCount == 0 || !SecureRandom(&secret, sizeof secret) || secret == 0) {
+        return -1;
+    }
+    uint32_t slot = store->freeSlots[--store->freeCount];
+    SlotState *state = &store->slots[slot];
+    state->secret = secret;
+    state->status = SLOT_OPEN;
+    store->stats.stored++;
+    *code = (SessionCode){slot, secret};
+    return (int)slot;
+}
+
+/*
+ * @brief Продолжить сохранённую партию по коду
+ * Из двух записей слота берётся последняя целая. Партию, открытую
+ * другим соединением, продолжить нельзя.
+ *
+ * @param slot Сюда - номер слота, он становится открытым
+ * @return Состояние прямо в отображении файла (живо до записи слота)
+ *         или NULL, если партии с таким кодом нет
+ */
+const GameState* ResumeStoredSession(SessionStore *store, const SessionCode *code, int *slot) {
+    uint32_t index = code->slot;
+    if (code->secret == 0 || index >= store->slotCount || store->slots[index].status != SLOT_STORED) {
+        return NULL;
+    }
+    SessionRecord *records[2] = {RecordAt(store, index, 0), RecordAt(store, index, 1)};
+    int chosen = -1;
+    for (int r = 0; r < 2; r++) {
+        if (RecordValid(store, records[r]) && (chosen < 0 || records[r]->sequence > records[chosen]->sequence)) {
+            chosen = r;
+        }
+    }
+    if (chosen < 0 || records[chosen]->secret == 0) {
+        // Целой партии в слоте нет: обе записи оборваны или последняя - конец партии
+        FreeSlot(store, index);
+        return NULL;
+    }
+    if (records[chosen]->secret != code->secret) {
+        return NULL;
+    }
+    if (records[1 - chosen]->sequence > records[chosen]->sequence) {
+        store->stats.torn++;
+    }
+    SlotState *state = &store->slots[index];
+    state->secret = code->secret;
+    state->current = (uint8_t)chosen;
+    state->status = SLOT_OPEN;
+    *slot = (int)index;
+    return (const GameState *)(records[chosen] + 1);
+}
+
+/*
+ * @brief Записать состояние открытой партии
+ * Пишется более старая запись слота; прежнее состояние остаётся целым,
+ * пока новое не дописано.
+ *
+ * @param slot Слот из NewStoredSession/ResumeStoredSession, -1 - ничего не делать
+ */
+void SaveStoredSession(SessionStore *store, int slot, const GameState *state) {
+    if (slot < 0) {
+        return;
+    }
+    WriteRecord(store, (uint32_t)slot, store->slots[slot].secret, state);
+}
+
+/*
+ * @brief Отпустить слот открытой партии
+ * @param keep true - партия остаётся в файле (обрыв соединения),
+ *             false - закончена, слот свободен
+ */
+void ReleaseStoredSession(SessionStore *store, int slot, bool keep) {
+    if (slot < 0) {
+        return;
+    }
+    if (keep) {
+        store->slots[slot].status = SLOT_STORED;
+        return;
+    }
+    WriteRecord(store, (uint32_t)slot, 0, NULL);
+    FreeSlot(store, (uint32_t)slot);
+}
+
+SessionStoreStats GetSessionStoreStats(const SessionStore *store) {
+    return store->stats;
+}
+
+/*
+ * @brief Код партии текстом для игрока
+ * @param text Буфер на SESSION_CODE_LENGTH символов и нуль
+ */
+void FormatSessionCode(const SessionCode *code, char text[SESSION_CODE_LENGTH + 1]) {
+    snprintf(text, SESSION_CODE_LENGTH + 1, "%08lx%016llx", (unsigned long)code->slot,
+             (unsigned long long)code->secret);
+}
+
+/*
+ * @brief Разбор кода партии из ввода
+ * Пробелы вокруг допустимы, код - ровно SESSION_CODE_LENGTH
+ * шестнадцатеричных цифр.
+ */
+bool ParseSessionCode(const char *text, SessionCode *code) {
+    text += strspn(text, " \t");
+    size_t length = strspn(text, "0123456789abcdefABCDEF");
+    if (length != SESSION_CODE_LENGTH || text[length + strspn(text + length, " \t\r\n")] != '\0') {
+        return false;
+    }
+    uint64_t slot = 0;
+    uint64_t secret = 0;
+    for (size_t i = 0; i < length; i++) {
+        char c = text[i];
+        uint64_t digit = c <= '9' ? (uint64_t)(c - '0') : (uint64_t)((c | 0x20) - 'a' + 10);
+        if (i < 8) {
+            slot = slot << 4 | digit;
+        } else {
+            secret = secret << 4 | digit;
+        }
+    }
+    *code = (SessionCode){(uint32_t)slot, secret};
+    return true;
+}
+
+/* [[ Внутренние функции ]] */
+
+static SessionRecord* RecordAt(const SessionStore *store, uint32_t slot, int record) {
+    return (SessionRecord *)(store->image + sizeof(SessionStoreHeader) + (size_t)slot * store->slotSize +
+                             (size_t)record * store->recordSize);
+}
+
+/* Сумма по секрету, времени, номеру записи и состоянию */
+static uint32_t RecordChecksum(const SessionStore *store, const SessionRecord *record, uint32_t sequence) {
+    uint32_t hash = HashBytes(&record->secret, sizeof record->secret + sizeof record->stamp, HASH_SEED);
+    hash = HashBytes(&sequence, sizeof sequence, hash);
+    return HashBytes(record + 1, store->stateSize, hash);
+}
+
+static bool RecordValid(const SessionStore *store, const SessionRecord *record) {
+    return record->sequence != 0 && record->checksum == RecordChecksum(store, record, record->sequence);
+}
+
+/*
+ * Запись в более старую половину слота. Номер записи обнуляется первым
+ * и ставится последним: при обрыве процесса посреди записи она старше
+ * соседней уже по номеру. При сбое питания порядок страниц на диске не
+ * гарантирован - тогда обрыв видит контрольная сумма.
+ */
+static void WriteRecord(SessionStore *store, uint32_t slot, uint64_t secret, const GameState *state) {
+    SlotState *slotState = &store->slots[slot];
+    int target = 1 - slotState->current;
+    SessionRecord *record = RecordAt(store, slot, target);
+    uint32_t sequence = ++slotState->sequence;
+
+    record->sequence = 0;
+    record->secret = secret;
+    record->stamp = (int64_t)time(NULL);
+    if (state != NULL) {
+        memcpy(record + 1, state, store->stateSize);
+    } else {
+        memset(record + 1, 0, store->stateSize);
+    }
+    record->checksum = RecordChecksum(store, record, sequence);
+    record->sequence = sequence;
+    slotState->current = (uint8_t)target;
+}
+
+static void FreeSlot(SessionStore *store, uint32_t slot) {
+    store->slots[slot].status = SLOT_FREE;
+    store->freeSlots[store->freeCount++] = slot;
+    store->stats.stored--;
+}
+
+/*
+ * Разбор слотов при открытии: только номера, коды и время записей, без
+ * сумм - по строке кэша на слот. Занятым считается слот, чья последняя
+ * по номеру запись - партия не старше SESSION_STORE_TTL.
+ */
+static void ScanSlots(SessionStore *store) {
+    int64_t now = (int64_t)time(NULL);
+
+    for (uint32_t slot = store->slotCount; slot-- > 0;) {
+        const SessionRecord *a = RecordAt(store, slot, 0);
+        const SessionRecord *b = RecordAt(store, slot, 1);
+        int newest = b->sequence > a->sequence;
+        const SessionRecord *record = newest ? b : a;
+        SlotState *state = &store->slots[slot];
+
+        state->sequence = record->sequence;
+        state->current = (uint8_t)newest;
+        if (record->sequence != 0 && record->secret != 0) {
+            if (record->stamp <= now && now - record->stamp < SESSION_STORE_TTL) {
+                state->status = SLOT_STORED;
+                store->stats.recovered++;
+                continue;
+            }
+            store->stats.expired++;
+        }
+        state->status = SLOT_FREE;
+        store->freeSlots[store->freeCount++] = slot;
+    }
+    store->stats.stored = store->stats.recovered;
+}
+
+/* Отображение файла на чтение и запись; пустой файл растягивается до createSize */
+static bool MapStoreFile(SessionStore *store, const char *path, size_t createSize) {
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, NULL, OPEN_ALWAYS,
+                              FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE) {
+        fprintf(stderr, "%s: cannot open session store\n", path);
+        return false;
+    }
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize)) {
+        CloseHandle(file);
+        fprintf(stderr, "%s: cannot open session store\n", path);
+        return false;
+    }
+    size_t length = fileSize.QuadPart > 0 ? (size_t)fileSize.QuadPart : createSize;
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READWRITE, (DWORD)((uint64_t)length >> 32),
+                                        (DWORD)length, NULL);
+    CloseHandle(file);
+    void *image = mapping != NULL ? MapViewOfFile(mapping, FILE_MAP_WRITE, 0, 0, length) : NULL;
+    if (mapping != NULL) {
+        CloseHandle(mapping);
+    }
+    if (image == NULL) {
+        fprintf(stderr, "%s: cannot map session store\n", path);
+        return false;
+    }
+    store->image = image;
+    store->size = length;
+    return true;
+#else
+    int fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        fprintf(stderr, "%s: cannot open session store\n", path);
+        return false;
+    }
+    if (flock(fd, LOCK_EX | LOCK_NB) != 0) {
+        fprintf(stderr, "%s: session store is in use\n", path);
+        close(fd);
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (st.st_size == 0 && ftruncate(fd, (off_t)createSize) != 0)) {
+        fprintf(stderr, "%s: cannot open session store\n", path);
+        close(fd);
+        return false;
+    }
+    size_t length = st.st_size > 0 ? (size_t)st.st_size : createSize;
+    void *image = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (image == MAP_FAILED) {
+        fprintf(stderr, "%s: cannot map session store\n", path);
+        close(fd);
+        return false;
+    }
+    store->image = image;
+    store->size = length;
+    store->fd = fd;
+    return true;
+#endif
+}
+
+static void UnmapStoreFile(SessionStore *store, bool sync) {
+#ifdef _WIN32
+    if (sync) {
+        FlushViewOfFile(store->image, 0);
+    }
+    UnmapViewOfFile(store->image);
+#else
+    if (sync) {
+        msync(store->image, store->size, MS_SYNC);
+    }
+    munmap(store->image, store->size);
+    close(store->fd);
+#endif
+}
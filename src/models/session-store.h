@@ -0,0 +1,90 @@
+#ifndef SESSION_STORE_H
+#define SESSION_STORE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "game.h"
+
+/*
+ * [[ Хранилище партий ]]
+ *
+ * Файл, отображённый в память: заголовок и слоты фиксированного
+ * размера, выровненные по строке кэша. Слот - одна партия, в нём две
+ * записи GameState с номером записи (sequence) и контрольной суммой.
+ * Запись идёт в более старую из двух, поэтому оборванная (сбой питания
+ * посреди записи) видна по сумме, а предыдущая остаётся целой: партия
+ * теряет не больше одного хода.
+ *
+ * Восстановление после перезапуска - снова отобразить файл. При
+ * открытии читаются только заголовки записей, чтобы собрать список
+ * свободных слотов; суммы проверяются, когда партию продолжают
+ * (ResumeStoredSession), и состояние берётся прямо из отображения.
+ *
+ * Код партии - номер слота и 64-битный секрет из генератора ОС
+ * (SecureRandom); в слоте хранится только секрет. Слоты, не записанные
+ * дольше SESSION_STORE_TTL, при открытии считаются свободными.
+ * Хранилищем пользуется один поток.
+ */
+#define SESSION_STORE_MAGIC 0x53534553u   // "SESS"
+#define SESSION_STORE_VERSION 2
+#define SESSION_STORE_LINE 64             // выравнивание слотов
+#define SESSION_STORE_DEFAULT_SLOTS 65536
+#define SESSION_STORE_MAX_SLOTS (1u << 24)
+#define SESSION_STORE_TTL (7 * 24 * 3600) // секунд без записи до освобождения слота
+
+/* [[ Заголовок файла ]] */
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t headerSize;    // слоты начинаются сразу за заголовком
+    uint32_t worldHash;     // отпечаток образа мира, см. HashWorldImage
+    uint32_t stateSize;     // GameStateSize мира
+    uint32_t recordSize;    // SessionRecord со state, кратно 8
+    uint32_t slotSize;      // две записи, кратно SESSION_STORE_LINE
+    uint32_t slotCount;
+    uint8_t reserved[36];
+} SessionStoreHeader;
+
+/* [[ Запись слота ]] */
+/* За записью - GameState на stateSize байт */
+typedef struct {
+    uint64_t secret;        // 0 - партия закончена, слот свободен
+    int64_t stamp;          // время записи, секунды UTC
+    uint32_t sequence;      // растёт с каждой записью слота; 0 - не писалась
+    uint32_t checksum;      // HashBytes записи без этого поля вместе с состоянием
+} SessionRecord;
+
+/* [[ Код партии ]] */
+/* В тексте - 8 шестнадцатеричных цифр слота и 16 - секрета */
+#define SESSION_CODE_LENGTH 24
+
+typedef struct {
+    uint32_t slot;
+    uint64_t secret;
+} SessionCode;
+
+/* [[ Счётчики хранилища ]] */
+typedef struct {
+    uint32_t slots;
+    uint32_t stored;        // слоты с партиями, включая открытые
+    uint32_t recovered;     // партий найдено при открытии
+    uint32_t expired;       // освобождено при открытии по SESSION_STORE_TTL
+    uint32_t torn;          // оборванных записей, вместо которых взята предыдущая
+    uint64_t openNs;        // время открытия и разбора слотов
+} SessionStoreStats;
+
+typedef struct SessionStore SessionStore;
+
+/* [[ Функции хранилища ]] */
+SessionStore* OpenSessionStore(const char *path, const World *world, uint32_t slots);
+void CloseSessionStore(SessionStore *store);
+int NewStoredSession(SessionStore *store, SessionCode *code);
+const GameState* ResumeStoredSession(SessionStore *store, const SessionCode *code, int *slot);
+void SaveStoredSession(SessionStore *store, int slot, const GameState *state);
+void ReleaseStoredSession(SessionStore *store, int slot, bool keep);
+SessionStoreStats GetSessionStoreStats(const SessionStore *store);
+void FormatSessionCode(const SessionCode *code, char text[SESSION_CODE_LENGTH + 1]);
+bool ParseSessionCode(const char *text, SessionCode *code);
+
+#endif
@@ -0,0 +1,638 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include "state-delta.h"
+#include "command-parser.h"
+#include "../utils/bitset.h"
+#include "../utils/metrics.h"
+
+/* [[ Сообщение ]] */
+/*
+ * Сообщение пишется прямо в кадр вывода. Поля - пары ключ/значение:
+ * в JSON ключ печатается, в двоичном кадре порядок полей фиксирован
+ * и ключ пропускается. Длина двоичного кадра дописывается в конце.
+ */
+typedef struct {
+    FrameBuffer *out;
+    bool json;
+    size_t start;      // начало сообщения в кадре
+    bool firstField;
+} Message;
+
+/* Множество в битах GameState: слово начала и длина в словах */
+typedef struct {
+    uint32_t word;
+    size_t words;
+} StateSet;
+
+/* [[ Прототипы внутренних функций ]] */
+static void BeginMessage(Message *m, DeltaFormat format, FrameBuffer *out, char type);
+static void EndMessage(Message *m);
+static void PutKey(Message *m, const char *key);
+static void PutUnsigned(Message *m, const char *key, uint64_t value);
+static void PutIndex(Message *m, const char *key, int32_t value);
+static void PutString(Message *m, const char *key, const char *text, size_t length);
+static void PutBits(Message *m, const char *key, const uint64_t *now, const uint64_t *before, size_t words);
+static bool HasNewBits(const uint64_t *now, const uint64_t *before, size_t words);
+static void PutVarint(FrameBuffer *out, uint64_t value);
+static void PutDecimal(FrameBuffer *out, uint64_t value);
+static void PutJsonString(FrameBuffer *out, const char *text, size_t length);
+static void PutTextEntry(Message *m, const World *world, const LocationPage *page, uint32_t offset);
+static const char* EventName(int event);
+static const char* TextCommandError(TextCommandKind kind);
+
+/* [[ Функции протокола ]] */
+
+/*
+ * @brief Кодировщик для одного клиента
+ * Первое сообщение состояния будет снимком.
+ *
+ * @return false если не хватило памяти
+ */
+bool InitDeltaEncoder(DeltaEncoder *encoder, const World *world, DeltaFormat format) {
+    encoder->format = format;
+    encoder->primed = false;
+    encoder->sequence = 0;
+    encoder->stateSize = GameStateSize(world);
+    encoder->known = calloc(1, encoder->stateSize);
+    return encoder->known != NULL;
+}
+
+void FreeDeltaEncoder(DeltaEncoder *encoder) {
+    free(encoder->known);
+    encoder->known = NULL;
+}
+
+/*
+ * @brief Изменения состояния сессии с прошлого сообщения
+ * Пустые списки не пишутся; до первого снимка пишется снимок.
+ * Стоимость - проход по словам множеств мира, без выделений памяти.
+ *
+ * @param event StepResult хода или DELTA_EVENT_*
+ */
+void WriteStateDelta(DeltaEncoder *encoder, const GameSession *session, int event, FrameBuffer *out) {
+    if (!encoder->primed) {
+        WriteStateSnapshot(encoder, session, out);
+        return;
+    }
+    const World *world = GetSessionWorld(session);
+    const GameState *now = GetSessionState(session);
+    const GameState *before = encoder->known;
+    StateSet inventory = {world->inventoryWord, BITSET_WORDS(world->itemCount)};
+    StateSet collected = {world->collectedWord, BITSET_WORDS(world->itemCount)};
+    StateSet available = {world->availableWord, BITSET_WORDS(world->actionCount)};
+
+    unsigned changed = 0;
+    if (now->currentLocation != before->currentLocation) {
+        changed |= DELTA_HAS_LOCATION;
+    }
+    if (HasNewBits(now->bits + inventory.word, before->bits + inventory.word, inventory.words)) {
+        changed |= DELTA_HAS_INVENTORY_ADDED;
+    }
+    if (HasNewBits(before->bits + inventory.word, now->bits + inventory.word, inventory.words)) {
+        changed |= DELTA_HAS_INVENTORY_GONE;
+    }
+    if (HasNewBits(now->bits + collected.word, before->bits + collected.word, collected.words)) {
+        changed |= DELTA_HAS_COLLECTED_ADDED;
+    }
+    if (HasNewBits(before->bits + collected.word, now->bits + collected.word, collected.words)) {
+        changed |= DELTA_HAS_COLLECTED_GONE;
+    }
+    if (HasNewBits(now->bits + available.word, before->bits + available.word, available.words)) {
+        changed |= DELTA_HAS_ACTIONS_ON;
+    }
+    if (HasNewBits(before->bits + available.word, now->bits + available.word, available.words)) {
+        changed |= DELTA_HAS_ACTIONS_OFF;
+    }
+    if ((now->flags ^ before->flags) & GAME_FLAG_WON) {
+        changed |= DELTA_HAS_WON;
+    }
+
+    Message m;
+    BeginMessage(&m, encoder->format, out, DELTA_CHANGE);
+    PutUnsigned(&m, "seq", encoder->sequence++);
+    PutUnsigned(&m, "turn", (uint64_t)GetTurnNumber(session));
+    if (m.json) {
+        PutKey(&m, "r");
+        PutJsonString(out, EventName(event), strlen(EventName(event)));
+    } else {
+        // Флаги - какие поля дальше; DELTA_HAS_WON - признак победы сменился
+        char flags = (char)changed;
+        PutVarint(out, (uint64_t)event);
+        FrameAppendN(out, &flags, 1);
+    }
+    if (changed & DELTA_HAS_LOCATION) {
+        PutUnsigned(&m, "loc", now->currentLocation);
+    }
+    if (changed & DELTA_HAS_INVENTORY_ADDED) {
+        PutBits(&m, "inv+", now->bits + inventory.word, before->bits + inventory.word, inventory.words);
+    }
+    if (changed & DELTA_HAS_INVENTORY_GONE) {
+        PutBits(&m, "inv-", before->bits + inventory.word, now->bits + inventory.word, inventory.words);
+    }
+    if (changed & DELTA_HAS_COLLECTED_ADDED) {
+        PutBits(&m, "col+", now->bits + collected.word, before->bits + collected.word, collected.words);
+    }
+    if (changed & DELTA_HAS_COLLECTED_GONE) {
+        PutBits(&m, "col-", before->bits + collected.word, now->bits + collected.word, collected.words);
+    }
+    if (changed & DELTA_HAS_ACTIONS_ON) {
+        PutBits(&m, "act+", now->bits + available.word, before->bits + available.word, available.words);
+    }
+    if (changed & DELTA_HAS_ACTIONS_OFF) {
+        PutBits(&m, "act-", before->bits + available.word, now->bits + available.word, available.words);
+    }
+    if ((changed & DELTA_HAS_WON) && m.json) {
+        PutKey(&m, "won");
+        FrameAppend(out, (now->flags & GAME_FLAG_WON) ? "true" : "false");
+    }
+    EndMessage(&m);
+    memcpy(encoder->known, now, encoder->stateSize);
+}
+
+/*
+ * @brief Полное состояние: для первого сообщения и для повторной
+ * синхронизации клиента (/snapshot)
+ */
+void WriteStateSnapshot(DeltaEncoder *encoder, const GameSession *session, FrameBuffer *out) {
+    const World *world = GetSessionWorld(session);
+    const GameState *now = GetSessionState(session);
+    size_t itemWords = BITSET_WORDS(world->itemCount);
+
+    Message m;
+    BeginMessage(&m, encoder->format, out, DELTA_SNAPSHOT);
+    PutUnsigned(&m, "seq", encoder->sequence++);
+    PutUnsigned(&m, "turn", (uint64_t)GetTurnNumber(session));
+    PutUnsigned(&m, "loc", now->currentLocation);
+    PutUnsigned(&m, "won", (now->flags & GAME_FLAG_WON) != 0);
+    PutBits(&m, "inv", now->bits + world->inventoryWord, NULL, itemWords);
+    PutBits(&m, "col", now->bits + world->collectedWord, NULL, itemWords);
+    PutBits(&m, "act", now->bits + world->availableWord, NULL, BITSET_WORDS(world->actionCount));
+    EndMessage(&m);
+
+    memcpy(encoder->known, now, encoder->stateSize);
+    encoder->primed = true;
+}
+
+/*
+ * @brief Справочник мира: номера текстов и связи записей
+ * Локации - [название, описание, первое действие, число действий,
+ * [предметы]], действия - [текст, результат, отказ, куда, требует,
+ * даёт] (-1 - нет), предметы - [название, описание]. Тексты предметов
+ * всегда в памяти, поэтому идут тут же; тексты локаций - через /texts.
+ * В двоичном кадре индексы со значением -1 пишутся со сдвигом на 1.
+ */
+void WriteWorldCatalog(const DeltaEncoder *encoder, const World *world, FrameBuffer *out) {
+    Message m;
+    BeginMessage(&m, encoder->format, out, DELTA_CATALOG);
+    PutUnsigned(&m, "start", (uint64_t)world->startLocation);
+    PutIndex(&m, "win", world->winItem);
+
+    PutKey(&m, "locations");
+    if (m.json) {
+        FrameAppend(out, "[");
+    } else {
+        PutVarint(out, (uint64_t)world->locationCount);
+    }
+    for (int l = 0; l < world->locationCount; l++) {
+        const Location *loc = &world->locations[l];
+        Message row = {out, m.json, 0, true};
+        FrameAppend(out, m.json ? (l == 0 ? "[" : ",[") : "");
+        PutUnsigned(&row, NULL, loc->name);
+        PutUnsigned(&row, NULL, loc->description);
+        PutUnsigned(&row, NULL, loc->firstAction);
+        PutUnsigned(&row, NULL, loc->actionCount);
+        PutKey(&row, NULL);
+        if (m.json) {
+            FrameAppend(out, "[");
+        } else {
+            PutVarint(out, loc->itemCount);
+        }
+        for (int i = 0; i < (int)loc->itemCount; i++) {
+            Message item = {out, m.json, 0, i == 0};
+            PutIndex(&item, NULL, GetLocationItemId(world, loc, i));
+        }
+        FrameAppend(out, m.json ? "]]" : "");
+    }
+    FrameAppend(out, m.json ? "]" : "");
+
+    PutKey(&m, "actions");
+    if (m.json) {
+        FrameAppend(out, "[");
+    } else {
+        PutVarint(out, (uint64_t)world->actionCount);
+    }
+    for (int a = 0; a < world->actionCount; a++) {
+        const Action *action = &world->actions[a];
+        Message row = {out, m.json, 0, true};
+        FrameAppend(out, m.json ? (a == 0 ? "[" : ",[") : "");
+        PutUnsigned(&row, NULL, action->text);
+        PutUnsigned(&row, NULL, action->resultText);
+        PutUnsigned(&row, NULL, action->blockedText);
+        PutIndex(&row, NULL, action->targetLocation);
+        PutIndex(&row, NULL, action->requiredItem);
+        PutIndex(&row, NULL, action->givesItem);
+        FrameAppend(out, m.json ? "]" : "");
+    }
+    FrameAppend(out, m.json ? "]" : "");
+
+    PutKey(&m, "items");
+    if (m.json) {
+        FrameAppend(out, "[");
+    } else {
+        PutVarint(out, (uint64_t)world->itemCount);
+    }
+    for (int i = 0; i < world->itemCount; i++) {
+        Message row = {out, m.json, 0, true};
+        FrameAppend(out, m.json ? (i == 0 ? "[" : ",[") : "");
+        PutUnsigned(&row, NULL, world->items[i].name);
+        PutUnsigned(&row, NULL, world->items[i].description);
+        FrameAppend(out, m.json ? "]" : "");
+    }
+    FrameAppend(out, m.json ? "]" : "");
+
+    PutKey(&m, "texts");
+    if (m.json) {
+        FrameAppend(out, "[");
+    } else {
+        uint64_t present = 0;
+        for (int i = 0; i < world->itemCount; i++) {
+            present += (world->items[i].name != 0) + (world->items[i].description != 0);
+        }
+        PutVarint(out, present);
+    }
+    Message texts = {out, m.json, 0, true};
+    for (int i = 0; i < world->itemCount; i++) {
+        PutTextEntry(&texts, world, NULL, world->items[i].name);
+        PutTextEntry(&texts, world, NULL, world->items[i].description);
+    }
+    FrameAppend(out, m.json ? "]" : "");
+    EndMessage(&m);
+}
+
+/*
+ * @brief Тексты локации: название, описание и строки её действий
+ * Пары [номер, текст]; номер 0 - всегда пустая строка и не пересылается.
+ *
+ * @return false если локации нет
+ */
+bool WriteLocationTexts(const DeltaEncoder *encoder, const World *world, int locationId, FrameBuffer *out) {
+    const Location *loc = GetWorldLocation(world, locationId);
+    if (loc == NULL) {
+        return false;
+    }
+    const LocationPage *page = AcquireLocationPage(world, locationId);
+    Message m;
+    BeginMessage(&m, encoder->format, out, DELTA_TEXTS);
+    PutUnsigned(&m, "loc", (uint64_t)locationId);
+    PutKey(&m, "texts");
+    if (m.json) {
+        FrameAppend(out, "[");
+    } else {
+        // Пустые строки (номер 0) пропускаются - считаем их заранее
+        uint32_t present = (loc->name != 0) + (loc->description != 0);
+        for (uint32_t i = 0; i < loc->actionCount; i++) {
+            const Action *action = GetLocationAction(world, loc, (int)i);
+            if (action != NULL) {
+                present += (action->text != 0) + (action->resultText != 0) + (action->blockedText != 0);
+            }
+        }
+        PutVarint(out, present);
+    }
+    Message texts = {out, m.json, 0, true};
+    PutTextEntry(&texts, world, page, loc->name);
+    PutTextEntry(&texts, world, page, loc->description);
+    for (uint32_t i = 0; i < loc->actionCount; i++) {
+        const Action *action = GetLocationAction(world, loc, (int)i);
+        if (action == NULL) {
+            continue;
+        }
+        PutTextEntry(&texts, world, page, action->text);
+        PutTextEntry(&texts, world, page, action->resultText);
+        PutTextEntry(&texts, world, page, action->blockedText);
+    }
+    FrameAppend(out, m.json ? "]" : "");
+    EndMessage(&m);
+    ReleaseLocationPage(world, page);
+    return true;
+}
+
+/*
+ * @brief Ошибка запроса: код - короткое английское слово
+ */
+void WriteDeltaError(const DeltaEncoder *encoder, const char *error, FrameBuffer *out) {
+    Message m;
+    BeginMessage(&m, encoder->format, out, DELTA_ERROR);
+    PutString(&m, "error", error, strlen(error));
+    EndMessage(&m);
+}
+
+/*
+ * @brief Служебный текст (отчёт /stats) одним сообщением
+ */
+void WriteDeltaReport(const DeltaEncoder *encoder, const char *text, size_t length, FrameBuffer *out) {
+    Message m;
+    BeginMessage(&m, encoder->format, out, DELTA_REPORT);
+    PutString(&m, "text", text, length);
+    EndMessage(&m);
+}
+
+/*
+ * @brief Код партии в хранилище (FormatSessionCode) - строка,
+ * которую клиент передаёт в /resume после переподключения
+ */
+void WriteSessionCode(const DeltaEncoder *encoder, const char *code, FrameBuffer *out) {
+    Message m;
+    BeginMessage(&m, encoder->format, out, DELTA_SESSION);
+    PutString(&m, "code", code, strlen(code));
+    EndMessage(&m);
+}
+
+/*
+ * @brief Одна строка ввода клиента протокола
+ * Сообщения хода сессии (Say) не нужны: вывод сессии должен быть
+ * отключён (SetSessionOutput(session, NULL)), клиент строит их сам
+ * по справочнику и изменениям.
+ *
+ * @return INPUT_NONE после "q", иначе INPUT_COMMAND
+ */
+ExpectedInput StepProtocol(DeltaEncoder *encoder, GameSession *session, const char *line, FrameBuffer *out) {
+    char command[16] = {0};
+    int value;
+
+    while (*line == ' ' || *line == '\t') {
+        line++;
+    }
+    sscanf(line, "%15s", command);
+
+    if (strcmp(command, "q") == 0 || strcmp(command, "quit") == 0) {
+        SetGameOver(session);
+        return INPUT_NONE;
+    }
+    if (strcmp(command, "/world") == 0) {
+        WriteWorldCatalog(encoder, GetSessionWorld(session), out);
+        return INPUT_COMMAND;
+    }
+    if (strcmp(command, "/snapshot") == 0) {
+        WriteStateSnapshot(encoder, session, out);
+        return INPUT_COMMAND;
+    }
+    if (strcmp(command, "/texts") == 0) {
+        if (sscanf(line + 6, "%d", &value) != 1 ||
+            !WriteLocationTexts(encoder, GetSessionWorld(session), value, out)) {
+            WriteDeltaError(encoder, "bad_location", out);
+        }
+        return INPUT_COMMAND;
+    }
+    if (strcmp(command, "n") == 0) {
+        InitGameModel(session);
+        WriteStateDelta(encoder, session, DELTA_EVENT_NEW_GAME, out);
+        return INPUT_COMMAND;
+    }
+    // "u" или "u N" - отмена последних ходов
+    if ((command[0] == 'u' || command[0] == 'U') && strspn(command + 1, "0123456789") == strlen(command + 1)) {
+        int count = 1;
+        sscanf(line + 1, "%d", &count);
+        if (!UndoTurns(session, count)) {
+            WriteDeltaError(encoder, "undo_unavailable", out);
+            return INPUT_COMMAND;
+        }
+        WriteStateDelta(encoder, session, DELTA_EVENT_UNDO, out);
+        return INPUT_COMMAND;
+    }
+    if (sscanf(line, "%d", &value) == 1) {
+        WriteStateDelta(encoder, session, StepGameSession(session, value), out);
+        return INPUT_COMMAND;
+    }
+
+    TextCommand text;
+    METRIC_START(TIMER_PARSE, parseStarted);
+    ParseTextCommand(session, line, &text);
+    METRIC_STOP(TIMER_PARSE, parseStarted);
+    if (text.kind == TEXT_ACTION || text.kind == TEXT_INVENTORY) {
+        int choice = text.kind == TEXT_ACTION ? text.choice : 0;
+        WriteStateDelta(encoder, session, StepGameSession(session, choice), out);
+    } else if (text.kind == TEXT_LOOK) {
+        WriteStateSnapshot(encoder, session, out);
+    } else {
+        WriteDeltaError(encoder, TextCommandError(text.kind), out);
+    }
+    return INPUT_COMMAND;
+}
+
+/* [[ Внутренние функции ]] */
+
+static void BeginMessage(Message *m, DeltaFormat format, FrameBuffer *out, char type) {
+    m->out = out;
+    m->json = format == DELTA_FORMAT_JSON;
+    m->start = out->size;
+    m->firstField = false;
+    if (m->json) {
+        char head[] = "{\"t\":\"?\"";
+        head[6] = type;
+        FrameAppend(out, head);
+    } else {
+        char head[5] = {type, 0, 0, 0, 0};   // длина - в EndMessage
+        FrameAppendN(out, head, sizeof head);
+    }
+}
+
+static void EndMessage(Message *m) {
+    FrameBuffer *out = m->out;
+    if (m->json) {
+        FrameAppend(out, "}\n");
+        return;
+    }
+    if (out->failed) {
+        return;
+    }
+    uint32_t length = (uint32_t)(out->size - m->start - 5);
+    unsigned char *head = (unsigned char *)out->data + m->start + 1;
+    head[0] = (unsigned char)length;
+    head[1] = (unsigned char)(length >> 8);
+    head[2] = (unsigned char)(length >> 16);
+    head[3] = (unsigned char)(length >> 24);
+}
+
+/* JSON: разделитель и ключ (NULL - элемент массива); в двоичном кадре ничего */
+static void PutKey(Message *m, const char *key) {
+    if (!m->json) {
+        return;
+    }
+    if (!m->firstField) {
+        FrameAppendN(m->out, ",", 1);
+    }
+    m->firstField = false;
+    if (key != NULL) {
+        FrameAppendN(m->out, "\"", 1);
+        FrameAppend(m->out, key);
+        FrameAppendN(m->out, "\":", 2);
+    }
+}
+
+static void PutUnsigned(Message *m, const char *key, uint64_t value) {
+    PutKey(m, key);
+    if (m->json) {
+        PutDecimal(m->out, value);
+    } else {
+        PutVarint(m->out, value);
+    }
+}
+
+/* Индекс или -1 (NO_ITEM, NO_LOCATION) */
+static void PutIndex(Message *m, const char *key, int32_t value) {
+    if (!m->json) {
+        PutVarint(m->out, (uint64_t)((int64_t)value + 1));
+        return;
+    }
+    PutKey(m, key);
+    if (value < 0) {
+        FrameAppendN(m->out, "-1", 2);
+    } else {
+        PutDecimal(m->out, (uint64_t)value);
+    }
+}
+
+static void PutString(Message *m, const char *key, const char *text, size_t length) {
+    PutKey(m, key);
+    if (m->json) {
+        PutJsonString(m->out, text, length);
+    } else {
+        PutVarint(m->out, length);
+        FrameAppendN(m->out, text, length);
+    }
+}
+
+/*
+ * Номера битов now, которых нет в before (before == NULL - все биты now).
+ * JSON - массив, двоичный кадр - число номеров и разности соседних.
+ */
+static void PutBits(Message *m, const char *key, const uint64_t *now, const uint64_t *before, size_t words) {
+    PutKey(m, key);
+    if (m->json) {
+        FrameAppendN(m->out, "[", 1);
+    } else {
+        uint64_t count = 0;
+        for (size_t w = 0; w < words; w++) {
+            count += (uint64_t)CountBits64(now[w] & (before != NULL ? ~before[w] : UINT64_MAX));
+        }
+        PutVarint(m->out, count);
+    }
+    uint64_t previous = 0;
+    bool first = true;
+    for (size_t w = 0; w < words; w++) {
+        uint64_t bits = now[w] & (before != NULL ? ~before[w] : UINT64_MAX);
+        while (bits != 0) {
+            uint64_t index = w * 64 + (uint64_t)LowestBit64(bits);
+            bits &= bits - 1;
+            if (m->json) {
+                if (!first) {
+                    FrameAppendN(m->out, ",", 1);
+                }
+                PutDecimal(m->out, index);
+            } else {
+                PutVarint(m->out, first ? index : index - previous);
+            }
+            previous = index;
+            first = false;
+        }
+    }
+    if (m->json) {
+        FrameAppendN(m->out, "]", 1);
+    }
+}
+
+static bool HasNewBits(const uint64_t *now, const uint64_t *before, size_t words) {
+    for (size_t w = 0; w < words; w++) {
+        if (now[w] & ~before[w]) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void PutVarint(FrameBuffer *out, uint64_t value) {
+    unsigned char bytes[10];
+    size_t length = 0;
+    do {
+        unsigned char byte = value & 0x7Fu;
+        value >>= 7;
+        bytes[length++] = byte | (value != 0 ? 0x80u : 0);
+    } while (value != 0);
+    FrameAppendN(out, (const char *)bytes, length);
+}
+
+static void PutDecimal(FrameBuffer *out, uint64_t value) {
+    char digits[20];
+    size_t at = sizeof digits;
+    do {
+        digits[--at] = (char)('0' + value % 10);
+        value /= 10;
+    } while (value != 0);
+    FrameAppendN(out, digits + at, sizeof digits - at);
+}
+
+/* Строка JSON: UTF-8 как есть, экранируются кавычка, \ и управляющие */
+static void PutJsonString(FrameBuffer *out, const char *text, size_t length) {
+    static const char hex[] = "0123456789abcdef";
+    size_t run = 0;
+
+    FrameAppendN(out, "\"", 1);
+    for (size_t i = 0; i < length; i++) {
+        unsigned char c = (unsigned char)text[i];
+        if (c >= 0x20 && c != '"' && c != '\\') {
+            continue;
+        }
+        FrameAppendN(out, text + run, i - run);
+        run = i + 1;
+        if (c == '"' || c == '\\') {
+            char escaped[2] = {'\\', (char)c};
+            FrameAppendN(out, escaped, 2);
+        } else if (c == '\n') {
+            FrameAppendN(out, "\\n", 2);
+        } else {
+            char escaped[6] = {'\\', 'u', '0', '0', hex[c >> 4], hex[c & 15]};
+            FrameAppendN(out, escaped, 6);
+        }
+    }
+    FrameAppendN(out, text + run, length - run);
+    FrameAppendN(out, "\"", 1);
+}
+
+/* Пара [номер, текст]; номер 0 - пустая строка, клиенту она известна */
+static void PutTextEntry(Message *m, const World *world, const LocationPage *page, uint32_t offset) {
+    if (offset == 0) {
+        return;
+    }
+    const char *text = PageString(world, page, offset);
+    if (m->json) {
+        PutKey(m, NULL);
+        FrameAppendN(m->out, "[", 1);
+        PutDecimal(m->out, offset);
+        FrameAppendN(m->out, ",", 1);
+        PutJsonString(m->out, text, strlen(text));
+        FrameAppendN(m->out, "]", 1);
+    } else {
+        PutVarint(m->out, offset);
+        PutString(m, NULL, text, strlen(text));
+    }
+}
+
+static const char* EventName(int event) {
+    switch (event) {
+        case DELTA_EVENT_UNDO:     return "undo";
+        case DELTA_EVENT_NEW_GAME: return "new";
+    }
+    return StepResultName((StepResult)event);
+}
+
+static const char* TextCommandError(TextCommandKind kind) {
+    switch (kind) {
+        case TEXT_UNKNOWN_WORD: return "unknown_word";
+        case TEXT_NO_MATCH:     return "no_match";
+        case TEXT_AMBIGUOUS:    return "ambiguous";
+        case TEXT_NO_LEXICON:   return "no_lexicon";
+        default:                return "bad_command";
+    }
+}
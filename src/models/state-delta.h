@@ -0,0 +1,82 @@
+#ifndef STATE_DELTA_H
+#define STATE_DELTA_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "game.h"
+#include "../utils/frame.h"
+
+/*
+ * [[ Протокол изменений состояния ]]
+ *
+ * Вместо экранов с рамками - сообщение на ход для тонких клиентов.
+ * Первое сообщение - снимок (локация, инвентарь, собранные предметы,
+ * доступные действия), дальше только изменения относительно того, что
+ * клиент уже знает: новая локация, предметы и действия, у которых
+ * перевернулся бит. Тексты не пересылаются: в сообщениях их номера -
+ * смещения в пуле строк мира. Справочник мира (/world) и тексты локации
+ * (/texts N) клиент запрашивает один раз и кэширует.
+ *
+ * JSON - объект на строку, ключ "t" - тип сообщения. Двоичный кадр:
+ * байт типа, длина данных (uint32, little-endian), данные. Числа в
+ * данных - varint (LEB128), списки - длина и возрастающие номера
+ * разностями от предыдущего.
+ *
+ * Ввод - строки: номер действия, 0 - инвентарь, "u [N]" - отмена,
+ * "n" - новая партия, свободный текст, /world, /texts N, /snapshot, q.
+ * С хранилищем партий сервер ещё принимает /resume КОД (server-service.c).
+ */
+
+/* [[ Формат ]] */
+typedef enum {
+    DELTA_FORMAT_JSON,
+    DELTA_FORMAT_BINARY
+} DeltaFormat;
+
+/* [[ Типы сообщений ]] */
+#define DELTA_SNAPSHOT 's'
+#define DELTA_CHANGE 'd'
+#define DELTA_CATALOG 'c'
+#define DELTA_TEXTS 'x'
+#define DELTA_ERROR 'e'
+#define DELTA_REPORT 'm'     // текст отчёта /stats
+#define DELTA_SESSION 'k'    // код партии для /resume
+
+/* События изменения помимо StepResult */
+#define DELTA_EVENT_UNDO 100
+#define DELTA_EVENT_NEW_GAME 101
+
+/* Флаги изменения в двоичном кадре: какие поля присутствуют */
+#define DELTA_HAS_LOCATION        0x01u
+#define DELTA_HAS_INVENTORY_ADDED 0x02u
+#define DELTA_HAS_INVENTORY_GONE  0x04u
+#define DELTA_HAS_COLLECTED_ADDED 0x08u
+#define DELTA_HAS_COLLECTED_GONE  0x10u
+#define DELTA_HAS_ACTIONS_ON      0x20u
+#define DELTA_HAS_ACTIONS_OFF     0x40u
+#define DELTA_HAS_WON             0x80u
+
+/* [[ Кодировщик клиента ]] */
+/* Память под известное клиенту состояние берётся один раз при создании */
+typedef struct {
+    DeltaFormat format;
+    bool primed;          // снимок отправлен, дальше - изменения
+    uint32_t sequence;    // номер следующего сообщения состояния
+    size_t stateSize;
+    GameState *known;     // что знает клиент
+} DeltaEncoder;
+
+/* [[ Функции протокола ]] */
+bool InitDeltaEncoder(DeltaEncoder *encoder, const World *world, DeltaFormat format);
+void FreeDeltaEncoder(DeltaEncoder *encoder);
+void WriteStateDelta(DeltaEncoder *encoder, const GameSession *session, int event, FrameBuffer *out);
+void WriteStateSnapshot(DeltaEncoder *encoder, const GameSession *session, FrameBuffer *out);
+void WriteWorldCatalog(const DeltaEncoder *encoder, const World *world, FrameBuffer *out);
+bool WriteLocationTexts(const DeltaEncoder *encoder, const World *world, int locationId, FrameBuffer *out);
+void WriteDeltaError(const DeltaEncoder *encoder, const char *error, FrameBuffer *out);
+void WriteDeltaReport(const DeltaEncoder *encoder, const char *text, size_t length, FrameBuffer *out);
+void WriteSessionCode(const DeltaEncoder *encoder, const char *code, FrameBuffer *out);
+ExpectedInput StepProtocol(DeltaEncoder *encoder, GameSession *session, const char *line, FrameBuffer *out);
+
+#endif
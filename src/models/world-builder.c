@@ -0,0 +1,714 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include "world-builder.h"
+#include "lexicon.h"
+#include "action-script.h"
+#include "../utils/bitset.h"
+
+/* [[ Внутренние структуры ]] */
+
+/* Пул строк с дедупликацией через открытую адресацию */
+typedef struct {
+    char *data;
+    size_t size;
+    size_t capacity;
+    uint32_t *slots;      // смещение + 1, 0 - пустой слот
+    size_t slotCount;
+    size_t used;
+} StringPool;
+
+typedef struct {
+    int location;
+    Action record;
+} PendingAction;
+
+typedef struct {
+    int location;
+    uint32_t item;
+} PendingLocationItem;
+
+typedef struct {
+    WorldKeyKind kind;
+    int index;            // у действий - номер в порядке добавления
+    uint32_t key;
+} PendingKey;
+
+struct WorldBuilder {
+    StringPool strings;
+    Location *locations;
+    int locationCount;
+    int locationCapacity;
+    Item *items;
+    int itemCount;
+    int itemCapacity;
+    PendingAction *actions;
+    int actionCount;
+    int actionCapacity;
+    PendingLocationItem *locationItems;
+    int locationItemCount;
+    int locationItemCapacity;
+    LexiconBuilder *lexicon;
+    uint32_t *code;            // code[0] - SCRIPT_END пустой программы
+    int codeCount;
+    int codeCapacity;
+    int flagCount;
+    int counterCount;
+    PendingKey *keys;
+    int keyCount;
+    int keyCapacity;
+    int startLocation;
+    int winItem;
+    bool failed;
+    char error[256];
+};
+
+/* [[ Прототипы внутренних функций ]] */
+static bool Reserve(void **data, int *capacity, int count, size_t elemSize);
+static uint32_t InternString(WorldBuilder *builder, const char *text);
+static uint32_t HashString(const char *text);
+static void* BuildWorldLexicon(WorldBuilder *builder, size_t *size);
+static bool FillKeys(WorldBuilder *builder, uint32_t *keys, const uint32_t *slots);
+static uint32_t KeyOf(uint32_t seed, uint32_t value);
+static int CompareKeys(const void *a, const void *b);
+static void Fail(WorldBuilder *builder, const char *message);
+static size_t AlignUp(size_t value);
+
+/* [[ Функции сборщика ]] */
+
+/*
+ * @brief Создание пустого сборщика мира
+ * @return Сборщик или NULL, если не хватило памяти
+ */
+WorldBuilder* CreateWorldBuilder() {
+    WorldBuilder *builder = calloc(1, sizeof(WorldBuilder));
+    if (builder == NULL) {
+        return NULL;
+    }
+    builder->startLocation = 0;
+    builder->winItem = NO_ITEM;
+    builder->lexicon = CreateLexiconBuilder();
+    if (builder->lexicon == NULL) {
+        free(builder);
+        return NULL;
+    }
+    InternString(builder, "");  // смещение 0 - пустая строка
+    if (!Reserve((void **)&builder->code, &builder->codeCapacity, 1, sizeof(uint32_t))) {
+        DestroyWorldBuilder(builder);
+        return NULL;
+    }
+    builder->code[builder->codeCount++] = SCRIPT_END;
+    return builder;
+}
+
+/*
+ * @brief Освобождение сборщика (NULL допустим)
+ */
+void DestroyWorldBuilder(WorldBuilder *builder) {
+    if (builder == NULL) {
+        return;
+    }
+    free(builder->strings.data);
+    free(builder->strings.slots);
+    free(builder->locations);
+    free(builder->items);
+    free(builder->actions);
+    free(builder->locationItems);
+    DestroyLexiconBuilder(builder->lexicon);
+    free(builder->code);
+    free(builder->keys);
+    free(builder);
+}
+
+/*
+ * @brief Добавить локацию
+ * @return Индекс локации или -1 при ошибке
+ */
+int WorldBuilderAddLocation(WorldBuilder *builder, const char *name, const char *description) {
+    if (!Reserve((void **)&builder->locations, &builder->locationCapacity,
+                 builder->locationCount + 1, sizeof(Location))) {
+        Fail(builder, "out of memory");
+        return -1;
+    }
+
+    Location *loc = &builder->locations[builder->locationCount];
+    memset(loc, 0, sizeof *loc);
+    loc->name = InternString(builder, name);
+    loc->description = InternString(builder, description);
+    return builder->locationCount++;
+}
+
+/*
+ * @brief Добавить предмет, лежащий в локации
+ * @return Индекс предмета мира или NO_ITEM при ошибке
+ */
+int WorldBuilderAddItem(WorldBuilder *builder, int location, const char *name, const char *description) {
+    if (location < 0 || location >= builder->locationCount) {
+        Fail(builder, "item placed in unknown location");
+        return NO_ITEM;
+    }
+    if (!Reserve((void **)&builder->items, &builder->itemCapacity,
+                 builder->itemCount + 1, sizeof(Item)) ||
+        !Reserve((void **)&builder->locationItems, &builder->locationItemCapacity,
+                 builder->locationItemCount + 1, sizeof(PendingLocationItem))) {
+        Fail(builder, "out of memory");
+        return NO_ITEM;
+    }
+
+    Item *item = &builder->items[builder->itemCount];
+    item->name = InternString(builder, name);
+    item->description = InternString(builder, description);
+
+    PendingLocationItem *slot = &builder->locationItems[builder->locationItemCount++];
+    slot->location = location;
+    slot->item = (uint32_t)builder->itemCount;
+    builder->locations[location].itemCount++;
+    return builder->itemCount++;
+}
+
+/*
+ * @brief Добавить действие в локацию
+ * Действия одной локации сохраняют порядок добавления.
+ *
+ * @param requiredItem Индекс требуемого предмета или NO_ITEM
+ * @return Порядковый номер действия в локации или -1 при ошибке
+ */
+int WorldBuilderAddAction(WorldBuilder *builder, int location, const char *text, int targetLocation,
+                          int requiredItem, const char *resultText, int givesItem,
+                          bool available) {
+    if (location < 0 || location >= builder->locationCount) {
+        Fail(builder, "action added to unknown location");
+        return -1;
+    }
+    if (!Reserve((void **)&builder->actions, &builder->actionCapacity,
+                 builder->actionCount + 1, sizeof(PendingAction))) {
+        Fail(builder, "out of memory");
+        return -1;
+    }
+
+    PendingAction *pending = &builder->actions[builder->actionCount++];
+    memset(pending, 0, sizeof *pending);
+    pending->location = location;
+    pending->record.text = InternString(builder, text);
+    pending->record.resultText = InternString(builder, resultText);
+    pending->record.targetLocation = targetLocation;
+    pending->record.givesItem = givesItem;
+    pending->record.requiredItem = requiredItem;
+    pending->record.flags = available ? ACTION_FLAG_AVAILABLE : 0;
+
+    return (int)builder->locations[location].actionCount++;
+}
+
+/*
+ * @brief Сценарий действия: условие, последствия и текст отказа
+ * Код - без завершающего SCRIPT_END; операнды unlock/lock - номера
+ * действий в порядке добавления, при сборке они переводятся в индексы
+ * таблицы образа. Проверяется код при сборке (WorldBuilderFinish).
+ *
+ * @param action Номер действия в порядке добавления (с 0)
+ * @param blockedText Текст, если условие не выполнено, или NULL
+ */
+bool WorldBuilderSetActionScript(WorldBuilder *builder, int action, const uint32_t *condition,
+                                 size_t conditionLength, const uint32_t *effect, size_t effectLength,
+                                 const char *blockedText) {
+    if (action < 0 || action >= builder->actionCount) {
+        Fail(builder, "script attached to unknown action");
+        return false;
+    }
+    size_t needed = (size_t)builder->codeCount + conditionLength + effectLength + 2;
+    if (needed > INT32_MAX ||
+        !Reserve((void **)&builder->code, &builder->codeCapacity, (int)needed, sizeof(uint32_t))) {
+        Fail(builder, "out of memory");
+        return false;
+    }
+
+    Action *record = &builder->actions[action].record;
+    record->condition = 0;
+    record->effect = 0;
+    if (conditionLength > 0) {
+        record->condition = (uint32_t)builder->codeCount;
+        memcpy(builder->code + builder->codeCount, condition, conditionLength * sizeof(uint32_t));
+        builder->codeCount += (int)conditionLength;
+        builder->code[builder->codeCount++] = SCRIPT_END;
+    }
+    if (effectLength > 0) {
+        record->effect = (uint32_t)builder->codeCount;
+        memcpy(builder->code + builder->codeCount, effect, effectLength * sizeof(uint32_t));
+        builder->codeCount += (int)effectLength;
+        builder->code[builder->codeCount++] = SCRIPT_END;
+    }
+    record->blockedText = blockedText != NULL ? InternString(builder, blockedText) : 0;
+    return !builder->failed;
+}
+
+/*
+ * @brief Сколько флагов и счётчиков партии используют сценарии
+ */
+void WorldBuilderSetStateCounts(WorldBuilder *builder, int flags, int counters) {
+    builder->flagCount = flags;
+    builder->counterCount = counters;
+}
+
+/*
+ * @brief Стабильный ключ записи - символ из исходника
+ * Без ключа локация, предмет, флаг и счётчик получают ключ по индексу,
+ * действие - по ключу локации и месту в ней. Ключи одного вида должны
+ * различаться, это проверяет WorldBuilderFinish.
+ *
+ * @param index Индекс записи; у действий - номер в порядке добавления
+ */
+void WorldBuilderSetKey(WorldBuilder *builder, WorldKeyKind kind, int index, const char *key) {
+    if (!Reserve((void **)&builder->keys, &builder->keyCapacity, builder->keyCount + 1, sizeof(PendingKey))) {
+        Fail(builder, "out of memory");
+        return;
+    }
+    builder->keys[builder->keyCount++] = (PendingKey){kind, index, HashString(key)};
+}
+
+/*
+ * @brief Синонимы слова для свободного ввода команд
+ * Все слова synonyms при разборе ввода значат то же, что word.
+ *
+ * @return false при ошибке (например, синоним уже значит другое слово)
+ */
+bool WorldBuilderAddSynonym(WorldBuilder *builder, const char *word, const char *synonyms) {
+    if (!LexiconAddSynonym(builder->lexicon, word, synonyms)) {
+        Fail(builder, LexiconBuilderError(builder->lexicon));
+        return false;
+    }
+    return true;
+}
+
+void WorldBuilderSetStart(WorldBuilder *builder, int location) {
+    builder->startLocation = location;
+}
+
+void WorldBuilderSetWinItem(WorldBuilder *builder, int item) {
+    builder->winItem = item;
+}
+
+/*
+ * @brief Сборка двоичного образа мира
+ * Проверяет ссылки и пределы, раскладывает действия и предметы
+ * по локациям и склеивает таблицы в один выровненный буфер.
+ *
+ * @param size Сюда записывается размер образа
+ * @return Образ (освобождать через free) или NULL, см. WorldBuilderError
+ */
+void* WorldBuilderFinish(WorldBuilder *builder, size_t *size) {
+    if (builder->failed) {
+        return NULL;
+    }
+    if (builder->locationCount == 0) {
+        Fail(builder, "world has no locations");
+        return NULL;
+    }
+    if (builder->startLocation < 0 || builder->startLocation >= builder->locationCount) {
+        Fail(builder, "start location out of range");
+        return NULL;
+    }
+    if (builder->winItem < NO_ITEM || builder->winItem >= builder->itemCount) {
+        Fail(builder, "win item out of range");
+        return NULL;
+    }
+    ScriptLimits limits = {
+        (uint32_t)builder->itemCount, (uint32_t)builder->locationCount, (uint32_t)builder->actionCount,
+        (uint32_t)builder->flagCount, (uint32_t)builder->counterCount,
+    };
+    if (builder->flagCount < 0 || builder->counterCount < 0) {
+        Fail(builder, "negative flag or counter count");
+        return NULL;
+    }
+    for (int i = 0; i < builder->actionCount; i++) {
+        const Action *a = &builder->actions[i].record;
+        const char *scriptError = CheckScript(builder->code, (uint32_t)builder->codeCount, a->condition, true, &limits);
+        if (scriptError == NULL) {
+            scriptError = CheckScript(builder->code, (uint32_t)builder->codeCount, a->effect, false, &limits);
+        }
+        if (scriptError != NULL) {
+            Fail(builder, scriptError);
+            return NULL;
+        }
+        if (a->targetLocation < NO_LOCATION || a->targetLocation >= builder->locationCount) {
+            Fail(builder, "action targets unknown location");
+            return NULL;
+        }
+        if (a->givesItem < NO_ITEM || a->givesItem >= builder->itemCount ||
+            a->requiredItem < NO_ITEM || a->requiredItem >= builder->itemCount) {
+            Fail(builder, "action references unknown item");
+            return NULL;
+        }
+    }
+
+    size_t locationsOffset = AlignUp(sizeof(WorldFileHeader));
+    size_t actionsOffset = AlignUp(locationsOffset + (size_t)builder->locationCount * sizeof(Location));
+    size_t itemsOffset = AlignUp(actionsOffset + (size_t)builder->actionCount * sizeof(Action));
+    size_t locationItemsOffset = AlignUp(itemsOffset + (size_t)builder->itemCount * sizeof(Item));
+    size_t availableOffset = AlignUp(locationItemsOffset + (size_t)builder->locationItemCount * sizeof(uint32_t));
+    size_t codeOffset = AlignUp(availableOffset + BITSET_WORDS(builder->actionCount) * sizeof(uint64_t));
+    size_t keysOffset = AlignUp(codeOffset + (size_t)builder->codeCount * sizeof(uint32_t));
+    size_t keyCount = (size_t)builder->locationCount + (size_t)builder->itemCount + (size_t)builder->actionCount +
+                      (size_t)builder->flagCount + (size_t)builder->counterCount;
+    size_t lexiconOffset = AlignUp(keysOffset + keyCount * sizeof(uint32_t));
+
+    // Словарь стоит до пула строк, чтобы попадать в отображение индекса
+    // при постраничной загрузке (см. world-pager.h)
+    size_t lexiconSize = 0;
+    void *lexicon = BuildWorldLexicon(builder, &lexiconSize);
+    if (lexicon == NULL) {
+        return NULL;
+    }
+    size_t stringsOffset = AlignUp(lexiconOffset + lexiconSize);
+    size_t total = AlignUp(stringsOffset + builder->strings.size);
+
+    if (total > UINT32_MAX) {
+        free(lexicon);
+        Fail(builder, "world image exceeds 4 GiB");
+        return NULL;
+    }
+
+    char *image = calloc(1, total);
+    if (image == NULL) {
+        free(lexicon);
+        Fail(builder, "out of memory");
+        return NULL;
+    }
+
+    WorldFileHeader *header = (WorldFileHeader *)image;
+    Location *locations = (Location *)(image + locationsOffset);
+    Action *actions = (Action *)(image + actionsOffset);
+    uint32_t *locationItems = (uint32_t *)(image + locationItemsOffset);
+    uint64_t *initialAvailable = (uint64_t *)(image + availableOffset);
+    uint32_t *code = (uint32_t *)(image + codeOffset);
+    uint32_t *slots = malloc(((size_t)builder->actionCount + 1) * sizeof(uint32_t));
+    if (slots == NULL) {
+        free(image);
+        free(lexicon);
+        Fail(builder, "out of memory");
+        return NULL;
+    }
+
+    memcpy(locations, builder->locations, (size_t)builder->locationCount * sizeof(Location));
+    memcpy(image + itemsOffset, builder->items, (size_t)builder->itemCount * sizeof(Item));
+    memcpy(image + lexiconOffset, lexicon, lexiconSize);
+    memcpy(image + stringsOffset, builder->strings.data, builder->strings.size);
+    free(lexicon);
+
+    // Раскладка по локациям: стабильная сортировка подсчётом,
+    // счётчики actionCount/itemCount уже набраны при добавлении
+    uint32_t nextAction = 0;
+    uint32_t nextItem = 0;
+    for (int l = 0; l < builder->locationCount; l++) {
+        locations[l].firstAction = nextAction;
+        locations[l].firstItem = nextItem;
+        nextAction += locations[l].actionCount;
+        nextItem += locations[l].itemCount;
+        locations[l].actionCount = 0;
+        locations[l].itemCount = 0;
+    }
+
+    for (int i = 0; i < builder->actionCount; i++) {
+        Location *loc = &locations[builder->actions[i].location];
+        uint32_t slot = loc->firstAction + loc->actionCount++;
+        slots[i] = slot;
+        actions[slot] = builder->actions[i].record;
+        if (actions[slot].flags & ACTION_FLAG_AVAILABLE) {
+            BitsetSet(initialAvailable, (int)slot);
+        }
+    }
+    for (int i = 0; i < builder->locationItemCount; i++) {
+        Location *loc = &locations[builder->locationItems[i].location];
+        locationItems[loc->firstItem + loc->itemCount++] = builder->locationItems[i].item;
+    }
+
+    // Код проверен выше; unlock/lock - из порядка добавления в индексы таблицы
+    memcpy(code, builder->code, (size_t)builder->codeCount * sizeof(uint32_t));
+    for (int at = 1; at < builder->codeCount; at++) {
+        uint32_t op = SCRIPT_OP(code[at]);
+        if ((op == SCRIPT_UNLOCK || op == SCRIPT_LOCK) && SCRIPT_OPERAND(code[at]) < (uint32_t)builder->actionCount) {
+            code[at] = SCRIPT_WORD(op, slots[SCRIPT_OPERAND(code[at])]);
+        } else if (op == SCRIPT_COUNTER_EQ || op == SCRIPT_COUNTER_LT || op == SCRIPT_COUNTER_GT ||
+                   op == SCRIPT_ADD_COUNTER || op == SCRIPT_SET_COUNTER) {
+            at++;   // число, а не операция
+        }
+    }
+    bool keysOk = FillKeys(builder, (uint32_t *)(image + keysOffset), slots);
+    free(slots);
+    if (!keysOk) {
+        free(image);
+        return NULL;
+    }
+
+    header->magic = WORLD_FILE_MAGIC;
+    header->version = WORLD_FILE_VERSION;
+    header->headerSize = (uint16_t)sizeof(WorldFileHeader);
+    header->fileSize = (uint32_t)total;
+    header->startLocation = (uint32_t)builder->startLocation;
+    header->locationCount = (uint32_t)builder->locationCount;
+    header->locationsOffset = (uint32_t)locationsOffset;
+    header->actionCount = (uint32_t)builder->actionCount;
+    header->actionsOffset = (uint32_t)actionsOffset;
+    header->itemCount = (uint32_t)builder->itemCount;
+    header->itemsOffset = (uint32_t)itemsOffset;
+    header->locationItemCount = (uint32_t)builder->locationItemCount;
+    header->locationItemsOffset = (uint32_t)locationItemsOffset;
+    header->stringsSize = (uint32_t)builder->strings.size;
+    header->stringsOffset = (uint32_t)stringsOffset;
+    header->winItem = builder->winItem;
+    header->availableOffset = (uint32_t)availableOffset;
+    header->lexiconOffset = (uint32_t)lexiconOffset;
+    header->lexiconSize = (uint32_t)lexiconSize;
+    header->codeOffset = (uint32_t)codeOffset;
+    header->codeCount = (uint32_t)builder->codeCount;
+    header->flagCount = (uint32_t)builder->flagCount;
+    header->counterCount = (uint32_t)builder->counterCount;
+    header->keysOffset = (uint32_t)keysOffset;
+    header->keyCount = (uint32_t)keyCount;
+
+    *size = total;
+    return image;
+}
+
+/*
+ * @brief Текст последней ошибки сборщика
+ */
+const char* WorldBuilderError(const WorldBuilder *builder) {
+    return builder->failed ? builder->error : "";
+}
+
+/* [[ Внутренние функции ]] */
+
+static bool Reserve(void **data, int *capacity, int count, size_t elemSize) {
+    if (count <= *capacity) {
+        return true;
+    }
+    int newCapacity = *capacity > 0 ? *capacity * 2 : 16;
+    while (newCapacity < count) {
+        newCapacity *= 2;
+    }
+    void *grown = realloc(*data, (size_t)newCapacity * elemSize);
+    if (grown == NULL) {
+        return false;
+    }
+    *data = grown;
+    *capacity = newCapacity;
+    return true;
+}
+
+/*
+ * Таблица ключей образа подряд по видам (см. WorldKeyKind). Действия
+ * без ключа - по ключу своей локации, поэтому они заполняются после
+ * локаций. Одинаковые ключи внутри вида - ошибка сборки.
+ */
+static bool FillKeys(WorldBuilder *builder, uint32_t *keys, const uint32_t *slots) {
+    int counts[WORLD_KEY_KINDS] = {
+        builder->locationCount, builder->itemCount, builder->actionCount, builder->flagCount, builder->counterCount,
+    };
+    uint32_t *base[WORLD_KEY_KINDS];
+    static const char *const duplicate[WORLD_KEY_KINDS] = {
+        "duplicate location key", "duplicate item key", "duplicate action key",
+        "duplicate flag key", "duplicate counter key",
+    };
+
+    uint32_t *at = keys;
+    for (int kind = 0; kind < WORLD_KEY_KINDS; kind++) {
+        base[kind] = at;
+        for (int i = 0; i < counts[kind]; i++) {
+            at[i] = KeyOf(2166136261u + (uint32_t)kind, (uint32_t)i);
+        }
+        at += counts[kind];
+    }
+
+    // Сначала ключи локаций и прочего, затем действия от ключей локаций
+    for (int pass = 0; pass < 2; pass++) {
+        if (pass == 1) {
+            for (int l = 0; l < builder->locationCount; l++) {
+                const Location *loc = &builder->locations[l];
+                for (uint32_t i = 0; i < loc->actionCount; i++) {
+                    base[WORLD_KEY_ACTION][loc->firstAction + i] = KeyOf(base[WORLD_KEY_LOCATION][l], i);
+                }
+            }
+        }
+        for (int k = 0; k < builder->keyCount; k++) {
+            const PendingKey *pending = &builder->keys[k];
+            if ((pending->kind == WORLD_KEY_ACTION) != (pass == 1)) {
+                continue;
+            }
+            if (pending->kind < 0 || pending->kind >= WORLD_KEY_KINDS || pending->index < 0 ||
+                pending->index >= counts[pending->kind]) {
+                Fail(builder, "key for unknown record");
+                return false;
+            }
+            uint32_t index = pending->kind == WORLD_KEY_ACTION ? slots[pending->index] : (uint32_t)pending->index;
+            base[pending->kind][index] = pending->key;
+        }
+    }
+
+    size_t largest = 0;
+    for (int kind = 0; kind < WORLD_KEY_KINDS; kind++) {
+        largest = (size_t)counts[kind] > largest ? (size_t)counts[kind] : largest;
+    }
+    uint32_t *sorted = malloc((largest > 0 ? largest : 1) * sizeof(uint32_t));
+    if (sorted == NULL) {
+        Fail(builder, "out of memory");
+        return false;
+    }
+    for (int kind = 0; kind < WORLD_KEY_KINDS; kind++) {
+        memcpy(sorted, base[kind], (size_t)counts[kind] * sizeof(uint32_t));
+        qsort(sorted, (size_t)counts[kind], sizeof(uint32_t), CompareKeys);
+        for (int i = 1; i < counts[kind]; i++) {
+            if (sorted[i] == sorted[i - 1]) {
+                free(sorted);
+                Fail(builder, duplicate[kind]);
+                return false;
+            }
+        }
+    }
+    free(sorted);
+    return true;
+}
+
+/* FNV-1a по байтам value, продолжая seed */
+static uint32_t KeyOf(uint32_t seed, uint32_t value) {
+    for (int i = 0; i < 4; i++) {
+        seed = (seed ^ ((value >> (8 * i)) & 0xFFu)) * 16777619u;
+    }
+    return seed;
+}
+
+static int CompareKeys(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *)a;
+    uint32_t y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+static uint32_t HashString(const char *text) {
+    uint32_t hash = 2166136261u;  // FNV-1a
+    for (const unsigned char *p = (const unsigned char *)text; *p; p++) {
+        hash = (hash ^ *p) * 16777619u;
+    }
+    return hash;
+}
+
+static bool GrowSlots(StringPool *pool) {
+    size_t newCount = pool->slotCount > 0 ? pool->slotCount * 2 : 256;
+    uint32_t *slots = calloc(newCount, sizeof(uint32_t));
+    if (slots == NULL) {
+        return false;
+    }
+    for (size_t i = 0; i < pool->slotCount; i++) {
+        uint32_t entry = pool->slots[i];
+        if (entry == 0) {
+            continue;
+        }
+        size_t pos = HashString(pool->data + entry - 1) & (newCount - 1);
+        while (slots[pos] != 0) {
+            pos = (pos + 1) & (newCount - 1);
+        }
+        slots[pos] = entry;
+    }
+    free(pool->slots);
+    pool->slots = slots;
+    pool->slotCount = newCount;
+    return true;
+}
+
+/*
+ * Возвращает смещение строки в пуле; одинаковые строки хранятся один раз.
+ */
+static uint32_t InternString(WorldBuilder *builder, const char *text) {
+    StringPool *pool = &builder->strings;
+
+    if (text == NULL) {
+        text = "";
+    }
+    if ((pool->used + 1) * 2 > pool->slotCount && !GrowSlots(pool)) {
+        Fail(builder, "out of memory");
+        return 0;
+    }
+
+    size_t pos = HashString(text) & (pool->slotCount - 1);
+    while (pool->slots[pos] != 0) {
+        uint32_t offset = pool->slots[pos] - 1;
+        if (strcmp(pool->data + offset, text) == 0) {
+            return offset;
+        }
+        pos = (pos + 1) & (pool->slotCount - 1);
+    }
+
+    size_t length = strlen(text) + 1;
+    if (pool->size + length > UINT32_MAX - 1) {
+        Fail(builder, "string pool exceeds 4 GiB");
+        return 0;
+    }
+    if (pool->size + length > pool->capacity) {
+        size_t newCapacity = pool->capacity > 0 ? pool->capacity * 2 : 4096;
+        while (newCapacity < pool->size + length) {
+            newCapacity *= 2;
+        }
+        char *grown = realloc(pool->data, newCapacity);
+        if (grown == NULL) {
+            Fail(builder, "out of memory");
+            return 0;
+        }
+        pool->data = grown;
+        pool->capacity = newCapacity;
+    }
+
+    uint32_t offset = (uint32_t)pool->size;
+    memcpy(pool->data + offset, text, length);
+    pool->size += length;
+    pool->slots[pos] = offset + 1;
+    pool->used++;
+    return offset;
+}
+
+/*
+ * Термы действия - слова его текста, названия локации, куда оно ведёт,
+ * и предмета, который оно даёт. Номер действия - его место в таблице
+ * образа, поэтому действия нумеруются той же раскладкой по локациям.
+ */
+static void* BuildWorldLexicon(WorldBuilder *builder, size_t *size) {
+    uint32_t *next = calloc((size_t)builder->locationCount + 1, sizeof(uint32_t));
+    if (next == NULL) {
+        Fail(builder, "out of memory");
+        return NULL;
+    }
+    for (int l = 0; l < builder->locationCount; l++) {
+        next[l + 1] = next[l] + builder->locations[l].actionCount;
+    }
+
+    const char *strings = builder->strings.data;
+    bool ok = true;
+    for (int i = 0; i < builder->actionCount && ok; i++) {
+        const Action *a = &builder->actions[i].record;
+        uint32_t slot = next[builder->actions[i].location]++;
+        ok = LexiconAddActionText(builder->lexicon, slot, strings + a->text);
+        if (ok && a->targetLocation != NO_LOCATION) {
+            ok = LexiconAddActionText(builder->lexicon, slot,
+                                      strings + builder->locations[a->targetLocation].name);
+        }
+        if (ok && a->givesItem != NO_ITEM) {
+            ok = LexiconAddActionText(builder->lexicon, slot, strings + builder->items[a->givesItem].name);
+        }
+    }
+    free(next);
+
+    void *lexicon = ok ? BuildLexicon(builder->lexicon, (uint32_t)builder->actionCount, size) : NULL;
+    if (lexicon == NULL) {
+        Fail(builder, LexiconBuilderError(builder->lexicon));
+    }
+    return lexicon;
+}
+
+static void Fail(WorldBuilder *builder, const char *message) {
+    if (!builder->failed) {
+        builder->failed = true;
+        snprintf(builder->error, sizeof builder->error, "%s", message);
+    }
+}
+
+static size_t AlignUp(size_t value) {
+    return (value + 7) & ~(size_t)7;
+}
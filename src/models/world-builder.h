@@ -0,0 +1,36 @@
+#ifndef WORLD_BUILDER_H
+#define WORLD_BUILDER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "world.h"
+
+/*
+ * [[ Сборщик образа мира ]]
+ * Накапливает локации, предметы и действия в любом порядке и собирает
+ * из них двоичный образ (см. WorldFileHeader): строки пулятся
+ * с дедупликацией, действия и предметы раскладываются по локациям.
+ * Используется встроенным миром и конвертером world-compiler.
+ */
+typedef struct WorldBuilder WorldBuilder;
+
+/* [[ Функции сборщика ]] */
+WorldBuilder* CreateWorldBuilder();
+void DestroyWorldBuilder(WorldBuilder *builder);
+int WorldBuilderAddLocation(WorldBuilder *builder, const char *name, const char *description);
+int WorldBuilderAddItem(WorldBuilder *builder, int location, const char *name, const char *description);
+int WorldBuilderAddAction(WorldBuilder *builder, int location, const char *text, int targetLocation,
+                          int requiredItem, const char *resultText, int givesItem,
+                          bool available);
+bool WorldBuilderSetActionScript(WorldBuilder *builder, int action, const uint32_t *condition,
+                                 size_t conditionLength, const uint32_t *effect, size_t effectLength,
+                                 const char *blockedText);
+void WorldBuilderSetStateCounts(WorldBuilder *builder, int flags, int counters);
+void WorldBuilderSetKey(WorldBuilder *builder, WorldKeyKind kind, int index, const char *key);
+bool WorldBuilderAddSynonym(WorldBuilder *builder, const char *word, const char *synonyms);
+void WorldBuilderSetStart(WorldBuilder *builder, int location);
+void WorldBuilderSetWinItem(WorldBuilder *builder, int item);
+void* WorldBuilderFinish(WorldBuilder *builder, size_t *size);
+const char* WorldBuilderError(const WorldBuilder *builder);
+
+#endif
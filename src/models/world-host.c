@@ -0,0 +1,127 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "world-host.h"
+
+/* [[ Прототипы внутренних функций ]] */
+static int LoaderMain(void *argument);
+static bool ReclaimWorld(void *object, bool force);
+
+/* [[ Функции хоста ]] */
+
+/*
+ * @brief Хост с начальной версией мира
+ * @param world Начальная версия; хост становится её владельцем и выгружает
+ *              её, как и следующие версии (встроенный мир UnloadWorld не трогает)
+ * @param path Файл мира для перезагрузки или NULL
+ * @param cacheBytes Кэш текстов для постраничной загрузки или 0
+ * @return false если не удалось создать домен эпох; world тогда остаётся
+ *         у вызывающего
+ */
+bool InitWorldHost(WorldHost *host, const World *world, const char *path, size_t cacheBytes) {
+    atomic_init(&host->current, world);
+    host->path = path;
+    host->cacheBytes = cacheBytes;
+    host->loaderStarted = false;
+    atomic_init(&host->loading, false);
+    atomic_init(&host->version, 1);
+    return InitEpochDomain(&host->epochs);
+}
+
+/*
+ * @brief Остановить хост
+ * Ждёт загрузчик и выгружает все версии вместе с оставшимися в них
+ * сессиями. Читателей уже быть не должно.
+ */
+void FreeWorldHost(WorldHost *host) {
+    if (host->loaderStarted) {
+        thrd_join(host->loader, NULL);
+        host->loaderStarted = false;
+    }
+    FreeEpochDomain(&host->epochs);
+    UnloadWorld((World *)atomic_exchange(&host->current, NULL));
+}
+
+/*
+ * @brief Перечитать мир из файла в фоне
+ * Загрузка идёт своим потоком, по готовности версия подменяется
+ * (PublishWorld). Ошибки загрузки пишутся в stderr, текущая версия
+ * тогда остаётся.
+ *
+ * @return false если файла нет или загрузка уже идёт
+ */
+bool RequestWorldReload(WorldHost *host) {
+    if (host->path == NULL || atomic_exchange(&host->loading, true)) {
+        return false;
+    }
+    if (host->loaderStarted) {
+        thrd_join(host->loader, NULL);   // прошлый загрузчик уже закончил
+        host->loaderStarted = false;
+    }
+    if (thrd_create(&host->loader, LoaderMain, host) != thrd_success) {
+        atomic_store(&host->loading, false);
+        return false;
+    }
+    host->loaderStarted = true;
+    return true;
+}
+
+/*
+ * @brief Сделать world текущей версией
+ * Строит индекс ключей для переноса сессий, подменяет указатель и снимает
+ * прошлую версию; она выгрузится в ReclaimWorlds, когда опустеет.
+ *
+ * @param world Загруженный мир, ещё не доступный другим потокам; хост
+ *              становится его владельцем
+ * @return false если не хватило памяти, world тогда не опубликован
+ */
+bool PublishWorld(WorldHost *host, World *world) {
+    if (!IndexWorldKeys(world)) {
+        return false;
+    }
+    const World *previous = atomic_exchange(&host->current, world);
+    atomic_fetch_add(&host->version, 1);
+    if (!EpochRetire(&host->epochs, (void *)previous, ReclaimWorld)) {
+        fprintf(stderr, "Прошлая версия мира останется в памяти: не хватило памяти.\n");
+    }
+    return true;
+}
+
+/*
+ * @brief Выгрузить снятые версии, которые никто не читает и где нет сессий
+ * Не блокирует; вызывать время от времени вне пути хода.
+ *
+ * @return Сколько версий ещё ждёт выгрузки
+ */
+size_t ReclaimWorlds(WorldHost *host) {
+    return HasRetired(&host->epochs) ? EpochReclaim(&host->epochs) : 0;
+}
+
+/* [[ Внутренние функции ]] */
+
+static int LoaderMain(void *argument) {
+    WorldHost *host = argument;
+    // Копия, а не отображение: следующая замена файла этой версии не коснётся
+    World *world = LoadWorldFileCopy(host->path, host->cacheBytes);
+    if (world == NULL) {
+        fprintf(stderr, "Не удалось перезагрузить мир: %s\n", host->path);
+    } else if (!PublishWorld(host, world)) {
+        fprintf(stderr, "Не удалось перезагрузить мир: не хватило памяти.\n");
+        UnloadWorld(world);
+    } else {
+        fprintf(stderr, "Мир перезагружен: %s (версия %u)\n", host->path,
+                (unsigned)atomic_load(&host->version));
+        ReclaimWorlds(host);
+    }
+    atomic_store(&host->loading, false);
+    return 0;
+}
+
+/* Версия мира выгружается, только когда из её пула вернули все сессии */
+static bool ReclaimWorld(void *object, bool force) {
+    World *world = object;
+    if (!force && PoolLiveBlocks(world->sessions) > 0) {
+        return false;
+    }
+    UnloadWorld(world);
+    return true;
+}
@@ -0,0 +1,62 @@
+#ifndef WORLD_HOST_H
+#define WORLD_HOST_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdatomic.h>
+#include <threads.h>
+#include "world.h"
+#include "../utils/epoch.h"
+
+/*
+ * [[ Перезагрузка мира ]]
+ *
+ * Текущая версия мира - атомарный указатель. Новая версия загружается
+ * отдельным потоком и подменяет старую одной записью; ход, начатый на
+ * старой версии, доигрывается на ней, следующий видит новую. Читатель
+ * на пути хода (EnterWorld/LeaveWorld) замков не берёт.
+ *
+ * Сессия остаётся на своей версии мира, пока её не перенесут
+ * (MoveGameSession) - обычно перед следующим ходом. Старая версия,
+ * включая начальную, выгружается, когда её не читает ни один поток
+ * (см. epoch.h) и в её пуле не осталось сессий. Всеми версиями владеет
+ * хост.
+ *
+ * Версии держат образ в своей памяти (LoadWorldFileCopy), поэтому
+ * следующая сборка файла уже загруженную версию не меняет. Файл
+ * заменяют целиком (запись во временный и rename, как world-compiler):
+ * страничный мир читает тексты из открытого файла, а перезапись на
+ * месте может попасть в середину чтения.
+ */
+typedef struct {
+    _Atomic(const World *) current;
+    EpochDomain epochs;
+    const char *path;           // откуда перечитывать, NULL - перезагрузки нет
+    size_t cacheBytes;          // > 0 - постраничная загрузка (LoadWorldFilePaged)
+    thrd_t loader;
+    bool loaderStarted;
+    _Atomic bool loading;
+    _Atomic uint32_t version;   // 1 - начальная, растёт с каждой подменой
+} WorldHost;
+
+/* [[ Функции хоста ]] */
+bool InitWorldHost(WorldHost *host, const World *world, const char *path, size_t cacheBytes);
+void FreeWorldHost(WorldHost *host);
+bool RequestWorldReload(WorldHost *host);
+bool PublishWorld(WorldHost *host, World *world);
+size_t ReclaimWorlds(WorldHost *host);
+
+/*
+ * @brief Текущая версия мира для одного хода
+ * Указатель и всё, что в нём, живы до LeaveWorld.
+ */
+static inline const World* EnterWorld(WorldHost *host, EpochReader *reader) {
+    EpochEnter(&host->epochs, reader);
+    return atomic_load(&host->current);
+}
+
+static inline void LeaveWorld(EpochReader *reader) {
+    EpochLeave(reader);
+}
+
+#endif
@@ -0,0 +1,590 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <threads.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+#include "world-pager.h"
+#include "../utils/hash.h"
+#include "../utils/metrics.h"
+
+#define PAGER_READ_SIZE 4096     // первое чтение строки; тексты локации обычно лежат рядом
+#define PREFETCH_QUEUE 64        // степень двойки
+#define ITEMS_PAGE_ID (-1)
+
+_Static_assert((PREFETCH_QUEUE & (PREFETCH_QUEUE - 1)) == 0, "prefetch queue must be a power of two");
+
+/* [[ Страница ]] */
+typedef struct {
+    uint32_t offset;   // смещение строки в пуле файла
+    uint32_t at;       // начало копии в text
+} PageEntry;
+
+struct LocationPage {
+    int locationId;
+    int refs;                      // захваты; под замком кэша
+    bool prefetched;               // прочитана заранее и ещё не запрошена
+    struct LocationPage *newer;    // список LRU
+    struct LocationPage *older;
+    size_t bytes;
+    uint32_t count;
+    const char *text;
+    PageEntry entries[];           // по возрастанию offset
+};
+
+/* Окно чтения: строки одной локации обычно попадают в одно чтение */
+typedef struct {
+    char *data;
+    size_t capacity;
+    uint32_t start;    // смещение в пуле
+    uint32_t size;
+} ReadWindow;
+
+/* [[ Кэш ]] */
+struct WorldPager {
+    const World *world;
+#ifdef _WIN32
+    HANDLE file;
+#else
+    int fd;
+#endif
+    uint32_t stringsOffset;
+    uint32_t stringsSize;
+    uint32_t fileSize;
+
+    mtx_t lock;
+    LocationPage **slots;          // [locationCount]; calloc - нетронутые части таблицы не занимают память
+    LocationPage *newest;
+    LocationPage *oldest;
+    size_t residentBytes;
+    size_t capacityBytes;
+    LocationPage *items;           // тексты предметов, в памяти всегда
+
+    thrd_t prefetcher;
+    bool prefetcherRunning;
+    bool stopping;
+    cnd_t wake;
+    int queue[PREFETCH_QUEUE];
+    unsigned queueHead;
+    unsigned queueTail;
+};
+
+/* [[ Прототипы внутренних функций ]] */
+static LocationPage* LoadLocationPage(WorldPager *pager, int locationId);
+static LocationPage* BuildPage(WorldPager *pager, int id, uint32_t *offsets, uint32_t count);
+static const char* ReadString(WorldPager *pager, ReadWindow *window, uint32_t offset, size_t *length);
+static bool ReadAt(const WorldPager *pager, uint64_t position, void *buffer, size_t size);
+static void InsertPage(WorldPager *pager, LocationPage *page);
+static void RemovePage(WorldPager *pager, LocationPage *page);
+static void TouchPage(WorldPager *pager, LocationPage *page);
+static void LinkNewest(WorldPager *pager, LocationPage *page);
+static void Unlink(WorldPager *pager, LocationPage *page);
+static void EvictOverflow(WorldPager *pager);
+static void QueueNeighbours(WorldPager *pager, int locationId);
+static int PrefetchThread(void *arg);
+
+/* [[ Функции кэша страниц ]] */
+
+/*
+ * @brief Кэш текстов для мира, отображённого без пула строк
+ * @param world Мир с привязанным индексом (World.strings == NULL)
+ * @param path Тот же файл мира, из него читаются тексты
+ * @param cacheBytes Предел памяти под страницы локаций
+ * @return Кэш или NULL при ошибке (файл не читается, битые тексты предметов)
+ */
+WorldPager* CreateWorldPager(const World *world, const char *path, size_t cacheBytes) {
+    WorldPager *pager = calloc(1, sizeof(WorldPager));
+    if (pager == NULL) {
+        return NULL;
+    }
+    pager->world = world;
+    pager->stringsOffset = world->header->stringsOffset;
+    pager->stringsSize = world->header->stringsSize;
+    pager->fileSize = world->header->fileSize;
+    pager->capacityBytes = cacheBytes;
+    pager->slots = calloc((size_t)world->locationCount, sizeof(LocationPage *));
+
+#ifdef _WIN32
+    pager->file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL, NULL);
+    bool opened = pager->file != INVALID_HANDLE_VALUE;
+#else
+    pager->fd = open(path, O_RDONLY);
+    bool opened = pager->fd >= 0;
+#endif
+    if (!opened || pager->slots == NULL) {
+        free(pager->slots);
+        free(pager);
+        return NULL;
+    }
+    mtx_init(&pager->lock, mtx_plain);
+    cnd_init(&pager->wake);
+
+    // Тексты предметов нужны в любой локации (инвентарь), держим их целиком
+    uint32_t *offsets = malloc(((size_t)world->itemCount * 2 + 1) * sizeof(uint32_t));
+    if (offsets != NULL) {
+        for (int i = 0; i < world->itemCount; i++) {
+            offsets[2 * i] = world->items[i].name;
+            offsets[2 * i + 1] = world->items[i].description;
+        }
+        pager->items = BuildPage(pager, ITEMS_PAGE_ID, offsets, (uint32_t)world->itemCount * 2);
+        free(offsets);
+    }
+    if (pager->items == NULL) {
+        DestroyWorldPager(pager);
+        return NULL;
+    }
+
+    // Без фонового потока кэш работает, только без упреждающего чтения
+    pager->prefetcherRunning = thrd_create(&pager->prefetcher, PrefetchThread, pager) == thrd_success;
+    return pager;
+}
+
+/*
+ * @brief Освобождение кэша; захваченных страниц к этому моменту быть не должно
+ */
+void DestroyWorldPager(WorldPager *pager) {
+    if (pager == NULL) {
+        return;
+    }
+    if (pager->prefetcherRunning) {
+        mtx_lock(&pager->lock);
+        pager->stopping = true;
+        cnd_signal(&pager->wake);
+        mtx_unlock(&pager->lock);
+        thrd_join(pager->prefetcher, NULL);
+    }
+    while (pager->oldest != NULL) {
+        LocationPage *page = pager->oldest;
+        RemovePage(pager, page);
+        free(page);
+    }
+    free(pager->items);
+    free(pager->slots);
+#ifdef _WIN32
+    CloseHandle(pager->file);
+#else
+    close(pager->fd);
+#endif
+    cnd_destroy(&pager->wake);
+    mtx_destroy(&pager->lock);
+    free(pager);
+}
+
+/*
+ * @brief Продолжить хеш байтами файла с позиции from до конца
+ * Нужен отпечатку мира: в памяти у страничного мира только индекс.
+ */
+uint32_t HashWorldPagerTail(const WorldPager *pager, uint32_t from, uint32_t hash) {
+    char buffer[65536];
+    for (uint32_t at = from; at < pager->fileSize;) {
+        size_t size = pager->fileSize - at < sizeof buffer ? pager->fileSize - at : sizeof buffer;
+        if (!ReadAt(pager, at, buffer, size)) {
+            return 0;
+        }
+        hash = HashBytes(buffer, size, hash);
+        at += (uint32_t)size;
+    }
+    return hash;
+}
+
+/*
+ * @brief Захватить страницу текстов локации
+ * Пока страница захвачена, её строки не освобождаются. Промах читает
+ * тексты из файла в вызывающем потоке, остальное - под коротким замком.
+ *
+ * @return Страница или NULL, если мир не страничный (тогда PageString
+ *         берёт строки из образа) или прочитать тексты не удалось
+ */
+const LocationPage* AcquireLocationPage(const World *world, int locationId) {
+    WorldPager *pager = world->pager;
+    if (pager == NULL || locationId < 0 || locationId >= world->locationCount) {
+        return NULL;
+    }
+
+    mtx_lock(&pager->lock);
+    LocationPage *page = pager->slots[locationId];
+    if (page != NULL) {
+        METRIC_ADD(COUNTER_PAGE_HITS, 1);
+        if (page->prefetched) {
+            // Игрок пришёл туда, куда ждали, - ждём его и дальше
+            page->prefetched = false;
+            METRIC_ADD(COUNTER_PAGE_PREFETCH_HITS, 1);
+            QueueNeighbours(pager, locationId);
+        }
+        page->refs++;
+        TouchPage(pager, page);
+        mtx_unlock(&pager->lock);
+        return page;
+    }
+    mtx_unlock(&pager->lock);
+
+    METRIC_ADD(COUNTER_PAGE_MISSES, 1);
+    LocationPage *loaded = LoadLocationPage(pager, locationId);
+    if (loaded == NULL) {
+        return NULL;
+    }
+
+    mtx_lock(&pager->lock);
+    page = pager->slots[locationId];
+    if (page != NULL) {
+        // Пока читали, страницу загрузил другой поток
+        free(loaded);
+        page->prefetched = false;
+        TouchPage(pager, page);
+    } else {
+        page = loaded;
+        InsertPage(pager, page);
+    }
+    page->refs++;
+    QueueNeighbours(pager, locationId);
+    EvictOverflow(pager);
+    mtx_unlock(&pager->lock);
+    return page;
+}
+
+/*
+ * @brief Отпустить страницу, захваченную AcquireLocationPage (NULL допустим)
+ */
+void ReleaseLocationPage(const World *world, const LocationPage *page) {
+    WorldPager *pager = world->pager;
+    if (pager == NULL || page == NULL) {
+        return;
+    }
+    mtx_lock(&pager->lock);
+    ((LocationPage *)page)->refs--;
+    EvictOverflow(pager);
+    mtx_unlock(&pager->lock);
+}
+
+/*
+ * @brief Строка мира по смещению в пуле
+ * У обычного мира - как WorldString. У страничного строка ищется
+ * в захваченной странице и среди текстов предметов.
+ *
+ * @param page Страница текущей локации или NULL
+ * @return Строка или "" для неизвестного смещения
+ */
+const char* PageString(const World *world, const LocationPage *page, uint32_t offset) {
+    WorldPager *pager = world->pager;
+    if (pager == NULL) {
+        return WorldString(world, offset);
+    }
+    const LocationPage *pages[2] = {page, pager->items};
+    for (int p = 0; p < 2; p++) {
+        if (pages[p] == NULL) {
+            continue;
+        }
+        uint32_t low = 0;
+        uint32_t high = pages[p]->count;
+        while (low < high) {
+            uint32_t middle = (low + high) / 2;
+            if (pages[p]->entries[middle].offset < offset) {
+                low = middle + 1;
+            } else {
+                high = middle;
+            }
+        }
+        if (low < pages[p]->count && pages[p]->entries[low].offset == offset) {
+            return pages[p]->text + pages[p]->entries[low].at;
+        }
+    }
+    return "";
+}
+
+/* [[ Внутренние функции ]] */
+
+/* Тексты локации: название, описание и строки её действий (с отказом по условию) */
+static LocationPage* LoadLocationPage(WorldPager *pager, int locationId) {
+    const World *world = pager->world;
+    const Location *loc = &world->locations[locationId];
+    uint32_t actionCount = loc->actionCount;
+
+    uint32_t *offsets = malloc(((size_t)actionCount * 3 + 2) * sizeof(uint32_t));
+    if (offsets == NULL) {
+        return NULL;
+    }
+    uint32_t count = 0;
+    offsets[count++] = loc->name;
+    offsets[count++] = loc->description;
+    for (uint32_t i = 0; i < actionCount; i++) {
+        const Action *action = GetLocationAction(world, loc, (int)i);
+        if (action != NULL) {
+            offsets[count++] = action->text;
+            offsets[count++] = action->resultText;
+            offsets[count++] = action->blockedText;
+        }
+    }
+    LocationPage *page = BuildPage(pager, locationId, offsets, count);
+    free(offsets);
+    return page;
+}
+
+/*
+ * Страница из набора смещений: строки читаются по возрастанию смещения,
+ * поэтому соседние строки приходят одним чтением окна.
+ */
+static LocationPage* BuildPage(WorldPager *pager, int id, uint32_t *offsets, uint32_t count) {
+    // Сортировка вставками: смещений на страницу - единицы и десятки
+    for (uint32_t i = 1; i < count; i++) {
+        uint32_t value = offsets[i];
+        uint32_t j = i;
+        for (; j > 0 && offsets[j - 1] > value; j--) {
+            offsets[j] = offsets[j - 1];
+        }
+        offsets[j] = value;
+    }
+    uint32_t unique = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        if (unique == 0 || offsets[unique - 1] != offsets[i]) {
+            offsets[unique++] = offsets[i];
+        }
+    }
+
+    ReadWindow window = {NULL, 0, 0, 0};
+    char *text = NULL;
+    size_t textSize = 0;
+    size_t textCapacity = 0;
+    PageEntry *entries = malloc((unique > 0 ? unique : 1) * sizeof(PageEntry));
+    bool ok = entries != NULL;
+
+    for (uint32_t i = 0; i < unique && ok; i++) {
+        size_t length = 0;
+        const char *s = ReadString(pager, &window, offsets[i], &length);
+        if (s == NULL) {
+            ok = false;
+            break;
+        }
+        if (textSize + length + 1 > textCapacity) {
+            size_t capacity = textCapacity > 0 ? textCapacity * 2 : 1024;
+            while (capacity < textSize + length + 1) {
+                capacity *= 2;
+            }
+            char *grown = realloc(text, capacity);
+            if (grown == NULL) {
+                ok = false;
+                break;
+            }
+            text = grown;
+            textCapacity = capacity;
+        }
+        memcpy(text + textSize, s, length + 1);
+        entries[i] = (PageEntry){offsets[i], (uint32_t)textSize};
+        textSize += length + 1;
+    }
+
+    LocationPage *page = NULL;
+    if (ok) {
+        size_t bytes = sizeof(LocationPage) + (size_t)unique * sizeof(PageEntry) + textSize;
+        page = malloc(bytes);
+        if (page != NULL) {
+            memset(page, 0, sizeof *page);
+            page->locationId = id;
+            page->bytes = bytes;
+            page->count = unique;
+            memcpy(page->entries, entries, (size_t)unique * sizeof(PageEntry));
+            char *copy = (char *)(page->entries + unique);
+            if (textSize > 0) {
+                memcpy(copy, text, textSize);
+            }
+            page->text = copy;
+        }
+    }
+    free(window.data);
+    free(text);
+    free(entries);
+    return page;
+}
+
+/*
+ * Строка пула через окно чтения. Если строка не уместилась в окно,
+ * оно перечитывается с начала строки вдвое большим.
+ *
+ * @return Указатель внутрь окна (до следующего вызова) или NULL,
+ *         если смещение вне пула, строка не завершена или чтение не удалось
+ */
+static const char* ReadString(WorldPager *pager, ReadWindow *window, uint32_t offset, size_t *length) {
+    if (offset >= pager->stringsSize) {
+        return NULL;
+    }
+    for (size_t want = PAGER_READ_SIZE;; want *= 2) {
+        if (window->size > 0 && offset >= window->start && offset - window->start < window->size) {
+            const char *s = window->data + (offset - window->start);
+            const char *end = memchr(s, '\0', window->size - (offset - window->start));
+            if (end != NULL) {
+                *length = (size_t)(end - s);
+                return s;
+            }
+            if (window->start + window->size == pager->stringsSize) {
+                return NULL;
+            }
+        }
+
+        uint32_t rest = pager->stringsSize - offset;
+        size_t size = want < rest ? want : rest;
+        if (size > window->capacity) {
+            char *grown = realloc(window->data, size);
+            if (grown == NULL) {
+                return NULL;
+            }
+            window->data = grown;
+            window->capacity = size;
+        }
+        if (!ReadAt(pager, (uint64_t)pager->stringsOffset + offset, window->data, size)) {
+            return NULL;
+        }
+        window->start = offset;
+        window->size = (uint32_t)size;
+    }
+}
+
+/* Чтение с позиции без общего указателя файла: потоки не мешают друг другу */
+static bool ReadAt(const WorldPager *pager, uint64_t position, void *buffer, size_t size) {
+    char *at = buffer;
+    while (size > 0) {
+#ifdef _WIN32
+        OVERLAPPED overlapped = {0};
+        overlapped.Offset = (DWORD)position;
+        overlapped.OffsetHigh = (DWORD)(position >> 32);
+        DWORD chunk = size > 0x40000000u ? 0x40000000u : (DWORD)size;
+        DWORD done = 0;
+        if (!ReadFile(pager->file, at, chunk, &done, &overlapped) || done == 0) {
+            return false;
+        }
+#else
+        ssize_t done = pread(pager->fd, at, size, (off_t)position);
+        if (done <= 0) {
+            return false;
+        }
+#endif
+        at += done;
+        position += (uint64_t)done;
+        size -= (size_t)done;
+    }
+    return true;
+}
+
+/* Новая страница - самая свежая в LRU */
+static void InsertPage(WorldPager *pager, LocationPage *page) {
+    pager->slots[page->locationId] = page;
+    pager->residentBytes += page->bytes;
+    LinkNewest(pager, page);
+    METRIC_ADD(COUNTER_PAGE_BYTES_LOADED, page->bytes);
+}
+
+static void RemovePage(WorldPager *pager, LocationPage *page) {
+    Unlink(pager, page);
+    pager->slots[page->locationId] = NULL;
+    pager->residentBytes -= page->bytes;
+    METRIC_ADD(COUNTER_PAGE_BYTES_EVICTED, page->bytes);
+}
+
+static void TouchPage(WorldPager *pager, LocationPage *page) {
+    if (pager->newest != page) {
+        Unlink(pager, page);
+        LinkNewest(pager, page);
+    }
+}
+
+static void LinkNewest(WorldPager *pager, LocationPage *page) {
+    page->older = pager->newest;
+    page->newer = NULL;
+    if (pager->newest != NULL) {
+        pager->newest->newer = page;
+    }
+    pager->newest = page;
+    if (pager->oldest == NULL) {
+        pager->oldest = page;
+    }
+}
+
+static void Unlink(WorldPager *pager, LocationPage *page) {
+    if (page->newer != NULL) {
+        page->newer->older = page->older;
+    } else {
+        pager->newest = page->older;
+    }
+    if (page->older != NULL) {
+        page->older->newer = page->newer;
+    } else {
+        pager->oldest = page->newer;
+    }
+}
+
+/* Вытеснение свободных страниц, начиная с давно не нужных */
+static void EvictOverflow(WorldPager *pager) {
+    LocationPage *page = pager->oldest;
+    while (pager->residentBytes > pager->capacityBytes && page != NULL) {
+        LocationPage *newer = page->newer;
+        if (page->refs == 0) {
+            RemovePage(pager, page);
+            METRIC_ADD(COUNTER_PAGE_EVICTIONS, 1);
+            free(page);
+        }
+        page = newer;
+    }
+}
+
+/* Соседи - локации, куда ведут действия; вызывается под замком */
+static void QueueNeighbours(WorldPager *pager, int locationId) {
+    if (!pager->prefetcherRunning) {
+        return;
+    }
+    const World *world = pager->world;
+    const Location *loc = &world->locations[locationId];
+    bool queued = false;
+
+    for (uint32_t i = 0; i < loc->actionCount; i++) {
+        const Action *action = GetLocationAction(world, loc, (int)i);
+        if (action == NULL || action->targetLocation < 0 || action->targetLocation >= world->locationCount ||
+            action->targetLocation == locationId || pager->slots[action->targetLocation] != NULL) {
+            continue;
+        }
+        if (pager->queueTail - pager->queueHead == PREFETCH_QUEUE) {
+            break;      // очередь полна - упреждение лишь подсказка
+        }
+        pager->queue[pager->queueTail++ & (PREFETCH_QUEUE - 1)] = action->targetLocation;
+        queued = true;
+    }
+    if (queued) {
+        cnd_signal(&pager->wake);
+    }
+}
+
+static int PrefetchThread(void *arg) {
+    WorldPager *pager = arg;
+
+    mtx_lock(&pager->lock);
+    while (!pager->stopping) {
+        if (pager->queueHead == pager->queueTail) {
+            cnd_wait(&pager->wake, &pager->lock);
+            continue;
+        }
+        int locationId = pager->queue[pager->queueHead++ & (PREFETCH_QUEUE - 1)];
+        if (pager->slots[locationId] != NULL) {
+            continue;
+        }
+        mtx_unlock(&pager->lock);
+        LocationPage *page = LoadLocationPage(pager, locationId);
+        mtx_lock(&pager->lock);
+
+        if (page == NULL) {
+            continue;
+        }
+        if (pager->slots[locationId] != NULL) {
+            free(page);
+            continue;
+        }
+        page->prefetched = true;
+        InsertPage(pager, page);
+        METRIC_ADD(COUNTER_PAGE_PREFETCHES, 1);
+        EvictOverflow(pager);
+    }
+    mtx_unlock(&pager->lock);
+    return 0;
+}
@@ -0,0 +1,32 @@
+#ifndef WORLD_PAGER_H
+#define WORLD_PAGER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "world.h"
+
+/*
+ * [[ Страничная загрузка текстов мира ]]
+ *
+ * Для миров, которые не нужно держать в памяти целиком. Записи
+ * локаций, действий и предметов - компактный индекс (около сотни байт
+ * на локацию) - отображаются через mmap, а тексты, основной объём
+ * файла, читаются по локациям при первом обращении.
+ *
+ * Страница локации - её название, описание и тексты действий. Страницы
+ * лежат в общем для всех сессий кэше, ограниченном по байтам: пока
+ * страница захвачена (AcquireLocationPage), она не вытесняется, свободные
+ * вытесняются в порядке давности использования (LRU). После загрузки
+ * страницы фоновый поток заранее читает соседей - локации, куда ведут
+ * её действия. Тексты предметов (их носят с собой) загружаются сразу.
+ *
+ * Попадания, промахи, упреждающие чтения и вытеснения считаются
+ * в метриках (COUNTER_PAGE_*).
+ */
+
+/* [[ Функции кэша страниц ]] */
+WorldPager* CreateWorldPager(const World *world, const char *path, size_t cacheBytes);
+void DestroyWorldPager(WorldPager *pager);
+uint32_t HashWorldPagerTail(const WorldPager *pager, uint32_t from, uint32_t hash);
+
+#endif
@@ -0,0 +1,622 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "world-source.h"
+#include "world-builder.h"
+#include "action-script.h"
+
+/* [[ Внутренние структуры ]] */
+
+typedef struct {
+    const char *symbol;
+    const char *name;
+    const char *description;
+    int line;
+} SourceLocation;
+
+typedef struct {
+    const char *symbol;
+    const char *name;
+    const char *description;
+    int location;
+    int line;
+} SourceItem;
+
+typedef struct {
+    int location;
+    const char *text;
+    const char *result;
+    const char *target;
+    const char *gives;
+    const char *requires;
+    const char *when;
+    const char *effects;
+    const char *otherwise;
+    bool available;
+    int line;
+} SourceAction;
+
+/* Синонимы: "synonym <слово> <синоним...>" */
+typedef struct {
+    const char *word;
+    const char *synonyms;
+    int line;
+} SourceSynonym;
+
+/* Таблица символов: открытая адресация, значение - индекс объекта */
+typedef struct {
+    const char **keys;
+    int *values;
+    size_t capacity;
+    size_t count;
+} SymbolTable;
+
+typedef enum {
+    BLOCK_NONE,
+    BLOCK_LOCATION,
+    BLOCK_ITEM,
+    BLOCK_ACTION
+} BlockType;
+
+typedef struct {
+    const char *path;
+    char *text;
+    SourceLocation *locations;
+    int locationCount;
+    int locationCapacity;
+    SourceItem *items;
+    int itemCount;
+    int itemCapacity;
+    SourceAction *actions;
+    int actionCount;
+    int actionCapacity;
+    SourceSynonym *synonyms;
+    int synonymCount;
+    int synonymCapacity;
+    SymbolTable locationSymbols;
+    SymbolTable itemSymbols;
+    SymbolTable actionSymbols;
+    SymbolTable flagSymbols;      // флаги и счётчики объявляются первым упоминанием
+    SymbolTable counterSymbols;
+    char **names;                 // копии имён флагов и счётчиков
+    int nameCount;
+    int nameCapacity;
+    const char *start;
+    int startLine;
+    const char *win;
+    int winLine;
+    char *error;
+    size_t errorSize;
+} SourceParser;
+
+/* [[ Прототипы внутренних функций ]] */
+static char* ReadWholeFile(const char *path);
+static bool ParseLines(SourceParser *parser);
+static void* BuildImage(SourceParser *parser, size_t *size);
+static bool Grow(void **data, int *capacity, int count, size_t elemSize);
+static bool SymbolPut(SymbolTable *table, const char *key, int value);
+static int SymbolGet(const SymbolTable *table, const char *key);
+static void SetSymbolKeys(WorldBuilder *builder, const SymbolTable *table, WorldKeyKind kind);
+static int ResolveScriptSymbol(void *context, ScriptSymbolKind kind, const char *name);
+static void FreeParser(SourceParser *parser);
+static bool ParseError(SourceParser *parser, int line, const char *message, const char *detail);
+
+/* [[ Функции исходника ]] */
+
+/*
+ * @brief Сборка двоичного образа мира из текстового исходника
+ *
+ * @param path Путь к исходнику
+ * @param size Сюда записывается размер образа
+ * @param error Буфер для текста ошибки вида "файл:строка: сообщение"
+ * @return Образ (освобождать через free) или NULL при ошибке
+ */
+void* CompileWorldSource(const char *path, size_t *size, char *error, size_t errorSize) {
+    SourceParser parser;
+    memset(&parser, 0, sizeof parser);
+    parser.path = path;
+    parser.error = error;
+    parser.errorSize = errorSize;
+
+    parser.text = ReadWholeFile(path);
+    if (parser.text == NULL) {
+        snprintf(error, errorSize, "%s: не удалось прочитать файл", path);
+        return NULL;
+    }
+
+    void *image = NULL;
+    if (ParseLines(&parser)) {
+        image = BuildImage(&parser, size);
+    }
+    FreeParser(&parser);
+    return image;
+}
+
+/* [[ Разбор строк ]] */
+
+static char* TrimLeft(char *s) {
+    while (*s == ' ' || *s == '\t') {
+        s++;
+    }
+    return s;
+}
+
+static void TrimRight(char *s) {
+    size_t length = strlen(s);
+    while (length > 0 && (s[length - 1] == ' ' || s[length - 1] == '\t' || s[length - 1] == '\r')) {
+        s[--length] = '\0';
+    }
+}
+
+static bool ParseLines(SourceParser *parser) {
+    BlockType block = BLOCK_NONE;
+    int lineNumber = 0;
+    char *cursor = parser->text;
+
+    while (cursor != NULL && *cursor != '\0') {
+        char *line = cursor;
+        char *newline = strchr(cursor, '\n');
+        if (newline != NULL) {
+            *newline = '\0';
+            cursor = newline + 1;
+        } else {
+            cursor = NULL;
+        }
+        lineNumber++;
+
+        TrimRight(line);
+        line = TrimLeft(line);
+        if (*line == '\0' || *line == '#') {
+            continue;
+        }
+
+        // Ключевое слово до первого пробела, остальное - значение
+        char *value = line;
+        while (*value != '\0' && *value != ' ' && *value != '\t') {
+            value++;
+        }
+        if (*value != '\0') {
+            *value++ = '\0';
+            value = TrimLeft(value);
+        }
+        const char *key = line;
+
+        if (strcmp(key, "start") == 0) {
+            parser->start = value;
+            parser->startLine = lineNumber;
+        } else if (strcmp(key, "win") == 0) {
+            parser->win = value;
+            parser->winLine = lineNumber;
+        } else if (strcmp(key, "synonym") == 0) {
+            char *synonyms = value;
+            while (*synonyms != '\0' && *synonyms != ' ' && *synonyms != '\t') {
+                synonyms++;
+            }
+            if (*synonyms != '\0') {
+                *synonyms++ = '\0';
+                synonyms = TrimLeft(synonyms);
+            }
+            if (*value == '\0' || *synonyms == '\0') {
+                return ParseError(parser, lineNumber, "synonym ожидает слово и синонимы", NULL);
+            }
+            if (!Grow((void **)&parser->synonyms, &parser->synonymCapacity,
+                      parser->synonymCount + 1, sizeof(SourceSynonym))) {
+                return ParseError(parser, lineNumber, "не хватает памяти", NULL);
+            }
+            parser->synonyms[parser->synonymCount++] = (SourceSynonym){value, synonyms, lineNumber};
+        } else if (strcmp(key, "location") == 0) {
+            if (*value == '\0') {
+                return ParseError(parser, lineNumber, "у локации нет идентификатора", NULL);
+            }
+            if (!Grow((void **)&parser->locations, &parser->locationCapacity,
+                      parser->locationCount + 1, sizeof(SourceLocation))) {
+                return ParseError(parser, lineNumber, "не хватает памяти", NULL);
+            }
+            if (SymbolGet(&parser->locationSymbols, value) >= 0) {
+                return ParseError(parser, lineNumber, "повторная локация", value);
+            }
+            SourceLocation *loc = &parser->locations[parser->locationCount];
+            memset(loc, 0, sizeof *loc);
+            loc->symbol = value;
+            loc->line = lineNumber;
+            if (!SymbolPut(&parser->locationSymbols, value, parser->locationCount)) {
+                return ParseError(parser, lineNumber, "не хватает памяти", NULL);
+            }
+            parser->locationCount++;
+            block = BLOCK_LOCATION;
+        } else if (strcmp(key, "item") == 0) {
+            if (parser->locationCount == 0) {
+                return ParseError(parser, lineNumber, "предмет вне локации", value);
+            }
+            if (*value == '\0') {
+                return ParseError(parser, lineNumber, "у предмета нет идентификатора", NULL);
+            }
+            if (SymbolGet(&parser->itemSymbols, value) >= 0) {
+                return ParseError(parser, lineNumber, "повторный предмет", value);
+            }
+            if (!Grow((void **)&parser->items, &parser->itemCapacity,
+                      parser->itemCount + 1, sizeof(SourceItem)) ||
+                !SymbolPut(&parser->itemSymbols, value, parser->itemCount)) {
+                return ParseError(parser, lineNumber, "не хватает памяти", NULL);
+            }
+            SourceItem *item = &parser->items[parser->itemCount++];
+            memset(item, 0, sizeof *item);
+            item->symbol = value;
+            item->location = parser->locationCount - 1;
+            item->line = lineNumber;
+            block = BLOCK_ITEM;
+        } else if (strcmp(key, "action") == 0) {
+            if (parser->locationCount == 0) {
+                return ParseError(parser, lineNumber, "действие вне локации", NULL);
+            }
+            if (!Grow((void **)&parser->actions, &parser->actionCapacity,
+                      parser->actionCount + 1, sizeof(SourceAction))) {
+                return ParseError(parser, lineNumber, "не хватает памяти", NULL);
+            }
+            if (*value != '\0' && SymbolGet(&parser->actionSymbols, value) >= 0) {
+                return ParseError(parser, lineNumber, "повторное действие", value);
+            }
+            if (*value != '\0' && !SymbolPut(&parser->actionSymbols, value, parser->actionCount)) {
+                return ParseError(parser, lineNumber, "не хватает памяти", NULL);
+            }
+            SourceAction *action = &parser->actions[parser->actionCount++];
+            memset(action, 0, sizeof *action);
+            action->location = parser->locationCount - 1;
+            action->available = true;
+            action->line = lineNumber;
+            block = BLOCK_ACTION;
+        } else if (block == BLOCK_LOCATION && strcmp(key, "name") == 0) {
+            parser->locations[parser->locationCount - 1].name = value;
+        } else if (block == BLOCK_LOCATION && strcmp(key, "description") == 0) {
+            parser->locations[parser->locationCount - 1].description = value;
+        } else if (block == BLOCK_ITEM && strcmp(key, "name") == 0) {
+            parser->items[parser->itemCount - 1].name = value;
+        } else if (block == BLOCK_ITEM && strcmp(key, "description") == 0) {
+            parser->items[parser->itemCount - 1].description = value;
+        } else if (block == BLOCK_ACTION) {
+            SourceAction *action = &parser->actions[parser->actionCount - 1];
+            if (strcmp(key, "text") == 0) {
+                action->text = value;
+            } else if (strcmp(key, "result") == 0) {
+                action->result = value;
+            } else if (strcmp(key, "target") == 0) {
+                action->target = value;
+            } else if (strcmp(key, "gives") == 0) {
+                action->gives = value;
+            } else if (strcmp(key, "requires") == 0) {
+                action->requires = value;
+            } else if (strcmp(key, "when") == 0) {
+                action->when = value;
+            } else if (strcmp(key, "do") == 0) {
+                if (action->effects != NULL) {
+                    return ParseError(parser, lineNumber, "повторный do, перечислите через запятую", NULL);
+                }
+                action->effects = value;
+            } else if (strcmp(key, "otherwise") == 0) {
+                action->otherwise = value;
+            } else if (strcmp(key, "available") == 0) {
+                if (strcmp(value, "yes") != 0 && strcmp(value, "no") != 0) {
+                    return ParseError(parser, lineNumber, "available ожидает yes или no", value);
+                }
+                action->available = strcmp(value, "yes") == 0;
+            } else {
+                return ParseError(parser, lineNumber, "неизвестный ключ действия", key);
+            }
+        } else {
+            return ParseError(parser, lineNumber, "неизвестный ключ", key);
+        }
+    }
+    return true;
+}
+
+/* [[ Сборка образа ]] */
+
+static void* BuildImage(SourceParser *parser, size_t *size) {
+    WorldBuilder *builder = CreateWorldBuilder();
+    if (builder == NULL) {
+        ParseError(parser, 0, "не хватает памяти", NULL);
+        return NULL;
+    }
+
+    void *image = NULL;
+
+    for (int i = 0; i < parser->synonymCount; i++) {
+        const SourceSynonym *synonym = &parser->synonyms[i];
+        if (!WorldBuilderAddSynonym(builder, synonym->word, synonym->synonyms)) {
+            ParseError(parser, synonym->line, WorldBuilderError(builder), NULL);
+            goto done;
+        }
+    }
+
+    for (int i = 0; i < parser->locationCount; i++) {
+        const SourceLocation *loc = &parser->locations[i];
+        if (loc->name == NULL) {
+            ParseError(parser, loc->line, "у локации нет name", loc->symbol);
+            goto done;
+        }
+        WorldBuilderAddLocation(builder, loc->name, loc->description);
+    }
+
+    // Индексы предметов совпадают с порядком объявления
+    for (int i = 0; i < parser->itemCount; i++) {
+        const SourceItem *item = &parser->items[i];
+        if (item->name == NULL) {
+            ParseError(parser, item->line, "у предмета нет name", item->symbol);
+            goto done;
+        }
+        WorldBuilderAddItem(builder, item->location, item->name, item->description);
+    }
+
+    for (int i = 0; i < parser->actionCount; i++) {
+        const SourceAction *action = &parser->actions[i];
+        int target = NO_LOCATION;
+        int gives = NO_ITEM;
+        int required = NO_ITEM;
+
+        if (action->text == NULL) {
+            ParseError(parser, action->line, "у действия нет text", NULL);
+            goto done;
+        }
+        if (action->target != NULL) {
+            target = SymbolGet(&parser->locationSymbols, action->target);
+            if (target < 0) {
+                ParseError(parser, action->line, "неизвестная локация", action->target);
+                goto done;
+            }
+        }
+        if (action->gives != NULL) {
+            gives = SymbolGet(&parser->itemSymbols, action->gives);
+            if (gives < 0) {
+                ParseError(parser, action->line, "неизвестный предмет", action->gives);
+                goto done;
+            }
+        }
+        if (action->requires != NULL) {
+            required = SymbolGet(&parser->itemSymbols, action->requires);
+            if (required < 0) {
+                ParseError(parser, action->line, "неизвестный предмет", action->requires);
+                goto done;
+            }
+        }
+        WorldBuilderAddAction(builder, action->location, action->text, target, required,
+                              action->result, gives, action->available);
+    }
+
+    // Сценарии - после всех действий: unlock и lock ссылаются и вперёд
+    for (int i = 0; i < parser->actionCount; i++) {
+        const SourceAction *action = &parser->actions[i];
+        ScriptBuffer condition = {0};
+        ScriptBuffer effects = {0};
+        bool ok = (action->when == NULL ||
+                   CompileCondition(&condition, action->when, ResolveScriptSymbol, parser)) &&
+                  (action->effects == NULL ||
+                   CompileEffects(&effects, action->effects, ResolveScriptSymbol, parser));
+        if (!ok) {
+            ParseError(parser, action->line, condition.error[0] != '\0' ? condition.error : effects.error, NULL);
+        } else if ((action->when != NULL || action->effects != NULL || action->otherwise != NULL) &&
+                   !WorldBuilderSetActionScript(builder, i, condition.code, condition.count,
+                                                effects.code, effects.count, action->otherwise)) {
+            ParseError(parser, action->line, WorldBuilderError(builder), NULL);
+            ok = false;
+        }
+        FreeScriptBuffer(&condition);
+        FreeScriptBuffer(&effects);
+        if (!ok) {
+            goto done;
+        }
+    }
+    WorldBuilderSetStateCounts(builder, (int)parser->flagSymbols.count, (int)parser->counterSymbols.count);
+
+    // Символы исходника - стабильные ключи для перезагрузки мира
+    SetSymbolKeys(builder, &parser->locationSymbols, WORLD_KEY_LOCATION);
+    SetSymbolKeys(builder, &parser->itemSymbols, WORLD_KEY_ITEM);
+    SetSymbolKeys(builder, &parser->actionSymbols, WORLD_KEY_ACTION);
+    SetSymbolKeys(builder, &parser->flagSymbols, WORLD_KEY_FLAG);
+    SetSymbolKeys(builder, &parser->counterSymbols, WORLD_KEY_COUNTER);
+
+    if (parser->start != NULL) {
+        int start = SymbolGet(&parser->locationSymbols, parser->start);
+        if (start < 0) {
+            ParseError(parser, parser->startLine, "неизвестная стартовая локация", parser->start);
+            goto done;
+        }
+        WorldBuilderSetStart(builder, start);
+    }
+    if (parser->win != NULL) {
+        int win = SymbolGet(&parser->itemSymbols, parser->win);
+        if (win < 0) {
+            ParseError(parser, parser->winLine, "неизвестный предмет победы", parser->win);
+            goto done;
+        }
+        WorldBuilderSetWinItem(builder, win);
+    }
+
+    image = WorldBuilderFinish(builder, size);
+    if (image == NULL) {
+        ParseError(parser, 0, WorldBuilderError(builder), NULL);
+    }
+
+done:
+    DestroyWorldBuilder(builder);
+    return image;
+}
+
+/* Имена сценариев: флаг или счётчик заводится при первом упоминании */
+static int ResolveScriptSymbol(void *context, ScriptSymbolKind kind, const char *name) {
+    SourceParser *parser = context;
+    SymbolTable *table = NULL;
+
+    switch (kind) {
+        case SCRIPT_SYMBOL_ITEM:     return SymbolGet(&parser->itemSymbols, name);
+        case SCRIPT_SYMBOL_LOCATION: return SymbolGet(&parser->locationSymbols, name);
+        case SCRIPT_SYMBOL_ACTION:   return SymbolGet(&parser->actionSymbols, name);
+        case SCRIPT_SYMBOL_FLAG:     table = &parser->flagSymbols; break;
+        case SCRIPT_SYMBOL_COUNTER:  table = &parser->counterSymbols; break;
+    }
+
+    int index = SymbolGet(table, name);
+    if (index >= 0) {
+        return index;
+    }
+    char *copy = malloc(strlen(name) + 1);
+    if (copy == NULL || !Grow((void **)&parser->names, &parser->nameCapacity, parser->nameCount + 1, sizeof(char *))) {
+        free(copy);
+        return -1;
+    }
+    strcpy(copy, name);
+    parser->names[parser->nameCount++] = copy;
+    index = (int)table->count;
+    return SymbolPut(table, copy, index) ? index : -1;
+}
+
+/* [[ Вспомогательные функции ]] */
+
+static char* ReadWholeFile(const char *path) {
+    FILE *file = fopen(path, "rb");
+    if (file == NULL) {
+        return NULL;
+    }
+
+    size_t capacity = 4096;
+    size_t size = 0;
+    char *data = malloc(capacity);
+    while (data != NULL) {
+        size_t read = fread(data + size, 1, capacity - size - 1, file);
+        size += read;
+        if (size + 1 < capacity) {
+            break;
+        }
+        char *grown = realloc(data, capacity * 2);
+        if (grown == NULL) {
+            free(data);
+            data = NULL;
+            break;
+        }
+        data = grown;
+        capacity *= 2;
+    }
+    bool failed = ferror(file) != 0;
+    fclose(file);
+
+    if (data == NULL || failed) {
+        free(data);
+        return NULL;
+    }
+    data[size] = '\0';
+    return data;
+}
+
+static bool Grow(void **data, int *capacity, int count, size_t elemSize) {
+    if (count <= *capacity) {
+        return true;
+    }
+    int newCapacity = *capacity > 0 ? *capacity * 2 : 64;
+    void *grown = realloc(*data, (size_t)newCapacity * elemSize);
+    if (grown == NULL) {
+        return false;
+    }
+    *data = grown;
+    *capacity = newCapacity;
+    return true;
+}
+
+static uint32_t HashSymbol(const char *key) {
+    uint32_t hash = 2166136261u;  // FNV-1a
+    for (const unsigned char *p = (const unsigned char *)key; *p; p++) {
+        hash = (hash ^ *p) * 16777619u;
+    }
+    return hash;
+}
+
+static bool SymbolPut(SymbolTable *table, const char *key, int value) {
+    if ((table->count + 1) * 2 > table->capacity) {
+        size_t newCapacity = table->capacity > 0 ? table->capacity * 2 : 64;
+        const char **keys = calloc(newCapacity, sizeof(const char *));
+        int *values = calloc(newCapacity, sizeof(int));
+        if (keys == NULL || values == NULL) {
+            free(keys);
+            free(values);
+            return false;
+        }
+        for (size_t i = 0; i < table->capacity; i++) {
+            if (table->keys[i] == NULL) {
+                continue;
+            }
+            size_t pos = HashSymbol(table->keys[i]) & (newCapacity - 1);
+            while (keys[pos] != NULL) {
+                pos = (pos + 1) & (newCapacity - 1);
+            }
+            keys[pos] = table->keys[i];
+            values[pos] = table->values[i];
+        }
+        free(table->keys);
+        free(table->values);
+        table->keys = keys;
+        table->values = values;
+        table->capacity = newCapacity;
+    }
+
+    size_t pos = HashSymbol(key) & (table->capacity - 1);
+    while (table->keys[pos] != NULL) {
+        pos = (pos + 1) & (table->capacity - 1);
+    }
+    table->keys[pos] = key;
+    table->values[pos] = value;
+    table->count++;
+    return true;
+}
+
+static int SymbolGet(const SymbolTable *table, const char *key) {
+    if (table->capacity == 0) {
+        return -1;
+    }
+    size_t pos = HashSymbol(key) & (table->capacity - 1);
+    while (table->keys[pos] != NULL) {
+        if (strcmp(table->keys[pos], key) == 0) {
+            return table->values[pos];
+        }
+        pos = (pos + 1) & (table->capacity - 1);
+    }
+    return -1;
+}
+
+static void SetSymbolKeys(WorldBuilder *builder, const SymbolTable *table, WorldKeyKind kind) {
+    for (size_t i = 0; i < table->capacity; i++) {
+        if (table->keys[i] != NULL) {
+            WorldBuilderSetKey(builder, kind, table->values[i], table->keys[i]);
+        }
+    }
+}
+
+static void FreeParser(SourceParser *parser) {
+    free(parser->text);
+    free(parser->locations);
+    free(parser->items);
+    free(parser->actions);
+    free(parser->synonyms);
+    free(parser->locationSymbols.keys);
+    free(parser->locationSymbols.values);
+    free(parser->itemSymbols.keys);
+    free(parser->itemSymbols.values);
+    free(parser->actionSymbols.keys);
+    free(parser->actionSymbols.values);
+    free(parser->flagSymbols.keys);
+    free(parser->flagSymbols.values);
+    free(parser->counterSymbols.keys);
+    free(parser->counterSymbols.values);
+    for (int i = 0; i < parser->nameCount; i++) {
+        free(parser->names[i]);
+    }
+    free(parser->names);
+}
+
+static bool ParseError(SourceParser *parser, int line, const char *message, const char *detail) {
+    if (detail != NULL) {
+        snprintf(parser->error, parser->errorSize, "%s:%d: %s: %s", parser->path, line, message, detail);
+    } else {
+        snprintf(parser->error, parser->errorSize, "%s:%d: %s", parser->path, line, message);
+    }
+    return false;
+}
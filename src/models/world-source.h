@@ -0,0 +1,15 @@
+#ifndef WORLD_SOURCE_H
+#define WORLD_SOURCE_H
+
+#include <stddef.h>
+
+/*
+ * [[ Текстовый исходник мира ]]
+ * Человекочитаемый формат (см. worlds/mansion.txt), из которого
+ * world-compiler собирает двоичный образ мира.
+ */
+
+/* [[ Функции исходника ]] */
+void* CompileWorldSource(const char *path, size_t *size, char *error, size_t errorSize);
+
+#endif
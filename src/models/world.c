@@ -0,0 +1,595 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stddef.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#include "world.h"
+#include "builtin-world.h"
+#include "world-pager.h"
+#include "../utils/bitset.h"
+
+/* Раскладка записей - часть формата файла, менять только вместе с версией */
+_Static_assert(sizeof(WorldFileHeader) == 96, "WorldFileHeader layout changed");
+_Static_assert(sizeof(Location) == 24, "Location layout changed");
+_Static_assert(sizeof(Action) == 36, "Action layout changed");
+_Static_assert(sizeof(Item) == 8, "Item layout changed");
+
+/* [[ Шаблон мира по умолчанию ]] */
+static World *defaultWorld = NULL;
+
+/* [[ Прототипы внутренних функций ]] */
+static bool BindWorldImage(World *world, void *image, size_t size, size_t fileSize);
+static World* PlaceWorld(const World *bound);
+static bool BindLexicon(Lexicon *lexicon, const WorldFileHeader *header, const char *base, size_t size);
+static bool TableFits(const WorldFileHeader *header, uint32_t offset, uint32_t count, size_t elemSize);
+static int CompareKeyEntries(const void *a, const void *b);
+static World* LoadFromFile(const char *path, size_t cacheBytes, bool copy);
+static void* MapWorldFile(const char *path, size_t *size, size_t limit);
+static void UnmapWorldFile(void *image, size_t size);
+static void* ReadWorldFile(const char *path, size_t *size, size_t limit);
+
+/* [[ Функции мира ]] */
+
+/*
+ * @brief Загрузка встроенного мира (особняк)
+ * Образ вкомпилирован в программу (см. builtin-world.h) и используется
+ * на месте, как отображённый файл: ни разбора, ни копирования строк.
+ * Первый вызов должен произойти до запуска рабочих потоков.
+ *
+ * @return Указатель на неизменяемый мир или NULL, если образ несовместим
+ */
+const World* LoadDefaultWorld() {
+    if (defaultWorld != NULL) {
+        return defaultWorld;
+    }
+
+    // Образ только читается; UnloadWorld не освобождает встроенный мир
+    World bound;
+    if (!BindWorldImage(&bound, (void *)builtinWorldImage, builtinWorldSize, builtinWorldSize)) {
+        fprintf(stderr, "Встроенный мир несовместим с движком\n");
+        return NULL;
+    }
+    defaultWorld = PlaceWorld(&bound);
+    return defaultWorld;
+}
+
+/*
+ * @brief Загрузка мира из двоичного файла
+ * Файл отображается в память только для чтения и используется на месте:
+ * проверяются лишь заголовок и границы таблиц, поэтому время загрузки
+ * не зависит от размера мира.
+ *
+ * Отображение общее с файлом: файл нельзя переписывать на месте, пока
+ * мир загружен (world-compiler заменяет файл целиком, см. rename).
+ *
+ * @param path Путь к файлу, собранному world-compiler
+ * @return Мир (освобождать через UnloadWorld) или NULL при ошибке
+ */
+World* LoadWorldFile(const char *path) {
+    return LoadFromFile(path, 0, false);
+}
+
+/*
+ * @brief Загрузка мира с чтением текстов по требованию
+ * Отображается только индекс - таблицы до пула строк; тексты локаций
+ * читаются при первом обращении в общий кэш (см. world-pager.h),
+ * поэтому память растёт с числом посещённых локаций, а не с размером мира.
+ *
+ * @param cacheBytes Предел памяти под тексты локаций
+ * @return Мир (освобождать через UnloadWorld) или NULL при ошибке
+ */
+World* LoadWorldFilePaged(const char *path, size_t cacheBytes) {
+    return LoadFromFile(path, cacheBytes, false);
+}
+
+/*
+ * @brief Загрузка мира в собственную память
+ * Образ (при cacheBytes > 0 - только индекс) читается в кучу, а не
+ * отображается: изменение или усечение файла загруженный мир не
+ * затрагивает. Для процесса, который перечитывает файл на ходу
+ * (см. world-host.h). Тексты страничного мира по-прежнему читаются
+ * из открытого файла, поэтому его заменяют только целиком.
+ *
+ * @param cacheBytes 0 - образ целиком, иначе как LoadWorldFilePaged
+ * @return Мир (освобождать через UnloadWorld) или NULL при ошибке
+ */
+World* LoadWorldFileCopy(const char *path, size_t cacheBytes) {
+    return LoadFromFile(path, cacheBytes, true);
+}
+
+/*
+ * @brief Мир поверх готового образа в куче
+ * При успехе мир становится владельцем образа (освобождается через free).
+ *
+ * @return Мир или NULL, если образ некорректен (образ тогда не освобождается)
+ */
+World* LoadWorldImage(void *image, size_t size) {
+    World bound;
+    if (!BindWorldImage(&bound, image, size, size)) {
+        return NULL;
+    }
+    return PlaceWorld(&bound);
+}
+
+/*
+ * @brief Выгрузка мира, загруженного LoadWorldFile/LoadWorldImage
+ * Все сессии этого мира должны быть уничтожены заранее.
+ */
+void UnloadWorld(World *world) {
+    if (world == NULL || world == defaultWorld) {
+        return;
+    }
+    DestroyWorldPager(world->pager);
+    if (world->mapped) {
+        UnmapWorldFile(world->image, world->imageSize);
+    } else {
+        free(world->image);
+    }
+    FreeBlockPool(world->sessions);
+    // Дескриптор лежит в самой арене: освобождаем по копии
+    Arena arena = world->arena;
+    FreeArena(&arena);
+}
+
+/*
+ * @brief Строка из пула по смещению
+ * У страничного мира без страницы локации доступны только тексты
+ * предметов; тексты локаций - через AcquireLocationPage и PageString.
+ *
+ * @return Строка или "" для смещения за пределами пула
+ */
+const char* WorldString(const World *world, uint32_t offset) {
+    if (world->strings == NULL) {
+        return PageString(world, NULL, offset);
+    }
+    if (offset >= world->header->stringsSize) {
+        return "";
+    }
+    return world->strings + offset;
+}
+
+const Location* GetWorldLocation(const World *world, int locationId) {
+    if (locationId < 0 || locationId >= world->locationCount) {
+        return NULL;
+    }
+    return &world->locations[locationId];
+}
+
+/*
+ * @brief Действие локации по порядковому номеру
+ * @return Действие или NULL для неверного номера
+ */
+const Action* GetLocationAction(const World *world, const Location *loc, int actionIndex) {
+    int id = GetLocationActionId(world, loc, actionIndex);
+    return id < 0 ? NULL : &world->actions[id];
+}
+
+/*
+ * @brief Глобальный индекс действия (номер бита в масках доступности)
+ * @return Индекс или -1 для неверного номера
+ */
+int GetLocationActionId(const World *world, const Location *loc, int actionIndex) {
+    if (actionIndex < 0 || (uint32_t)actionIndex >= loc->actionCount) {
+        return -1;
+    }
+    uint32_t id = loc->firstAction + (uint32_t)actionIndex;
+    return id < (uint32_t)world->actionCount ? (int)id : -1;
+}
+
+/*
+ * @brief Индекс предмета, лежащего в локации
+ * @return Индекс предмета мира или NO_ITEM
+ */
+int GetLocationItemId(const World *world, const Location *loc, int index) {
+    if (index < 0 || (uint32_t)index >= loc->itemCount) {
+        return NO_ITEM;
+    }
+    uint32_t slot = loc->firstItem + (uint32_t)index;
+    if (slot >= world->header->locationItemCount) {
+        return NO_ITEM;
+    }
+    uint32_t item = world->locationItems[slot];
+    return item < (uint32_t)world->itemCount ? (int)item : NO_ITEM;
+}
+
+/*
+ * @brief Получить предмет мира по индексу
+ * @return Указатель на предмет или NULL для неверного индекса
+ */
+const Item* GetWorldItem(const World *world, int itemId) {
+    if (itemId < 0 || itemId >= world->itemCount) {
+        return NULL;
+    }
+    return &world->items[itemId];
+}
+
+/*
+ * @brief Поиск предмета по имени
+ * Линейный поиск для фронтендов и утилит; на пути хода не используется,
+ * там предметы адресуются только индексами.
+ *
+ * @return Индекс предмета или NO_ITEM
+ */
+int FindWorldItem(const World *world, const char *name) {
+    for (int i = 0; i < world->itemCount; i++) {
+        if (strcmp(WorldString(world, world->items[i].name), name) == 0) {
+            return i;
+        }
+    }
+    return NO_ITEM;
+}
+
+/* [[ Ключи записей ]] */
+
+/*
+ * @brief Стабильный ключ записи (см. WorldKeyKind)
+ * @return Ключ или 0 для неверного индекса
+ */
+uint32_t GetWorldKey(const World *world, WorldKeyKind kind, int index) {
+    if (index < 0 || (uint32_t)index >= world->keyBase[kind + 1] - world->keyBase[kind]) {
+        return 0;
+    }
+    return world->keys[world->keyBase[kind] + (uint32_t)index];
+}
+
+/*
+ * @brief Запись по ключу
+ * Двоичный поиск по индексу ключей, O(log n).
+ *
+ * @return Индекс записи или -1, если ключа нет или индекс не построен
+ */
+int FindWorldKey(const World *world, WorldKeyKind kind, uint32_t key) {
+    if (world->keyIndex == NULL) {
+        return -1;
+    }
+    const WorldKeyEntry *entries = world->keyIndex + world->keyBase[kind];
+    size_t low = 0;
+    size_t high = world->keyBase[kind + 1] - world->keyBase[kind];
+    while (low < high) {
+        size_t middle = low + (high - low) / 2;
+        if (entries[middle].key < key) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    bool found = low < world->keyBase[kind + 1] - world->keyBase[kind] && entries[low].key == key;
+    return found ? (int)entries[low].index : -1;
+}
+
+/*
+ * @brief Построить индекс ключей для FindWorldKey
+ * Нужен только для переноса сессий между версиями мира, поэтому при
+ * загрузке не строится. Память - из арены мира: вызывать до того, как
+ * мир стал доступен другим потокам.
+ *
+ * @return false если не хватило памяти
+ */
+bool IndexWorldKeys(World *world) {
+    if (world->keyIndex != NULL) {
+        return true;
+    }
+    // Арену мира делит пул сессий (см. World.arena)
+    uint32_t count = world->keyBase[WORLD_KEY_KINDS];
+    mtx_lock(&world->sessions->lock);
+    WorldKeyEntry *entries = ArenaAlloc(&world->arena, (count > 0 ? count : 1) * sizeof(WorldKeyEntry));
+    mtx_unlock(&world->sessions->lock);
+    if (entries == NULL) {
+        return false;
+    }
+    for (int kind = 0; kind < WORLD_KEY_KINDS; kind++) {
+        uint32_t first = world->keyBase[kind];
+        for (uint32_t i = first; i < world->keyBase[kind + 1]; i++) {
+            entries[i] = (WorldKeyEntry){world->keys[i], i - first};
+        }
+        qsort(entries + first, world->keyBase[kind + 1] - first, sizeof(WorldKeyEntry), CompareKeyEntries);
+    }
+    world->keyIndex = entries;
+    return true;
+}
+
+/* [[ Внутренние функции загрузки ]] */
+
+/*
+ * Привязка дескриптора к образу. Проверки O(1): заголовок, версия,
+ * границы таблиц и завершающий ноль пула строк. Индексы внутри записей
+ * проверяются при обращении (см. Get*), так что битый файл не приведёт
+ * к чтению за пределами образа.
+ *
+ * size - сколько образа в памяти, fileSize - полный размер. Если они
+ * различаются, в памяти только индекс: все таблицы, кроме пула строк.
+ */
+static bool BindWorldImage(World *world, void *image, size_t size, size_t fileSize) {
+    const WorldFileHeader *header = image;
+
+    if (size < sizeof(WorldFileHeader) || header->magic != WORLD_FILE_MAGIC ||
+        header->version != WORLD_FILE_VERSION || header->headerSize != sizeof(WorldFileHeader) ||
+        header->fileSize != fileSize || size > fileSize) {
+        return false;
+    }
+    if (!TableFits(header, header->locationsOffset, header->locationCount, sizeof(Location)) ||
+        !TableFits(header, header->actionsOffset, header->actionCount, sizeof(Action)) ||
+        !TableFits(header, header->itemsOffset, header->itemCount, sizeof(Item)) ||
+        !TableFits(header, header->locationItemsOffset, header->locationItemCount, sizeof(uint32_t)) ||
+        !TableFits(header, header->availableOffset, (uint32_t)BITSET_WORDS(header->actionCount), sizeof(uint64_t)) ||
+        !TableFits(header, header->codeOffset, header->codeCount, sizeof(uint32_t)) ||
+        !TableFits(header, header->keysOffset, header->keyCount, sizeof(uint32_t)) ||
+        !TableFits(header, header->stringsOffset, header->stringsSize, 1)) {
+        return false;
+    }
+    if (header->locationCount == 0 || header->startLocation >= header->locationCount || header->stringsSize == 0 ||
+        header->winItem < NO_ITEM || header->winItem >= (int32_t)header->itemCount ||
+        header->flagCount >= SCRIPT_OPERAND_LIMIT || header->counterCount >= SCRIPT_OPERAND_LIMIT ||
+        (uint64_t)header->keyCount != (uint64_t)header->locationCount + header->itemCount + header->actionCount +
+                                          header->flagCount + header->counterCount) {
+        return false;
+    }
+
+    bool indexOnly = size < fileSize;
+    if (indexOnly && (header->stringsOffset != size ||
+                      header->locationsOffset + (uint64_t)header->locationCount * sizeof(Location) > size ||
+                      header->actionsOffset + (uint64_t)header->actionCount * sizeof(Action) > size ||
+                      header->itemsOffset + (uint64_t)header->itemCount * sizeof(Item) > size ||
+                      header->locationItemsOffset + (uint64_t)header->locationItemCount * sizeof(uint32_t) > size ||
+                      header->availableOffset + BITSET_WORDS(header->actionCount) * sizeof(uint64_t) > size ||
+                      header->codeOffset + (uint64_t)header->codeCount * sizeof(uint32_t) > size ||
+                      header->keysOffset + (uint64_t)header->keyCount * sizeof(uint32_t) > size)) {
+        return false;
+    }
+
+    const char *base = image;
+    if (!indexOnly && base[header->stringsOffset + header->stringsSize - 1] != '\0') {
+        return false;
+    }
+
+    memset(world, 0, sizeof *world);
+    world->header = header;
+    world->locations = (const Location *)(base + header->locationsOffset);
+    world->actions = (const Action *)(base + header->actionsOffset);
+    world->items = (const Item *)(base + header->itemsOffset);
+    world->locationItems = (const uint32_t *)(base + header->locationItemsOffset);
+    world->strings = indexOnly ? NULL : base + header->stringsOffset;
+    world->locationCount = (int)header->locationCount;
+    world->actionCount = (int)header->actionCount;
+    world->itemCount = (int)header->itemCount;
+    world->startLocation = (int)header->startLocation;
+    world->winItem = header->winItem;
+    world->initialAvailable = (const uint64_t *)(base + header->availableOffset);
+    world->code = (const uint32_t *)(base + header->codeOffset);
+    world->codeCount = header->codeCount;
+    world->flagCount = (int)header->flagCount;
+    world->counterCount = (int)header->counterCount;
+    world->keys = (const uint32_t *)(base + header->keysOffset);
+    uint32_t kindCounts[WORLD_KEY_KINDS] = {
+        header->locationCount, header->itemCount, header->actionCount, header->flagCount, header->counterCount,
+    };
+    for (int kind = 0; kind < WORLD_KEY_KINDS; kind++) {
+        world->keyBase[kind + 1] = world->keyBase[kind] + kindCounts[kind];
+    }
+    if (!BindLexicon(&world->lexicon, header, base, size)) {
+        return false;
+    }
+
+    // Множества состояния партии подряд: действия, локации, предметы x2,
+    // флаги; за ними счётчики
+    world->availableWord = 0;
+    world->visitedWord = world->availableWord + (uint32_t)BITSET_WORDS(header->actionCount);
+    world->collectedWord = world->visitedWord + (uint32_t)BITSET_WORDS(header->locationCount);
+    world->inventoryWord = world->collectedWord + (uint32_t)BITSET_WORDS(header->itemCount);
+    world->flagWord = world->inventoryWord + (uint32_t)BITSET_WORDS(header->itemCount);
+    world->counterWord = world->flagWord + (uint32_t)BITSET_WORDS(header->flagCount);
+    world->stateWords = world->counterWord + header->counterCount;
+    world->image = image;
+    world->imageSize = size;
+    world->mapped = false;
+    return true;
+}
+
+/*
+ * Дескриптор из привязанного образа - в новую арену мира, вместе с
+ * пустым пулом сессий. Образ при ошибке остаётся у вызывающего.
+ */
+static World* PlaceWorld(const World *bound) {
+    Arena arena;
+    InitArena(&arena, 0);
+    World *world = ArenaAlloc(&arena, sizeof(World));
+    BlockPool *sessions = ArenaAlloc(&arena, sizeof(BlockPool));
+    if (world == NULL || sessions == NULL) {
+        FreeArena(&arena);
+        return NULL;
+    }
+    *world = *bound;
+    world->arena = arena;
+    world->sessions = sessions;
+    if (!InitBlockPool(sessions, &world->arena)) {
+        arena = world->arena;
+        FreeArena(&arena);
+        return NULL;
+    }
+    return world;
+}
+
+/*
+ * Словарь необязателен (lexiconOffset == 0) и целиком лежит в индексе.
+ * Проверяются только размеры таблиц; ссылки узлов, рёбер и срезы термов
+ * проверяют LookupLexicon и ParseTextCommand при обращении.
+ */
+static bool BindLexicon(Lexicon *lexicon, const WorldFileHeader *header, const char *base, size_t size) {
+    memset(lexicon, 0, sizeof *lexicon);
+    if (header->lexiconOffset == 0) {
+        return true;
+    }
+    if (!TableFits(header, header->lexiconOffset, header->lexiconSize / 8, sizeof(uint64_t)) ||
+        header->lexiconSize < sizeof(LexiconHeader) ||
+        (uint64_t)header->lexiconOffset + header->lexiconSize > size) {
+        return false;
+    }
+
+    const char *table = base + header->lexiconOffset;
+    const LexiconHeader *lexiconHeader = (const LexiconHeader *)table;
+    uint64_t nodesOffset = sizeof(LexiconHeader);
+    uint64_t edgesOffset = nodesOffset + (uint64_t)lexiconHeader->nodeCount * sizeof(LexiconNode);
+    uint64_t actionsOffset = edgesOffset + (uint64_t)lexiconHeader->edgeCount * sizeof(LexiconEdge);
+    uint64_t termsOffset = actionsOffset + (uint64_t)header->actionCount * sizeof(ActionTerms);
+    if (lexiconHeader->nodeCount == 0 ||
+        termsOffset + (uint64_t)lexiconHeader->termCount * sizeof(uint32_t) > header->lexiconSize) {
+        return false;
+    }
+
+    lexicon->nodes = (const LexiconNode *)(table + nodesOffset);
+    lexicon->edges = (const LexiconEdge *)(table + edgesOffset);
+    lexicon->actionTerms = (const ActionTerms *)(table + actionsOffset);
+    lexicon->terms = (const uint32_t *)(table + termsOffset);
+    lexicon->nodeCount = lexiconHeader->nodeCount;
+    lexicon->edgeCount = lexiconHeader->edgeCount;
+    lexicon->termCount = lexiconHeader->termCount;
+    return true;
+}
+
+static bool TableFits(const WorldFileHeader *header, uint32_t offset, uint32_t count, size_t elemSize) {
+    if (offset % 8 != 0 && elemSize > 1) {
+        return false;
+    }
+    return offset >= sizeof(WorldFileHeader) && offset <= header->fileSize &&
+           (uint64_t)count * elemSize <= header->fileSize - offset;
+}
+
+/*
+ * Общая часть загрузки из файла. Страничному миру (cacheBytes > 0)
+ * нужен только индекс до пула строк; его граница читается из заголовка
+ * до загрузки образа.
+ */
+static World* LoadFromFile(const char *path, size_t cacheBytes, bool copy) {
+    size_t limit = SIZE_MAX;
+    if (cacheBytes > 0) {
+        WorldFileHeader header;
+        FILE *file = fopen(path, "rb");
+        bool headerRead = file != NULL && fread(&header, sizeof header, 1, file) == 1;
+        if (file != NULL) {
+            fclose(file);
+        }
+        if (!headerRead || header.magic != WORLD_FILE_MAGIC || header.stringsOffset < sizeof(WorldFileHeader)) {
+            fprintf(stderr, "Не удалось открыть мир: %s\n", path);
+            return NULL;
+        }
+        limit = header.stringsOffset;
+    }
+
+    size_t size = 0;
+    void *image = copy ? ReadWorldFile(path, &size, limit) : MapWorldFile(path, &size, limit);
+    if (image == NULL) {
+        fprintf(stderr, "Не удалось открыть мир: %s\n", path);
+        return NULL;
+    }
+    size_t loadedSize = size < limit ? size : limit;
+
+    World bound;
+    World *world = NULL;
+    if (BindWorldImage(&bound, image, loadedSize, size)) {
+        bound.mapped = !copy;
+        world = PlaceWorld(&bound);
+    } else {
+        fprintf(stderr, "Файл мира повреждён или несовместим: %s\n", path);
+    }
+    if (world == NULL) {
+        if (copy) {
+            free(image);
+        } else {
+            UnmapWorldFile(image, loadedSize);
+        }
+        return NULL;
+    }
+    if (cacheBytes > 0) {
+        world->pager = CreateWorldPager(world, path, cacheBytes);
+        if (world->pager == NULL) {
+            fprintf(stderr, "Файл мира повреждён или несовместим: %s\n", path);
+            UnloadWorld(world);
+            return NULL;
+        }
+    }
+    return world;
+}
+
+static int CompareKeyEntries(const void *a, const void *b) {
+    uint32_t x = ((const WorldKeyEntry *)a)->key;
+    uint32_t y = ((const WorldKeyEntry *)b)->key;
+    return (x > y) - (x < y);
+}
+
+/* Отображение не больше limit байт начала файла; в size - полный размер файла */
+static void* MapWorldFile(const char *path, size_t *size, size_t limit) {
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE) {
+        return NULL;
+    }
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) {
+        CloseHandle(file);
+        return NULL;
+    }
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(file);
+    if (mapping == NULL) {
+        return NULL;
+    }
+    size_t length = (size_t)fileSize.QuadPart < limit ? (size_t)fileSize.QuadPart : limit;
+    void *image = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, length);
+    CloseHandle(mapping);
+    *size = (size_t)fileSize.QuadPart;
+    return image;
+#else
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return NULL;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+        close(fd);
+        return NULL;
+    }
+    size_t length = (size_t)st.st_size < limit ? (size_t)st.st_size : limit;
+    void *image = mmap(NULL, length, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (image == MAP_FAILED) {
+        return NULL;
+    }
+    *size = (size_t)st.st_size;
+    return image;
+#endif
+}
+
+static void UnmapWorldFile(void *image, size_t size) {
+#ifdef _WIN32
+    (void)size;
+    UnmapViewOfFile(image);
+#else
+    munmap(image, size);
+#endif
+}
+
+/* Копия не больше limit байт начала файла в куче; в size - полный размер файла */
+static void* ReadWorldFile(const char *path, size_t *size, size_t limit) {
+    FILE *file = fopen(path, "rb");
+    if (file == NULL) {
+        return NULL;
+    }
+    long fileSize = fseek(file, 0, SEEK_END) == 0 ? ftell(file) : -1;
+    size_t length = fileSize > 0 && (size_t)fileSize < limit ? (size_t)fileSize : limit;
+    void *image = fileSize > 0 && fseek(file, 0, SEEK_SET) == 0 ? malloc(length) : NULL;
+    if (image != NULL && fread(image, 1, length, file) != length) {
+        free(image);
+        image = NULL;
+    }
+    fclose(file);
+    *size = (size_t)fileSize;
+    return image;
+}
@@ -0,0 +1,284 @@
+#ifndef WORLD_H
+#define WORLD_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "../utils/arena.h"
+
+#define NO_ITEM (-1)
+#define NO_LOCATION (-1)
+
+/*
+ * [[ Двоичный формат мира ]]
+ *
+ * Файл мира - это готовый образ памяти: заголовок, таблицы записей
+ * и пул строк. Записи ссылаются на строки смещениями в пуле, а друг
+ * на друга - индексами, поэтому образ можно отобразить через mmap
+ * и использовать на месте без разбора и копирования. Несколько
+ * процессов, отобразивших один файл, делят одну копию в page cache.
+ *
+ * Граф мира хранится в виде CSR: локация - срез [firstAction,
+ * firstAction + actionCount) таблицы действий и такой же срез таблицы
+ * предметов локаций. Все ссылки - 32-битные индексы, так что число
+ * локаций, действий и предметов и ветвление локации ограничены только
+ * размером файла.
+ *
+ * Все числа - little-endian, все таблицы выровнены на 8 байт.
+ * Смещение 0 в пуле строк всегда указывает на пустую строку.
+ *
+ * Ключи - стабильные номера записей между версиями мира (см. WorldKeyKind):
+ * хеш символа из исходника, у безымянного действия - хеш ключа локации
+ * и порядкового номера действия в ней. По ним сессии переносятся в новую
+ * версию мира при перезагрузке.
+ */
+#define WORLD_FILE_MAGIC 0x444C5257u  // "WRLD"
+#define WORLD_FILE_VERSION 5
+
+/* [[ Флаги действия ]] */
+#define ACTION_FLAG_AVAILABLE 0x01u  // доступно в начале партии
+
+/* [[ Заголовок файла мира ]] */
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t headerSize;
+    uint32_t fileSize;
+    uint32_t startLocation;
+    uint32_t locationCount;
+    uint32_t locationsOffset;
+    uint32_t actionCount;
+    uint32_t actionsOffset;
+    uint32_t itemCount;
+    uint32_t itemsOffset;
+    uint32_t locationItemCount;
+    uint32_t locationItemsOffset;
+    uint32_t stringsSize;
+    uint32_t stringsOffset;
+    int32_t winItem;            // предмет, дающий победу, или NO_ITEM
+    uint32_t availableOffset;   // битовое множество действий, доступных в начале партии
+    uint32_t lexiconOffset;     // словарь команд (LexiconHeader) или 0
+    uint32_t lexiconSize;
+    uint32_t codeOffset;        // байткод сценариев действий (uint32_t)
+    uint32_t codeCount;
+    uint32_t flagCount;         // флаги и счётчики партии для сценариев
+    uint32_t counterCount;
+    uint32_t keysOffset;        // ключи записей (uint32_t), см. WorldKeyKind
+    uint32_t keyCount;          // сумма записей всех видов
+} WorldFileHeader;
+
+/* [[ Виды ключей ]] */
+/* Таблица ключей образа - подряд по видам в этом порядке */
+typedef enum {
+    WORLD_KEY_LOCATION,
+    WORLD_KEY_ITEM,
+    WORLD_KEY_ACTION,
+    WORLD_KEY_FLAG,
+    WORLD_KEY_COUNTER,
+    WORLD_KEY_KINDS
+} WorldKeyKind;
+
+/* [[ Структура предмета ]] */
+typedef struct {
+    uint32_t name;         // смещение в пуле строк
+    uint32_t description;
+} Item;
+
+/* [[ Структура действия ]] */
+typedef struct {
+    uint32_t text;
+    uint32_t resultText;
+    int32_t requiredItem;     // индекс требуемого предмета или NO_ITEM
+    int32_t targetLocation;   // индекс локации или NO_LOCATION
+    int32_t givesItem;        // индекс предмета или NO_ITEM
+    uint32_t flags;           // ACTION_FLAG_*
+    uint32_t condition;       // смещение условия в таблице кода, 0 - нет условия
+    uint32_t effect;          // смещение последствий, 0 - нет
+    uint32_t blockedText;     // текст, если условие не выполнено (0 - общий)
+} Action;
+
+/* [[ Структура локации ]] */
+typedef struct {
+    uint32_t name;
+    uint32_t description;
+    uint32_t firstAction;  // индекс первого действия в таблице действий
+    uint32_t actionCount;
+    uint32_t firstItem;    // индекс первого элемента в таблице предметов локаций
+    uint32_t itemCount;
+} Location;
+
+/* [[ Сценарии действий ]] */
+/*
+ * Условие и последствия действия - байткод в общей таблице кода образа.
+ * Слово кода: операция в младших 8 битах, операнд (индекс предмета,
+ * локации, действия, флага или счётчика) - в старших 24. Операции со
+ * счётчиком берут число (int32) из следующего слова. Программа кончается
+ * SCRIPT_END; code[0] == SCRIPT_END, поэтому смещение 0 - пустая программа.
+ *
+ * Условие - стековая машина над логическими значениями глубиной не больше
+ * SCRIPT_STACK_DEPTH, результат - единственное значение на стеке.
+ * Последствия выполняются по порядку.
+ */
+#define SCRIPT_STACK_DEPTH 64
+#define SCRIPT_OPERAND_LIMIT (1u << 24)
+#define SCRIPT_WORD(op, operand) ((uint32_t)(op) | ((uint32_t)(operand) << 8))
+#define SCRIPT_OP(word) ((word) & 0xFFu)
+#define SCRIPT_OPERAND(word) ((word) >> 8)
+
+typedef enum {
+    SCRIPT_END = 0,
+    // Условия: кладут значение на стек
+    SCRIPT_HAS = 1,           // предмет в инвентаре
+    SCRIPT_VISITED = 2,       // локация посещена
+    SCRIPT_FLAG = 3,          // флаг установлен
+    SCRIPT_COUNTER_EQ = 4,    // счётчик == число
+    SCRIPT_COUNTER_LT = 5,
+    SCRIPT_COUNTER_GT = 6,
+    SCRIPT_NOT = 7,
+    SCRIPT_AND = 8,
+    SCRIPT_OR = 9,
+    // Последствия
+    SCRIPT_SET_FLAG = 16,
+    SCRIPT_CLEAR_FLAG = 17,
+    SCRIPT_ADD_COUNTER = 18,  // счётчик += число
+    SCRIPT_SET_COUNTER = 19,  // счётчик = число
+    SCRIPT_UNLOCK = 20,       // действие становится доступным
+    SCRIPT_LOCK = 21,
+    SCRIPT_GIVE = 22,         // предмет в инвентарь
+    SCRIPT_TAKE = 23          // предмет забирается из инвентаря
+} ScriptOp;
+
+/* [[ Словарь команд ]] */
+/*
+ * Необязательная таблица для свободного ввода (см. command-parser.h).
+ * Слова сводятся к основам (см. lexicon.h), основа - к терму: синонимы
+ * делят один терм. Основы лежат в префиксном дереве по байтам UTF-8,
+ * у каждого действия - срез отсортированных термов его текста, названия
+ * локации, куда оно ведёт, и предмета, который оно даёт.
+ *
+ * Раскладка: LexiconHeader, узлы, рёбра, ActionTerms на каждое действие
+ * мира, затем сами термы (uint32_t). Корень дерева - узел 0.
+ */
+#define LEXICON_NO_TERM UINT32_MAX
+#define LEXICON_TERM_INVENTORY 0   // встроенные команды
+#define LEXICON_TERM_LOOK 1
+#define LEXICON_FIRST_TERM 2       // первый терм слов мира
+
+typedef struct {
+    uint32_t nodeCount;
+    uint32_t edgeCount;
+    uint32_t termCount;        // длина таблицы термов действий
+    uint32_t reserved;
+} LexiconHeader;
+
+typedef struct {
+    uint32_t firstEdge;        // срез рёбер, отсортирован по байту
+    uint32_t edgeCount;
+    uint32_t term;             // терм основы, которая здесь кончается, или LEXICON_NO_TERM
+    uint32_t prefixTerm;       // единственный терм поддерева или LEXICON_NO_TERM
+} LexiconNode;
+
+typedef struct {
+    uint32_t byte;
+    uint32_t node;
+} LexiconEdge;
+
+typedef struct {
+    uint32_t firstTerm;
+    uint32_t termCount;
+} ActionTerms;
+
+/* Словарь внутри образа; nodes == NULL - словаря нет */
+typedef struct {
+    const LexiconNode *nodes;
+    const LexiconEdge *edges;
+    const ActionTerms *actionTerms;
+    const uint32_t *terms;
+    uint32_t nodeCount;
+    uint32_t edgeCount;
+    uint32_t termCount;
+} Lexicon;
+
+typedef struct WorldPager WorldPager;
+typedef struct LocationPage LocationPage;
+
+/* Ключ и индекс записи; в индексе ключей отсортированы по ключу внутри вида */
+typedef struct {
+    uint32_t key;
+    uint32_t index;
+} WorldKeyEntry;
+
+/* [[ Структура мира ]] */
+/*
+ * Дескриптор загруженного мира: указатели прямо внутрь образа.
+ * Неизменяем и разделяется всеми сессиями только для чтения.
+ * Сам дескриптор лежит в арене мира, там же пул блоков сессий:
+ * выгрузка мира освобождает их разом.
+ */
+typedef struct {
+    const WorldFileHeader *header;
+    const Location *locations;
+    const Action *actions;
+    const Item *items;
+    const uint32_t *locationItems;
+    const char *strings;
+    int locationCount;
+    int actionCount;
+    int itemCount;
+    int startLocation;
+    int winItem;         // предмет победы или NO_ITEM
+    const uint64_t *initialAvailable;  // бит на действие, внутри образа
+    const uint32_t *code;              // байткод сценариев (см. ScriptOp)
+    uint32_t codeCount;
+    int flagCount;
+    int counterCount;
+
+    // Раскладка битовых множеств GameState.bits в 64-битных словах
+    uint32_t availableWord;
+    uint32_t visitedWord;
+    uint32_t collectedWord;
+    uint32_t inventoryWord;
+    uint32_t flagWord;
+    uint32_t counterWord;  // по слову на счётчик, значение - int64 в дополнительном коде
+    uint32_t stateWords;
+
+    Lexicon lexicon;
+
+    const uint32_t *keys;                     // внутри образа, подряд по видам
+    uint32_t keyBase[WORLD_KEY_KINDS + 1];    // начало вида в keys, последний - keyCount
+    const WorldKeyEntry *keyIndex;            // NULL до IndexWorldKeys
+
+    void *image;         // владеемый образ (куча или отображение файла)
+    size_t imageSize;
+    bool mapped;
+    WorldPager *pager;   // тексты читаются страницами, strings == NULL (см. world-pager.h)
+
+    Arena arena;         // дескриптор и блоки сессий; после загрузки - только под замком пула
+    BlockPool *sessions; // блоки GameSession (см. CreateGameSession)
+} World;
+
+/* [[ Функции мира ]] */
+const World* LoadDefaultWorld();
+World* LoadWorldFile(const char *path);
+World* LoadWorldFilePaged(const char *path, size_t cacheBytes);
+World* LoadWorldFileCopy(const char *path, size_t cacheBytes);
+World* LoadWorldImage(void *image, size_t size);
+void UnloadWorld(World *world);
+
+const char* WorldString(const World *world, uint32_t offset);
+const Location* GetWorldLocation(const World *world, int locationId);
+const Action* GetLocationAction(const World *world, const Location *loc, int actionIndex);
+int GetLocationActionId(const World *world, const Location *loc, int actionIndex);
+int GetLocationItemId(const World *world, const Location *loc, int index);
+const Item* GetWorldItem(const World *world, int itemId);
+int FindWorldItem(const World *world, const char *name);
+uint32_t GetWorldKey(const World *world, WorldKeyKind kind, int index);
+int FindWorldKey(const World *world, WorldKeyKind kind, uint32_t key);
+bool IndexWorldKeys(World *world);
+
+/* [[ Страницы текстов локаций ]] */
+const LocationPage* AcquireLocationPage(const World *world, int locationId);
+void ReleaseLocationPage(const World *world, const LocationPage *page);
+const char* PageString(const World *world, const LocationPage *page, uint32_t offset);
+
+#endif
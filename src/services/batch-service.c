@@ -0,0 +1,307 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <limits.h>
+#include "batch-service.h"
+#include "../models/game.h"
+#include "../models/command-parser.h"
+#include "../utils/clock.h"
+
+/*
+ * Безголовый режим: команды читаются из файла или stdin целиком и
+ * проигрываются без пауз, очистки экрана и отрисовки. Сценарий можно
+ * повторить много раз (каждый повтор - новая партия) для нагрузочных
+ * прогонов.
+ */
+
+/* [[ Сценарий ]] */
+typedef enum {
+    COMMAND_CHOICE,   // номер действия, 0 - инвентарь
+    COMMAND_UNDO,     // отменить value последних ходов
+    COMMAND_REWIND,   // вернуться к состоянию после хода value
+    COMMAND_TEXT      // свободный ввод, value - смещение строки в text
+} BatchCommandType;
+
+typedef struct {
+    BatchCommandType type;
+    int value;
+} BatchCommand;
+
+typedef struct {
+    BatchCommand *commands;
+    long count;
+    long capacity;
+    char *text;          // строки COMMAND_TEXT подряд, через '\0'
+    size_t textSize;
+    size_t textCapacity;
+} BatchScript;
+
+/* [[ Прототипы внутренних функций ]] */
+static bool LoadScript(const char *path, BatchScript *script);
+static bool AppendCommand(BatchScript *script, BatchCommand command);
+static bool AppendText(BatchScript *script, const char *line, int *offset);
+static bool ParseCommand(const char *line, BatchCommand *command);
+static bool ParseNumber(const char *text, int *value);
+static StepResult RunCommand(GameSession *session, const BatchScript *script, const BatchCommand *command);
+static StepResult RunTextCommand(GameSession *session, const char *line);
+static const char* CommandName(BatchCommandType type);
+
+/*
+ * @brief Безголовый прогон сценария
+ * Формат сценария: одна команда на строку - номер действия (0 - инвентарь),
+ * "undo [N]" (отменить N ходов, по умолчанию 1), "rewind K" (вернуться
+ * к ходу K) или свободный ввод вроде "взять ключ": его разбирает словарь
+ * мира (ParseTextCommand) в момент хода, как в интерактивной игре.
+ * Пустые строки и строки с # пропускаются; число с хвостом ("3abc") и
+ * ввод, который словарь не понял, - неверный ввод.
+ * Команды после победы в повторе пропускаются.
+ *
+ * @return 0 если каждая партия закончилась победой, 1 если нет, 2 при ошибке
+ */
+int RunBatch(const World *world, const BatchOptions *options) {
+    BatchScript script = {0};
+
+    if (!LoadScript(options->scriptPath, &script)) {
+        fprintf(stderr, "Не удалось прочитать сценарий: %s\n", options->scriptPath);
+        free(script.commands);
+        free(script.text);
+        return 2;
+    }
+
+    GameSession *session = CreateGameSession(world);
+    if (session == NULL) {
+        fprintf(stderr, "Не удалось создать игровую сессию.\n");
+        free(script.commands);
+        free(script.text);
+        return 2;
+    }
+    SetSessionJournal(session, options->journal);
+
+    long repeat = options->repeat > 0 ? options->repeat : 1;
+    uint64_t turns = 0;
+    uint64_t invalid = 0;
+    uint64_t wins = 0;
+    bool transcript = options->output == BATCH_OUTPUT_TRANSCRIPT;
+
+    uint64_t started = NowNanoseconds();
+    for (long game = 0; game < repeat; game++) {
+        InitGameModel(session);
+
+        for (long i = 0; i < script.count; i++) {
+            const BatchCommand *command = &script.commands[i];
+            StepResult result = RunCommand(session, &script, command);
+            if (result == STEP_FINISHED) {
+                break;
+            }
+            turns++;
+            if (result == STEP_INVALID || result == STEP_BLOCKED) {
+                invalid++;
+            }
+            if (transcript) {
+                const World *w = GetSessionWorld(session);
+                const Location *loc = GetCurrentLocation(session);
+                const LocationPage *page = AcquireLocationPage(w, GetCurrentLocationId(session));
+                if (command->type == COMMAND_TEXT) {
+                    printf("%ld:%ld %s %s %s\n", game + 1, i + 1, script.text + command->value,
+                           StepResultName(result), PageString(w, page, loc->name));
+                } else {
+                    printf("%ld:%ld %s%d %s %s\n", game + 1, i + 1, CommandName(command->type),
+                           command->value, StepResultName(result), PageString(w, page, loc->name));
+                }
+                ReleaseLocationPage(w, page);
+            }
+        }
+        if (IsGameWon(session)) {
+            wins++;
+        }
+    }
+    uint64_t elapsed = NowNanoseconds() - started;
+
+    if (options->output != BATCH_OUTPUT_NONE) {
+        double seconds = (double)elapsed / 1e9;
+        printf("games: %ld\n", repeat);
+        printf("wins: %llu\n", (unsigned long long)wins);
+        printf("turns: %llu\n", (unsigned long long)turns);
+        printf("rejected: %llu\n", (unsigned long long)invalid);
+        printf("elapsed: %.6f s\n", seconds);
+        printf("turns/sec: %.0f\n", seconds > 0 ? (double)turns / seconds : 0.0);
+    }
+
+    DestroyGameSession(session);
+    free(script.commands);
+    free(script.text);
+    return wins == (uint64_t)repeat ? 0 : 1;
+}
+
+/* [[ Внутренние функции ]] */
+
+static bool LoadScript(const char *path, BatchScript *script) {
+    bool fromStdin = strcmp(path, "-") == 0;
+    FILE *file = fromStdin ? stdin : fopen(path, "r");
+    if (file == NULL) {
+        return false;
+    }
+
+    char buf[256];
+    bool ok = true;
+    while (ok && fgets(buf, sizeof buf, file) != NULL) {
+        char *line = buf;
+        while (*line == ' ' || *line == '\t') {
+            line++;
+        }
+        size_t length = strlen(line);
+        while (length > 0 && strchr(" \t\r\n", line[length - 1]) != NULL) {
+            line[--length] = '\0';
+        }
+        if (*line == '\0' || *line == '#') {
+            continue;
+        }
+        BatchCommand command;
+        if (!ParseCommand(line, &command)) {
+            command = (BatchCommand){COMMAND_CHOICE, -1};  // как неверный ввод в интерактивной игре
+        } else if (command.type == COMMAND_TEXT && !AppendText(script, line, &command.value)) {
+            ok = false;
+            break;
+        }
+        ok = AppendCommand(script, command);
+    }
+    ok = ok && !ferror(file);
+
+    if (!fromStdin) {
+        fclose(file);
+    }
+    return ok;
+}
+
+/*
+ * @brief Разбор строки сценария без пробелов по краям
+ * Строка, начинающаяся с цифры или знака, должна быть числом целиком;
+ * прочее, кроме undo и rewind, - свободный ввод (COMMAND_TEXT, строку
+ * сохраняет вызывающий).
+ *
+ * @return false - неверная команда
+ */
+static bool ParseCommand(const char *line, BatchCommand *command) {
+    if (strncmp(line, "undo", 4) == 0 && (line[4] == '\0' || line[4] == ' ' || line[4] == '\t')) {
+        *command = (BatchCommand){COMMAND_UNDO, 1};
+        return line[4] == '\0' || ParseNumber(line + 4, &command->value);
+    }
+    if (strncmp(line, "rewind", 6) == 0 && (line[6] == ' ' || line[6] == '\t')) {
+        *command = (BatchCommand){COMMAND_REWIND, 0};
+        return ParseNumber(line + 6, &command->value);
+    }
+    if (*line != '\0' && strchr("0123456789+-", *line) != NULL) {
+        *command = (BatchCommand){COMMAND_CHOICE, 0};
+        return ParseNumber(line, &command->value);
+    }
+    *command = (BatchCommand){COMMAND_TEXT, 0};
+    return true;
+}
+
+/* Число целиком, пробелы впереди допустимы */
+static bool ParseNumber(const char *text, int *value) {
+    char *end;
+    errno = 0;
+    long parsed = strtol(text, &end, 10);
+    if (end == text || *end != '\0' || errno != 0 || parsed < INT_MIN || parsed > INT_MAX) {
+        return false;
+    }
+    *value = (int)parsed;
+    return true;
+}
+
+/*
+ * @brief Выполнить команду сценария
+ * Откат, выходящий за окно истории, считается отказом (STEP_BLOCKED).
+ */
+static StepResult RunCommand(GameSession *session, const BatchScript *script, const BatchCommand *command) {
+    switch (command->type) {
+        case COMMAND_UNDO:
+            return UndoTurns(session, command->value) ? STEP_OK : STEP_BLOCKED;
+        case COMMAND_REWIND:
+            return RewindToTurn(session, command->value) ? STEP_OK : STEP_BLOCKED;
+        case COMMAND_TEXT:
+            return RunTextCommand(session, script->text + command->value);
+        case COMMAND_CHOICE:
+            break;
+    }
+    return StepGameSession(session, command->value);
+}
+
+/*
+ * Свободный ввод разбирается на каждом ходу: одна и та же строка в
+ * разных локациях значит разные действия. Найденное действие
+ * выполняется как ввод его номера (см. RunTextCommand в game.c);
+ * непонятый ввод - неверный ход, в журнал он не попадает.
+ */
+static StepResult RunTextCommand(GameSession *session, const char *line) {
+    TextCommand command;
+    ParseTextCommand(session, line, &command);
+
+    switch (command.kind) {
+        case TEXT_ACTION:
+            return StepGameSession(session, command.choice);
+        case TEXT_INVENTORY:
+            return StepGameSession(session, 0);
+        case TEXT_LOOK:
+            return IsGameOver(session) || IsGameWon(session) ? STEP_FINISHED : STEP_OK;
+        case TEXT_UNKNOWN_WORD:
+        case TEXT_NO_MATCH:
+        case TEXT_AMBIGUOUS:
+        case TEXT_EMPTY:
+        case TEXT_NO_LEXICON:
+            break;
+    }
+    return IsGameOver(session) || IsGameWon(session) ? STEP_FINISHED : STEP_INVALID;
+}
+
+static const char* CommandName(BatchCommandType type) {
+    switch (type) {
+        case COMMAND_UNDO:   return "undo ";
+        case COMMAND_REWIND: return "rewind ";
+        case COMMAND_CHOICE:
+        case COMMAND_TEXT:   break;
+    }
+    return "";
+}
+
+static bool AppendCommand(BatchScript *script, BatchCommand command) {
+    if (script->count == script->capacity) {
+        long capacity = script->capacity > 0 ? script->capacity * 2 : 64;
+        BatchCommand *grown = realloc(script->commands, (size_t)capacity * sizeof(BatchCommand));
+        if (grown == NULL) {
+            return false;
+        }
+        script->commands = grown;
+        script->capacity = capacity;
+    }
+    script->commands[script->count++] = command;
+    return true;
+}
+
+/* Строка свободного ввода в пул сценария; offset - её смещение */
+static bool AppendText(BatchScript *script, const char *line, int *offset) {
+    size_t length = strlen(line) + 1;
+    if (script->textSize + length > INT_MAX) {
+        return false;
+    }
+    if (script->textSize + length > script->textCapacity) {
+        size_t capacity = script->textCapacity > 0 ? script->textCapacity * 2 : 1024;
+        while (capacity < script->textSize + length) {
+            capacity *= 2;
+        }
+        char *grown = realloc(script->text, capacity);
+        if (grown == NULL) {
+            return false;
+        }
+        script->text = grown;
+        script->textCapacity = capacity;
+    }
+    memcpy(script->text + script->textSize, line, length);
+    *offset = (int)script->textSize;
+    script->textSize += length;
+    return true;
+}
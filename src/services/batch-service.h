@@ -0,0 +1,25 @@
+#ifndef BATCH_SERVICE_H
+#define BATCH_SERVICE_H
+
+#include "../models/world.h"
+#include "../models/journal.h"
+
+/* [[ Режим вывода безголового прогона ]] */
+typedef enum {
+    BATCH_OUTPUT_NONE,        // ничего, только код возврата
+    BATCH_OUTPUT_TRANSCRIPT,  // строка на каждый ход + итог
+    BATCH_OUTPUT_SUMMARY      // только итог
+} BatchOutput;
+
+/* [[ Параметры безголового прогона ]] */
+typedef struct {
+    const char *scriptPath;   // файл команд, "-" - stdin
+    BatchOutput output;
+    long repeat;              // сколько раз проиграть сценарий
+    Journal *journal;         // журнал действий или NULL
+} BatchOptions;
+
+/* [[ Batch Functions ]] */
+int RunBatch(const World *world, const BatchOptions *options);
+
+#endif
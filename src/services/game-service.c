@@ -1,8 +1,12 @@
 #include <stdio.h>
 #include <stdbool.h>
 #include <stdlib.h>
+#include <string.h>
 #include "../utils/console.h"
 #include "../models/game.h"
+#include "../utils/frame.h"
+#include "../utils/layout.h"
+#include "../utils/metrics.h"
 
 bool isGame = false;
 
@@ -10,21 +14,26 @@ bool isGame = false;
  * @brief Показ вступительного текста
  */
 void ShowIntro() {
-    _clearConsole();
-    printf("\n=======================================================\n");
-    printf("|                                                   |\n");
-    printf("|        TAJNA STAROGO MANUSKRIPTA                 |\n");
-    printf("|                                                   |\n");
-    printf("=======================================================\n\n");
-
-    printf("Вы - начинающий повар, ищущий легендарный рецепт\n");
-    printf("древнего блюда, который был утерян много лет назад.\n\n");
-    printf("Слухи гласят, что рецепт хранится в заброшенном особняке\n");
-    printf("известного кулинара. Вы решили рискнуть и отправиться\n");
-    printf("на поиски этого сокровища...\n\n");
-
-    printf("Ваша цель: найти все необходимые предметы и разгадать\n");
-    printf("тайну древнего рецепта!\n\n");
+    FrameBuffer frame;
+    FrameInit(&frame);
+    FrameClearScreen(&frame);
+    FrameAppend(&frame, "\n=======================================================\n");
+    FrameAppend(&frame, "|                                                   |\n");
+    FrameAppend(&frame, "|        TAJNA STAROGO MANUSKRIPTA                 |\n");
+    FrameAppend(&frame, "|                                                   |\n");
+    FrameAppend(&frame, "=======================================================\n\n");
+
+    FrameAppend(&frame, "Вы - начинающий повар, ищущий легендарный рецепт\n");
+    FrameAppend(&frame, "древнего блюда, который был утерян много лет назад.\n\n");
+    FrameAppend(&frame, "Слухи гласят, что рецепт хранится в заброшенном особняке\n");
+    FrameAppend(&frame, "известного кулинара. Вы решили рискнуть и отправиться\n");
+    FrameAppend(&frame, "на поиски этого сокровища...\n\n");
+
+    FrameAppend(&frame, "Ваша цель: найти все необходимые предметы и разгадать\n");
+    FrameAppend(&frame, "тайну древнего рецепта!\n\n");
+
+    FrameFlush(&frame);
+    FrameFree(&frame);
 
     WaitForEnter();
 }
@@ -37,76 +46,54 @@ int ShowMainMenu() {
     return CreateMenu(options);
 }
 
-/*
- * @brief Отображение экрана победы
- */
-void ShowWinScreen() {
-    _clearConsole();
-    printf("\n=======================================================\n");
-    printf("|                                                   |\n");
-    printf("|          POZDRAVLYAEM! VY POBEDILI!              |\n");
-    printf("|                                                   |\n");
-    printf("=======================================================\n\n");
-
-    printf("Вы нашли древний манускрипт с секретным рецептом!\n\n");
-    printf("В манускрипте записан рецепт легендарного блюда,\n");
-    printf("которое было утеряно много лет назад.\n\n");
-    printf("Теперь вы сможете воссоздать это произведение\n");
-    printf("кулинарного искусства и прославиться как великий повар!\n\n");
-    printf("Ваше приключение завершено успешно!\n\n");
-    printf("=======================================================\n");
-    printf("|      Spasibo za igru! Do novyh vstrech!            |\n");
-    printf("=======================================================\n\n");
-
-    WaitForEnter();
-}
-
 /*
  * @brief Основной игровой цикл
+ * Терминальный фронтенд пошагового диалога: читает строку, отдаёт её
+ * сессии и выводит ответ одной записью. Паузы и очистка экрана - это
+ * настройки диалога, сам диалог stdin и stdout не трогает.
+ *
+ * @param session Сессия, которую ведёт игрок
  */
-void GameLoop() {
-    int choice;
+void GameLoop(GameSession *session) {
+    FrameBuffer frame;   // переиспользуется между ходами
+    char buf[64];
 
-    while (!IsGameWon() && !IsGameOver()) {
-        DisplayLocation();
+    FrameInit(&frame);
+    SetDialogOptions(session, DIALOG_PAUSES | (IsTerminalOutput() ? DIALOG_CLEAR_SCREEN : 0));
+    SetDialogWidth(session, TerminalWidth());
 
-        // Проверка условий победы
-        if (CheckWinCondition()) {
+    ExpectedInput expect = BeginDialog(session, &frame);
+    FrameFlush(&frame);
+
+    while (expect != INPUT_NONE) {
+        if (fgets(buf, sizeof buf, stdin) == NULL) {
+            // Конец ввода: дальше ждать нечего
+            SetGameOver(session);
             break;
         }
-
-        Location *loc = GetCurrentLocation();
-
-        printf("\n[0] Инвентарь\n");
-        printf("Выберите действие (0-%d): ", loc->actionCount);
-
-        char buf[64];
-        if (fgets(buf, sizeof buf, stdin) != NULL) {
-            if (sscanf(buf, "%d", &choice) == 1) {
-                if (choice == 0) {
-                    DisplayInventory();
-                } else if (choice >= 1 && choice <= loc->actionCount) {
-                    ExecuteAction(choice - 1);
-                } else {
-                    printf("Неверный выбор! Попробуйте снова.\n");
-                    WaitForEnter();
-                }
-            } else {
-                printf("Неверный ввод! Попробуйте снова.\n");
-                WaitForEnter();
-            }
+        if (strchr(buf, '\n') == NULL) {
+            // Хвост слишком длинной строки - не отдельная команда
+            int ch;
+            while ((ch = getchar()) != '\n' && ch != EOF);
+        }
+        if (strncmp(buf, "/stats", 6) == 0) {
+            // Служебная команда: отчёт метрик, ход не делается
+            RenderMetrics(&frame);
+        } else {
+            expect = StepDialog(session, buf, &frame);
         }
+        FrameFlush(&frame);
     }
 
-    if (IsGameWon()) {
-        ShowWinScreen();
-    }
+    FrameFree(&frame);
 }
 
 /*
  * @brief Инициализация игры
+ * @param world Мир для новой партии
+ * @param journal Журнал действий или NULL
  */
-void GameInit() {
+void GameInit(const World *world, Journal *journal) {
     if (isGame) {
         printf("Игра уже инициализирована.\n");
         return;
@@ -116,9 +103,15 @@ void GameInit() {
     int menuChoice = ShowMainMenu();
 
     if (menuChoice == 1) {
+        GameSession *session = CreateGameSession(world);
+        if (session == NULL) {
+            printf("Не удалось создать игровую сессию.\n");
+            return;
+        }
+        SetSessionJournal(session, journal);
         ShowIntro();
-        InitGameModel();
-        GameLoop();
+        GameLoop(session);
+        DestroyGameSession(session);
     } else if (menuChoice == 2) {
         printf("До свидания!\n");
         exit(0);
@@ -2,11 +2,12 @@
 #define GAME_SERVICE_H
 
 #include <stdbool.h>
+#include "../models/game.h"
 
 /* [[ Game Functions ]] */
-void GameInit();
+void GameInit(const World *world, Journal *journal);
 void GameStop();
-void GameLoop();
+void GameLoop(GameSession *session);
 
 #endif
 
@@ -0,0 +1,632 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "server-service.h"
+#include "../models/game.h"
+#include "../models/state-delta.h"
+#include "../models/world-host.h"
+#include "../utils/frame.h"
+#include "../utils/metrics.h"
+
+/*
+ * Сетевой режим: много telnet-подключений в одном потоке на неблокирующем
+ * epoll. У каждого соединения своя сессия, свой буфер строки ввода и свой
+ * буфер вывода. Медленный клиент никого не задерживает: недописанный вывод
+ * ждёт EPOLLOUT, а клиент, который не читает, отключается по лимиту буфера.
+ *
+ * Протокол - строки текста: номер действия, 0 - инвентарь, "u [N]" - отмена
+ * ходов, "q" - выход. Каждый ответ заканчивается приглашением и telnet
+ * IAC GA ("go ahead"), по которому клиент узнаёт конец ответа.
+ *
+ * С --protocol json|binary соединение вместо экранов получает сообщения
+ * изменений состояния (state-delta.h): снимок при подключении, затем
+ * по сообщению на команду. Приветствия и IAC GA нет - границы задают
+ * сами сообщения.
+ *
+ * SIGHUP перечитывает файл мира (--world) в фоне, не останавливая игры:
+ * каждое соединение переходит на новую версию перед своим следующим
+ * ходом, сохраняя партию (см. MoveGameSession).
+ *
+ * С --sessions партия каждого соединения после каждой команды пишется
+ * в хранилище (session-store.h). Соединение при подключении получает
+ * код партии; после обрыва или перезапуска сервера "/resume КОД"
+ * продолжает её с последнего хода. Партия, законченная по "q",
+ * из хранилища удаляется. После SERVER_RESUME_ATTEMPTS неверных кодов
+ * соединение /resume больше не принимает: перебирать секреты незачем.
+ */
+
+#ifdef __linux__
+
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+
+/* [[ Constants ]] */
+#define SERVER_LINE_MAX 256
+#define SERVER_OUTPUT_LIMIT (256 * 1024)   // столько вывода может ждать клиента
+#define SERVER_EVENTS 256
+#define SERVER_TICK_MS 1000    // сигнал мог попасть в другой поток - флаги проверяются и по таймеру
+#define SERVER_RESUME_ATTEMPTS 3
+#define TELNET_IAC 255
+#define TELNET_GA 249
+#define TELNET_SB 250
+#define TELNET_SE 240
+#define TELNET_WILL 251
+
+/* [[ Соединение ]] */
+typedef struct {
+    int fd;
+    GameSession *session;
+    char line[SERVER_LINE_MAX];
+    size_t lineLength;
+    bool lineOverflow;      // строка длиннее буфера, ждём конца строки
+    int telnetState;        // разбор команд telnet, см. ReadClient
+    FrameBuffer output;
+    size_t sent;            // сколько байт output уже отправлено
+    bool writing;           // подписаны на EPOLLOUT
+    bool closing;           // закрыть после отправки вывода
+    bool structured;        // протокол изменений вместо экранов
+    DeltaEncoder delta;     // только при structured
+    int slot;               // слот хранилища партий, -1 - партия не сохраняется
+    bool saved;             // партия уже записана в слот
+    uint8_t resumeFailures; // неверных кодов /resume, см. SERVER_RESUME_ATTEMPTS
+} Client;
+
+/* [[ Состояние сервера ]] */
+typedef struct {
+    WorldHost host;         // версии мира, см. world-host.h
+    EpochReader reader;     // поток цикла событий - читатель мира
+    Journal *journal;       // NULL - без журнала
+    SessionStore *sessions; // NULL - партии не сохраняются
+    ServerProtocol protocol;
+    int epoll;
+    int listener;
+    int clients;
+    int maxClients;
+    uint64_t accepted;
+    uint64_t turns;
+} Server;
+
+static volatile sig_atomic_t stopRequested = 0;
+static volatile sig_atomic_t reloadRequested = 0;
+
+/* [[ Прототипы внутренних функций ]] */
+static void OnSignal(int signal);
+static void OnReloadSignal(int signal);
+static void ReloadWorld(Server *server);
+static int OpenListener(const ServerOptions *options);
+static void RaiseFileLimit();
+static bool SetNonBlocking(int fd);
+static void AcceptClients(Server *server);
+static bool StartClient(Server *server, Client *client);
+static void ReadClient(Server *server, Client *client);
+static void HandleLine(Server *server, Client *client, const char *line);
+static void ResumeClient(Server *server, Client *client, const char *code);
+static void MoveClient(Client *client, const World *world);
+static void EndResponse(Client *client, ExpectedInput expect);
+static bool FlushClient(Server *server, Client *client);
+static void CloseClient(Server *server, Client *client);
+
+/*
+ * @brief Запуск сервера
+ * Цикл работает до SIGINT/SIGTERM.
+ *
+ * @param world Начальная версия мира; её выгружает сервер (см. WorldHost)
+ * @return 0 при штатной остановке, 1 если не удалось открыть порт
+ */
+int RunServer(const World *world, const ServerOptions *options) {
+    Server server = {.journal = options->journal, .sessions = options->sessions, .protocol = options->protocol,
+                     .epoll = -1, .listener = -1,
+                     .maxClients = options->maxClients > 0 ? options->maxClients : 10000};
+
+    if (!InitWorldHost(&server.host, world, options->worldPath, options->worldCache)) {
+        UnloadWorld((World *)world);
+        return 1;
+    }
+    if (!RegisterEpochReader(&server.host.epochs, &server.reader)) {
+        FreeWorldHost(&server.host);
+        return 1;
+    }
+    RaiseFileLimit();
+    signal(SIGPIPE, SIG_IGN);
+    signal(SIGINT, OnSignal);
+    signal(SIGTERM, OnSignal);
+    signal(SIGHUP, OnReloadSignal);
+
+    server.listener = OpenListener(options);
+    if (server.listener < 0) {
+        FreeWorldHost(&server.host);
+        return 1;
+    }
+    server.epoll = epoll_create1(EPOLL_CLOEXEC);
+    struct epoll_event listen = {.events = EPOLLIN, .data.ptr = NULL};
+    if (server.epoll < 0 || epoll_ctl(server.epoll, EPOLL_CTL_ADD, server.listener, &listen) != 0) {
+        perror("epoll");
+        close(server.listener);
+        FreeWorldHost(&server.host);
+        return 1;
+    }
+
+    fprintf(stderr, "Сервер слушает %s:%d\n", options->address != NULL ? options->address : "127.0.0.1",
+            options->port);
+    if (server.sessions != NULL) {
+        SessionStoreStats stats = GetSessionStoreStats(server.sessions);
+        fprintf(stderr, "Сохранённых партий: %u из %u (устаревших %u), открыто за %.1f мс\n", stats.recovered,
+                stats.slots, stats.expired, (double)stats.openNs / 1e6);
+    }
+
+    struct epoll_event events[SERVER_EVENTS];
+    while (!stopRequested) {
+        int ready = epoll_wait(server.epoll, events, SERVER_EVENTS, SERVER_TICK_MS);
+        if (reloadRequested) {
+            reloadRequested = 0;
+            ReloadWorld(&server);
+        }
+        ReclaimWorlds(&server.host);
+        if (ready < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("epoll_wait");
+            break;
+        }
+        for (int i = 0; i < ready; i++) {
+            Client *client = events[i].data.ptr;
+            if (client == NULL) {
+                AcceptClients(&server);
+                continue;
+            }
+            if (events[i].events & (EPOLLHUP | EPOLLERR)) {
+                CloseClient(&server, client);
+                continue;
+            }
+            if ((events[i].events & EPOLLOUT) && !FlushClient(&server, client)) {
+                continue;   // клиент закрыт
+            }
+            if (events[i].events & EPOLLIN) {
+                ReadClient(&server, client);
+            }
+        }
+    }
+
+    // Оставшиеся соединения и их сессии освобождаются вместе с процессом
+    fprintf(stderr, "Сервер остановлен: соединений %llu, ходов %llu\n",
+            (unsigned long long)server.accepted, (unsigned long long)server.turns);
+    close(server.epoll);
+    close(server.listener);
+    UnregisterEpochReader(&server.host.epochs, &server.reader);
+    FreeWorldHost(&server.host);
+    return 0;
+}
+
+/* [[ Внутренние функции ]] */
+
+static void OnSignal(int signal) {
+    (void)signal;
+    stopRequested = 1;
+}
+
+static void OnReloadSignal(int signal) {
+    (void)signal;
+    reloadRequested = 1;
+}
+
+/* Журнал сверяется с одной версией мира, поэтому вместе они не работают */
+static void ReloadWorld(Server *server) {
+    if (server->host.path == NULL) {
+        fprintf(stderr, "Перезагрузка мира: встроенный мир не перечитывается, нужен --world.\n");
+    } else if (server->journal != NULL) {
+        fprintf(stderr, "Перезагрузка мира недоступна с --journal: журнал привязан к версии мира.\n");
+    } else if (server->sessions != NULL) {
+        fprintf(stderr, "Перезагрузка мира недоступна с --sessions: партии сохранены для версии мира.\n");
+    } else if (!RequestWorldReload(&server->host)) {
+        fprintf(stderr, "Перезагрузка мира уже идёт.\n");
+    }
+}
+
+static int OpenListener(const ServerOptions *options) {
+    struct sockaddr_in address = {0};
+    address.sin_family = AF_INET;
+    address.sin_port = htons((uint16_t)options->port);
+    if (inet_pton(AF_INET, options->address != NULL ? options->address : "127.0.0.1", &address.sin_addr) != 1) {
+        fprintf(stderr, "Неверный адрес: %s\n", options->address);
+        return -1;
+    }
+
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        perror("socket");
+        return -1;
+    }
+    int on = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof on);
+    if (bind(fd, (struct sockaddr *)&address, sizeof address) != 0 || listen(fd, SOMAXCONN) != 0) {
+        perror("bind");
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/* Тысячи соединений упираются в лимит дескрипторов, поднимаем его до жёсткого */
+static void RaiseFileLimit() {
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max) {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+}
+
+static bool SetNonBlocking(int fd) {
+    int flags = fcntl(fd, F_GETFL, 0);
+    return flags >= 0 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0;
+}
+
+static void AcceptClients(Server *server) {
+    for (;;) {
+        int fd = accept(server->listener, NULL, NULL);
+        if (fd < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                perror("accept");
+            }
+            return;
+        }
+        if (server->clients >= server->maxClients || !SetNonBlocking(fd)) {
+            close(fd);
+            continue;
+        }
+        int on = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof on);
+
+        const World *world = EnterWorld(&server->host, &server->reader);
+        Client *client = calloc(1, sizeof *client);
+        GameSession *session = client != NULL ? CreateGameSession(world) : NULL;
+        struct epoll_event event = {.events = EPOLLIN, .data.ptr = client};
+        if (session == NULL || epoll_ctl(server->epoll, EPOLL_CTL_ADD, fd, &event) != 0) {
+            DestroyGameSession(session);
+            LeaveWorld(&server->reader);
+            free(client);
+            close(fd);
+            continue;
+        }
+        client->fd = fd;
+        client->session = session;
+        client->slot = -1;
+        FrameInit(&client->output);
+        bool started = StartClient(server, client);
+        LeaveWorld(&server->reader);
+        if (!started) {
+            epoll_ctl(server->epoll, EPOLL_CTL_DEL, fd, NULL);
+            DestroyGameSession(session);
+            free(client);
+            close(fd);
+            continue;
+        }
+        server->clients++;
+        server->accepted++;
+        FlushClient(server, client);
+    }
+}
+
+/*
+ * Приветствие и первый экран или, для протокола изменений, снимок
+ * состояния. С хранилищем партий соединение сразу получает слот и код.
+ */
+static bool StartClient(Server *server, Client *client) {
+    GameSession *session = client->session;
+    SessionCode code;
+    char codeText[SESSION_CODE_LENGTH + 1];
+
+    SetSessionJournal(session, server->journal);
+    if (server->sessions != NULL) {
+        client->slot = NewStoredSession(server->sessions, &code);
+    }
+    if (client->slot >= 0) {
+        FormatSessionCode(&code, codeText);
+    }
+    if (server->protocol != SERVER_PROTOCOL_TEXT) {
+        DeltaFormat format = server->protocol == SERVER_PROTOCOL_JSON ? DELTA_FORMAT_JSON : DELTA_FORMAT_BINARY;
+        if (!InitDeltaEncoder(&client->delta, GetSessionWorld(session), format)) {
+            ReleaseStoredSession(server->sessions, client->slot, false);
+            return false;
+        }
+        client->structured = true;
+        if (client->slot >= 0) {
+            WriteSessionCode(&client->delta, codeText, &client->output);
+        } else if (server->sessions != NULL) {
+            WriteDeltaError(&client->delta, "store_unavailable", &client->output);
+        }
+        WriteStateSnapshot(&client->delta, session, &client->output);
+        return true;
+    }
+
+    SetSessionOutput(session, &client->output);
+    SetDialogOptions(session, DIALOG_RESTART);
+    FrameAppend(&client->output, "Добро пожаловать в особняк!\n"
+                                 "Номер - действие, 0 - инвентарь, u - отменить ход, q - выход.\n");
+    if (client->slot >= 0) {
+        FramePrintf(&client->output, "Код партии: %s - после обрыва продолжить: /resume КОД\n", codeText);
+    } else if (server->sessions != NULL) {
+        FrameAppend(&client->output, "Партия не сохраняется: хранилище заполнено или недоступно.\n");
+    }
+    EndResponse(client, BeginDialog(session, &client->output));
+    return true;
+}
+
+/*
+ * @brief Разбор пришедших байтов на строки
+ * Команды telnet (IAC ...) выбрасываются, \r игнорируется, слишком
+ * длинная строка отбрасывается целиком.
+ */
+static void ReadClient(Server *server, Client *client) {
+    unsigned char buf[4096];
+    ssize_t received = recv(client->fd, buf, sizeof buf, 0);
+
+    if (received == 0 || (received < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+        CloseClient(server, client);
+        return;
+    }
+    for (ssize_t i = 0; i < received && !client->closing; i++) {
+        unsigned char c = buf[i];
+
+        // 0 - текст, 1 - после IAC, 2 - опция WILL/WONT/DO/DONT, 3 - внутри SB
+        switch (client->telnetState) {
+            case 1:
+                client->telnetState = c == TELNET_SB ? 3 : c >= TELNET_WILL && c != TELNET_IAC ? 2 : 0;
+                continue;
+            case 2:
+                client->telnetState = 0;
+                continue;
+            case 3:
+                client->telnetState = c == TELNET_SE ? 0 : 3;
+                continue;
+            default:
+                if (c == TELNET_IAC) {
+                    client->telnetState = 1;
+                    continue;
+                }
+        }
+
+        if (c == '\r') {
+            continue;
+        }
+        if (c != '\n') {
+            if (client->lineLength + 1 < SERVER_LINE_MAX) {
+                client->line[client->lineLength++] = (char)c;
+            } else {
+                client->lineOverflow = true;
+            }
+            continue;
+        }
+
+        client->line[client->lineLength] = '\0';
+        if (client->lineOverflow && client->structured) {
+            WriteDeltaError(&client->delta, "line_too_long", &client->output);
+        } else if (client->lineOverflow) {
+            FrameAppend(&client->output, "Слишком длинная строка.\n");
+            EndResponse(client, GetExpectedInput(client->session));
+        } else {
+            HandleLine(server, client, client->line);
+        }
+        client->lineLength = 0;
+        client->lineOverflow = false;
+    }
+
+    // После "q" в протоколе изменений вывода нет, но соединение надо закрыть
+    if (client->output.size > client->sent || client->closing) {
+        FlushClient(server, client);
+    }
+}
+
+/*
+ * @brief Одна команда игрока
+ * Строку разбирает пошаговый диалог сессии; ответ уходит сразу, без пауз.
+ */
+static void HandleLine(Server *server, Client *client, const char *line) {
+    // Ход целиком на одной версии мира; новая версия - с этого хода
+    const World *world = EnterWorld(&server->host, &server->reader);
+    if (GetSessionWorld(client->session) != world) {
+        MoveClient(client, world);
+    }
+
+    // Служебные команды: отчёт метрик и продолжение сохранённой партии
+    if (strncmp(line, "/resume", 7) == 0 && server->sessions != NULL) {
+        ResumeClient(server, client, line + 7);
+    } else if (strncmp(line, "/stats", 6) == 0 && client->structured) {
+        FrameBuffer report;
+        FrameInit(&report);
+        RenderMetrics(&report);
+        WriteDeltaReport(&client->delta, report.data != NULL ? report.data : "", report.size, &client->output);
+        FrameFree(&report);
+    } else if (strncmp(line, "/stats", 6) == 0) {
+        RenderMetrics(&client->output);
+        EndResponse(client, GetExpectedInput(client->session));
+    } else {
+        if (client->structured) {
+            client->closing = StepProtocol(&client->delta, client->session, line, &client->output) == INPUT_NONE;
+        } else {
+            EndResponse(client, StepDialog(client->session, line, &client->output));
+        }
+        server->turns++;
+        if (client->slot >= 0 && !client->closing) {
+            SaveStoredSession(server->sessions, client->slot, GetSessionState(client->session));
+            client->saved = true;
+        }
+    }
+    LeaveWorld(&server->reader);
+}
+
+/*
+ * @brief /resume КОД: продолжить сохранённую партию в этом соединении
+ * Партия соединения до этого заканчивается, её слот освобождается.
+ * Восстановленная партия начинается с сохранённого хода без истории
+ * отмены и в журнал не пишется: журнал сверяет партии только с начала.
+ * Неверные коды считаются; после SERVER_RESUME_ATTEMPTS команда в этом
+ * соединении отклоняется, не заглядывая в хранилище.
+ */
+static void ResumeClient(Server *server, Client *client, const char *code) {
+    if (client->resumeFailures >= SERVER_RESUME_ATTEMPTS) {
+        if (client->structured) {
+            WriteDeltaError(&client->delta, "resume_locked", &client->output);
+        } else {
+            FrameAppend(&client->output, "Слишком много неверных кодов: /resume в этом соединении больше не принимается.\n");
+            EndResponse(client, GetExpectedInput(client->session));
+        }
+        return;
+    }
+
+    SessionCode value;
+    int slot = -1;
+    const GameState *state = ParseSessionCode(code, &value) ? ResumeStoredSession(server->sessions, &value, &slot) : NULL;
+
+    if (state == NULL || !SetSessionState(client->session, state)) {
+        if (state != NULL) {
+            ReleaseStoredSession(server->sessions, slot, true);
+        }
+        client->resumeFailures++;
+        if (client->structured) {
+            WriteDeltaError(&client->delta, "bad_code", &client->output);
+        } else {
+            FrameAppend(&client->output, "Партия с таким кодом не найдена или уже открыта.\n");
+            EndResponse(client, GetExpectedInput(client->session));
+        }
+        return;
+    }
+    ReleaseStoredSession(server->sessions, client->slot, false);
+    client->slot = slot;
+    client->saved = true;
+    SetSessionJournal(client->session, NULL);
+
+    if (client->structured) {
+        WriteStateSnapshot(&client->delta, client->session, &client->output);
+    } else {
+        FrameAppend(&client->output, "Партия восстановлена.\n");
+        EndResponse(client, BeginDialog(client->session, &client->output));
+    }
+}
+
+/*
+ * @brief Перенести партию соединения в новую версию мира
+ * Клиент протокола изменений получает снимок: номера текстов и действий
+ * могли измениться, справочник (/world) надо запросить заново. При
+ * нехватке памяти партия остаётся на старой версии до следующего хода.
+ */
+static void MoveClient(Client *client, const World *world) {
+    DeltaEncoder delta;
+    if (client->structured && !InitDeltaEncoder(&delta, world, client->delta.format)) {
+        return;
+    }
+    GameSession *moved = MoveGameSession(client->session, world);
+    if (moved == NULL) {
+        if (client->structured) {
+            FreeDeltaEncoder(&delta);
+        }
+        return;
+    }
+    client->session = moved;
+    if (client->structured) {
+        delta.sequence = client->delta.sequence;
+        FreeDeltaEncoder(&client->delta);
+        client->delta = delta;
+        WriteStateSnapshot(&client->delta, moved, &client->output);
+    } else {
+        FrameAppend(&client->output, "Мир обновлён.\n");
+    }
+}
+
+/* Ответ заканчивается IAC GA; если диалог окончен - закрываем соединение */
+static void EndResponse(Client *client, ExpectedInput expect) {
+    static const char goAhead[] = {(char)TELNET_IAC, (char)TELNET_GA};
+
+    if (expect == INPUT_NONE) {
+        client->closing = true;
+        return;
+    }
+    FrameAppendN(&client->output, goAhead, sizeof goAhead);
+}
+
+/*
+ * @brief Отправить накопленный вывод без блокировки
+ * Что не ушло, ждёт EPOLLOUT. Клиент, у которого скопилось больше
+ * SERVER_OUTPUT_LIMIT, отключается.
+ *
+ * @return false если клиент закрыт
+ */
+static bool FlushClient(Server *server, Client *client) {
+    FrameBuffer *out = &client->output;
+
+    if (out->failed || out->size - client->sent > SERVER_OUTPUT_LIMIT) {
+        CloseClient(server, client);
+        return false;
+    }
+    METRIC_START(TIMER_WRITE, writeStarted);
+    size_t sentBefore = client->sent;
+    while (client->sent < out->size) {
+        ssize_t written = send(client->fd, out->data + client->sent, out->size - client->sent, MSG_NOSIGNAL);
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+        if (written < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            break;
+        }
+        if (written <= 0) {
+            CloseClient(server, client);
+            return false;
+        }
+        client->sent += (size_t)written;
+    }
+    METRIC_STOP(TIMER_WRITE, writeStarted);
+    METRIC_ADD(COUNTER_BYTES_WRITTEN, client->sent - sentBefore);
+
+    bool pending = client->sent < out->size;
+    if (!pending) {
+        FrameReset(out);
+        client->sent = 0;
+        if (client->closing) {
+            CloseClient(server, client);
+            return false;
+        }
+    }
+    if (pending != client->writing) {
+        struct epoll_event event = {.events = EPOLLIN | (pending ? EPOLLOUT : 0), .data.ptr = client};
+        epoll_ctl(server->epoll, EPOLL_CTL_MOD, client->fd, &event);
+        client->writing = pending;
+    }
+    return true;
+}
+
+static void CloseClient(Server *server, Client *client) {
+    epoll_ctl(server->epoll, EPOLL_CTL_DEL, client->fd, NULL);
+    close(client->fd);
+    // Оборванная партия ждёт /resume, законченная по "q" или пустая - нет
+    if (server->sessions != NULL) {
+        ReleaseStoredSession(server->sessions, client->slot, client->saved && !client->closing);
+    }
+    DestroyGameSession(client->session);
+    FrameFree(&client->output);
+    if (client->structured) {
+        FreeDeltaEncoder(&client->delta);
+    }
+    free(client);
+    server->clients--;
+}
+
+#else
+
+int RunServer(const World *world, const ServerOptions *options) {
+    (void)options;
+    UnloadWorld((World *)world);
+    fprintf(stderr, "Сетевой режим доступен только в Linux (epoll).\n");
+    return 1;
+}
+
+#endif
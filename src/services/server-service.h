@@ -0,0 +1,31 @@
+#ifndef SERVER_SERVICE_H
+#define SERVER_SERVICE_H
+
+#include "../models/world.h"
+#include "../models/journal.h"
+#include "../models/session-store.h"
+
+/* [[ Протокол соединений ]] */
+typedef enum {
+    SERVER_PROTOCOL_TEXT,      // экраны для telnet
+    SERVER_PROTOCOL_JSON,      // изменения состояния, см. state-delta.h
+    SERVER_PROTOCOL_BINARY
+} ServerProtocol;
+
+/* [[ Параметры сервера ]] */
+typedef struct {
+    const char *address;   // адрес для bind, по умолчанию 127.0.0.1
+    int port;
+    int maxClients;        // сверх лимита соединения сразу закрываются
+    Journal *journal;      // журнал действий всех клиентов или NULL
+    ServerProtocol protocol;
+    const char *worldPath; // файл мира для перезагрузки по SIGHUP или NULL
+    size_t worldCache;     // кэш текстов при перезагрузке, 0 - файл целиком
+    SessionStore *sessions; // сохранённые партии (/resume) или NULL
+} ServerOptions;
+
+/* [[ Server Functions ]] */
+/* Сервер владеет world: выгружает его, когда версия сменится или сервер остановится */
+int RunServer(const World *world, const ServerOptions *options);
+
+#endif
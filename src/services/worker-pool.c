@@ -0,0 +1,511 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <threads.h>
+#include "worker-pool.h"
+
+/*
+ * Очередь сессии - кольцо Вьюкова: у каждой ячейки свой номер
+ * последовательности, писатели занимают ячейки через CAS, читатель
+ * (рабочий, выполняющий сессию) один. Дек рабочего - дек Чейза-Леви:
+ * владелец кладёт и берёт с одного конца, воры забирают с другого.
+ */
+
+/* [[ Constants ]] */
+#define DEQUE_CAPACITY 4096          // степень двойки
+#define INJECT_BATCH 32              // сколько сессий рабочий забирает из общей очереди
+#define CACHE_LINE 64
+
+_Static_assert((POOL_QUEUE_CAPACITY & (POOL_QUEUE_CAPACITY - 1)) == 0, "queue capacity must be a power of two");
+
+/* [[ Очередь ходов сессии ]] */
+typedef struct {
+    atomic_size_t sequence;
+    int choice;
+} QueueCell;
+
+struct PoolSession {
+    WorkerPool *pool;
+    GameSession *session;
+    TurnCallback callback;
+    void *user;
+    atomic_bool scheduled;          // сессия в деке или выполняется
+    char pad0[CACHE_LINE];
+    atomic_size_t enqueuePos;       // писатели
+    char pad1[CACHE_LINE];
+    size_t dequeuePos;              // только текущий исполнитель
+    QueueCell cells[POOL_QUEUE_CAPACITY];
+};
+
+/* [[ Рабочий поток ]] */
+typedef struct {
+    WorkerPool *pool;
+    thrd_t thread;
+    uint32_t random;                // выбор жертвы для кражи
+    char pad0[CACHE_LINE];
+    atomic_llong top;               // конец для воров
+    char pad1[CACHE_LINE];
+    atomic_llong bottom;            // конец владельца
+    char pad2[CACHE_LINE];
+    atomic_uint_fast64_t turns;
+    atomic_uint_fast64_t runs;
+    atomic_uint_fast64_t steals;
+    _Atomic(PoolSession *) slots[DEQUE_CAPACITY];
+} Worker;
+
+/* [[ Пул ]] */
+struct WorkerPool {
+    Worker *workers;
+    int workerCount;
+    int startedCount;
+    atomic_bool stopping;
+
+    // Общая очередь для сессий, запланированных не из рабочих потоков
+    mtx_t injectLock;
+    PoolSession **inject;
+    size_t injectHead;
+    size_t injectCount;
+    size_t injectCapacity;
+
+    atomic_long runnable;           // сессий в деках и общей очереди
+    atomic_int sleepers;
+    mtx_t sleepLock;
+    cnd_t wake;
+
+    atomic_uint_fast64_t pending;   // принятых, но не выполненных ходов
+    mtx_t idleLock;
+    cnd_t idle;
+};
+
+static _Thread_local Worker *currentWorker = NULL;
+
+/* [[ Прототипы внутренних функций ]] */
+static bool Enqueue(PoolSession *pooled, int choice);
+static bool Dequeue(PoolSession *pooled, int *choice);
+static bool QueueEmptyAt(const PoolSession *pooled, size_t pos);
+static bool DequePush(Worker *worker, PoolSession *pooled);
+static PoolSession* DequeTake(Worker *worker);
+static PoolSession* DequeSteal(Worker *worker);
+static bool InjectPush(WorkerPool *pool, PoolSession *pooled);
+static PoolSession* InjectTake(WorkerPool *pool, Worker *worker);
+static void Schedule(WorkerPool *pool, PoolSession *pooled);
+static PoolSession* FindWork(Worker *worker);
+static void RunSession(Worker *worker, PoolSession *pooled);
+static int WorkerMain(void *arg);
+
+/* [[ Функции пула ]] */
+
+/*
+ * @brief Создание пула
+ * Потоки не запускаются до StartWorkerPool, поэтому ходы можно
+ * поставить в очередь заранее (например, чтобы замерить только работу).
+ *
+ * @param workers Число рабочих потоков (> 0)
+ * @return Пул или NULL при нехватке памяти
+ */
+WorkerPool* CreateWorkerPool(int workers) {
+    if (workers <= 0) {
+        return NULL;
+    }
+    WorkerPool *pool = calloc(1, sizeof *pool);
+    if (pool == NULL) {
+        return NULL;
+    }
+    pool->workers = calloc((size_t)workers, sizeof(Worker));
+    if (pool->workers == NULL) {
+        free(pool);
+        return NULL;
+    }
+    pool->workerCount = workers;
+    for (int i = 0; i < workers; i++) {
+        pool->workers[i].pool = pool;
+        pool->workers[i].random = 0x9E3779B9u * (uint32_t)(i + 1);
+    }
+    mtx_init(&pool->injectLock, mtx_plain);
+    mtx_init(&pool->sleepLock, mtx_plain);
+    mtx_init(&pool->idleLock, mtx_plain);
+    cnd_init(&pool->wake);
+    cnd_init(&pool->idle);
+    return pool;
+}
+
+/*
+ * @brief Запуск рабочих потоков
+ * @return false если не удалось запустить ни одного потока
+ */
+bool StartWorkerPool(WorkerPool *pool) {
+    for (int i = pool->startedCount; i < pool->workerCount; i++) {
+        if (thrd_create(&pool->workers[i].thread, WorkerMain, &pool->workers[i]) != thrd_success) {
+            break;
+        }
+        pool->startedCount++;
+    }
+    return pool->startedCount > 0;
+}
+
+/*
+ * @brief Остановка и освобождение пула
+ * Невыполненные ходы отбрасываются. Сессии пула нужно отсоединить
+ * (DetachPoolSession) после остановки.
+ */
+void DestroyWorkerPool(WorkerPool *pool) {
+    if (pool == NULL) {
+        return;
+    }
+    atomic_store(&pool->stopping, true);
+    mtx_lock(&pool->sleepLock);
+    cnd_broadcast(&pool->wake);
+    mtx_unlock(&pool->sleepLock);
+
+    for (int i = 0; i < pool->startedCount; i++) {
+        thrd_join(pool->workers[i].thread, NULL);
+    }
+    mtx_destroy(&pool->injectLock);
+    mtx_destroy(&pool->sleepLock);
+    mtx_destroy(&pool->idleLock);
+    cnd_destroy(&pool->wake);
+    cnd_destroy(&pool->idle);
+    free(pool->inject);
+    free(pool->workers);
+    free(pool);
+}
+
+/*
+ * @brief Дождаться выполнения всех принятых ходов
+ * Пул должен быть запущен, иначе ожидание не закончится.
+ */
+void WaitWorkerPoolIdle(WorkerPool *pool) {
+    mtx_lock(&pool->idleLock);
+    while (atomic_load(&pool->pending) > 0) {
+        cnd_wait(&pool->idle, &pool->idleLock);
+    }
+    mtx_unlock(&pool->idleLock);
+}
+
+PoolStats GetWorkerPoolStats(WorkerPool *pool) {
+    PoolStats stats = {0, 0, 0};
+    for (int i = 0; i < pool->workerCount; i++) {
+        stats.turns += atomic_load_explicit(&pool->workers[i].turns, memory_order_relaxed);
+        stats.runs += atomic_load_explicit(&pool->workers[i].runs, memory_order_relaxed);
+        stats.steals += atomic_load_explicit(&pool->workers[i].steals, memory_order_relaxed);
+    }
+    return stats;
+}
+
+/*
+ * @brief Передать сессию пулу
+ * Сессией после этого распоряжается пул: трогать её напрямую можно
+ * только когда у неё нет невыполненных ходов.
+ *
+ * @param callback Вызывается после каждого хода (NULL - не нужен)
+ * @return Дескриптор сессии в пуле или NULL при нехватке памяти
+ */
+PoolSession* AttachPoolSession(WorkerPool *pool, GameSession *session, TurnCallback callback, void *user) {
+    PoolSession *pooled = malloc(sizeof *pooled);
+    if (pooled == NULL) {
+        return NULL;
+    }
+    pooled->pool = pool;
+    pooled->session = session;
+    pooled->callback = callback;
+    pooled->user = user;
+    atomic_init(&pooled->scheduled, false);
+    atomic_init(&pooled->enqueuePos, 0);
+    pooled->dequeuePos = 0;
+    for (size_t i = 0; i < POOL_QUEUE_CAPACITY; i++) {
+        atomic_init(&pooled->cells[i].sequence, i);
+    }
+    return pooled;
+}
+
+/*
+ * @brief Забрать сессию из пула
+ * Только для сессии без невыполненных ходов (после WaitWorkerPoolIdle
+ * или остановки пула). Сама GameSession не уничтожается.
+ */
+void DetachPoolSession(PoolSession *pooled) {
+    free(pooled);
+}
+
+/*
+ * @brief Поставить ход в очередь сессии
+ * Можно вызывать из любого потока, в том числе из TurnCallback.
+ *
+ * @param choice Выбор игрока, как в StepGameSession
+ * @return false если очередь сессии заполнена (POOL_QUEUE_CAPACITY)
+ */
+bool SubmitTurn(PoolSession *pooled, int choice) {
+    WorkerPool *pool = pooled->pool;
+
+    atomic_fetch_add(&pool->pending, 1);
+    if (!Enqueue(pooled, choice)) {
+        atomic_fetch_sub(&pool->pending, 1);
+        return false;
+    }
+    // Планирует тот, кто первым перевёл флаг; остальные ходы заберёт тот же запуск
+    if (!atomic_exchange(&pooled->scheduled, true)) {
+        Schedule(pool, pooled);
+    }
+    return true;
+}
+
+GameSession* GetPooledGameSession(PoolSession *pooled) {
+    return pooled->session;
+}
+
+/* [[ Очередь ходов ]] */
+
+static bool Enqueue(PoolSession *pooled, int choice) {
+    size_t pos = atomic_load_explicit(&pooled->enqueuePos, memory_order_relaxed);
+    QueueCell *cell;
+
+    for (;;) {
+        cell = &pooled->cells[pos & (POOL_QUEUE_CAPACITY - 1)];
+        size_t sequence = atomic_load_explicit(&cell->sequence, memory_order_acquire);
+        intptr_t diff = (intptr_t)sequence - (intptr_t)pos;
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&pooled->enqueuePos, &pos, pos + 1,
+                                                      memory_order_relaxed, memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            return false;   // ячейку ещё не освободил читатель: очередь полна
+        } else {
+            pos = atomic_load_explicit(&pooled->enqueuePos, memory_order_relaxed);
+        }
+    }
+    cell->choice = choice;
+    atomic_store_explicit(&cell->sequence, pos + 1, memory_order_release);
+    return true;
+}
+
+static bool Dequeue(PoolSession *pooled, int *choice) {
+    QueueCell *cell = &pooled->cells[pooled->dequeuePos & (POOL_QUEUE_CAPACITY - 1)];
+    size_t sequence = atomic_load_explicit(&cell->sequence, memory_order_acquire);
+
+    if ((intptr_t)sequence - (intptr_t)(pooled->dequeuePos + 1) < 0) {
+        return false;
+    }
+    *choice = cell->choice;
+    atomic_store_explicit(&cell->sequence, pooled->dequeuePos + POOL_QUEUE_CAPACITY, memory_order_release);
+    pooled->dequeuePos++;
+    return true;
+}
+
+/* Пуста ли очередь, если читатель стоит на позиции pos */
+static bool QueueEmptyAt(const PoolSession *pooled, size_t pos) {
+    const QueueCell *cell = &pooled->cells[pos & (POOL_QUEUE_CAPACITY - 1)];
+    size_t sequence = atomic_load_explicit(&cell->sequence, memory_order_acquire);
+    return (intptr_t)sequence - (intptr_t)(pos + 1) < 0;
+}
+
+/* [[ Дек рабочего ]] */
+
+static bool DequePush(Worker *worker, PoolSession *pooled) {
+    long long b = atomic_load_explicit(&worker->bottom, memory_order_relaxed);
+    long long t = atomic_load_explicit(&worker->top, memory_order_acquire);
+
+    if (b - t >= DEQUE_CAPACITY) {
+        return false;
+    }
+    atomic_store_explicit(&worker->slots[b & (DEQUE_CAPACITY - 1)], pooled, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    atomic_store_explicit(&worker->bottom, b + 1, memory_order_relaxed);
+    return true;
+}
+
+static PoolSession* DequeTake(Worker *worker) {
+    long long b = atomic_load_explicit(&worker->bottom, memory_order_relaxed) - 1;
+    atomic_store_explicit(&worker->bottom, b, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    long long t = atomic_load_explicit(&worker->top, memory_order_relaxed);
+
+    if (t > b) {
+        atomic_store_explicit(&worker->bottom, b + 1, memory_order_relaxed);
+        return NULL;
+    }
+    PoolSession *pooled = atomic_load_explicit(&worker->slots[b & (DEQUE_CAPACITY - 1)], memory_order_relaxed);
+    if (t == b) {
+        // Последний элемент: соревнуемся с ворами
+        if (!atomic_compare_exchange_strong_explicit(&worker->top, &t, t + 1, memory_order_seq_cst,
+                                                     memory_order_relaxed)) {
+            pooled = NULL;
+        }
+        atomic_store_explicit(&worker->bottom, b + 1, memory_order_relaxed);
+    }
+    return pooled;
+}
+
+static PoolSession* DequeSteal(Worker *worker) {
+    long long t = atomic_load_explicit(&worker->top, memory_order_acquire);
+    atomic_thread_fence(memory_order_seq_cst);
+    long long b = atomic_load_explicit(&worker->bottom, memory_order_acquire);
+
+    if (t >= b) {
+        return NULL;
+    }
+    PoolSession *pooled = atomic_load_explicit(&worker->slots[t & (DEQUE_CAPACITY - 1)], memory_order_relaxed);
+    if (!atomic_compare_exchange_strong_explicit(&worker->top, &t, t + 1, memory_order_seq_cst,
+                                                 memory_order_relaxed)) {
+        return NULL;
+    }
+    return pooled;
+}
+
+/* [[ Общая очередь ]] */
+
+static bool InjectPush(WorkerPool *pool, PoolSession *pooled) {
+    mtx_lock(&pool->injectLock);
+    if (pool->injectCount == pool->injectCapacity) {
+        size_t capacity = pool->injectCapacity > 0 ? pool->injectCapacity * 2 : 1024;
+        PoolSession **grown = malloc(capacity * sizeof *grown);
+        if (grown == NULL) {
+            mtx_unlock(&pool->injectLock);
+            return false;
+        }
+        for (size_t i = 0; i < pool->injectCount; i++) {
+            grown[i] = pool->inject[(pool->injectHead + i) % pool->injectCapacity];
+        }
+        free(pool->inject);
+        pool->inject = grown;
+        pool->injectHead = 0;
+        pool->injectCapacity = capacity;
+    }
+    pool->inject[(pool->injectHead + pool->injectCount) % pool->injectCapacity] = pooled;
+    pool->injectCount++;
+    mtx_unlock(&pool->injectLock);
+    return true;
+}
+
+/* Первую сессию пачки - на выполнение, остальные - в свой дек, откуда их можно украсть */
+static PoolSession* InjectTake(WorkerPool *pool, Worker *worker) {
+    PoolSession *first = NULL;
+
+    mtx_lock(&pool->injectLock);
+    for (int taken = 0; taken < INJECT_BATCH && pool->injectCount > 0; taken++) {
+        PoolSession *pooled = pool->inject[pool->injectHead];
+        if (first != NULL && !DequePush(worker, pooled)) {
+            break;
+        }
+        pool->injectHead = (pool->injectHead + 1) % pool->injectCapacity;
+        pool->injectCount--;
+        if (first == NULL) {
+            first = pooled;
+        }
+    }
+    mtx_unlock(&pool->injectLock);
+    return first;
+}
+
+/* [[ Планирование ]] */
+
+static void Schedule(WorkerPool *pool, PoolSession *pooled) {
+    Worker *self = currentWorker;
+
+    if (self == NULL || self->pool != pool || !DequePush(self, pooled)) {
+        // Общая очередь растёт по мере надобности; без памяти ждём, пока её разберут
+        while (!InjectPush(pool, pooled)) {
+            thrd_yield();
+        }
+    }
+    atomic_fetch_add(&pool->runnable, 1);
+    if (atomic_load(&pool->sleepers) > 0) {
+        mtx_lock(&pool->sleepLock);
+        cnd_signal(&pool->wake);
+        mtx_unlock(&pool->sleepLock);
+    }
+}
+
+static PoolSession* FindWork(Worker *worker) {
+    WorkerPool *pool = worker->pool;
+    PoolSession *pooled = DequeTake(worker);
+
+    if (pooled == NULL) {
+        pooled = InjectTake(pool, worker);
+    }
+    if (pooled == NULL && pool->workerCount > 1) {
+        // Обход соседей с случайного места, чтобы воры не толпились у одного
+        worker->random ^= worker->random << 13;
+        worker->random ^= worker->random >> 17;
+        worker->random ^= worker->random << 5;
+        int start = (int)(worker->random % (uint32_t)pool->workerCount);
+        for (int i = 0; i < pool->workerCount && pooled == NULL; i++) {
+            Worker *victim = &pool->workers[(start + i) % pool->workerCount];
+            if (victim != worker) {
+                pooled = DequeSteal(victim);
+            }
+        }
+        if (pooled != NULL) {
+            atomic_fetch_add_explicit(&worker->steals, 1, memory_order_relaxed);
+        }
+    }
+    if (pooled != NULL) {
+        atomic_fetch_sub(&pool->runnable, 1);
+    }
+    return pooled;
+}
+
+/*
+ * @brief Выполнить накопившиеся ходы сессии
+ * За один запуск - не больше POOL_QUEUE_CAPACITY ходов, чтобы активная
+ * сессия не держала рабочего вечно; остаток планируется заново.
+ */
+static void RunSession(Worker *worker, PoolSession *pooled) {
+    WorkerPool *pool = worker->pool;
+    uint64_t executed = 0;
+    int choice;
+
+    while (executed < POOL_QUEUE_CAPACITY && Dequeue(pooled, &choice)) {
+        StepResult result = StepGameSession(pooled->session, choice);
+        if (pooled->callback != NULL) {
+            pooled->callback(pooled, choice, result, pooled->user);
+        }
+        executed++;
+    }
+    atomic_fetch_add_explicit(&worker->turns, executed, memory_order_relaxed);
+    atomic_fetch_add_explicit(&worker->runs, 1, memory_order_relaxed);
+
+    // Ход мог прийти, пока флаг был поднят: тогда его никто не запланировал.
+    // Позицию читателя запоминаем до сброса флага - потом сессию может взять другой
+    size_t next = pooled->dequeuePos;
+    atomic_store(&pooled->scheduled, false);
+    if (!QueueEmptyAt(pooled, next) && !atomic_exchange(&pooled->scheduled, true)) {
+        Schedule(pool, pooled);
+    }
+
+    // Счётчик - последним: после него ожидающий может освободить сессию
+    if (atomic_fetch_sub(&pool->pending, executed) == executed) {
+        mtx_lock(&pool->idleLock);
+        cnd_broadcast(&pool->idle);
+        mtx_unlock(&pool->idleLock);
+    }
+}
+
+static int WorkerMain(void *arg) {
+    Worker *worker = arg;
+    WorkerPool *pool = worker->pool;
+
+    currentWorker = worker;
+    while (!atomic_load(&pool->stopping)) {
+        PoolSession *pooled = FindWork(worker);
+        if (pooled != NULL) {
+            RunSession(worker, pooled);
+            continue;
+        }
+        if (atomic_load(&pool->runnable) > 0) {
+            thrd_yield();   // работа есть, но её как раз перекладывают
+            continue;
+        }
+        mtx_lock(&pool->sleepLock);
+        atomic_fetch_add(&pool->sleepers, 1);
+        while (atomic_load(&pool->runnable) == 0 && !atomic_load(&pool->stopping)) {
+            cnd_wait(&pool->wake, &pool->sleepLock);
+        }
+        atomic_fetch_sub(&pool->sleepers, 1);
+        mtx_unlock(&pool->sleepLock);
+    }
+    currentWorker = NULL;
+    return 0;
+}
@@ -0,0 +1,45 @@
+#ifndef WORKER_POOL_H
+#define WORKER_POOL_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "../models/game.h"
+
+/* Сколько ходов может ждать в очереди одной сессии */
+#define POOL_QUEUE_CAPACITY 64
+
+/*
+ * [[ Пул рабочих потоков ]]
+ * Пул владеет набором независимых сессий и выполняет их ходы на всех
+ * ядрах. Ходы сессии складываются в её очередь (много писателей, один
+ * читатель, без блокировок). Сессия с непустой очередью попадает в дек
+ * одного из рабочих; простаивающий рабочий крадёт сессии у соседей.
+ * В каждый момент сессию выполняет не больше одного рабочего, поэтому
+ * её ходы применяются строго в порядке очереди.
+ */
+typedef struct WorkerPool WorkerPool;
+typedef struct PoolSession PoolSession;
+
+/* Вызывается рабочим потоком после каждого хода сессии */
+typedef void (*TurnCallback)(PoolSession *pooled, int choice, StepResult result, void *user);
+
+/* [[ Счётчики пула ]] */
+typedef struct {
+    uint64_t turns;
+    uint64_t runs;      // сколько раз сессии брались в работу
+    uint64_t steals;    // из них украдено у других рабочих
+} PoolStats;
+
+/* [[ Функции пула ]] */
+WorkerPool* CreateWorkerPool(int workers);
+bool StartWorkerPool(WorkerPool *pool);
+void DestroyWorkerPool(WorkerPool *pool);
+void WaitWorkerPoolIdle(WorkerPool *pool);
+PoolStats GetWorkerPoolStats(WorkerPool *pool);
+
+PoolSession* AttachPoolSession(WorkerPool *pool, GameSession *session, TurnCallback callback, void *user);
+void DetachPoolSession(PoolSession *pooled);
+bool SubmitTurn(PoolSession *pooled, int choice);
+GameSession* GetPooledGameSession(PoolSession *pooled);
+
+#endif
@@ -0,0 +1,290 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <threads.h>
+#include "models/game.h"
+#include "models/journal.h"
+#include "models/world.h"
+#include "utils/clock.h"
+#include "utils/cpu.h"
+#include "utils/hash.h"
+
+/*
+ * [[ Проигрыватель журнала ]]
+ *
+ * Читает журнал действий (8practic --journal), раскладывает записи
+ * по сессиям в порядке sequence и заново проигрывает каждую сессию
+ * на движке, сверяя результат хода, хеш состояния и хеш вывода.
+ * Сессии независимы и делятся между потоками по одной.
+ *
+ * Пропуск в номерах записей (переполнение кольца при записи) делает
+ * дальнейшую сверку сессии бессмысленной до следующей NEW_GAME:
+ * такие записи считаются пропущенными, а не расхождениями.
+ *
+ * Использование: journal-replay [--threads N] [--world мир.world] журнал
+ * Код возврата 0 - расхождений нет, 1 - есть, 2 - ошибка запуска.
+ */
+
+#define MAX_REPORTED 10
+
+/* [[ Сессия журнала ]] */
+typedef struct {
+    size_t first;    // записи [first, first + count) в отсортированном массиве
+    size_t count;
+} SessionRange;
+
+/* [[ Общее состояние проигрывания ]] */
+typedef struct {
+    const World *world;
+    const JournalRecord *records;
+    const SessionRange *sessions;
+    size_t sessionCount;
+    atomic_size_t nextSession;
+    atomic_uint_fast64_t replayed;
+    atomic_uint_fast64_t skipped;
+    atomic_uint_fast64_t gaps;
+    atomic_uint_fast64_t mismatches;
+    mtx_t reportLock;
+} Replay;
+
+/* [[ Прототипы внутренних функций ]] */
+static int CompareRecords(const void *a, const void *b);
+static int ReplayThread(void *arg);
+static void ReplaySession(Replay *replay, GameSession *session, FrameBuffer *output, const SessionRange *range);
+static bool CheckRecord(GameSession *session, FrameBuffer *output, const JournalRecord *record);
+static void ReportMismatch(Replay *replay, const JournalRecord *record);
+static const char* KindName(uint8_t kind);
+
+int main(int argc, char **argv) {
+    int threads = GetCpuCount();
+    const char *worldPath = NULL;
+    const char *journalPath = NULL;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            threads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--world") == 0 && i + 1 < argc) {
+            worldPath = argv[++i];
+        } else if (argv[i][0] != '-' && journalPath == NULL) {
+            journalPath = argv[i];
+        } else {
+            journalPath = NULL;
+            break;
+        }
+    }
+    if (threads <= 0 || journalPath == NULL) {
+        fprintf(stderr, "Usage: %s [--threads N] [--world world.world] journal\n", argv[0]);
+        return 2;
+    }
+
+    World *loaded = NULL;
+    const World *world = NULL;
+    if (worldPath != NULL) {
+        loaded = LoadWorldFile(worldPath);
+        world = loaded;
+    } else {
+        world = LoadDefaultWorld();
+    }
+    if (world == NULL) {
+        return 2;
+    }
+
+    JournalHeader header;
+    size_t count = 0;
+    JournalRecord *records = LoadJournal(journalPath, &header, &count);
+    if (records == NULL) {
+        fprintf(stderr, "%s: cannot read journal\n", journalPath);
+        return 2;
+    }
+    if (header.worldHash != HashWorldImage(world)) {
+        fprintf(stderr, "%s: journal was written for another world\n", journalPath);
+        return 2;
+    }
+
+    uint64_t started = NowNanoseconds();
+
+    // Записи разных сессий перемешаны потоками записи - собираем по сессиям
+    qsort(records, count, sizeof(JournalRecord), CompareRecords);
+
+    SessionRange *sessions = malloc((count > 0 ? count : 1) * sizeof(SessionRange));
+    thrd_t *handles = calloc((size_t)threads, sizeof *handles);
+    if (sessions == NULL || handles == NULL) {
+        fprintf(stderr, "out of memory\n");
+        return 2;
+    }
+    size_t sessionCount = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (i == 0 || records[i].sessionId != records[i - 1].sessionId) {
+            sessions[sessionCount++] = (SessionRange){i, 0};
+        }
+        sessions[sessionCount - 1].count++;
+    }
+
+    Replay replay = {.world = world, .records = records, .sessions = sessions, .sessionCount = sessionCount};
+    mtx_init(&replay.reportLock, mtx_plain);
+
+    int running = 0;
+    for (int t = 0; t < threads && (size_t)t < sessionCount; t++) {
+        if (thrd_create(&handles[t], ReplayThread, &replay) != thrd_success) {
+            break;
+        }
+        running++;
+    }
+    if (running == 0) {
+        ReplayThread(&replay);
+    }
+    for (int t = 0; t < running; t++) {
+        thrd_join(handles[t], NULL);
+    }
+
+    uint64_t elapsed = NowNanoseconds() - started;
+    double seconds = (double)elapsed / 1e9;
+    uint64_t replayed = atomic_load(&replay.replayed);
+    uint64_t mismatches = atomic_load(&replay.mismatches);
+
+    printf("sessions: %zu\n", sessionCount);
+    printf("records: %zu\n", count);
+    printf("replayed: %llu\n", (unsigned long long)replayed);
+    printf("skipped: %llu (gaps %llu)\n", (unsigned long long)atomic_load(&replay.skipped),
+           (unsigned long long)atomic_load(&replay.gaps));
+    printf("mismatches: %llu\n", (unsigned long long)mismatches);
+    printf("elapsed: %.3f s\n", seconds);
+    printf("records/sec: %.0f\n", seconds > 0 ? (double)replayed / seconds : 0.0);
+
+    mtx_destroy(&replay.reportLock);
+    free(handles);
+    free(sessions);
+    free(records);
+    UnloadWorld(loaded);
+    return mismatches == 0 ? 0 : 1;
+}
+
+/* [[ Внутренние функции ]] */
+
+static int CompareRecords(const void *a, const void *b) {
+    const JournalRecord *x = a;
+    const JournalRecord *y = b;
+
+    if (x->sessionId != y->sessionId) {
+        return x->sessionId < y->sessionId ? -1 : 1;
+    }
+    return (x->sequence > y->sequence) - (x->sequence < y->sequence);
+}
+
+static int ReplayThread(void *arg) {
+    Replay *replay = arg;
+    GameSession *session = CreateGameSession(replay->world);
+    FrameBuffer output;
+
+    if (session == NULL) {
+        return 1;
+    }
+    FrameInit(&output);
+    SetSessionOutput(session, &output);
+
+    for (;;) {
+        size_t index = atomic_fetch_add(&replay->nextSession, 1);
+        if (index >= replay->sessionCount) {
+            break;
+        }
+        ReplaySession(replay, session, &output, &replay->sessions[index]);
+    }
+
+    FrameFree(&output);
+    DestroyGameSession(session);
+    return 0;
+}
+
+/*
+ * @brief Проиграть одну сессию журнала
+ * Сессия проигрывателя переиспользуется: каждая сессия журнала
+ * начинается с NEW_GAME, которая сбрасывает состояние.
+ */
+static void ReplaySession(Replay *replay, GameSession *session, FrameBuffer *output, const SessionRange *range) {
+    bool synced = false;        // состояние известно: была NEW_GAME без пропусков после неё
+    uint32_t expected = 0;
+    uint64_t replayed = 0;
+    uint64_t skipped = 0;
+
+    for (size_t i = range->first; i < range->first + range->count; i++) {
+        const JournalRecord *record = &replay->records[i];
+
+        if (record->kind == 0) {
+            continue;   // добивка оборванной записи, см. LoadJournal
+        }
+        if (record->sequence != expected) {
+            atomic_fetch_add(&replay->gaps, 1);
+            synced = false;
+        }
+        expected = record->sequence + 1;
+
+        if (record->kind == JOURNAL_NEW_GAME) {
+            InitGameModel(session);
+            synced = true;
+        }
+        if (!synced) {
+            skipped++;
+            continue;
+        }
+
+        replayed++;
+        if (!CheckRecord(session, output, record)) {
+            ReportMismatch(replay, record);
+            // Дальше сверять бессмысленно до следующей новой партии
+            synced = false;
+        }
+    }
+    atomic_fetch_add(&replay->replayed, replayed);
+    atomic_fetch_add(&replay->skipped, skipped);
+}
+
+/* Применить запись к сессии и сверить результат с журналом */
+static bool CheckRecord(GameSession *session, FrameBuffer *output, const JournalRecord *record) {
+    int result;
+
+    FrameReset(output);
+    switch ((JournalKind)record->kind) {
+        case JOURNAL_NEW_GAME:
+            result = 1;
+            break;
+        case JOURNAL_STEP:
+            result = StepGameSession(session, record->argument);
+            break;
+        case JOURNAL_REWIND:
+            result = RewindToTurn(session, record->argument);
+            break;
+        default:
+            return false;
+    }
+
+    if (result != record->result || (uint32_t)GetTurnNumber(session) != record->turn ||
+        HashGameState(GetSessionState(session)) != record->stateHash) {
+        return false;
+    }
+    return !(record->flags & JOURNAL_FLAG_OUTPUT) ||
+           HashBytes(output->data, output->size, HASH_SEED) == record->outputHash;
+}
+
+static void ReportMismatch(Replay *replay, const JournalRecord *record) {
+    uint64_t number = atomic_fetch_add(&replay->mismatches, 1);
+    if (number >= MAX_REPORTED) {
+        return;
+    }
+    mtx_lock(&replay->reportLock);
+    fprintf(stderr, "mismatch: session %016llx #%u %s %d (result %u, turn %u)\n",
+            (unsigned long long)record->sessionId, record->sequence, KindName(record->kind), record->argument,
+            record->result, record->turn);
+    mtx_unlock(&replay->reportLock);
+}
+
+static const char* KindName(uint8_t kind) {
+    switch ((JournalKind)kind) {
+        case JOURNAL_NEW_GAME: return "new-game";
+        case JOURNAL_STEP:     return "step";
+        case JOURNAL_REWIND:   return "rewind";
+    }
+    return "?";
+}
@@ -0,0 +1,303 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "utils/clock.h"
+
+/*
+ * [[ Нагрузочный клиент для сетевого режима ]]
+ *
+ * Открывает много соединений к 8practic --serve и в каждом проигрывает
+ * сценарий заданное число раз. Задержка хода - от отправки команды
+ * до telnet IAC GA в конце ответа. Все соединения ведёт один поток
+ * на epoll, так что клиент сам не становится узким местом.
+ *
+ * Использование: load-client [--host 127.0.0.1] [--port 4000]
+ *                            [--connections N] [--games N] [--script FILE]
+ * Сценарий - как для --batch: номер действия или свободный ввод на строку;
+ * строки уходят серверу как есть.
+ */
+
+#ifdef __linux__
+
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+
+#define TELNET_IAC 255
+#define TELNET_GA 249
+#define MAX_COMMANDS 1024
+#define COMMAND_BYTES 64
+#define CLIENT_EVENTS 256
+
+/* Прохождение особняка по умолчанию (см. worlds/mansion-walkthrough.txt) */
+static const char *const defaultScript[] = {"1", "1", "2", "0", "4", "1"};
+
+/* [[ Соединение ]] */
+typedef struct {
+    int fd;
+    int command;         // следующая команда сценария
+    int game;            // номер текущей партии
+    bool started;        // первый экран уже получен
+    bool afterIac;       // последний байт прошлого чтения - IAC
+    uint64_t sentAt;     // время отправки команды, 0 - ответа не ждём
+} Connection;
+
+/* [[ Прогон ]] */
+typedef struct {
+    char commands[MAX_COMMANDS][COMMAND_BYTES];
+    int commandCount;
+    int games;
+    uint64_t *latencies;
+    size_t latencyCount;
+    size_t latencyCapacity;
+    int open;
+    int failed;
+} LoadRun;
+
+/* [[ Прототипы внутренних функций ]] */
+static bool LoadScript(const char *path, LoadRun *run);
+static void RaiseFileLimit();
+static bool OnResponse(LoadRun *run, Connection *conn);
+static void CloseConnection(int epoll, LoadRun *run, Connection *conn, bool failed);
+static int CompareLatency(const void *a, const void *b);
+static double Percentile(const LoadRun *run, double p);
+
+int main(int argc, char **argv) {
+    const char *host = "127.0.0.1";
+    int port = 4000;
+    int connections = 1000;
+    const char *scriptPath = NULL;
+    LoadRun run = {.games = 10};
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--host") == 0 && i + 1 < argc) {
+            host = argv[++i];
+        } else if (strcmp(argv[i], "--port") == 0 && i + 1 < argc) {
+            port = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--connections") == 0 && i + 1 < argc) {
+            connections = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--games") == 0 && i + 1 < argc) {
+            run.games = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--script") == 0 && i + 1 < argc) {
+            scriptPath = argv[++i];
+        } else {
+            connections = 0;
+            break;
+        }
+    }
+    if (connections <= 0 || run.games <= 0 || port <= 0 || port > 65535) {
+        fprintf(stderr, "Usage: %s [--host ADDR] [--port N] [--connections N] [--games N] [--script FILE]\n",
+                argv[0]);
+        return 2;
+    }
+    if (scriptPath != NULL) {
+        if (!LoadScript(scriptPath, &run)) {
+            fprintf(stderr, "%s: cannot read script\n", scriptPath);
+            return 2;
+        }
+    } else {
+        run.commandCount = (int)(sizeof defaultScript / sizeof defaultScript[0]);
+        for (int i = 0; i < run.commandCount; i++) {
+            strcpy(run.commands[i], defaultScript[i]);
+        }
+    }
+
+    struct sockaddr_in address = {0};
+    address.sin_family = AF_INET;
+    address.sin_port = htons((uint16_t)port);
+    if (inet_pton(AF_INET, host, &address.sin_addr) != 1) {
+        fprintf(stderr, "%s: bad address\n", host);
+        return 2;
+    }
+
+    RaiseFileLimit();
+    signal(SIGPIPE, SIG_IGN);
+
+    run.latencyCapacity = (size_t)connections * (size_t)run.games * (size_t)run.commandCount;
+    run.latencies = malloc(run.latencyCapacity * sizeof(uint64_t));
+    Connection *conns = calloc((size_t)connections, sizeof *conns);
+    int epoll = epoll_create1(EPOLL_CLOEXEC);
+    if (run.latencies == NULL || conns == NULL || epoll < 0) {
+        fprintf(stderr, "out of memory\n");
+        return 2;
+    }
+
+    uint64_t started = NowNanoseconds();
+
+    // Соединения открываются все сразу; connect завершается асинхронно
+    for (int c = 0; c < connections; c++) {
+        int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (fd < 0) {
+            run.failed++;
+            continue;
+        }
+        int on = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof on);
+        if (connect(fd, (struct sockaddr *)&address, sizeof address) != 0 && errno != EINPROGRESS) {
+            close(fd);
+            run.failed++;
+            continue;
+        }
+        conns[c].fd = fd;
+        struct epoll_event event = {.events = EPOLLIN | EPOLLRDHUP, .data.ptr = &conns[c]};
+        epoll_ctl(epoll, EPOLL_CTL_ADD, fd, &event);
+        run.open++;
+    }
+
+    struct epoll_event events[CLIENT_EVENTS];
+    while (run.open > 0) {
+        int ready = epoll_wait(epoll, events, CLIENT_EVENTS, 10000);
+        if (ready < 0 && errno == EINTR) {
+            continue;
+        }
+        if (ready <= 0) {
+            fprintf(stderr, "timeout: %d connections still open\n", run.open);
+            break;
+        }
+        for (int i = 0; i < ready; i++) {
+            Connection *conn = events[i].data.ptr;
+            unsigned char buf[8192];
+            ssize_t received = recv(conn->fd, buf, sizeof buf, 0);
+
+            if (received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+                continue;
+            }
+            if (received <= 0) {
+                CloseConnection(epoll, &run, conn, true);
+                continue;
+            }
+            // Конец ответа - IAC GA, он может прийти разорванным между чтениями
+            bool open = true;
+            for (ssize_t b = 0; b < received && open; b++) {
+                if (conn->afterIac && buf[b] == TELNET_GA) {
+                    open = OnResponse(&run, conn);
+                }
+                conn->afterIac = !conn->afterIac && buf[b] == TELNET_IAC;
+            }
+            if (!open) {
+                CloseConnection(epoll, &run, conn, false);
+            }
+        }
+    }
+
+    uint64_t elapsed = NowNanoseconds() - started;
+    double seconds = (double)elapsed / 1e9;
+    qsort(run.latencies, run.latencyCount, sizeof(uint64_t), CompareLatency);
+
+    printf("connections: %d (failed %d)\n", connections, run.failed);
+    printf("turns: %zu\n", run.latencyCount);
+    printf("elapsed: %.3f s\n", seconds);
+    printf("turns/sec: %.0f\n", seconds > 0 ? (double)run.latencyCount / seconds : 0.0);
+    printf("latency p50: %.1f us\n", Percentile(&run, 0.50) / 1e3);
+    printf("latency p99: %.1f us\n", Percentile(&run, 0.99) / 1e3);
+    printf("latency max: %.1f us\n", Percentile(&run, 1.0) / 1e3);
+
+    close(epoll);
+    free(conns);
+    free(run.latencies);
+    return run.failed == 0 ? 0 : 1;
+}
+
+/* [[ Внутренние функции ]] */
+
+/*
+ * @brief Получен полный ответ: записать задержку и отправить следующую команду
+ * @return false если сценарий закончен и соединение пора закрыть
+ */
+static bool OnResponse(LoadRun *run, Connection *conn) {
+    uint64_t now = NowNanoseconds();
+
+    if (conn->started && conn->sentAt != 0 && run->latencyCount < run->latencyCapacity) {
+        run->latencies[run->latencyCount++] = now - conn->sentAt;
+    }
+    conn->started = true;
+
+    if (conn->command == run->commandCount) {
+        conn->command = 0;
+        conn->game++;
+    }
+    if (conn->game == run->games) {
+        send(conn->fd, "q\n", 2, MSG_NOSIGNAL);
+        return false;
+    }
+
+    char line[COMMAND_BYTES + 1];
+    int length = snprintf(line, sizeof line, "%s\n", run->commands[conn->command++]);
+    conn->sentAt = NowNanoseconds();
+    // Команда в несколько байт всегда влезает в пустой буфер сокета
+    return send(conn->fd, line, (size_t)length, MSG_NOSIGNAL) == length;
+}
+
+static void CloseConnection(int epoll, LoadRun *run, Connection *conn, bool failed) {
+    epoll_ctl(epoll, EPOLL_CTL_DEL, conn->fd, NULL);
+    close(conn->fd);
+    conn->fd = -1;
+    run->open--;
+    if (failed) {
+        run->failed++;
+    }
+}
+
+static bool LoadScript(const char *path, LoadRun *run) {
+    FILE *file = fopen(path, "r");
+    if (file == NULL) {
+        return false;
+    }
+    char buf[256];
+    bool ok = true;
+    while (ok && fgets(buf, sizeof buf, file) != NULL && run->commandCount < MAX_COMMANDS) {
+        char *line = buf + strspn(buf, " \t");
+        size_t length = strlen(line);
+        while (length > 0 && strchr(" \t\r\n", line[length - 1]) != NULL) {
+            line[--length] = '\0';
+        }
+        if (length == 0 || line[0] == '#') {
+            continue;
+        }
+        ok = length < COMMAND_BYTES;
+        if (ok) {
+            memcpy(run->commands[run->commandCount++], line, length + 1);
+        }
+    }
+    fclose(file);
+    return ok && run->commandCount > 0;
+}
+
+static void RaiseFileLimit() {
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max) {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+}
+
+static int CompareLatency(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+static double Percentile(const LoadRun *run, double p) {
+    if (run->latencyCount == 0) {
+        return 0;
+    }
+    size_t index = (size_t)(p * (double)(run->latencyCount - 1) + 0.5);
+    return (double)run->latencies[index];
+}
+
+#else
+
+int main() {
+    fprintf(stderr, "load-client requires Linux (epoll)\n");
+    return 2;
+}
+
+#endif
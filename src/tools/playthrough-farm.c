@@ -0,0 +1,441 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <threads.h>
+#include "models/game.h"
+#include "models/world.h"
+#include "utils/bitset.h"
+#include "utils/clock.h"
+#include "utils/cpu.h"
+
+/*
+ * [[ Ферма прохождений ]]
+ *
+ * Монте-Карло по миру: миллионы партий, где игрока заменяет политика
+ * выбора действия. Ходы делает сам движок (StepGameSession поверх
+ * ExecuteAction) без вывода и без пауз, так что скорость фермы -
+ * это и есть пропускная способность движка.
+ *
+ * Партии делятся между потоками поровну заранее. У потока своя сессия,
+ * свой генератор и своя статистика; общее только неизменяемое: мир
+ * и настройки. Статистика сводится после завершения потоков, поэтому
+ * результат при одинаковых --seed и --threads воспроизводим.
+ *
+ * Политики (из действий, которые игрок видит на экране):
+ *   random - равновероятно любое;
+ *   greedy - ведущее в непосещённую локацию или дающее новый предмет,
+ *            если такого нет - любое.
+ *
+ * Использование: playthrough-farm [--games N] [--policy random|greedy]
+ *                [--threads N] [--seed N] [--max-turns N] [мир.world]
+ * Код возврата 0 - хотя бы одна партия выиграна, 1 - ни одной, 2 - ошибка запуска.
+ */
+
+#define DEFAULT_GAMES 1000000
+#define DEFAULT_MAX_TURNS 10000
+#define HISTOGRAM_ROWS 10
+
+/* [[ Политики ]] */
+typedef enum {
+    POLICY_RANDOM,
+    POLICY_GREEDY
+} Policy;
+
+/* [[ Настройки фермы ]] */
+typedef struct {
+    const World *world;
+    Policy policy;
+    uint64_t games;
+    uint64_t seed;
+    int maxTurns;
+    int threads;
+    uint32_t maxFanout;  // наибольшее число действий в локации
+} FarmOptions;
+
+/* [[ Статистика потока ]] */
+typedef struct {
+    const FarmOptions *options;
+    int index;
+    uint64_t gameCount;
+    uint64_t rng;
+    uint64_t turns;
+    uint64_t blocked;                               // ход не принят движком
+    uint64_t wins;
+    uint64_t *turnsToWin;       // [maxTurns + 1], индекс - число ходов
+    uint64_t *locationTurns;    // [локации] ходов, начатых в локации
+    uint64_t *locationGames;    // [локации] партий, где локация посещена
+    uint64_t *actionUses;       // [действия]
+    uint32_t *choices;          // [maxFanout] кандидаты текущего хода
+    bool failed;
+} FarmWorker;
+
+/* [[ Прототипы внутренних функций ]] */
+static int FarmThread(void *arg);
+static int ChooseAction(FarmWorker *w, const World *world, const GameState *state);
+static uint64_t NextRandom(uint64_t *rng);
+static uint32_t RandomBelow(uint64_t *rng, uint32_t bound);
+static bool AllocateStats(FarmWorker *w, const World *world, int maxTurns);
+static void FreeStats(FarmWorker *w);
+static void MergeWorker(FarmWorker *total, const FarmWorker *w, int maxTurns);
+static void PrintReport(const FarmOptions *options, const FarmWorker *total, double seconds);
+static uint64_t TurnsPercentile(const FarmWorker *total, int maxTurns, double p);
+static const char* PolicyName(Policy policy);
+
+int main(int argc, char **argv) {
+    FarmOptions options = {NULL, POLICY_RANDOM, DEFAULT_GAMES, 1, DEFAULT_MAX_TURNS, GetCpuCount(), 0};
+    const char *worldPath = NULL;
+    bool ok = true;
+
+    for (int i = 1; i < argc && ok; i++) {
+        if (strcmp(argv[i], "--games") == 0 && i + 1 < argc) {
+            options.games = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--policy") == 0 && i + 1 < argc) {
+            i++;
+            if (strcmp(argv[i], "random") == 0) {
+                options.policy = POLICY_RANDOM;
+            } else if (strcmp(argv[i], "greedy") == 0) {
+                options.policy = POLICY_GREEDY;
+            } else {
+                ok = false;
+            }
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            options.threads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            options.seed = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--max-turns") == 0 && i + 1 < argc) {
+            options.maxTurns = atoi(argv[++i]);
+        } else if (argv[i][0] != '-' && worldPath == NULL) {
+            worldPath = argv[i];
+        } else {
+            ok = false;
+        }
+    }
+    if (!ok || options.threads <= 0 || options.maxTurns <= 0 || options.games == 0) {
+        fprintf(stderr, "Usage: %s [--games N] [--policy random|greedy] [--threads N] [--seed N] "
+                        "[--max-turns N] [world.world]\n", argv[0]);
+        return 2;
+    }
+
+    World *loaded = NULL;
+    if (worldPath != NULL) {
+        loaded = LoadWorldFile(worldPath);
+        options.world = loaded;
+    } else {
+        options.world = LoadDefaultWorld();
+    }
+    if (options.world == NULL) {
+        return 2;
+    }
+    for (int l = 0; l < options.world->locationCount; l++) {
+        uint32_t fanout = options.world->locations[l].actionCount;
+        options.maxFanout = fanout > options.maxFanout ? fanout : options.maxFanout;
+    }
+    if ((uint64_t)options.threads > options.games) {
+        options.threads = (int)options.games;
+    }
+
+    // Каждому потоку - отдельное выделение, чтобы счётчики не делили кэш-линии
+    FarmWorker **workers = calloc((size_t)options.threads, sizeof *workers);
+    thrd_t *handles = calloc((size_t)options.threads, sizeof *handles);
+    if (workers == NULL || handles == NULL) {
+        fprintf(stderr, "out of memory\n");
+        return 2;
+    }
+    for (int t = 0; t < options.threads; t++) {
+        workers[t] = calloc(1, sizeof(FarmWorker));
+        if (workers[t] == NULL) {
+            fprintf(stderr, "out of memory\n");
+            return 2;
+        }
+        workers[t]->options = &options;
+        workers[t]->index = t;
+        workers[t]->gameCount = options.games * (uint64_t)(t + 1) / (uint64_t)options.threads -
+                                options.games * (uint64_t)t / (uint64_t)options.threads;
+    }
+
+    uint64_t started = NowNanoseconds();
+
+    int running = 0;
+    for (int t = 1; t < options.threads; t++) {
+        if (thrd_create(&handles[t], FarmThread, workers[t]) != thrd_success) {
+            break;
+        }
+        running++;
+    }
+    // Нулевой поток - главный; не созданные потоки доигрывает он же
+    FarmThread(workers[0]);
+    for (int t = running + 1; t < options.threads; t++) {
+        FarmThread(workers[t]);
+    }
+    for (int t = 1; t <= running; t++) {
+        thrd_join(handles[t], NULL);
+    }
+
+    double seconds = (double)(NowNanoseconds() - started) / 1e9;
+
+    FarmWorker total;
+    memset(&total, 0, sizeof total);
+    total.options = &options;
+    if (!AllocateStats(&total, options.world, options.maxTurns)) {
+        fprintf(stderr, "out of memory\n");
+        return 2;
+    }
+    for (int t = 0; t < options.threads; t++) {
+        if (workers[t]->failed) {
+            fprintf(stderr, "out of memory\n");
+            return 2;
+        }
+    }
+    for (int t = 0; t < options.threads; t++) {
+        MergeWorker(&total, workers[t], options.maxTurns);
+    }
+    PrintReport(&options, &total, seconds);
+
+    for (int t = 0; t < options.threads; t++) {
+        FreeStats(workers[t]);
+        free(workers[t]);
+    }
+    FreeStats(&total);
+    free(workers);
+    free(handles);
+    UnloadWorld(loaded);
+    return total.wins > 0 ? 0 : 1;
+}
+
+/* [[ Внутренние функции ]] */
+
+static int FarmThread(void *arg) {
+    FarmWorker *w = arg;
+    const FarmOptions *options = w->options;
+    const World *world = options->world;
+
+    GameSession *session = CreateGameSession(world);
+    if (session == NULL || !AllocateStats(w, world, options->maxTurns)) {
+        DestroyGameSession(session);
+        w->failed = true;
+        return 1;
+    }
+    // Разные потоки - разные последовательности при одном --seed
+    w->rng = options->seed ^ (0x9E3779B97F4A7C15ull * (uint64_t)(w->index + 1));
+
+    const GameState *state = GetSessionState(session);
+    for (uint64_t game = 0; game < w->gameCount; game++) {
+        InitGameModel(session);
+
+        int turn = 0;
+        bool won = false;
+        while (turn < options->maxTurns && !won) {
+            int location = (int)state->currentLocation;
+            int actionIndex = ChooseAction(w, world, state);
+            if (actionIndex < 0) {
+                break;      // тупик: на экране нет ни одного действия
+            }
+            w->locationTurns[location]++;
+            w->actionUses[world->locations[location].firstAction + (uint32_t)actionIndex]++;
+
+            StepResult result = StepGameSession(session, actionIndex + 1);
+            turn++;
+            if (result == STEP_BLOCKED || result == STEP_INVALID) {
+                w->blocked++;
+            }
+            won = result == STEP_WON;
+        }
+
+        w->turns += (uint64_t)turn;
+        if (won) {
+            w->wins++;
+            w->turnsToWin[turn]++;
+        }
+        const uint64_t *visited = state->bits + world->visitedWord;
+        size_t words = BITSET_WORDS(world->locationCount);
+        for (int l = BitsetNext(visited, words, 0); l >= 0; l = BitsetNext(visited, words, l + 1)) {
+            w->locationGames[l]++;
+        }
+    }
+
+    DestroyGameSession(session);
+    return 0;
+}
+
+/*
+ * Номер действия в локации (с 0) по политике или -1, если выбирать
+ * не из чего. Видимые действия - биты available в срезе локации;
+ * кандидаты собираются в w->choices по возрастанию номера, у greedy
+ * новые - в начало списка, тоже по возрастанию.
+ */
+static int ChooseAction(FarmWorker *w, const World *world, const GameState *state) {
+    const Location *loc = &world->locations[state->currentLocation];
+    const uint64_t *available = state->bits + world->availableWord;
+    const uint64_t *visited = state->bits + world->visitedWord;
+    const uint64_t *collected = state->bits + world->collectedWord;
+    bool greedy = w->options->policy == POLICY_GREEDY;
+    uint32_t visible = 0;
+    uint32_t novel = 0;
+
+    for (uint32_t index = 0; index < loc->actionCount; index++) {
+        uint32_t actionId = loc->firstAction + index;
+        if (!BitsetTest(available, (int)actionId)) {
+            continue;
+        }
+        const Action *action = &world->actions[actionId];
+        bool isNovel = greedy &&
+                       ((action->targetLocation >= 0 && !BitsetTest(visited, action->targetLocation)) ||
+                        (action->givesItem >= 0 && !BitsetTest(collected, action->givesItem)));
+        if (isNovel) {
+            w->choices[visible++] = w->choices[novel];
+            w->choices[novel++] = index;
+        } else {
+            w->choices[visible++] = index;
+        }
+    }
+    if (visible == 0) {
+        return -1;
+    }
+    return (int)w->choices[RandomBelow(&w->rng, novel > 0 ? novel : visible)];
+}
+
+/* xorshift64*: быстрый, без общего состояния, качества для выбора хода хватает */
+static uint64_t NextRandom(uint64_t *rng) {
+    uint64_t x = *rng != 0 ? *rng : 0x2545F4914F6CDD1Dull;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    *rng = x;
+    return x * 0x2545F4914F6CDD1Dull;
+}
+
+/* Число в [0, bound) умножением вместо деления (Lemire) */
+static uint32_t RandomBelow(uint64_t *rng, uint32_t bound) {
+    return (uint32_t)(((NextRandom(rng) >> 32) * (uint64_t)bound) >> 32);
+}
+
+/* Счётчики по размерам мира */
+static bool AllocateStats(FarmWorker *w, const World *world, int maxTurns) {
+    w->turnsToWin = calloc((size_t)maxTurns + 1, sizeof(uint64_t));
+    w->locationTurns = calloc((size_t)world->locationCount, sizeof(uint64_t));
+    w->locationGames = calloc((size_t)world->locationCount, sizeof(uint64_t));
+    w->actionUses = calloc((size_t)world->actionCount + 1, sizeof(uint64_t));
+    w->choices = calloc((size_t)w->options->maxFanout + 1, sizeof(uint32_t));
+    return w->turnsToWin != NULL && w->locationTurns != NULL && w->locationGames != NULL &&
+           w->actionUses != NULL && w->choices != NULL;
+}
+
+static void FreeStats(FarmWorker *w) {
+    free(w->turnsToWin);
+    free(w->locationTurns);
+    free(w->locationGames);
+    free(w->actionUses);
+    free(w->choices);
+}
+
+static void MergeWorker(FarmWorker *total, const FarmWorker *w, int maxTurns) {
+    total->gameCount += w->gameCount;
+    total->turns += w->turns;
+    total->blocked += w->blocked;
+    total->wins += w->wins;
+    for (int i = 0; i <= maxTurns; i++) {
+        total->turnsToWin[i] += w->turnsToWin[i];
+    }
+    const World *world = w->options->world;
+    for (int l = 0; l < world->locationCount; l++) {
+        total->locationTurns[l] += w->locationTurns[l];
+        total->locationGames[l] += w->locationGames[l];
+    }
+    for (int a = 0; a < world->actionCount; a++) {
+        total->actionUses[a] += w->actionUses[a];
+    }
+}
+
+static void PrintReport(const FarmOptions *options, const FarmWorker *total, double seconds) {
+    const World *world = options->world;
+
+    printf("policy: %s\n", PolicyName(options->policy));
+    printf("games: %llu\n", (unsigned long long)total->gameCount);
+    printf("wins: %llu (%.2f%%)\n", (unsigned long long)total->wins,
+           100.0 * (double)total->wins / (double)total->gameCount);
+    printf("turns: %llu (blocked %llu)\n", (unsigned long long)total->turns, (unsigned long long)total->blocked);
+    printf("threads: %d\n", options->threads);
+    printf("elapsed: %.3f s\n", seconds);
+    printf("turns/sec: %.0f\n", seconds > 0 ? (double)total->turns / seconds : 0.0);
+    printf("games/sec: %.0f\n", seconds > 0 ? (double)total->gameCount / seconds : 0.0);
+
+    if (total->wins > 0) {
+        uint64_t sum = 0;
+        uint64_t shortest = 0;
+        for (int i = options->maxTurns; i >= 0; i--) {
+            sum += (uint64_t)i * total->turnsToWin[i];
+            if (total->turnsToWin[i] != 0) {
+                shortest = (uint64_t)i;
+            }
+        }
+        uint64_t longest = TurnsPercentile(total, options->maxTurns, 1.0);
+        printf("\nturns to win: min %llu, mean %.1f, p50 %llu, p90 %llu, p99 %llu, max %llu\n",
+               (unsigned long long)shortest, (double)sum / (double)total->wins,
+               (unsigned long long)TurnsPercentile(total, options->maxTurns, 0.50),
+               (unsigned long long)TurnsPercentile(total, options->maxTurns, 0.90),
+               (unsigned long long)TurnsPercentile(total, options->maxTurns, 0.99),
+               (unsigned long long)longest);
+
+        // Равные интервалы от кратчайшей до самой долгой победы
+        uint64_t width = (longest - shortest) / HISTOGRAM_ROWS + 1;
+        for (uint64_t from = shortest; from <= longest; from += width) {
+            uint64_t count = 0;
+            for (uint64_t i = from; i < from + width && i <= longest; i++) {
+                count += total->turnsToWin[i];
+            }
+            printf("  %6llu-%-6llu %12llu  %6.2f%%\n", (unsigned long long)from,
+                   (unsigned long long)(from + width - 1), (unsigned long long)count,
+                   100.0 * (double)count / (double)total->wins);
+        }
+    }
+    uint64_t capped = total->gameCount - total->wins;
+    if (capped > 0) {
+        printf("not won within %d turns or stuck: %llu\n", options->maxTurns, (unsigned long long)capped);
+    }
+
+    // Имена - последней колонкой: printf выравнивает байты, а не буквы UTF-8
+    printf("\n%14s %8s %9s  %s\n", "turns", "turns%", "visited%", "location");
+    for (int l = 0; l < world->locationCount; l++) {
+        printf("%14llu %7.2f%% %8.2f%%  %s\n", (unsigned long long)total->locationTurns[l],
+               total->turns > 0 ? 100.0 * (double)total->locationTurns[l] / (double)total->turns : 0.0,
+               100.0 * (double)total->locationGames[l] / (double)total->gameCount,
+               WorldString(world, world->locations[l].name));
+    }
+
+    printf("\n%14s %8s  %s\n", "uses", "uses%", "action");
+    for (int a = 0; a < world->actionCount; a++) {
+        const Location *owner = NULL;
+        for (int l = 0; l < world->locationCount && owner == NULL; l++) {
+            const Location *loc = &world->locations[l];
+            if ((uint32_t)a >= loc->firstAction && (uint32_t)a < loc->firstAction + loc->actionCount) {
+                owner = loc;
+            }
+        }
+        printf("%14llu %7.2f%%  %s: %s\n", (unsigned long long)total->actionUses[a],
+               total->turns > 0 ? 100.0 * (double)total->actionUses[a] / (double)total->turns : 0.0,
+               owner != NULL ? WorldString(world, owner->name) : "?", WorldString(world, world->actions[a].text));
+    }
+}
+
+/* Наименьшее число ходов, за которое выиграна доля p побед */
+static uint64_t TurnsPercentile(const FarmWorker *total, int maxTurns, double p) {
+    uint64_t rank = (uint64_t)(p * (double)(total->wins - 1)) + 1;
+    uint64_t seen = 0;
+    for (int i = 0; i <= maxTurns; i++) {
+        seen += total->turnsToWin[i];
+        if (seen >= rank) {
+            return (uint64_t)i;
+        }
+    }
+    return (uint64_t)maxTurns;
+}
+
+static const char* PolicyName(Policy policy) {
+    switch (policy) {
+        case POLICY_RANDOM: return "random";
+        case POLICY_GREEDY: return "greedy";
+    }
+    return "?";
+}
@@ -0,0 +1,313 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <inttypes.h>
+#ifdef _WIN32
+#include <windows.h>
+#endif
+#include "models/world.h"
+#include "models/world-source.h"
+
+/*
+ * @brief Конвертер текстового исходника мира в двоичный файл
+ * Использование: world-compiler [--c-source] <исходник.txt> <выход>
+ *
+ * С --c-source вместо файла для mmap пишется исходник на C с тем же
+ * образом в виде static const таблиц (см. models/builtin-world.h).
+ *
+ * Выход пишется во временный файл рядом и переименовывается поверх
+ * прежнего: процесс, у которого прежний файл загружен (8practic --serve
+ * перечитывает его по SIGHUP), никогда не видит недописанный или
+ * усечённый файл.
+ */
+
+/* [[ Прототипы внутренних функций ]] */
+static bool WriteCSource(FILE *out, const char *sourcePath, const void *image, size_t size);
+static void WritePadding(FILE *out, int *padCount, size_t *at, size_t offset);
+static void WriteStringLiteral(FILE *out, const char *text);
+static void WriteItemIndex(FILE *out, int32_t value, const char *none);
+static bool ReplaceFile(const char *from, const char *to);
+
+int main(int argc, char **argv) {
+    bool cSource = argc == 4 && strcmp(argv[1], "--c-source") == 0;
+    if (argc != 3 && !cSource) {
+        fprintf(stderr, "Usage: %s [--c-source] <source.txt> <output>\n", argv[0]);
+        return 2;
+    }
+    const char *sourcePath = argv[argc - 2];
+    const char *outputPath = argv[argc - 1];
+
+    char error[512];
+    size_t size = 0;
+    void *image = CompileWorldSource(sourcePath, &size, error, sizeof error);
+    if (image == NULL) {
+        fprintf(stderr, "%s\n", error);
+        return 1;
+    }
+
+    char tempPath[4096];
+    if (snprintf(tempPath, sizeof tempPath, "%s.tmp", outputPath) >= (int)sizeof tempPath) {
+        fprintf(stderr, "%s: path too long\n", outputPath);
+        free(image);
+        return 1;
+    }
+    FILE *out = fopen(tempPath, cSource ? "w" : "wb");
+    if (out == NULL) {
+        fprintf(stderr, "%s: cannot open for writing\n", tempPath);
+        free(image);
+        return 1;
+    }
+    bool ok = cSource ? WriteCSource(out, sourcePath, image, size) : fwrite(image, 1, size, out) == size;
+    ok = fclose(out) == 0 && ok;
+    free(image);
+
+    if (!ok) {
+        fprintf(stderr, "%s: write failed\n", tempPath);
+        remove(tempPath);
+        return 1;
+    }
+    if (!ReplaceFile(tempPath, outputPath)) {
+        fprintf(stderr, "%s: cannot replace with %s\n", outputPath, tempPath);
+        remove(tempPath);
+        return 1;
+    }
+    return 0;
+}
+
+/* [[ Внутренние функции ]] */
+
+/* Атомарная замена: читатели видят либо прежний файл, либо новый целиком */
+static bool ReplaceFile(const char *from, const char *to) {
+#ifdef _WIN32
+    return MoveFileExA(from, to, MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+    return rename(from, to) == 0;
+#endif
+}
+
+/*
+ * Образ выписывается одной структурой, члены которой повторяют
+ * раскладку файла байт в байт: выравнивание таблиц - явные поля
+ * заполнения, а совпадение смещений проверяют _Static_assert. Поэтому
+ * встроенный мир и файл из того же исходника неотличимы (в том числе
+ * для отпечатка мира в журнале), и BindWorldImage работает с ним как
+ * с любым другим образом.
+ */
+static bool WriteCSource(FILE *out, const char *sourcePath, const void *image, size_t size) {
+    const WorldFileHeader *h = image;
+    const char *base = image;
+    const Location *locations = (const Location *)(base + h->locationsOffset);
+    const Action *actions = (const Action *)(base + h->actionsOffset);
+    const Item *items = (const Item *)(base + h->itemsOffset);
+    const uint32_t *locationItems = (const uint32_t *)(base + h->locationItemsOffset);
+    const uint64_t *initialAvailable = (const uint64_t *)(base + h->availableOffset);
+    uint32_t availableWords = (h->actionCount + 63) / 64;
+    const uint32_t *code = (const uint32_t *)(base + h->codeOffset);
+    const uint32_t *keys = (const uint32_t *)(base + h->keysOffset);
+    const uint64_t *lexicon = (const uint64_t *)(base + h->lexiconOffset);
+    uint32_t lexiconWords = h->lexiconOffset != 0 ? h->lexiconSize / 8 : 0;
+
+    // Порядок таблиц задан WorldBuilderFinish; пустые таблицы C не допускает
+    if (h->locationsOffset > h->actionsOffset || h->actionsOffset > h->itemsOffset ||
+        h->itemsOffset > h->locationItemsOffset || h->locationItemsOffset > h->availableOffset ||
+        h->availableOffset > h->codeOffset || h->codeOffset > h->keysOffset || h->keysOffset > h->stringsOffset ||
+        (lexiconWords > 0 && (h->lexiconOffset < h->keysOffset || h->lexiconOffset > h->stringsOffset)) ||
+        h->codeCount == 0 || h->actionCount == 0 || h->itemCount == 0 || h->locationItemCount == 0) {
+        fprintf(stderr, "world layout is not supported by --c-source\n");
+        return false;
+    }
+
+    // Только имя файла: сгенерированный исходник не зависит от каталога сборки
+    const char *sourceName = strrchr(sourcePath, '/');
+    sourceName = sourceName != NULL ? sourceName + 1 : sourcePath;
+    fprintf(out, "/* Сгенерировано world-compiler --c-source из %s - не редактировать */\n", sourceName);
+    fprintf(out, "#include <stddef.h>\n#include <stdint.h>\n");
+    fprintf(out, "#include \"models/world.h\"\n#include \"models/builtin-world.h\"\n\n");
+
+    int padCount = 0;
+    size_t at = sizeof(WorldFileHeader);
+    fprintf(out, "typedef struct {\n    WorldFileHeader header;\n");
+    WritePadding(out, &padCount, &at, h->locationsOffset);
+    fprintf(out, "    Location locations[%" PRIu32 "];\n", h->locationCount);
+    at += h->locationCount * sizeof(Location);
+    WritePadding(out, &padCount, &at, h->actionsOffset);
+    fprintf(out, "    Action actions[%" PRIu32 "];\n", h->actionCount);
+    at += h->actionCount * sizeof(Action);
+    WritePadding(out, &padCount, &at, h->itemsOffset);
+    fprintf(out, "    Item items[%" PRIu32 "];\n", h->itemCount);
+    at += h->itemCount * sizeof(Item);
+    WritePadding(out, &padCount, &at, h->locationItemsOffset);
+    fprintf(out, "    uint32_t locationItems[%" PRIu32 "];\n", h->locationItemCount);
+    at += h->locationItemCount * sizeof(uint32_t);
+    WritePadding(out, &padCount, &at, h->availableOffset);
+    fprintf(out, "    uint64_t initialAvailable[%" PRIu32 "];\n", availableWords);
+    at += availableWords * sizeof(uint64_t);
+    WritePadding(out, &padCount, &at, h->codeOffset);
+    fprintf(out, "    uint32_t code[%" PRIu32 "];\n", h->codeCount);
+    at += h->codeCount * sizeof(uint32_t);
+    WritePadding(out, &padCount, &at, h->keysOffset);
+    fprintf(out, "    uint32_t keys[%" PRIu32 "];\n", h->keyCount);
+    at += h->keyCount * sizeof(uint32_t);
+    if (lexiconWords > 0) {
+        WritePadding(out, &padCount, &at, h->lexiconOffset);
+        fprintf(out, "    uint64_t lexicon[%" PRIu32 "];\n", lexiconWords);
+        at += lexiconWords * sizeof(uint64_t);
+    }
+    WritePadding(out, &padCount, &at, h->stringsOffset);
+    fprintf(out, "    char strings[%" PRIu32 "];\n", h->stringsSize);
+    at += h->stringsSize;
+    WritePadding(out, &padCount, &at, size);
+    fprintf(out, "} BuiltinWorldImage;\n\n");
+
+    fprintf(out, "_Static_assert(offsetof(BuiltinWorldImage, locations) == %" PRIu32 ", \"layout\");\n",
+            h->locationsOffset);
+    fprintf(out, "_Static_assert(offsetof(BuiltinWorldImage, actions) == %" PRIu32 ", \"layout\");\n",
+            h->actionsOffset);
+    fprintf(out, "_Static_assert(offsetof(BuiltinWorldImage, items) == %" PRIu32 ", \"layout\");\n",
+            h->itemsOffset);
+    fprintf(out, "_Static_assert(offsetof(BuiltinWorldImage, locationItems) == %" PRIu32 ", \"layout\");\n",
+            h->locationItemsOffset);
+    fprintf(out, "_Static_assert(offsetof(BuiltinWorldImage, initialAvailable) == %" PRIu32 ", \"layout\");\n",
+            h->availableOffset);
+    fprintf(out, "_Static_assert(offsetof(BuiltinWorldImage, code) == %" PRIu32 ", \"layout\");\n", h->codeOffset);
+    fprintf(out, "_Static_assert(offsetof(BuiltinWorldImage, keys) == %" PRIu32 ", \"layout\");\n", h->keysOffset);
+    if (lexiconWords > 0) {
+        fprintf(out, "_Static_assert(offsetof(BuiltinWorldImage, lexicon) == %" PRIu32 ", \"layout\");\n",
+                h->lexiconOffset);
+    }
+    fprintf(out, "_Static_assert(offsetof(BuiltinWorldImage, strings) == %" PRIu32 ", \"layout\");\n",
+            h->stringsOffset);
+    fprintf(out, "_Static_assert(sizeof(BuiltinWorldImage) == %zu, \"layout\");\n\n", size);
+
+    fprintf(out, "static const BuiltinWorldImage image = {\n");
+    fprintf(out, "    .header = {\n");
+    fprintf(out, "        .magic = 0x%08" PRIX32 "u,\n", h->magic);
+    fprintf(out, "        .version = %u,\n", (unsigned)h->version);
+    fprintf(out, "        .headerSize = %u,\n", (unsigned)h->headerSize);
+    fprintf(out, "        .fileSize = %" PRIu32 ",\n", h->fileSize);
+    fprintf(out, "        .startLocation = %" PRIu32 ",\n", h->startLocation);
+    fprintf(out, "        .locationCount = %" PRIu32 ",\n", h->locationCount);
+    fprintf(out, "        .locationsOffset = %" PRIu32 ",\n", h->locationsOffset);
+    fprintf(out, "        .actionCount = %" PRIu32 ",\n", h->actionCount);
+    fprintf(out, "        .actionsOffset = %" PRIu32 ",\n", h->actionsOffset);
+    fprintf(out, "        .itemCount = %" PRIu32 ",\n", h->itemCount);
+    fprintf(out, "        .itemsOffset = %" PRIu32 ",\n", h->itemsOffset);
+    fprintf(out, "        .locationItemCount = %" PRIu32 ",\n", h->locationItemCount);
+    fprintf(out, "        .locationItemsOffset = %" PRIu32 ",\n", h->locationItemsOffset);
+    fprintf(out, "        .stringsSize = %" PRIu32 ",\n", h->stringsSize);
+    fprintf(out, "        .stringsOffset = %" PRIu32 ",\n", h->stringsOffset);
+    fprintf(out, "        .winItem = ");
+    WriteItemIndex(out, h->winItem, "NO_ITEM");
+    fprintf(out, ",\n        .availableOffset = %" PRIu32 ",\n", h->availableOffset);
+    fprintf(out, "        .lexiconOffset = %" PRIu32 ",\n", h->lexiconOffset);
+    fprintf(out, "        .lexiconSize = %" PRIu32 ",\n", h->lexiconSize);
+    fprintf(out, "        .codeOffset = %" PRIu32 ",\n", h->codeOffset);
+    fprintf(out, "        .codeCount = %" PRIu32 ",\n", h->codeCount);
+    fprintf(out, "        .flagCount = %" PRIu32 ",\n", h->flagCount);
+    fprintf(out, "        .counterCount = %" PRIu32 ",\n", h->counterCount);
+    fprintf(out, "        .keysOffset = %" PRIu32 ",\n", h->keysOffset);
+    fprintf(out, "        .keyCount = %" PRIu32 ",\n    },\n", h->keyCount);
+
+    fprintf(out, "    .locations = {\n");
+    for (uint32_t i = 0; i < h->locationCount; i++) {
+        const Location *l = &locations[i];
+        fprintf(out, "        {%" PRIu32 ", %" PRIu32 ", %" PRIu32 ", %" PRIu32 ", %" PRIu32 ", %" PRIu32 "},\n",
+                l->name, l->description, l->firstAction, l->actionCount, l->firstItem, l->itemCount);
+    }
+    fprintf(out, "    },\n    .actions = {\n");
+    for (uint32_t i = 0; i < h->actionCount; i++) {
+        const Action *a = &actions[i];
+        fprintf(out, "        {%" PRIu32 ", %" PRIu32 ", ", a->text, a->resultText);
+        WriteItemIndex(out, a->requiredItem, "NO_ITEM");
+        fprintf(out, ", ");
+        WriteItemIndex(out, a->targetLocation, "NO_LOCATION");
+        fprintf(out, ", ");
+        WriteItemIndex(out, a->givesItem, "NO_ITEM");
+        fprintf(out, ", 0x%02" PRIX32 "u, %" PRIu32 ", %" PRIu32 ", %" PRIu32 "},\n", a->flags, a->condition,
+                a->effect, a->blockedText);
+    }
+    fprintf(out, "    },\n    .items = {\n");
+    for (uint32_t i = 0; i < h->itemCount; i++) {
+        fprintf(out, "        {%" PRIu32 ", %" PRIu32 "},\n", items[i].name, items[i].description);
+    }
+    fprintf(out, "    },\n    .locationItems = {");
+    for (uint32_t i = 0; i < h->locationItemCount; i++) {
+        fprintf(out, "%s%" PRIu32, i == 0 ? "" : ", ", locationItems[i]);
+    }
+
+    fprintf(out, "},\n    .initialAvailable = {");
+    for (uint32_t i = 0; i < availableWords; i++) {
+        fprintf(out, "%s0x%016" PRIX64 "u", i == 0 ? "" : ", ", initialAvailable[i]);
+    }
+    fprintf(out, "},\n");
+
+    // Байткод сценариев действий - по восемь слов в строке
+    fprintf(out, "    .code = {");
+    for (uint32_t i = 0; i < h->codeCount; i++) {
+        fprintf(out, "%s0x%08" PRIX32 "u,", i % 8 == 0 ? "\n        " : " ", code[i]);
+    }
+    fprintf(out, "\n    },\n");
+
+    // Ключи записей для перезагрузки мира - по восемь в строке
+    fprintf(out, "    .keys = {");
+    for (uint32_t i = 0; i < h->keyCount; i++) {
+        fprintf(out, "%s0x%08" PRIX32 "u,", i % 8 == 0 ? "\n        " : " ", keys[i]);
+    }
+    fprintf(out, "\n    },\n");
+
+    // Словарь команд - непрозрачные 64-битные слова, по четыре в строке
+    if (lexiconWords > 0) {
+        fprintf(out, "    .lexicon = {");
+        for (uint32_t i = 0; i < lexiconWords; i++) {
+            fprintf(out, "%s0x%016" PRIX64 "u,", i % 4 == 0 ? "\n        " : " ", lexicon[i]);
+        }
+        fprintf(out, "\n    },\n");
+    }
+
+    // Пул строк - по литералу на строку; завершающий ноль массива не нужен,
+    // у каждой строки пула он свой
+    fprintf(out, "    .strings =\n");
+    const char *strings = base + h->stringsOffset;
+    for (uint32_t offset = 0; offset < h->stringsSize; offset += (uint32_t)strlen(strings + offset) + 1) {
+        fprintf(out, "        /* %5" PRIu32 " */ ", offset);
+        WriteStringLiteral(out, strings + offset);
+        fputc('\n', out);
+    }
+    fprintf(out, "};\n\n");
+
+    fprintf(out, "const void *const builtinWorldImage = &image;\n");
+    fprintf(out, "const size_t builtinWorldSize = sizeof image;\n");
+    return !ferror(out);
+}
+
+/* Поле заполнения до смещения offset (нули, как в файле) */
+static void WritePadding(FILE *out, int *padCount, size_t *at, size_t offset) {
+    if (offset > *at) {
+        fprintf(out, "    uint8_t pad%d[%zu];\n", (*padCount)++, offset - *at);
+        *at = offset;
+    }
+}
+
+/* Строка со своим нулём; кавычки, управляющие байты и '?' (триграфы) экранируются */
+static void WriteStringLiteral(FILE *out, const char *text) {
+    fputc('"', out);
+    for (const unsigned char *p = (const unsigned char *)text; *p != '\0'; p++) {
+        if (*p == '"' || *p == '\\' || *p == '?') {
+            fprintf(out, "\\%c", *p);
+        } else if (*p < 0x20 || *p == 0x7F) {
+            fprintf(out, "\\%03o", *p);
+        } else {
+            fputc(*p, out);
+        }
+    }
+    fputs("\\0\"", out);
+}
+
+static void WriteItemIndex(FILE *out, int32_t value, const char *none) {
+    if (value < 0) {
+        fputs(none, out);
+    } else {
+        fprintf(out, "%" PRId32, value);
+    }
+}
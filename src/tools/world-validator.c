@@ -0,0 +1,824 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <threads.h>
+#include "models/action-script.h"
+#include "models/game.h"
+#include "models/world.h"
+#include "utils/bitset.h"
+#include "utils/clock.h"
+#include "utils/cpu.h"
+
+/*
+ * [[ Валидатор мира ]]
+ *
+ * Полный перебор пространства состояний: локация x инвентарь x собранные
+ * предметы x доступные действия. Переходы считает сам движок
+ * (StepGameSession), поэтому проверяется ровно та логика, что в игре.
+ *
+ * Поиск в ширину по уровням: узлы уровня делятся между потоками порциями,
+ * посещённые состояния хранятся в хеш-множестве, разбитом на шарды
+ * с отдельными мьютексами. Номера узлов выдаются в порядке уровней,
+ * поэтому первый найденный выигрыш - кратчайший.
+ *
+ * Использование: world-validator [--threads N] [--max-states N]
+ *                                [--script FILE] [мир.world]
+ * Без файла проверяется встроенный мир. Код возврата 0 - мир проходим
+ * и тупиков нет, 1 - найдены проблемы, 2 - ошибка запуска.
+ */
+
+#define SHARD_COUNT 64
+#define SHARD_INITIAL_CAPACITY 1024
+#define EXPAND_CHUNK 256
+#define EMPTY_SLOT UINT32_MAX
+#define DEFAULT_MAX_STATES (1u << 24)
+
+/* [[ Хеш-множество состояний ]] */
+
+/*
+ * Ключ состояния - локация и множества available, collected и inventory;
+ * visited и flags на переходы не влияют. Длина ключа зависит от мира,
+ * поэтому ключи лежат в пуле шарда подряд по keyWords слов, а ячейка
+ * таблицы ссылается на ключ номером.
+ */
+typedef struct {
+    uint32_t id;       // номер узла, EMPTY_SLOT - ячейка свободна
+    uint32_t key;      // номер ключа в пуле шарда
+} StateSlot;
+
+typedef struct {
+    mtx_t lock;
+    StateSlot *slots;
+    size_t capacity;   // степень двойки
+    size_t count;      // и число ключей в пуле
+    uint64_t *keys;    // место под capacity / 2 ключей
+} StateShard;
+
+/* [[ Узлы и рёбра ]] */
+
+/* Состояния узлов - отдельным массивом по GameStateSize байт */
+typedef struct {
+    uint32_t parent;   // узел, из которого пришли впервые
+    uint32_t choice;   // номер действия 1..N, 0 для стартового узла
+} StateNode;
+
+typedef struct {
+    uint32_t from;
+    uint32_t to;
+} StateEdge;
+
+/* Запись очереди потока; сразу за ней - GameState узла */
+typedef struct {
+    uint32_t id;
+    StateNode node;
+    uint32_t padding;  // состояние за записью выровнено на 8
+} PendingNode;
+
+/* Растущий массив без лишних зависимостей */
+typedef struct {
+    void *data;
+    size_t count;
+    size_t capacity;
+    size_t elemSize;
+} Vector;
+
+/* [[ Общее состояние проверки ]] */
+
+typedef struct {
+    const World *world;
+    size_t stateSize;           // GameStateSize(world)
+    size_t keyWords;
+    StateShard shards[SHARD_COUNT];
+    StateNode *nodes;
+    unsigned char *states;      // по stateSize байт на узел
+    size_t nodeCount;
+    size_t nodeCapacity;
+    atomic_uint_fast32_t nextId;
+    atomic_size_t cursor;       // следующий необработанный узел уровня
+    size_t levelEnd;
+    uint32_t maxStates;
+    atomic_bool overflow;
+    atomic_bool outOfMemory;
+} Validator;
+
+typedef struct {
+    Validator *validator;
+    GameSession *session;
+    Vector pending;             // новые узлы следующего уровня
+    Vector edges;
+    uint64_t *executedActions;  // бит на действие, хоть раз сменившее состояние
+    uint64_t transitions;
+    uint64_t *fromKey;          // ключи разбираемого и полученного состояний
+    uint64_t *toKey;
+    PendingNode *scratch;       // запись очереди вместе с состоянием
+} Worker;
+
+/* [[ Прототипы внутренних функций ]] */
+static bool VectorPush(Vector *vector, const void *elem);
+static GameState* NodeState(const Validator *v, uint32_t id);
+static void MakeKey(const World *world, const GameState *state, uint64_t *key);
+static uint64_t HashKey(const uint64_t *key, size_t words);
+static uint32_t InsertState(Validator *v, const uint64_t *key, bool *inserted);
+static void ExpandNode(Worker *w, uint32_t id);
+static int ExpandThread(void *arg);
+static bool MergePending(Validator *v, Worker *workers, int threads);
+static int CheckStructure(const World *world);
+static void PrintPath(const Validator *v, uint32_t id, FILE *out, bool script);
+static const char* LocationName(const World *world, int locationId);
+static void MarkScriptGives(const World *world, uint32_t offset, uint64_t *givenItems);
+
+/* [[ Точка входа ]] */
+
+int main(int argc, char **argv) {
+    int threads = GetCpuCount();
+    uint32_t maxStates = DEFAULT_MAX_STATES;
+    const char *scriptPath = NULL;
+    const char *worldPath = NULL;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            threads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--max-states") == 0 && i + 1 < argc) {
+            maxStates = (uint32_t)strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--script") == 0 && i + 1 < argc) {
+            scriptPath = argv[++i];
+        } else if (argv[i][0] != '-' && worldPath == NULL) {
+            worldPath = argv[i];
+        } else {
+            worldPath = NULL;
+            threads = 0;
+            break;
+        }
+    }
+    if (threads <= 0 || maxStates == 0) {
+        fprintf(stderr, "Usage: %s [--threads N] [--max-states N] [--script FILE] [world.world]\n", argv[0]);
+        return 2;
+    }
+
+    World *loaded = NULL;
+    const World *world = NULL;
+    if (worldPath != NULL) {
+        loaded = LoadWorldFile(worldPath);
+        world = loaded;
+    } else {
+        world = LoadDefaultWorld();
+    }
+    if (world == NULL) {
+        return 2;
+    }
+
+    printf("world: %s (%d locations, %d actions, %d items)\n",
+           worldPath != NULL ? worldPath : "builtin", world->locationCount, world->actionCount,
+           world->itemCount);
+
+    // Битые индексы не ломают игру (движок их проверяет), но это ошибки мира
+    int problems = CheckStructure(world);
+
+    Validator *v = calloc(1, sizeof *v);
+    Worker *workers = calloc((size_t)threads, sizeof *workers);
+    thrd_t *handles = calloc((size_t)threads, sizeof *handles);
+    if (v == NULL || workers == NULL || handles == NULL) {
+        fprintf(stderr, "out of memory\n");
+        return 2;
+    }
+    v->world = world;
+    v->maxStates = maxStates;
+    v->stateSize = GameStateSize(world);
+    // Локация, available, collected и inventory (последние два идут подряд)
+    v->keyWords = 1 + (world->visitedWord - world->availableWord) + (world->stateWords - world->collectedWord);
+    for (int s = 0; s < SHARD_COUNT; s++) {
+        mtx_init(&v->shards[s].lock, mtx_plain);
+    }
+    size_t actionWords = BITSET_WORDS(world->actionCount);
+    for (int t = 0; t < threads; t++) {
+        workers[t].validator = v;
+        workers[t].session = CreateGameSession(world);
+        workers[t].pending.elemSize = sizeof(PendingNode) + v->stateSize;
+        workers[t].edges.elemSize = sizeof(StateEdge);
+        workers[t].executedActions = calloc(actionWords + 1, sizeof(uint64_t));
+        workers[t].fromKey = malloc(v->keyWords * sizeof(uint64_t));
+        workers[t].toKey = malloc(v->keyWords * sizeof(uint64_t));
+        workers[t].scratch = malloc(workers[t].pending.elemSize);
+        if (workers[t].session == NULL || workers[t].executedActions == NULL || workers[t].fromKey == NULL ||
+            workers[t].toKey == NULL || workers[t].scratch == NULL) {
+            fprintf(stderr, "out of memory\n");
+            return 2;
+        }
+    }
+
+    uint64_t started = NowNanoseconds();
+
+    // Стартовый узел - уровень 0
+    bool inserted = false;
+    const GameState *start = GetSessionState(workers[0].session);
+    MakeKey(world, start, workers[0].fromKey);
+    v->nodeCapacity = 1024;
+    v->nodes = malloc(v->nodeCapacity * sizeof(StateNode));
+    v->states = malloc(v->nodeCapacity * v->stateSize);
+    if (v->nodes == NULL || v->states == NULL || InsertState(v, workers[0].fromKey, &inserted) == EMPTY_SLOT) {
+        fprintf(stderr, "out of memory\n");
+        return 2;
+    }
+    v->nodes[0] = (StateNode){EMPTY_SLOT, 0};
+    memcpy(NodeState(v, 0), start, v->stateSize);
+    v->nodeCount = 1;
+
+    // Поиск в ширину по уровням
+    size_t levelBegin = 0;
+    int levels = 0;
+    while (levelBegin < v->nodeCount && !atomic_load(&v->overflow) && !atomic_load(&v->outOfMemory)) {
+        v->levelEnd = v->nodeCount;
+        atomic_store(&v->cursor, levelBegin);
+
+        // Мелкие уровни дешевле разобрать без запуска потоков
+        size_t width = v->levelEnd - levelBegin;
+        int spawned = width < (size_t)EXPAND_CHUNK * 2 ? 1 : threads;
+        if (spawned == 1) {
+            ExpandThread(&workers[0]);
+        } else {
+            int running = 0;
+            for (int t = 0; t < spawned; t++) {
+                if (thrd_create(&handles[t], ExpandThread, &workers[t]) != thrd_success) {
+                    break;
+                }
+                running++;
+            }
+            if (running == 0) {
+                ExpandThread(&workers[0]);
+            }
+            for (int t = 0; t < running; t++) {
+                thrd_join(handles[t], NULL);
+            }
+        }
+
+        levelBegin = v->levelEnd;
+        if (!MergePending(v, workers, threads)) {
+            atomic_store(&v->outOfMemory, true);
+        }
+        levels++;
+    }
+
+    uint64_t searchNs = NowNanoseconds() - started;
+
+    if (atomic_load(&v->outOfMemory)) {
+        fprintf(stderr, "out of memory after %zu states\n", v->nodeCount);
+        return 2;
+    }
+    if (atomic_load(&v->overflow)) {
+        fprintf(stderr, "state space exceeds --max-states %u, search stopped\n", maxStates);
+        return 2;
+    }
+
+    // [[ Покрытие: что вообще достижимо ]]
+    size_t itemWords = BITSET_WORDS(world->itemCount);
+    uint64_t *reachedLocations = calloc(BITSET_WORDS(world->locationCount), sizeof(uint64_t));
+    uint64_t *obtainedItems = calloc(itemWords + 1, sizeof(uint64_t));
+    uint64_t *givenItems = calloc(itemWords + 1, sizeof(uint64_t));
+    uint64_t *executedActions = calloc(actionWords + 1, sizeof(uint64_t));
+    uint64_t transitions = 0;
+    if (reachedLocations == NULL || obtainedItems == NULL || givenItems == NULL || executedActions == NULL) {
+        fprintf(stderr, "out of memory\n");
+        return 2;
+    }
+    for (size_t i = 0; i < v->nodeCount; i++) {
+        const GameState *state = NodeState(v, (uint32_t)i);
+        BitsetSet(reachedLocations, (int)state->currentLocation);
+        for (size_t word = 0; word < itemWords; word++) {
+            obtainedItems[word] |= state->bits[world->inventoryWord + word];
+        }
+    }
+    for (int t = 0; t < threads; t++) {
+        for (size_t word = 0; word < actionWords; word++) {
+            executedActions[word] |= workers[t].executedActions[word];
+        }
+        transitions += workers[t].transitions;
+    }
+
+    printf("explored: %zu states, %llu transitions, depth %d, %d threads, %.3f ms\n",
+           v->nodeCount, (unsigned long long)transitions, levels - 1, threads, searchNs / 1e6);
+
+    for (int l = 0; l < world->locationCount; l++) {
+        if (!BitsetTest(reachedLocations, l)) {
+            printf("unreachable location: %s\n", LocationName(world, l));
+            problems++;
+        }
+    }
+    for (int a = 0; a < world->actionCount; a++) {
+        int item = world->actions[a].givesItem;
+        if (item >= 0 && item < world->itemCount) {
+            BitsetSet(givenItems, item);
+        }
+        MarkScriptGives(world, world->actions[a].effect, givenItems);
+    }
+    for (int i = 0; i < world->itemCount; i++) {
+        if (BitsetTest(obtainedItems, i)) {
+            continue;
+        }
+        // Предмет, который не выдаёт ни одно действие, - часть обстановки
+        if (!BitsetTest(givenItems, i)) {
+            printf("note: scenery item (no action gives it): %s\n", WorldString(world, world->items[i].name));
+        } else {
+            printf("unobtainable item: %s\n", WorldString(world, world->items[i].name));
+            problems++;
+        }
+    }
+    for (int l = 0; l < world->locationCount; l++) {
+        const Location *loc = &world->locations[l];
+        for (int a = 0; a < (int)loc->actionCount; a++) {
+            int actionId = GetLocationActionId(world, loc, a);
+            if (actionId < 0 || BitsetTest(executedActions, actionId)) {
+                continue;
+            }
+            // Чистый текст без последствий состояние не меняет - это не ошибка
+            const Action *action = &world->actions[actionId];
+            bool hasEffect = action->targetLocation != NO_LOCATION || action->givesItem != NO_ITEM ||
+                             action->effect != 0;
+            if (hasEffect || !BitsetTest(world->initialAvailable, actionId)) {
+                printf("dead action: %s / %s\n", LocationName(world, l), WorldString(world, action->text));
+                problems++;
+            }
+        }
+    }
+
+    // [[ Выигрыш и тупики ]]
+    // Обратный обход от выигрышных узлов: кто до них не дотягивается - тупик
+    size_t edgeCount = 0;
+    for (int t = 0; t < threads; t++) {
+        edgeCount += workers[t].edges.count;
+    }
+    uint32_t *reverseStart = calloc(v->nodeCount + 1, sizeof(uint32_t));
+    uint32_t *reverseList = malloc((edgeCount > 0 ? edgeCount : 1) * sizeof(uint32_t));
+    uint32_t *queue = malloc(v->nodeCount * sizeof(uint32_t));
+    bool *canWin = calloc(v->nodeCount, sizeof(bool));
+    if (reverseStart == NULL || reverseList == NULL || queue == NULL || canWin == NULL) {
+        fprintf(stderr, "out of memory\n");
+        return 2;
+    }
+    for (int t = 0; t < threads; t++) {
+        const StateEdge *edges = workers[t].edges.data;
+        for (size_t e = 0; e < workers[t].edges.count; e++) {
+            reverseStart[edges[e].to + 1]++;
+        }
+    }
+    for (size_t i = 0; i < v->nodeCount; i++) {
+        reverseStart[i + 1] += reverseStart[i];
+    }
+    for (int t = 0; t < threads; t++) {
+        const StateEdge *edges = workers[t].edges.data;
+        for (size_t e = 0; e < workers[t].edges.count; e++) {
+            reverseList[reverseStart[edges[e].to]++] = edges[e].from;
+        }
+    }
+    // После заполнения reverseStart[i] указывает на конец списка i
+    for (size_t i = v->nodeCount; i > 0; i--) {
+        reverseStart[i] = reverseStart[i - 1];
+    }
+    reverseStart[0] = 0;
+
+    uint32_t shortestWin = EMPTY_SLOT;
+    size_t head = 0;
+    size_t tail = 0;
+    for (size_t i = 0; i < v->nodeCount; i++) {
+        if (IsWinState(world, NodeState(v, (uint32_t)i))) {
+            if (shortestWin == EMPTY_SLOT) {
+                shortestWin = (uint32_t)i;
+            }
+            canWin[i] = true;
+            queue[tail++] = (uint32_t)i;
+        }
+    }
+    while (head < tail) {
+        uint32_t id = queue[head++];
+        for (uint32_t e = reverseStart[id]; e < reverseStart[id + 1]; e++) {
+            uint32_t from = reverseList[e];
+            if (!canWin[from]) {
+                canWin[from] = true;
+                queue[tail++] = from;
+            }
+        }
+    }
+
+    // Узлы в порядке уровней: первый тупик - самый близкий к старту
+    size_t softlocks = 0;
+    uint32_t firstSoftlock = EMPTY_SLOT;
+    for (size_t i = 0; i < v->nodeCount; i++) {
+        if (!canWin[i]) {
+            if (firstSoftlock == EMPTY_SLOT) {
+                firstSoftlock = (uint32_t)i;
+            }
+            softlocks++;
+        }
+    }
+
+    if (shortestWin == EMPTY_SLOT) {
+        printf("win is unreachable%s\n", world->winItem == NO_ITEM ? " (world has no win item)" : "");
+        problems++;
+    } else {
+        uint32_t steps = 0;
+        for (uint32_t id = shortestWin; v->nodes[id].parent != EMPTY_SLOT; id = v->nodes[id].parent) {
+            steps++;
+        }
+        printf("shortest win: %u steps\n", steps);
+        PrintPath(v, shortestWin, stdout, false);
+
+        if (scriptPath != NULL) {
+            FILE *script = fopen(scriptPath, "w");
+            if (script == NULL) {
+                fprintf(stderr, "%s: cannot open for writing\n", scriptPath);
+                problems++;
+            } else {
+                fprintf(script, "# Кратчайшее прохождение, найденное world-validator\n");
+                PrintPath(v, shortestWin, script, true);
+                fclose(script);
+            }
+        }
+    }
+
+    if (softlocks > 0 && shortestWin != EMPTY_SLOT) {
+        printf("softlocks: %zu states cannot reach the win; nearest:\n", softlocks);
+        PrintPath(v, firstSoftlock, stdout, false);
+        printf("  -> stuck in %s\n", LocationName(world, (int)NodeState(v, firstSoftlock)->currentLocation));
+        problems++;
+    }
+
+    printf("%s: %d problem(s)\n", problems == 0 ? "OK" : "FAILED", problems);
+
+    free(reverseStart);
+    free(reverseList);
+    free(queue);
+    free(canWin);
+    free(reachedLocations);
+    free(obtainedItems);
+    free(givenItems);
+    free(executedActions);
+    for (int t = 0; t < threads; t++) {
+        DestroyGameSession(workers[t].session);
+        free(workers[t].pending.data);
+        free(workers[t].edges.data);
+        free(workers[t].executedActions);
+        free(workers[t].fromKey);
+        free(workers[t].toKey);
+        free(workers[t].scratch);
+    }
+    for (int s = 0; s < SHARD_COUNT; s++) {
+        mtx_destroy(&v->shards[s].lock);
+        free(v->shards[s].slots);
+        free(v->shards[s].keys);
+    }
+    free(v->nodes);
+    free(v->states);
+    free(v);
+    free(workers);
+    free(handles);
+    UnloadWorld(loaded);
+    return problems == 0 ? 0 : 1;
+}
+
+/* [[ Внутренние функции ]] */
+
+static bool VectorPush(Vector *vector, const void *elem) {
+    if (vector->count == vector->capacity) {
+        size_t capacity = vector->capacity > 0 ? vector->capacity * 2 : 256;
+        void *grown = realloc(vector->data, capacity * vector->elemSize);
+        if (grown == NULL) {
+            return false;
+        }
+        vector->data = grown;
+        vector->capacity = capacity;
+    }
+    memcpy((char *)vector->data + vector->count * vector->elemSize, elem, vector->elemSize);
+    vector->count++;
+    return true;
+}
+
+static GameState* NodeState(const Validator *v, uint32_t id) {
+    return (GameState *)(v->states + (size_t)id * v->stateSize);
+}
+
+/* Ключ: локация, затем available, затем collected и inventory */
+static void MakeKey(const World *world, const GameState *state, uint64_t *key) {
+    size_t availableWords = world->visitedWord - world->availableWord;
+    key[0] = state->currentLocation;
+    memcpy(key + 1, state->bits + world->availableWord, availableWords * sizeof(uint64_t));
+    memcpy(key + 1 + availableWords, state->bits + world->collectedWord,
+           (world->stateWords - world->collectedWord) * sizeof(uint64_t));
+}
+
+static uint64_t HashKey(const uint64_t *key, size_t words) {
+    uint64_t h = 0;
+    for (size_t i = 0; i < words; i++) {
+        h = (h ^ key[i]) * 0x9E3779B97F4A7C15ull;
+        h ^= h >> 29;
+    }
+    // Финальное перемешивание (fmix64 из MurmurHash3)
+    h ^= h >> 33;
+    h *= 0xFF51AFD7ED558CCDull;
+    h ^= h >> 33;
+    h *= 0xC4CEB9FE1A85EC53ull;
+    h ^= h >> 33;
+    return h;
+}
+
+static bool GrowShard(StateShard *shard, size_t keyWords) {
+    size_t capacity = shard->capacity > 0 ? shard->capacity * 2 : SHARD_INITIAL_CAPACITY;
+    StateSlot *slots = malloc(capacity * sizeof(StateSlot));
+    // Пул ключей заполняется не больше чем наполовину, как и таблица
+    uint64_t *keys = realloc(shard->keys, capacity / 2 * keyWords * sizeof(uint64_t));
+    if (keys != NULL) {
+        shard->keys = keys;
+    }
+    if (slots == NULL || keys == NULL) {
+        free(slots);
+        return false;
+    }
+    for (size_t i = 0; i < capacity; i++) {
+        slots[i].id = EMPTY_SLOT;
+    }
+    for (size_t i = 0; i < shard->capacity; i++) {
+        const StateSlot *old = &shard->slots[i];
+        if (old->id == EMPTY_SLOT) {
+            continue;
+        }
+        size_t at = (HashKey(shard->keys + (size_t)old->key * keyWords, keyWords) >> 6) & (capacity - 1);
+        while (slots[at].id != EMPTY_SLOT) {
+            at = (at + 1) & (capacity - 1);
+        }
+        slots[at] = *old;
+    }
+    free(shard->slots);
+    shard->slots = slots;
+    shard->capacity = capacity;
+    return true;
+}
+
+/*
+ * @brief Добавить состояние в множество посещённых
+ * Младшие биты хеша выбирают шард, старшие - ячейку внутри шарда.
+ *
+ * @param key Ключ состояния (MakeKey)
+ * @param inserted Сюда пишется true, если состояние новое
+ * @return Номер узла (нового или найденного) или EMPTY_SLOT при нехватке памяти
+ */
+static uint32_t InsertState(Validator *v, const uint64_t *key, bool *inserted) {
+    size_t keyWords = v->keyWords;
+    uint64_t hash = HashKey(key, keyWords);
+    StateShard *shard = &v->shards[hash & (SHARD_COUNT - 1)];
+    uint32_t id = EMPTY_SLOT;
+
+    *inserted = false;
+    mtx_lock(&shard->lock);
+    // Заполненность не выше 1/2: короткие цепочки линейного пробирования
+    if ((shard->count + 1) * 2 > shard->capacity && !GrowShard(shard, keyWords)) {
+        mtx_unlock(&shard->lock);
+        atomic_store(&v->outOfMemory, true);
+        return EMPTY_SLOT;
+    }
+    size_t at = (hash >> 6) & (shard->capacity - 1);
+    while (shard->slots[at].id != EMPTY_SLOT) {
+        const uint64_t *stored = shard->keys + (size_t)shard->slots[at].key * keyWords;
+        if (memcmp(stored, key, keyWords * sizeof(uint64_t)) == 0) {
+            id = shard->slots[at].id;
+            break;
+        }
+        at = (at + 1) & (shard->capacity - 1);
+    }
+    if (id == EMPTY_SLOT) {
+        id = (uint32_t)atomic_fetch_add(&v->nextId, 1);
+        if (id >= v->maxStates) {
+            atomic_store(&v->overflow, true);
+        }
+        memcpy(shard->keys + shard->count * keyWords, key, keyWords * sizeof(uint64_t));
+        shard->slots[at] = (StateSlot){id, (uint32_t)shard->count};
+        shard->count++;
+        *inserted = true;
+    }
+    mtx_unlock(&shard->lock);
+    return id;
+}
+
+/*
+ * @brief Перебрать все действия текущей локации узла
+ * Переходы, не меняющие состояние (чистый текст, отказ), не считаются.
+ * Выигрышные узлы конечные: партия после победы не продолжается.
+ * Массив состояний узлов во время уровня не перевыделяется.
+ */
+static void ExpandNode(Worker *w, uint32_t id) {
+    Validator *v = w->validator;
+    const World *world = v->world;
+    const GameState *from = NodeState(v, id);
+    const Location *loc = &world->locations[from->currentLocation];
+    size_t keyBytes = v->keyWords * sizeof(uint64_t);
+
+    if (IsWinState(world, from)) {
+        return;
+    }
+    MakeKey(world, from, w->fromKey);
+
+    for (uint32_t a = 0; a < loc->actionCount; a++) {
+        if (!SetSessionState(w->session, from)) {
+            return;
+        }
+        StepResult result = StepGameSession(w->session, (int)a + 1);
+        if (result != STEP_OK && result != STEP_WON) {
+            continue;
+        }
+        const GameState *to = GetSessionState(w->session);
+        MakeKey(world, to, w->toKey);
+        if (memcmp(w->toKey, w->fromKey, keyBytes) == 0) {
+            continue;
+        }
+        BitsetSet(w->executedActions, GetLocationActionId(world, loc, (int)a));
+        w->transitions++;
+
+        bool inserted = false;
+        uint32_t next = InsertState(v, w->toKey, &inserted);
+        if (next == EMPTY_SLOT) {
+            return;
+        }
+        if (inserted) {
+            PendingNode *pending = w->scratch;
+            GameState *state = (GameState *)(pending + 1);
+            *pending = (PendingNode){next, {id, a + 1}, 0};
+            memcpy(state, to, v->stateSize);
+            state->flags = 0;
+            if (!VectorPush(&w->pending, pending)) {
+                atomic_store(&v->outOfMemory, true);
+                return;
+            }
+        }
+        StateEdge edge = {id, next};
+        if (!VectorPush(&w->edges, &edge)) {
+            atomic_store(&v->outOfMemory, true);
+            return;
+        }
+    }
+}
+
+static int ExpandThread(void *arg) {
+    Worker *w = arg;
+    Validator *v = w->validator;
+
+    for (;;) {
+        size_t begin = atomic_fetch_add(&v->cursor, EXPAND_CHUNK);
+        if (begin >= v->levelEnd || atomic_load(&v->outOfMemory) || atomic_load(&v->overflow)) {
+            break;
+        }
+        size_t end = begin + EXPAND_CHUNK < v->levelEnd ? begin + EXPAND_CHUNK : v->levelEnd;
+        for (size_t id = begin; id < end; id++) {
+            ExpandNode(w, (uint32_t)id);
+        }
+    }
+    return 0;
+}
+
+/*
+ * @brief Перенести новые узлы потоков в общий массив
+ * Номера нового уровня идут подряд, так что массив растёт без дыр.
+ */
+static bool MergePending(Validator *v, Worker *workers, int threads) {
+    size_t total = (size_t)atomic_load(&v->nextId);
+
+    if (total > v->nodeCapacity) {
+        size_t capacity = v->nodeCapacity;
+        while (capacity < total) {
+            capacity *= 2;
+        }
+        StateNode *grown = realloc(v->nodes, capacity * sizeof(StateNode));
+        if (grown == NULL) {
+            return false;
+        }
+        v->nodes = grown;
+        unsigned char *states = realloc(v->states, capacity * v->stateSize);
+        if (states == NULL) {
+            return false;
+        }
+        v->states = states;
+        v->nodeCapacity = capacity;
+    }
+    for (int t = 0; t < threads; t++) {
+        const unsigned char *data = workers[t].pending.data;
+        for (size_t i = 0; i < workers[t].pending.count; i++) {
+            const PendingNode *pending = (const PendingNode *)(data + i * workers[t].pending.elemSize);
+            v->nodes[pending->id] = pending->node;
+            memcpy(NodeState(v, pending->id), pending + 1, v->stateSize);
+        }
+        workers[t].pending.count = 0;
+    }
+    v->nodeCount = total;
+    return true;
+}
+
+/*
+ * @brief Проверка ссылок между записями мира
+ * @return Число найденных ошибок
+ */
+static int CheckStructure(const World *world) {
+    int problems = 0;
+
+    for (int l = 0; l < world->locationCount; l++) {
+        const Location *loc = &world->locations[l];
+        if ((uint64_t)loc->firstAction + loc->actionCount > (uint64_t)world->actionCount) {
+            printf("broken location: %s has actions outside the table\n", LocationName(world, l));
+            problems++;
+        }
+        if ((uint64_t)loc->firstItem + loc->itemCount > (uint64_t)world->header->locationItemCount) {
+            printf("broken location: %s has items outside the table\n", LocationName(world, l));
+            problems++;
+        }
+    }
+    ScriptLimits limits = {
+        .items = (uint32_t)world->itemCount,
+        .locations = (uint32_t)world->locationCount,
+        .actions = (uint32_t)world->actionCount,
+        .flags = (uint32_t)world->flagCount,
+        .counters = (uint32_t)world->counterCount,
+    };
+    for (int a = 0; a < world->actionCount; a++) {
+        const Action *action = &world->actions[a];
+        const char *text = WorldString(world, action->text);
+        const char *error = CheckScript(world->code, world->codeCount, action->condition, true, &limits);
+        if (error != NULL) {
+            printf("broken action: \"%s\" condition script: %s\n", text, error);
+            problems++;
+        }
+        error = CheckScript(world->code, world->codeCount, action->effect, false, &limits);
+        if (error != NULL) {
+            printf("broken action: \"%s\" effect script: %s\n", text, error);
+            problems++;
+        }
+        if (action->targetLocation != NO_LOCATION &&
+            (action->targetLocation < 0 || action->targetLocation >= world->locationCount)) {
+            printf("broken action: \"%s\" targets location %d\n", text, action->targetLocation);
+            problems++;
+        }
+        if (action->requiredItem != NO_ITEM &&
+            (action->requiredItem < 0 || action->requiredItem >= world->itemCount)) {
+            printf("broken action: \"%s\" requires item %d\n", text, action->requiredItem);
+            problems++;
+        }
+        if (action->givesItem != NO_ITEM && (action->givesItem < 0 || action->givesItem >= world->itemCount)) {
+            printf("broken action: \"%s\" gives item %d\n", text, action->givesItem);
+            problems++;
+        }
+    }
+    if (world->winItem == NO_ITEM) {
+        printf("no win item defined\n");
+        problems++;
+    }
+    return problems;
+}
+
+/*
+ * @brief Вывести путь от старта до узла
+ * @param script true - в формате сценария безголового режима (--batch)
+ */
+static void PrintPath(const Validator *v, uint32_t id, FILE *out, bool script) {
+    size_t length = 0;
+    for (uint32_t at = id; v->nodes[at].parent != EMPTY_SLOT; at = v->nodes[at].parent) {
+        length++;
+    }
+    uint32_t *path = malloc((length > 0 ? length : 1) * sizeof(uint32_t));
+    if (path == NULL) {
+        return;
+    }
+    size_t filled = 0;
+    for (uint32_t at = id; filled < length; at = v->nodes[at].parent) {
+        path[filled++] = at;
+    }
+
+    while (length > 0) {
+        const StateNode *node = &v->nodes[path[--length]];
+        uint32_t location = NodeState(v, node->parent)->currentLocation;
+        const Location *loc = &v->world->locations[location];
+        const Action *action = GetLocationAction(v->world, loc, (int)node->choice - 1);
+        const char *text = action != NULL ? WorldString(v->world, action->text) : "?";
+        const char *where = LocationName(v->world, (int)location);
+
+        if (script) {
+            fprintf(out, "# %s: %s\n%u\n", where, text, node->choice);
+        } else {
+            fprintf(out, "  %2u  %s: %s\n", node->choice, where, text);
+        }
+    }
+    free(path);
+}
+
+/* Предметы, которые выдают последствия действия (give) */
+static void MarkScriptGives(const World *world, uint32_t offset, uint64_t *givenItems) {
+    for (uint32_t at = offset; at < world->codeCount && SCRIPT_OP(world->code[at]) != SCRIPT_END; at++) {
+        uint32_t word = world->code[at];
+        if (SCRIPT_OP(word) == SCRIPT_GIVE && SCRIPT_OPERAND(word) < (uint32_t)world->itemCount) {
+            BitsetSet(givenItems, (int)SCRIPT_OPERAND(word));
+        } else if (SCRIPT_OP(word) == SCRIPT_ADD_COUNTER || SCRIPT_OP(word) == SCRIPT_SET_COUNTER) {
+            at++;   // число в следующем слове
+        }
+    }
+}
+
+static const char* LocationName(const World *world, int locationId) {
+    const Location *loc = GetWorldLocation(world, locationId);
+    return loc != NULL ? WorldString(world, loc->name) : "?";
+}
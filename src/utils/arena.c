@@ -0,0 +1,231 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include "arena.h"
+
+/* [[ Внутренние структуры ]] */
+struct ArenaChunk {
+    ArenaChunk *previous;
+    size_t size;           // байт под данные
+    size_t used;
+};
+
+struct PoolBlock {
+    PoolBlock *next;
+};
+
+/* Данные куска начинаются сразу за выровненным заголовком */
+#define CHUNK_HEADER ((sizeof(ArenaChunk) + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1))
+
+_Static_assert((ARENA_ALIGN & (ARENA_ALIGN - 1)) == 0, "arena alignment must be a power of two");
+
+static _Atomic uint64_t arenaBytes;
+static _Atomic uint64_t arenaPeakBytes;
+static _Atomic uint64_t poolBytes;
+static _Atomic uint64_t poolBlocks;
+
+/* [[ Прототипы внутренних функций ]] */
+static ArenaChunk* AddChunk(Arena *arena, size_t size, bool current);
+static void RaisePeak(_Atomic uint64_t *peak, uint64_t value);
+
+/* [[ Функции арены ]] */
+
+/*
+ * @brief Пустая арена; память берётся при первом выделении
+ * @param chunkSize Размер куска или 0 - ARENA_CHUNK_SIZE
+ */
+void InitArena(Arena *arena, size_t chunkSize) {
+    arena->chunk = NULL;
+    arena->chunkSize = chunkSize > 0 ? chunkSize : ARENA_CHUNK_SIZE;
+    arena->used = 0;
+    arena->reserved = 0;
+}
+
+/*
+ * @brief Выделить size байт, выровненных на ARENA_ALIGN
+ * Память не обнуляется и живёт до FreeArena. Запрос больше куска
+ * получает собственный кусок, остаток текущего не теряется.
+ *
+ * @return Указатель или NULL, если не хватило памяти
+ */
+void* ArenaAlloc(Arena *arena, size_t size) {
+    if (size > SIZE_MAX - CHUNK_HEADER - ARENA_ALIGN) {
+        return NULL;
+    }
+    size = (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+
+    ArenaChunk *chunk = arena->chunk;
+    if (chunk == NULL || chunk->size - chunk->used < size) {
+        chunk = size > arena->chunkSize ? AddChunk(arena, size, false) : AddChunk(arena, arena->chunkSize, true);
+        if (chunk == NULL) {
+            return NULL;
+        }
+    }
+    void *memory = (unsigned char *)chunk + CHUNK_HEADER + chunk->used;
+    chunk->used += size;
+    arena->used += size;
+    return memory;
+}
+
+/*
+ * @brief Освободить всё, что выдала арена
+ * Арена снова пуста и пригодна к работе.
+ */
+void FreeArena(Arena *arena) {
+    for (ArenaChunk *chunk = arena->chunk; chunk != NULL;) {
+        ArenaChunk *previous = chunk->previous;
+        free(chunk);
+        chunk = previous;
+    }
+    atomic_fetch_sub_explicit(&arenaBytes, arena->reserved, memory_order_relaxed);
+    arena->chunk = NULL;
+    arena->used = 0;
+    arena->reserved = 0;
+}
+
+/* [[ Функции пула ]] */
+
+/*
+ * @brief Пустой пул поверх арены
+ * Арена должна жить дольше пула и использоваться другими только под
+ * тем же замком (или не использоваться вовсе).
+ *
+ * @return false если не удалось создать замок
+ */
+bool InitBlockPool(BlockPool *pool, Arena *arena) {
+    memset(pool, 0, sizeof *pool);
+    pool->arena = arena;
+    return mtx_init(&pool->lock, mtx_plain) == thrd_success;
+}
+
+/*
+ * @brief Взять блок из пула
+ * Первый вызов задаёт размер блока; больший запрос потом не принимается.
+ * Содержимое блока не определено.
+ *
+ * @return Блок или NULL, если не хватило памяти или размер не подходит
+ */
+void* PoolTake(BlockPool *pool, size_t blockSize) {
+    mtx_lock(&pool->lock);
+    if (pool->blockSize == 0) {
+        size_t size = blockSize > sizeof(PoolBlock) ? blockSize : sizeof(PoolBlock);
+        pool->blockSize = (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+    }
+    if (blockSize > pool->blockSize) {
+        mtx_unlock(&pool->lock);
+        return NULL;
+    }
+
+    PoolBlock *block = pool->free;
+    if (block != NULL) {
+        pool->free = block->next;
+    } else {
+        // Пачкой: один кусок арены на много блоков
+        size_t count = POOL_SLAB_SIZE / pool->blockSize;
+        count = count > 0 ? count : 1;
+        unsigned char *slab = ArenaAlloc(pool->arena, count * pool->blockSize);
+        if (slab == NULL) {
+            mtx_unlock(&pool->lock);
+            return NULL;
+        }
+        for (size_t i = count - 1; i > 0; i--) {
+            PoolBlock *spare = (PoolBlock *)(slab + i * pool->blockSize);
+            spare->next = pool->free;
+            pool->free = spare;
+        }
+        pool->blocks += count;
+        atomic_fetch_add_explicit(&poolBytes, count * pool->blockSize, memory_order_relaxed);
+        atomic_fetch_add_explicit(&poolBlocks, count, memory_order_relaxed);
+        block = (PoolBlock *)slab;
+    }
+    pool->live++;
+    if (pool->live > pool->peak) {
+        pool->peak = pool->live;
+    }
+    mtx_unlock(&pool->lock);
+    return block;
+}
+
+/*
+ * @brief Вернуть блок в пул
+ * @param block Блок из PoolTake этого пула (NULL допустим)
+ */
+void PoolGive(BlockPool *pool, void *block) {
+    if (block == NULL) {
+        return;
+    }
+    mtx_lock(&pool->lock);
+    PoolBlock *freed = block;
+    freed->next = pool->free;
+    pool->free = freed;
+    pool->live--;
+    mtx_unlock(&pool->lock);
+}
+
+/*
+ * @brief Сколько блоков сейчас выдано
+ */
+size_t PoolLiveBlocks(BlockPool *pool) {
+    mtx_lock(&pool->lock);
+    size_t live = pool->live;
+    mtx_unlock(&pool->lock);
+    return live;
+}
+
+/*
+ * @brief Уничтожить пул
+ * Память блоков остаётся у арены и освобождается вместе с ней.
+ */
+void FreeBlockPool(BlockPool *pool) {
+    atomic_fetch_sub_explicit(&poolBytes, pool->blocks * pool->blockSize, memory_order_relaxed);
+    atomic_fetch_sub_explicit(&poolBlocks, pool->blocks, memory_order_relaxed);
+    mtx_destroy(&pool->lock);
+}
+
+/*
+ * @brief Память арен и пулов процесса
+ * Значения читаются без общего замка и могут на мгновение расходиться
+ * между собой; для отчётов этого хватает.
+ */
+AllocatorStats GetAllocatorStats() {
+    AllocatorStats stats = {
+        .arenaBytes = atomic_load_explicit(&arenaBytes, memory_order_relaxed),
+        .arenaPeakBytes = atomic_load_explicit(&arenaPeakBytes, memory_order_relaxed),
+        .poolBytes = atomic_load_explicit(&poolBytes, memory_order_relaxed),
+        .poolBlocks = atomic_load_explicit(&poolBlocks, memory_order_relaxed),
+    };
+    return stats;
+}
+
+/* [[ Внутренние функции ]] */
+
+/* Новый кусок; current - он становится текущим, иначе встаёт за текущим */
+static ArenaChunk* AddChunk(Arena *arena, size_t size, bool current) {
+    ArenaChunk *chunk = malloc(CHUNK_HEADER + size);
+    if (chunk == NULL) {
+        return NULL;
+    }
+    chunk->size = size;
+    chunk->used = 0;
+    if (current || arena->chunk == NULL) {
+        chunk->previous = arena->chunk;
+        arena->chunk = chunk;
+    } else {
+        chunk->previous = arena->chunk->previous;
+        arena->chunk->previous = chunk;
+    }
+    arena->reserved += CHUNK_HEADER + size;
+
+    uint64_t total = atomic_fetch_add_explicit(&arenaBytes, CHUNK_HEADER + size, memory_order_relaxed) +
+                     CHUNK_HEADER + size;
+    RaisePeak(&arenaPeakBytes, total);
+    return chunk;
+}
+
+static void RaisePeak(_Atomic uint64_t *peak, uint64_t value) {
+    uint64_t seen = atomic_load_explicit(peak, memory_order_relaxed);
+    while (value > seen && !atomic_compare_exchange_weak_explicit(peak, &seen, value, memory_order_relaxed,
+                                                                  memory_order_relaxed)) {
+    }
+}
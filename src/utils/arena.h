@@ -0,0 +1,73 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <threads.h>
+
+/*
+ * [[ Арены и пулы ]]
+ * Арена выдаёт память сдвигом указателя внутри крупных кусков и
+ * освобождается только целиком: у объектов одного времени жизни (мир
+ * и всё, что создано под него) нет ни поштучных free, ни фрагментации.
+ *
+ * Пул - блоки одного размера, нарезанные пачками из арены, со списком
+ * свободных. Взять и вернуть блок - O(1) под коротким замком, malloc
+ * случается только когда пул растёт. Размер блока задаёт первый запрос:
+ * размер сессии известен только игре, а пул создаёт мир.
+ *
+ * Счётчики байтов общие для процесса - для оценки памяти под нагрузкой
+ * (см. GetAllocatorStats и /stats). Они меняются только когда арена или
+ * пул растут, так что взятие и возврат блока их не трогают. Пул
+ * не отдаёт блоки арене, поэтому нарезанное и есть пик одновременно
+ * выданных блоков с точностью до пачки.
+ */
+#define ARENA_ALIGN 16
+#define ARENA_CHUNK_SIZE (64 * 1024)   // кусок по умолчанию; больший запрос - отдельным куском
+#define POOL_SLAB_SIZE (64 * 1024)     // столько байт нарезается за раз, но не меньше блока
+
+typedef struct ArenaChunk ArenaChunk;
+
+typedef struct {
+    ArenaChunk *chunk;     // текущий кусок, предыдущие - по цепочке
+    size_t chunkSize;
+    size_t used;           // выдано байт
+    size_t reserved;       // взято у malloc
+} Arena;
+
+typedef struct PoolBlock PoolBlock;
+
+typedef struct {
+    mtx_t lock;
+    Arena *arena;          // откуда нарезаются новые блоки; под замком пула
+    size_t blockSize;      // 0 - ещё не задан
+    PoolBlock *free;
+    size_t live;           // выданных блоков
+    size_t peak;
+    size_t blocks;         // нарезано всего
+} BlockPool;
+
+/* Сумма по всем аренам и пулам процесса */
+typedef struct {
+    uint64_t arenaBytes;       // взято аренами у malloc
+    uint64_t arenaPeakBytes;
+    uint64_t poolBytes;        // нарезано пулами из арен
+    uint64_t poolBlocks;
+} AllocatorStats;
+
+/* [[ Функции арены ]] */
+void InitArena(Arena *arena, size_t chunkSize);
+void* ArenaAlloc(Arena *arena, size_t size);
+void FreeArena(Arena *arena);
+
+/* [[ Функции пула ]] */
+bool InitBlockPool(BlockPool *pool, Arena *arena);
+void* PoolTake(BlockPool *pool, size_t blockSize);
+void PoolGive(BlockPool *pool, void *block);
+size_t PoolLiveBlocks(BlockPool *pool);
+void FreeBlockPool(BlockPool *pool);
+
+AllocatorStats GetAllocatorStats();
+
+#endif
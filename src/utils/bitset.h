@@ -0,0 +1,76 @@
+#ifndef BITSET_H
+#define BITSET_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * [[ Битовые множества ]]
+ * Массив 64-битных слов: элемент i - бит i % 64 слова i / 64.
+ * Длину массива хранит владелец; множества состояния партии
+ * размечает мир (см. World.stateWords).
+ */
+
+/* Сколько слов нужно под count элементов */
+#define BITSET_WORDS(count) (((size_t)(count) + 63) / 64)
+
+static inline bool BitsetTest(const uint64_t *bits, int index) {
+    return (bits[(uint32_t)index >> 6] >> ((uint32_t)index & 63)) & 1u;
+}
+
+static inline void BitsetSet(uint64_t *bits, int index) {
+    bits[(uint32_t)index >> 6] |= 1ull << ((uint32_t)index & 63);
+}
+
+static inline void BitsetClear(uint64_t *bits, int index) {
+    bits[(uint32_t)index >> 6] &= ~(1ull << ((uint32_t)index & 63));
+}
+
+/* Индекс младшего установленного бита слова (word != 0) */
+static inline int LowestBit64(uint64_t word) {
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_ctzll(word);
+#else
+    int index = 0;
+    while ((word & 1u) == 0) {
+        word >>= 1;
+        index++;
+    }
+    return index;
+#endif
+}
+
+static inline int CountBits64(uint64_t word) {
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_popcountll(word);
+#else
+    int count = 0;
+    for (; word != 0; word &= word - 1) {
+        count++;
+    }
+    return count;
+#endif
+}
+
+/*
+ * @brief Первый установленный бит с индексом не меньше from
+ * @param words Длина множества в словах
+ * @return Индекс бита или -1, если дальше битов нет
+ */
+static inline int BitsetNext(const uint64_t *bits, size_t words, int from) {
+    size_t word = (uint32_t)from >> 6;
+    if (word >= words) {
+        return -1;
+    }
+    uint64_t rest = bits[word] & (UINT64_MAX << ((uint32_t)from & 63));
+    while (rest == 0) {
+        if (++word == words) {
+            return -1;
+        }
+        rest = bits[word];
+    }
+    return (int)(word * 64) + LowestBit64(rest);
+}
+
+#endif
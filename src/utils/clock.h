@@ -0,0 +1,9 @@
+#ifndef CLOCK_H
+#define CLOCK_H
+
+#include <stdint.h>
+
+/* [[ Монотонные часы ]] */
+uint64_t NowNanoseconds();
+
+#endif
@@ -3,6 +3,7 @@
 #include <stdlib.h>
 #include <stdbool.h>
 #include "console.h"
+#include "frame.h"
 
 /* [[ Constants ]] */
 #define HIGHLIGHT "\033[7m"
@@ -12,21 +13,20 @@
 
 /*
  * @brief Очистка консоли
- * Функция очищает консоль. Проверяя систему и наличие ошибок в процессе очистки.
+ * Функция очищает консоль ANSI-последовательностью, без запуска оболочки.
+ * Если stdout не терминал (файл, канал), ничего не выводит.
  *
  *  @return true если очистка прошла успешно, иначе false
  */
 bool _clearConsole() {
-    int result;
+    FrameBuffer frame;
+    FrameInit(&frame);
+    FrameClearScreen(&frame);
 
-    //логика предпроцессора перед очисткой консоли на Windows
-    #ifdef _WIN32
-        result = system("cls");
-    #else
-        result = system("clear");
-    #endif
+    bool result = FrameFlush(&frame);
+    FrameFree(&frame);
 
-    if (result != 0) {
+    if (!result) {
         printf("Error clearing console.\n");
         return false;
     }
@@ -46,24 +46,28 @@ bool _clearConsole() {
  *      CreateMenu(menu_items);
  */
 int CreateMenu(char **strings) {
-    bool resultClear = _clearConsole();
-    // Очистка консоли выполнена
-
     int count = 0;
     while(strings[count] != NULL) count++; //Высчитываем сколько строк в массиве
     if (count <= 0) return -1;
 
     char buf[64]; //Выделяем память под input
 
-    printf("\n===========================================\n");
-    printf("|               Main Menu               |\n");
-    printf("===========================================\n\n");
+    // Меню собирается в кадр и выводится одной записью вместе с очисткой
+    FrameBuffer frame;
+    FrameInit(&frame);
+    FrameClearScreen(&frame);
+    FrameAppend(&frame, "\n===========================================\n");
+    FrameAppend(&frame, "|               Main Menu               |\n");
+    FrameAppend(&frame, "===========================================\n\n");
 
     for (int i = 0; i < count; i++) {
-        printf("[%d] %s\n", i+1, strings[i]);
+        FramePrintf(&frame, "[%d] %s\n", i+1, strings[i]);
     }
 
-    printf("\nEnter option: ");
+    FrameAppend(&frame, "\nEnter option: ");
+    FrameFlush(&frame);
+    FrameFree(&frame);
+
     if(fgets(buf, sizeof buf, stdin) != NULL) {
        int opt;
        if (sscanf(buf, "%d", &opt) == 1){
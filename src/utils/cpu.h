@@ -0,0 +1,7 @@
+#ifndef CPU_H
+#define CPU_H
+
+/* [[ Сведения о процессоре ]] */
+int GetCpuCount();
+
+#endif
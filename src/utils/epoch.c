@@ -0,0 +1,135 @@
+#include <stdlib.h>
+#include <string.h>
+#include "epoch.h"
+
+/* [[ Внутренние структуры ]] */
+struct EpochRetired {
+    EpochRetired *next;
+    void *object;
+    EpochReclaimFn reclaim;
+    uint64_t epoch;        // эпоха снятия
+};
+
+/* [[ Прототипы внутренних функций ]] */
+static uint64_t OldestReader(const EpochDomain *domain);
+
+/* [[ Функции домена ]] */
+
+/*
+ * @brief Пустой домен без читателей
+ * @return false если не удалось создать замок
+ */
+bool InitEpochDomain(EpochDomain *domain) {
+    memset(domain, 0, sizeof *domain);
+    atomic_init(&domain->epoch, 1);
+    atomic_init(&domain->retiredCount, 0);
+    return mtx_init(&domain->lock, mtx_plain) == thrd_success;
+}
+
+/*
+ * @brief Закрыть домен
+ * Все снятые объекты освобождаются с force; читателей уже быть не должно.
+ */
+void FreeEpochDomain(EpochDomain *domain) {
+    for (EpochRetired *entry = domain->retired; entry != NULL;) {
+        EpochRetired *next = entry->next;
+        entry->reclaim(entry->object, true);
+        free(entry);
+        entry = next;
+    }
+    domain->retired = NULL;
+    atomic_store(&domain->retiredCount, 0);
+    mtx_destroy(&domain->lock);
+}
+
+/*
+ * @brief Зарегистрировать слот читателя (обычно - поток)
+ * @return false если читателей уже EPOCH_MAX_READERS
+ */
+bool RegisterEpochReader(EpochDomain *domain, EpochReader *reader) {
+    atomic_init(&reader->epoch, 0);
+    mtx_lock(&domain->lock);
+    bool ok = domain->readerCount < EPOCH_MAX_READERS;
+    if (ok) {
+        domain->readers[domain->readerCount++] = reader;
+    }
+    mtx_unlock(&domain->lock);
+    return ok;
+}
+
+void UnregisterEpochReader(EpochDomain *domain, EpochReader *reader) {
+    mtx_lock(&domain->lock);
+    for (int i = 0; i < domain->readerCount; i++) {
+        if (domain->readers[i] == reader) {
+            domain->readers[i] = domain->readers[--domain->readerCount];
+            break;
+        }
+    }
+    mtx_unlock(&domain->lock);
+}
+
+/*
+ * @brief Отдать объект на отложенное освобождение
+ * Вызывать после того, как указатель на объект подменён: читатели,
+ * вошедшие позже, его уже не увидят.
+ *
+ * @return false если не хватило памяти (объект тогда не снят)
+ */
+bool EpochRetire(EpochDomain *domain, void *object, EpochReclaimFn reclaim) {
+    EpochRetired *entry = malloc(sizeof *entry);
+    if (entry == NULL) {
+        return false;
+    }
+    entry->object = object;
+    entry->reclaim = reclaim;
+    entry->epoch = atomic_fetch_add(&domain->epoch, 1);
+
+    mtx_lock(&domain->lock);
+    entry->next = domain->retired;
+    domain->retired = entry;
+    atomic_fetch_add_explicit(&domain->retiredCount, 1, memory_order_relaxed);
+    mtx_unlock(&domain->lock);
+    return true;
+}
+
+/*
+ * @brief Освободить снятые объекты, которые никто не держит
+ * Не ждёт: занятые остаются до следующего вызова. Если замок занят
+ * другим писателем, ничего не делает.
+ *
+ * @return Сколько объектов ещё ждёт освобождения
+ */
+size_t EpochReclaim(EpochDomain *domain) {
+    if (mtx_trylock(&domain->lock) != thrd_success) {
+        return atomic_load_explicit(&domain->retiredCount, memory_order_relaxed);
+    }
+    uint64_t oldest = OldestReader(domain);
+    size_t left = 0;
+    for (EpochRetired **link = &domain->retired; *link != NULL;) {
+        EpochRetired *entry = *link;
+        if (entry->epoch < oldest && entry->reclaim(entry->object, false)) {
+            *link = entry->next;
+            free(entry);
+            continue;
+        }
+        left++;
+        link = &entry->next;
+    }
+    atomic_store_explicit(&domain->retiredCount, left, memory_order_relaxed);
+    mtx_unlock(&domain->lock);
+    return left;
+}
+
+/* [[ Внутренние функции ]] */
+
+/* Наименьшая эпоха среди читающих; если никто не читает - больше любой снятой */
+static uint64_t OldestReader(const EpochDomain *domain) {
+    uint64_t oldest = UINT64_MAX;
+    for (int i = 0; i < domain->readerCount; i++) {
+        uint64_t epoch = atomic_load(&domain->readers[i]->epoch);
+        if (epoch != 0 && epoch < oldest) {
+            oldest = epoch;
+        }
+    }
+    return oldest;
+}
@@ -0,0 +1,77 @@
+#ifndef EPOCH_H
+#define EPOCH_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <threads.h>
+
+/*
+ * [[ Эпохи ]]
+ * Отложенное освобождение объектов, которые читают без замков (RCU).
+ * Писатель подменяет атомарный указатель и отдаёт старый объект в
+ * EpochRetire; освобождается он, только когда ни один читатель не может
+ * его держать.
+ *
+ * Читатель на горячем пути делает два атомарных действия и не берёт
+ * замков: EpochEnter записывает в свой слот текущую эпоху, затем
+ * читается указатель; EpochLeave обнуляет слот. Объект, снятый в эпоху
+ * E, свободен, когда у всех читателей слот 0 или больше E: такой
+ * читатель вошёл после подмены и старого указателя не видел.
+ *
+ * Замок домена нужен только писателям: регистрация читателей, список
+ * снятых объектов и их освобождение.
+ */
+#define EPOCH_MAX_READERS 64
+
+/* Слот читателя; 0 - вне чтения */
+typedef struct {
+    _Atomic uint64_t epoch;
+} EpochReader;
+
+/*
+ * Освобождение снятого объекта. Вернуть false - объект ещё занят не
+ * только читателями (например, живыми сессиями), попытка повторится;
+ * force - домен закрывается, освободить в любом случае.
+ */
+typedef bool (*EpochReclaimFn)(void *object, bool force);
+
+typedef struct EpochRetired EpochRetired;
+
+typedef struct {
+    _Atomic uint64_t epoch;        // с 1; растёт на каждый EpochRetire
+    mtx_t lock;
+    EpochReader *readers[EPOCH_MAX_READERS];
+    int readerCount;
+    EpochRetired *retired;
+    _Atomic size_t retiredCount;   // для проверки без замка
+} EpochDomain;
+
+/* [[ Функции домена ]] */
+bool InitEpochDomain(EpochDomain *domain);
+void FreeEpochDomain(EpochDomain *domain);
+bool RegisterEpochReader(EpochDomain *domain, EpochReader *reader);
+void UnregisterEpochReader(EpochDomain *domain, EpochReader *reader);
+bool EpochRetire(EpochDomain *domain, void *object, EpochReclaimFn reclaim);
+size_t EpochReclaim(EpochDomain *domain);
+
+/*
+ * @brief Начало чтения: дальше прочитанные указатели домена живы
+ * Запись слота и последующее чтение указателя - seq_cst, иначе чтение
+ * могло бы обогнать запись эпохи.
+ */
+static inline void EpochEnter(EpochDomain *domain, EpochReader *reader) {
+    atomic_store(&reader->epoch, atomic_load(&domain->epoch));
+}
+
+/* Конец чтения: прочитанные указатели больше не используются */
+static inline void EpochLeave(EpochReader *reader) {
+    atomic_store_explicit(&reader->epoch, 0, memory_order_release);
+}
+
+static inline bool HasRetired(EpochDomain *domain) {
+    return atomic_load_explicit(&domain->retiredCount, memory_order_relaxed) > 0;
+}
+
+#endif
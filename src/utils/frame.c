@@ -0,0 +1,189 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <errno.h>
+#ifdef _WIN32
+#include <windows.h>
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+#include "frame.h"
+#include "metrics.h"
+
+/* [[ Constants ]] */
+#define CLEAR_SCREEN "\033[H\033[2J\033[3J"
+
+/* [[ Прототипы внутренних функций ]] */
+static bool Reserve(FrameBuffer *frame, size_t extra);
+static bool WriteAll(const char *data, size_t size);
+
+/*[[ Functions ]]*/
+
+void FrameInit(FrameBuffer *frame) {
+    memset(frame, 0, sizeof *frame);
+}
+
+void FrameFree(FrameBuffer *frame) {
+    free(frame->data);
+    memset(frame, 0, sizeof *frame);
+}
+
+/*
+ * @brief Начать новый кадр, сохранив выделенную память
+ */
+void FrameReset(FrameBuffer *frame) {
+    frame->size = 0;
+    frame->failed = false;
+}
+
+void FrameAppend(FrameBuffer *frame, const char *text) {
+    FrameAppendN(frame, text, strlen(text));
+}
+
+void FrameAppendN(FrameBuffer *frame, const char *text, size_t length) {
+    if (!Reserve(frame, length)) {
+        return;
+    }
+    memcpy(frame->data + frame->size, text, length);
+    frame->size += length;
+}
+
+/*
+ * @brief Форматированный вывод в кадр (аналог printf)
+ */
+void FramePrintf(FrameBuffer *frame, const char *format, ...) {
+    va_list args;
+
+    va_start(args, format);
+    FrameVPrintf(frame, format, args);
+    va_end(args);
+}
+
+/*
+ * @brief Форматированный вывод в кадр (аналог vprintf)
+ */
+void FrameVPrintf(FrameBuffer *frame, const char *format, va_list args) {
+    va_list retry;
+
+    va_copy(retry, args);
+    size_t room = frame->capacity - frame->size;
+    int length = vsnprintf(frame->data != NULL ? frame->data + frame->size : NULL, room, format, args);
+
+    if (length < 0) {
+        frame->failed = true;
+    } else if ((size_t)length < room || Reserve(frame, (size_t)length + 1)) {
+        // Если не поместилось, буфер уже расширен: форматируем ещё раз
+        if ((size_t)length >= room) {
+            vsnprintf(frame->data + frame->size, (size_t)length + 1, format, retry);
+        }
+        frame->size += (size_t)length;
+    }
+    va_end(retry);
+}
+
+/*
+ * @brief Очистка экрана в начале кадра
+ * ANSI-последовательность вместо system("clear"); в файл или канал
+ * ничего не пишется, чтобы вывод оставался чистым текстом.
+ */
+void FrameClearScreen(FrameBuffer *frame) {
+    if (IsTerminalOutput()) {
+        FrameAppendClearScreen(frame);
+    }
+}
+
+/*
+ * @brief Очистка экрана без проверки stdout
+ * Для кадров, которые уходят не в stdout (сокет, буфер диалога):
+ * решение об очистке принимает тот, кто знает, куда пойдёт кадр.
+ */
+void FrameAppendClearScreen(FrameBuffer *frame) {
+    FrameAppend(frame, CLEAR_SCREEN);
+}
+
+/*
+ * @brief Вывод кадра в stdout одним системным вызовом
+ * Перед записью сбрасывается буфер stdio, чтобы не нарушить порядок
+ * с обычным printf. После вывода кадр очищается.
+ *
+ * @return true если кадр записан полностью
+ */
+bool FrameFlush(FrameBuffer *frame) {
+    fflush(stdout);
+    METRIC_START(TIMER_WRITE, writeStarted);
+    bool ok = !frame->failed && WriteAll(frame->data, frame->size);
+    METRIC_STOP(TIMER_WRITE, writeStarted);
+    METRIC_ADD(COUNTER_BYTES_WRITTEN, ok ? frame->size : 0);
+    FrameReset(frame);
+    return ok;
+}
+
+/*
+ * @brief Является ли stdout терминалом
+ * Результат вычисляется один раз; в Windows заодно включается
+ * поддержка ANSI-последовательностей в консоли.
+ */
+bool IsTerminalOutput() {
+    static int cached = -1;
+
+    if (cached < 0) {
+#ifdef _WIN32
+        cached = 0;
+        if (_isatty(_fileno(stdout))) {
+            HANDLE out = GetStdHandle(STD_OUTPUT_HANDLE);
+            DWORD mode = 0;
+            if (GetConsoleMode(out, &mode) &&
+                SetConsoleMode(out, mode | ENABLE_VIRTUAL_TERMINAL_PROCESSING)) {
+                cached = 1;
+            }
+        }
+#else
+        cached = isatty(STDOUT_FILENO) ? 1 : 0;
+#endif
+    }
+    return cached == 1;
+}
+
+/* [[ Внутренние функции ]] */
+
+static bool Reserve(FrameBuffer *frame, size_t extra) {
+    if (frame->failed) {
+        return false;
+    }
+    if (frame->size + extra <= frame->capacity) {
+        return true;
+    }
+    size_t capacity = frame->capacity > 0 ? frame->capacity : 4096;
+    while (capacity < frame->size + extra) {
+        capacity *= 2;
+    }
+    char *grown = realloc(frame->data, capacity);
+    if (grown == NULL) {
+        frame->failed = true;
+        return false;
+    }
+    frame->data = grown;
+    frame->capacity = capacity;
+    return true;
+}
+
+static bool WriteAll(const char *data, size_t size) {
+    while (size > 0) {
+#ifdef _WIN32
+        int written = _write(_fileno(stdout), data, (unsigned int)size);
+#else
+        ssize_t written = write(STDOUT_FILENO, data, size);
+#endif
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+        if (written <= 0) {
+            return false;
+        }
+        data += written;
+        size -= (size_t)written;
+    }
+    return true;
+}
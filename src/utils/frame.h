@@ -0,0 +1,36 @@
+#ifndef FRAME_H
+#define FRAME_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdarg.h>
+
+/*
+ * [[ Буфер кадра ]]
+ * Экран целиком собирается в памяти и выводится одним write().
+ * Очистка экрана - ANSI-последовательность внутри кадра, без запуска
+ * оболочки; если stdout не терминал, кадр выводится простым текстом.
+ * Буфер переиспользуется между кадрами, память растёт только до
+ * размера самого большого кадра.
+ */
+typedef struct {
+    char *data;
+    size_t size;
+    size_t capacity;
+    bool failed;      // не хватило памяти, хвост кадра потерян
+} FrameBuffer;
+
+/* [[ Функции кадра ]] */
+void FrameInit(FrameBuffer *frame);
+void FrameFree(FrameBuffer *frame);
+void FrameReset(FrameBuffer *frame);
+void FrameAppend(FrameBuffer *frame, const char *text);
+void FrameAppendN(FrameBuffer *frame, const char *text, size_t length);
+void FramePrintf(FrameBuffer *frame, const char *format, ...);
+void FrameVPrintf(FrameBuffer *frame, const char *format, va_list args);
+void FrameClearScreen(FrameBuffer *frame);
+void FrameAppendClearScreen(FrameBuffer *frame);
+bool FrameFlush(FrameBuffer *frame);
+bool IsTerminalOutput();
+
+#endif
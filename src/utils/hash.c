@@ -0,0 +1,17 @@
+#include "hash.h"
+
+/*
+ * @brief FNV-1a по байтам
+ * Цепочку можно продолжать: результат передаётся как hash следующего вызова.
+ *
+ * @param hash Начальное значение (HASH_SEED) или предыдущий результат
+ */
+uint32_t HashBytes(const void *data, size_t size, uint32_t hash) {
+    const unsigned char *bytes = data;
+
+    for (size_t i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
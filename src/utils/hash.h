@@ -0,0 +1,12 @@
+#ifndef HASH_H
+#define HASH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* [[ Хеши ]] */
+#define HASH_SEED 2166136261u
+
+uint32_t HashBytes(const void *data, size_t size, uint32_t hash);
+
+#endif
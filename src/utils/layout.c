@@ -0,0 +1,310 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <threads.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/ioctl.h>
+#include <unistd.h>
+#endif
+#include "layout.h"
+#include "bitset.h"
+#include "metrics.h"
+
+#define LAYOUT_CACHE_SLOTS 256   // степень двойки
+
+_Static_assert((LAYOUT_CACHE_SLOTS & (LAYOUT_CACHE_SLOTS - 1)) == 0, "layout cache slots must be a power of two");
+
+/* [[ Кэш вёрстки ]] */
+/*
+ * Прямое отображение: слот выбирается по адресу текста и ширине, так что
+ * поиск не читает сам текст. Адрес может достаться другому тексту (страница
+ * мира вытеснена и прочитана заново), поэтому попадание подтверждается
+ * сравнением с копией исходника в слоте.
+ *
+ * Кэш свой у каждого потока - без блокировок; память освобождается
+ * при выходе потока.
+ */
+typedef struct {
+    const char *text;       // ключ: адрес исходного текста
+    uint32_t width;
+    uint32_t sourceLength;
+    uint32_t laidLength;
+    size_t capacity;
+    char *data;             // исходник с нулём, затем свёрстанный текст
+} LayoutSlot;
+
+static _Thread_local LayoutSlot *layoutSlots = NULL;
+static once_flag layoutOnce = ONCE_FLAG_INIT;
+static tss_t layoutOwner;       // только ради деструктора при выходе потока
+
+/* [[ Прототипы внутренних функций ]] */
+static size_t DecodeWidth(const unsigned char **p, const unsigned char *end);
+static void WrapText(FrameBuffer *frame, const char *text, size_t length, size_t width);
+static void AppendHardBroken(FrameBuffer *frame, const char *word, size_t length, size_t width, size_t *column);
+static LayoutSlot* AttachLayoutCache();
+static void InitLayoutCache();
+static void ReleaseLayoutCache(void *slots);
+
+/* [[ Функции вёрстки ]] */
+
+/*
+ * @brief Ширина текста в колонках терминала
+ * Быстрый путь - по 8 байт за раз: в ASCII и двухбайтовых символах
+ * (кириллица) колонок столько, сколько байтов, не являющихся
+ * продолжением символа. Три-четыре байта на символ и комбинирующие
+ * знаки (ведущие байты CC, CD) разбираются по одному символу.
+ *
+ * @param length Длина текста в байтах
+ */
+size_t DisplayWidth(const char *text, size_t length) {
+    const uint64_t highBits = 0x8080808080808080ull;
+    const uint64_t lowBits = 0x0101010101010101ull;
+    const unsigned char *p = (const unsigned char *)text;
+    const unsigned char *end = p + length;
+    size_t width = 0;
+
+    while (end - p >= 8) {
+        uint64_t word;
+        memcpy(&word, p, sizeof word);
+        uint64_t high = word & highBits;
+        if (high == 0) {
+            width += 8;
+            p += 8;
+            continue;
+        }
+        uint64_t longLead = word & (word << 1) & (word << 2) & highBits;   // 111xxxxx
+        uint64_t combining = (word & 0xFEFEFEFEFEFEFEFEull) ^ 0xCCCCCCCCCCCCCCCCull;
+        if (longLead == 0 && ((combining - lowBits) & ~combining & highBits) == 0) {
+            uint64_t continuation = high & ~(word << 1);                    // 10xxxxxx
+            width += 8 - (size_t)CountBits64(continuation);
+            p += 8;
+            continue;
+        }
+        width += DecodeWidth(&p, end);
+    }
+    while (p < end) {
+        width += DecodeWidth(&p, end);
+    }
+    return width;
+}
+
+/*
+ * @brief Текст с пробелами до ширины columns
+ * Более широкий текст выводится целиком.
+ */
+void FrameAppendPadded(FrameBuffer *frame, const char *text, size_t columns) {
+    static const char spaces[] = "                                                                ";
+    size_t length = strlen(text);
+    size_t width = DisplayWidth(text, length);
+
+    FrameAppendN(frame, text, length);
+    while (width < columns) {
+        size_t pad = columns - width < sizeof spaces - 1 ? columns - width : sizeof spaces - 1;
+        FrameAppendN(frame, spaces, pad);
+        width += pad;
+    }
+}
+
+/*
+ * @brief Текст с переносом по словам
+ * Строки не длиннее width колонок, переводы строк исходника сохраняются,
+ * слово шире строки режется по символам. Завершающий перевод строки
+ * не добавляется.
+ *
+ * @param width Ширина строки в колонках (приводится к LAYOUT_MIN_WIDTH..LAYOUT_MAX_WIDTH)
+ */
+void FrameAppendWrapped(FrameBuffer *frame, const char *text, int width) {
+    size_t columns = (size_t)(width < LAYOUT_MIN_WIDTH ? LAYOUT_MIN_WIDTH :
+                              width > LAYOUT_MAX_WIDTH ? LAYOUT_MAX_WIDTH : width);
+    LayoutSlot *slots = AttachLayoutCache();
+    if (slots == NULL) {
+        WrapText(frame, text, strlen(text), columns);
+        return;
+    }
+
+    uintptr_t key = (uintptr_t)text ^ ((uintptr_t)text >> 12) ^ (columns * 0x9E3779B1u);
+    LayoutSlot *slot = &slots[key & (LAYOUT_CACHE_SLOTS - 1)];
+    if (slot->text == text && slot->width == columns &&
+        strncmp(slot->data, text, (size_t)slot->sourceLength + 1) == 0) {
+        METRIC_ADD(COUNTER_LAYOUT_HITS, 1);
+        FrameAppendN(frame, slot->data + slot->sourceLength + 1, slot->laidLength);
+        return;
+    }
+
+    METRIC_ADD(COUNTER_LAYOUT_MISSES, 1);
+    size_t length = strlen(text);
+    size_t start = frame->size;
+    WrapText(frame, text, length, columns);
+    if (frame->failed || length > UINT32_MAX || frame->size - start > UINT32_MAX) {
+        return;
+    }
+
+    size_t laid = frame->size - start;
+    size_t need = length + 1 + laid;
+    if (need > slot->capacity) {
+        char *grown = realloc(slot->data, need);
+        if (grown == NULL) {
+            slot->text = NULL;
+            return;
+        }
+        slot->data = grown;
+        slot->capacity = need;
+    }
+    memcpy(slot->data, text, length + 1);
+    memcpy(slot->data + length + 1, frame->data + start, laid);
+    slot->text = text;
+    slot->width = (uint32_t)columns;
+    slot->sourceLength = (uint32_t)length;
+    slot->laidLength = (uint32_t)laid;
+}
+
+/*
+ * @brief Ширина терминала stdout в колонках
+ * @return Колонки или 0, если stdout не терминал
+ */
+int TerminalWidth() {
+#ifdef _WIN32
+    CONSOLE_SCREEN_BUFFER_INFO info;
+    if (!GetConsoleScreenBufferInfo(GetStdHandle(STD_OUTPUT_HANDLE), &info)) {
+        return 0;
+    }
+    return info.srWindow.Right - info.srWindow.Left + 1;
+#else
+    struct winsize size;
+    if (!isatty(STDOUT_FILENO) || ioctl(STDOUT_FILENO, TIOCGWINSZ, &size) != 0) {
+        return 0;
+    }
+    return size.ws_col;
+#endif
+}
+
+/* [[ Внутренние функции ]] */
+
+/*
+ * Ширина одного символа; *p сдвигается за него. Комбинирующие знаки
+ * и нулевой ширины - 0 колонок, восточноазиатские и эмодзи - 2.
+ * Байт продолжения без ведущего - 0, прочий мусор - 1 колонка.
+ */
+static size_t DecodeWidth(const unsigned char **p, const unsigned char *end) {
+    const unsigned char *at = *p;
+    uint32_t lead = at[0];
+    size_t bytes = lead < 0x80 ? 1 : lead < 0xC0 ? 0 : lead < 0xE0 ? 2 : lead < 0xF0 ? 3 : lead < 0xF8 ? 4 : 1;
+
+    if (bytes == 0) {
+        *p = at + 1;
+        return 0;
+    }
+    if (bytes == 1 || (size_t)(end - at) < bytes) {
+        *p = at + 1;
+        return 1;
+    }
+    uint32_t code = lead & (0x7Fu >> bytes);
+    for (size_t i = 1; i < bytes; i++) {
+        if ((at[i] & 0xC0) != 0x80) {
+            *p = at + 1;
+            return 1;
+        }
+        code = (code << 6) | (at[i] & 0x3F);
+    }
+    *p = at + bytes;
+
+    if ((code >= 0x0300 && code <= 0x036F) || (code >= 0x200B && code <= 0x200F) ||
+        (code >= 0xFE00 && code <= 0xFE0F)) {
+        return 0;
+    }
+    if ((code >= 0x1100 && code <= 0x115F) || (code >= 0x2E80 && code <= 0xA4CF) ||
+        (code >= 0xAC00 && code <= 0xD7A3) || (code >= 0xF900 && code <= 0xFAFF) ||
+        (code >= 0xFE30 && code <= 0xFE4F) || (code >= 0xFF00 && code <= 0xFF60) ||
+        (code >= 0xFFE0 && code <= 0xFFE6) || (code >= 0x1F300 && code <= 0x1F64F) ||
+        (code >= 0x1F900 && code <= 0x1F9FF) || (code >= 0x20000 && code <= 0x3FFFD)) {
+        return 2;
+    }
+    return 1;
+}
+
+/* Жадный перенос: слово уходит на новую строку, если не помещается в текущую */
+static void WrapText(FrameBuffer *frame, const char *text, size_t length, size_t width) {
+    const char *p = text;
+    const char *end = text + length;
+    size_t column = 0;
+
+    while (p < end) {
+        if (*p == '\n') {
+            FrameAppendN(frame, "\n", 1);
+            column = 0;
+            p++;
+            continue;
+        }
+        const char *gap = p;
+        while (p < end && (*p == ' ' || *p == '\t')) {
+            p++;
+        }
+        size_t gapLength = (size_t)(p - gap);
+        const char *word = p;
+        while (p < end && *p != ' ' && *p != '\t' && *p != '\n') {
+            p++;
+        }
+        size_t wordLength = (size_t)(p - word);
+        if (wordLength == 0) {
+            continue;   // пробелы в конце строки не нужны
+        }
+
+        size_t wordWidth = DisplayWidth(word, wordLength);
+        if (column > 0 && column + gapLength + wordWidth > width) {
+            FrameAppendN(frame, "\n", 1);
+            column = 0;
+        } else if (column > 0) {
+            FrameAppendN(frame, gap, gapLength);
+            column += gapLength;
+        }
+        if (wordWidth > width - column) {
+            AppendHardBroken(frame, word, wordLength, width, &column);
+        } else {
+            FrameAppendN(frame, word, wordLength);
+            column += wordWidth;
+        }
+    }
+}
+
+/* Слово шире строки - по символам, с переносом на границе колонок */
+static void AppendHardBroken(FrameBuffer *frame, const char *word, size_t length, size_t width, size_t *column) {
+    const unsigned char *p = (const unsigned char *)word;
+    const unsigned char *end = p + length;
+    while (p < end) {
+        const unsigned char *start = p;
+        size_t charWidth = DecodeWidth(&p, end);
+        if (*column + charWidth > width && *column > 0) {
+            FrameAppendN(frame, "\n", 1);
+            *column = 0;
+        }
+        FrameAppendN(frame, (const char *)start, (size_t)(p - start));
+        *column += charWidth;
+    }
+}
+
+static LayoutSlot* AttachLayoutCache() {
+    if (layoutSlots == NULL) {
+        call_once(&layoutOnce, InitLayoutCache);
+        layoutSlots = calloc(LAYOUT_CACHE_SLOTS, sizeof(LayoutSlot));
+        if (layoutSlots != NULL) {
+            tss_set(layoutOwner, layoutSlots);
+        }
+    }
+    return layoutSlots;
+}
+
+static void InitLayoutCache() {
+    tss_create(&layoutOwner, ReleaseLayoutCache);
+}
+
+static void ReleaseLayoutCache(void *slots) {
+    LayoutSlot *slot = slots;
+    for (int i = 0; i < LAYOUT_CACHE_SLOTS; i++) {
+        free(slot[i].data);
+    }
+    free(slots);
+}
@@ -0,0 +1,25 @@
+#ifndef LAYOUT_H
+#define LAYOUT_H
+
+#include <stddef.h>
+#include "frame.h"
+
+/*
+ * [[ Вёрстка текста ]]
+ * Ширина строки в колонках терминала, а не в байтах: кириллица в UTF-8 -
+ * два байта на колонку, поэтому printf("%-53s") ломает рамки. Перенос
+ * по словам под ширину экрана; свёрстанный текст кэшируется в потоке
+ * по паре (текст, ширина), так что повторный показ локации - одно
+ * копирование.
+ */
+#define LAYOUT_DEFAULT_WIDTH 80   // если ширина терминала неизвестна
+#define LAYOUT_MIN_WIDTH 20
+#define LAYOUT_MAX_WIDTH 1000
+
+/* [[ Функции вёрстки ]] */
+size_t DisplayWidth(const char *text, size_t length);
+void FrameAppendPadded(FrameBuffer *frame, const char *text, size_t columns);
+void FrameAppendWrapped(FrameBuffer *frame, const char *text, int width);
+int TerminalWidth();
+
+#endif
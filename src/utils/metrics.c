@@ -0,0 +1,358 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <threads.h>
+#include "metrics.h"
+#include "arena.h"
+
+#ifdef GAME_METRICS
+
+/* [[ Реестр осколков ]] */
+/* Осколки не освобождаются: завершившийся поток отдаёт свой следующему */
+static _Atomic(MetricsShard *) shards = NULL;
+static once_flag registryOnce = ONCE_FLAG_INIT;
+static mtx_t registryLock;
+static tss_t shardOwner;        // только ради деструктора при выходе потока
+
+_Thread_local MetricsShard *metricsShard = NULL;
+
+/* Калибровка тиков: первая точка при первом осколке */
+static uint64_t calibrationTicks;
+static uint64_t calibrationNanos;
+
+/* Прошлый отчёт - для скорости ходов между отчётами */
+static uint64_t lastTurns;
+static uint64_t lastReportAt;
+
+/* Поток периодического отчёта */
+static thrd_t reporter;
+static bool reporterRunning = false;
+static atomic_bool reporterStop;
+static mtx_t reporterLock;
+static cnd_t reporterWake;
+static int reporterSeconds;
+
+/* [[ Прототипы внутренних функций ]] */
+static void InitRegistry();
+static void ReleaseShard(void *shard);
+static double NanosPerTick();
+static int ReporterMain(void *arg);
+
+#endif
+
+static void RenderAllocatorStats(FrameBuffer *out);
+
+/* [[ Функции метрик ]] */
+
+bool MetricsEnabled() {
+#ifdef GAME_METRICS
+    return true;
+#else
+    return false;
+#endif
+}
+
+#ifdef GAME_METRICS
+
+/*
+ * @brief Осколок текущего потока
+ * Медленный путь первой пробы потока: взять осколок завершившегося
+ * потока или выделить новый.
+ *
+ * @return Осколок или NULL, если не хватило памяти (пробы тогда молчат)
+ */
+MetricsShard* AttachMetricsShard() {
+    call_once(&registryOnce, InitRegistry);
+
+    MetricsShard *shard = NULL;
+    mtx_lock(&registryLock);
+    for (MetricsShard *s = atomic_load(&shards); s != NULL; s = s->next) {
+        if (atomic_load(&s->idle)) {
+            atomic_store(&s->idle, false);
+            shard = s;
+            break;
+        }
+    }
+    if (shard == NULL) {
+        shard = calloc(1, sizeof(MetricsShard));
+        if (shard != NULL) {
+            shard->next = atomic_load(&shards);
+            atomic_store(&shards, shard);
+        }
+    }
+    mtx_unlock(&registryLock);
+
+    metricsShard = shard;
+    tss_set(shardOwner, shard);
+    return shard;
+}
+
+/*
+ * @brief Сумма осколков всех потоков
+ * Пробы при этом не останавливаются, поэтому снимок согласован
+ * с точностью до ходов, идущих прямо сейчас.
+ */
+void TakeMetricsSnapshot(MetricsSnapshot *snapshot) {
+    memset(snapshot, 0, sizeof *snapshot);
+    call_once(&registryOnce, InitRegistry);
+
+    for (MetricsShard *s = atomic_load(&shards); s != NULL; s = s->next) {
+        for (int c = 0; c < COUNTER_COUNT; c++) {
+            snapshot->counters[c] += atomic_load_explicit(&s->counters[c], memory_order_relaxed);
+        }
+        for (int t = 0; t < TIMER_COUNT; t++) {
+            const MetricHistogram *h = &s->timers[t];
+            snapshot->count[t] += atomic_load_explicit(&h->count, memory_order_relaxed);
+            snapshot->sum[t] += atomic_load_explicit(&h->sum, memory_order_relaxed);
+            uint64_t max = atomic_load_explicit(&h->max, memory_order_relaxed);
+            if (max > snapshot->max[t]) {
+                snapshot->max[t] = max;
+            }
+            for (int b = 0; b < METRIC_BUCKETS; b++) {
+                snapshot->buckets[t][b] += atomic_load_explicit(&h->buckets[b], memory_order_relaxed);
+            }
+        }
+    }
+    snapshot->nsPerTick = NanosPerTick();
+    snapshot->takenAt = NowNanoseconds();
+}
+
+/*
+ * @brief Квантиль таймера в наносекундах
+ * Возвращается нижняя граница бакета, куда попал квантиль.
+ *
+ * @param p Доля от 0 до 1
+ */
+double SnapshotPercentile(const MetricsSnapshot *snapshot, MetricTimer timer, double p) {
+    uint64_t count = snapshot->count[timer];
+    if (count == 0) {
+        return 0;
+    }
+    uint64_t rank = (uint64_t)(p * (double)(count - 1)) + 1;
+    uint64_t seen = 0;
+    for (int b = 0; b < METRIC_BUCKETS; b++) {
+        seen += snapshot->buckets[timer][b];
+        if (seen >= rank) {
+            uint64_t low;
+            if (b < METRIC_SUB_COUNT) {
+                low = (uint64_t)b;
+            } else {
+                int exponent = b / METRIC_SUB_COUNT + METRIC_SUB_BITS - 1;
+                uint64_t sub = (uint64_t)(b % METRIC_SUB_COUNT);
+                low = (METRIC_SUB_COUNT + sub) << (exponent - METRIC_SUB_BITS);
+            }
+            return (double)low * snapshot->nsPerTick;
+        }
+    }
+    return (double)snapshot->max[timer] * snapshot->nsPerTick;
+}
+
+#else
+
+MetricsShard* AttachMetricsShard() {
+    return NULL;
+}
+
+void TakeMetricsSnapshot(MetricsSnapshot *snapshot) {
+    memset(snapshot, 0, sizeof *snapshot);
+}
+
+double SnapshotPercentile(const MetricsSnapshot *snapshot, MetricTimer timer, double p) {
+    (void)snapshot;
+    (void)timer;
+    (void)p;
+    return 0;
+}
+
+#endif
+
+/*
+ * @brief Текстовый отчёт метрик в кадр
+ * Его выводят команда /stats и периодический отчёт. Скорость ходов
+ * считается от предыдущего отчёта.
+ */
+void RenderMetrics(FrameBuffer *out) {
+#ifdef GAME_METRICS
+    MetricsSnapshot *snapshot = malloc(sizeof(MetricsSnapshot));
+    if (snapshot == NULL) {
+        FrameAppend(out, "metrics: out of memory\n");
+        return;
+    }
+    TakeMetricsSnapshot(snapshot);
+
+    const uint64_t *counters = snapshot->counters;
+    mtx_lock(&registryLock);
+    double seconds = (double)(snapshot->takenAt - lastReportAt) / 1e9;
+    double turnRate = seconds > 0 ? (double)(counters[COUNTER_TURNS] - lastTurns) / seconds : 0.0;
+    lastTurns = counters[COUNTER_TURNS];
+    lastReportAt = snapshot->takenAt;
+    mtx_unlock(&registryLock);
+
+    FramePrintf(out, "sessions alive: %llu\n",
+                (unsigned long long)(counters[COUNTER_SESSIONS_CREATED] - counters[COUNTER_SESSIONS_DESTROYED]));
+    for (int c = 0; c < COUNTER_COUNT; c++) {
+        FramePrintf(out, "%s: %llu\n", MetricCounterName((MetricCounter)c), (unsigned long long)counters[c]);
+    }
+    FramePrintf(out, "turns/sec: %.0f\n", turnRate);
+    uint64_t lookups = counters[COUNTER_PAGE_HITS] + counters[COUNTER_PAGE_MISSES];
+    if (lookups > 0) {
+        FramePrintf(out, "page hit rate: %.2f%%, resident %llu bytes\n",
+                    100.0 * (double)counters[COUNTER_PAGE_HITS] / (double)lookups,
+                    (unsigned long long)(counters[COUNTER_PAGE_BYTES_LOADED] - counters[COUNTER_PAGE_BYTES_EVICTED]));
+    }
+    RenderAllocatorStats(out);
+
+    FramePrintf(out, "%-10s %12s %10s %10s %10s %10s\n", "timer", "samples", "mean ns", "p50 ns", "p99 ns", "max ns");
+    for (int t = 0; t < TIMER_COUNT; t++) {
+        uint64_t count = snapshot->count[t];
+        double mean = count > 0 ? (double)snapshot->sum[t] * snapshot->nsPerTick / (double)count : 0.0;
+        FramePrintf(out, "%-10s %12llu %10.0f %10.0f %10.0f %10.0f\n", MetricTimerName((MetricTimer)t),
+                    (unsigned long long)count, mean, SnapshotPercentile(snapshot, (MetricTimer)t, 0.50),
+                    SnapshotPercentile(snapshot, (MetricTimer)t, 0.99),
+                    (double)snapshot->max[t] * snapshot->nsPerTick);
+    }
+    free(snapshot);
+#else
+    FrameAppend(out, "metrics: disabled in this build (GAME_METRICS=OFF)\n");
+    RenderAllocatorStats(out);
+#endif
+}
+
+/*
+ * @brief Периодический отчёт в stderr
+ * @param seconds Интервал между отчётами
+ * @return false если поток не запустился или метрики выключены
+ */
+bool StartMetricsReporter(int seconds) {
+#ifdef GAME_METRICS
+    if (reporterRunning || seconds <= 0) {
+        return false;
+    }
+    call_once(&registryOnce, InitRegistry);
+    reporterSeconds = seconds;
+    atomic_store(&reporterStop, false);
+    reporterRunning = thrd_create(&reporter, ReporterMain, NULL) == thrd_success;
+    return reporterRunning;
+#else
+    (void)seconds;
+    return false;
+#endif
+}
+
+void StopMetricsReporter() {
+#ifdef GAME_METRICS
+    if (!reporterRunning) {
+        return;
+    }
+    mtx_lock(&reporterLock);
+    atomic_store(&reporterStop, true);
+    cnd_signal(&reporterWake);
+    mtx_unlock(&reporterLock);
+    thrd_join(reporter, NULL);
+    reporterRunning = false;
+#endif
+}
+
+const char* MetricTimerName(MetricTimer timer) {
+    switch (timer) {
+        case TIMER_STEP:      return "step";
+        case TIMER_PARSE:     return "parse";
+        case TIMER_EXECUTE:   return "execute";
+        case TIMER_RENDER:    return "render";
+        case TIMER_WRITE:     return "write";
+        case TIMER_WIN_CHECK: return "win_check";
+        case TIMER_COUNT:     break;
+    }
+    return "?";
+}
+
+const char* MetricCounterName(MetricCounter counter) {
+    switch (counter) {
+        case COUNTER_TURNS:              return "turns";
+        case COUNTER_SESSIONS_CREATED:   return "sessions created";
+        case COUNTER_SESSIONS_DESTROYED: return "sessions destroyed";
+        case COUNTER_BYTES_RENDERED:     return "bytes rendered";
+        case COUNTER_BYTES_WRITTEN:      return "bytes written";
+        case COUNTER_PAGE_HITS:          return "page hits";
+        case COUNTER_PAGE_MISSES:        return "page misses";
+        case COUNTER_PAGE_PREFETCHES:    return "page prefetches";
+        case COUNTER_PAGE_PREFETCH_HITS: return "page prefetch hits";
+        case COUNTER_PAGE_EVICTIONS:     return "page evictions";
+        case COUNTER_PAGE_BYTES_LOADED:  return "page bytes loaded";
+        case COUNTER_PAGE_BYTES_EVICTED: return "page bytes evicted";
+        case COUNTER_LAYOUT_HITS:        return "layout hits";
+        case COUNTER_LAYOUT_MISSES:      return "layout misses";
+        case COUNTER_COUNT:              break;
+    }
+    return "?";
+}
+
+#ifdef GAME_METRICS
+
+/* [[ Внутренние функции ]] */
+
+static void InitRegistry() {
+    mtx_init(&registryLock, mtx_plain);
+    mtx_init(&reporterLock, mtx_plain);
+    cnd_init(&reporterWake);
+    tss_create(&shardOwner, ReleaseShard);
+    calibrationTicks = MetricsTicks();
+    calibrationNanos = NowNanoseconds();
+    lastReportAt = calibrationNanos;
+}
+
+/* Поток завершился: его счёт остаётся в осколке, писать будет следующий */
+static void ReleaseShard(void *shard) {
+    atomic_store(&((MetricsShard *)shard)->idle, true);
+}
+
+/*
+ * Наносекунд на тик по двум точкам: старту реестра и текущему моменту.
+ * Если с начала прошло меньше 10 мс, точность добирается ожиданием.
+ */
+static double NanosPerTick() {
+    uint64_t nanos = NowNanoseconds();
+    while (nanos - calibrationNanos < 10000000u) {
+        thrd_yield();
+        nanos = NowNanoseconds();
+    }
+    uint64_t ticks = MetricsTicks();
+    if (ticks == calibrationTicks) {
+        return 1.0;
+    }
+    return (double)(nanos - calibrationNanos) / (double)(ticks - calibrationTicks);
+}
+
+static int ReporterMain(void *arg) {
+    (void)arg;
+    FrameBuffer frame;
+    FrameInit(&frame);
+
+    mtx_lock(&reporterLock);
+    while (!atomic_load(&reporterStop)) {
+        struct timespec deadline;
+        timespec_get(&deadline, TIME_UTC);
+        deadline.tv_sec += reporterSeconds;
+        if (cnd_timedwait(&reporterWake, &reporterLock, &deadline) == thrd_timedout) {
+            RenderMetrics(&frame);
+            fputs("--- stats ---\n", stderr);
+            fwrite(frame.data, 1, frame.size, stderr);
+            FrameReset(&frame);
+        }
+    }
+    mtx_unlock(&reporterLock);
+
+    FrameFree(&frame);
+    return 0;
+}
+
+#endif
+
+/* Память арен и пулов: метрики тут не нужны, выводится в любой сборке */
+static void RenderAllocatorStats(FrameBuffer *out) {
+    AllocatorStats stats = GetAllocatorStats();
+    FramePrintf(out, "arena bytes: %llu (peak %llu)\n", (unsigned long long)stats.arenaBytes,
+                (unsigned long long)stats.arenaPeakBytes);
+    FramePrintf(out, "pool blocks: %llu, %llu bytes\n", (unsigned long long)stats.poolBlocks,
+                (unsigned long long)stats.poolBytes);
+}
@@ -0,0 +1,195 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include "frame.h"
+#include "clock.h"
+
+/*
+ * [[ Метрики движка ]]
+ *
+ * Счётчики и гистограммы задержек горячих путей. У каждого потока свой
+ * осколок: проба - обычная запись в память своего потока без атомарных
+ * RMW и без блокировок, суммирование идёт только при чтении.
+ *
+ * Гистограммы - в духе HDR: бакет на каждую степень двойки, внутри
+ * неё 16 равных подбакетов, то есть относительная ошибка квантиля
+ * не больше 1/16 на любом масштабе от тиков до минут.
+ *
+ * Чтение часов дороже самих замеряемых функций (а в виртуальной машине
+ * rdtsc стоит десятки нс), поэтому таймер замеряет лишь каждый
+ * METRICS_SAMPLE_EVERY-й вызов в потоке. Остальные вызовы стоят
+ * декремент и ветвление. Счётчики считают всё.
+ *
+ * Сборка с -DGAME_METRICS=OFF убирает пробы целиком: макросы METRIC_*
+ * раскрываются в пустоту, отчёт сообщает, что метрик нет.
+ */
+
+#ifndef METRICS_SAMPLE_EVERY
+#define METRICS_SAMPLE_EVERY 64
+#endif
+
+/* [[ Счётчики ]] */
+typedef enum {
+    COUNTER_TURNS,               // вызовы StepGameSession
+    COUNTER_SESSIONS_CREATED,
+    COUNTER_SESSIONS_DESTROYED,
+    COUNTER_BYTES_RENDERED,      // байты экранов локации и инвентаря
+    COUNTER_BYTES_WRITTEN,       // байты, отданные в stdout или сокет
+    COUNTER_PAGE_HITS,           // страница локации уже была в кэше (world-pager.h)
+    COUNTER_PAGE_MISSES,
+    COUNTER_PAGE_PREFETCHES,     // страницы, прочитанные заранее
+    COUNTER_PAGE_PREFETCH_HITS,  // из них пригодились
+    COUNTER_PAGE_EVICTIONS,
+    COUNTER_PAGE_BYTES_LOADED,
+    COUNTER_PAGE_BYTES_EVICTED,
+    COUNTER_LAYOUT_HITS,         // свёрстанный текст взят из кэша (layout.h)
+    COUNTER_LAYOUT_MISSES,
+    COUNTER_COUNT
+} MetricCounter;
+
+/* [[ Таймеры ]] */
+typedef enum {
+    TIMER_STEP,          // ход целиком
+    TIMER_PARSE,         // разбор строки ввода
+    TIMER_EXECUTE,       // ExecuteAction
+    TIMER_RENDER,        // RenderLocation / RenderInventory
+    TIMER_WRITE,         // запись кадра в stdout или сокет
+    TIMER_WIN_CHECK,     // CheckWinCondition
+    TIMER_COUNT
+} MetricTimer;
+
+#define METRIC_SUB_BITS 4
+#define METRIC_SUB_COUNT (1 << METRIC_SUB_BITS)
+/* Значения < 16 точные, дальше по 16 подбакетов на степень двойки до 2^63 */
+#define METRIC_BUCKETS ((64 - METRIC_SUB_BITS + 1) * METRIC_SUB_COUNT)
+
+/* [[ Гистограмма ]] */
+typedef struct {
+    _Atomic uint64_t count;
+    _Atomic uint64_t sum;
+    _Atomic uint64_t max;
+    _Atomic uint64_t buckets[METRIC_BUCKETS];
+} MetricHistogram;
+
+/* [[ Осколок потока ]] */
+typedef struct MetricsShard {
+    _Atomic uint64_t counters[COUNTER_COUNT];
+    MetricHistogram timers[TIMER_COUNT];
+    uint32_t countdown[TIMER_COUNT];   // сколько вызовов таймера до следующего замера
+    atomic_bool idle;              // поток завершился, осколок можно отдать другому
+    struct MetricsShard *next;
+} MetricsShard;
+
+/* [[ Снимок ]] */
+/* Сумма по всем потокам; длительности в тиках, в нс - умножением на nsPerTick */
+typedef struct {
+    uint64_t counters[COUNTER_COUNT];
+    uint64_t count[TIMER_COUNT];
+    uint64_t sum[TIMER_COUNT];
+    uint64_t max[TIMER_COUNT];
+    uint64_t buckets[TIMER_COUNT][METRIC_BUCKETS];
+    double nsPerTick;
+    uint64_t takenAt;
+} MetricsSnapshot;
+
+/* [[ Функции метрик ]] */
+bool MetricsEnabled();
+void TakeMetricsSnapshot(MetricsSnapshot *snapshot);
+double SnapshotPercentile(const MetricsSnapshot *snapshot, MetricTimer timer, double p);
+void RenderMetrics(FrameBuffer *out);
+bool StartMetricsReporter(int seconds);
+void StopMetricsReporter();
+MetricsShard* AttachMetricsShard();
+const char* MetricTimerName(MetricTimer timer);
+const char* MetricCounterName(MetricCounter counter);
+
+#ifdef GAME_METRICS
+
+extern _Thread_local MetricsShard *metricsShard;
+
+/*
+ * Тики для таймеров: на x86-64 - счётчик тактов (несколько нс
+ * на чтение), иначе монотонные часы. В нс переводит снимок.
+ */
+static inline uint64_t MetricsTicks() {
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+    return __builtin_ia32_rdtsc();
+#else
+    return NowNanoseconds();
+#endif
+}
+
+static inline MetricsShard* MetricsThreadShard() {
+    MetricsShard *shard = metricsShard;
+    return shard != NULL ? shard : AttachMetricsShard();
+}
+
+/* Писатель у осколка один - хватает relaxed чтения и записи без RMW */
+static inline void MetricsBump(_Atomic uint64_t *cell, uint64_t value) {
+    atomic_store_explicit(cell, atomic_load_explicit(cell, memory_order_relaxed) + value, memory_order_relaxed);
+}
+
+static inline int MetricBucket(uint64_t value) {
+    if (value < METRIC_SUB_COUNT) {
+        return (int)value;
+    }
+#if defined(__GNUC__) || defined(__clang__)
+    int exponent = 63 - __builtin_clzll(value);
+#else
+    int exponent = 0;
+    for (uint64_t rest = value; rest > 1; rest >>= 1) {
+        exponent++;
+    }
+#endif
+    int sub = (int)(value >> (exponent - METRIC_SUB_BITS)) & (METRIC_SUB_COUNT - 1);
+    return (exponent - METRIC_SUB_BITS + 1) * METRIC_SUB_COUNT + sub;
+}
+
+static inline void MetricAdd(MetricCounter counter, uint64_t value) {
+    MetricsShard *shard = MetricsThreadShard();
+    if (shard != NULL) {
+        MetricsBump(&shard->counters[counter], value);
+    }
+}
+
+/* Начало замера или 0, если этот вызов не попал в выборку */
+static inline uint64_t MetricStart(MetricTimer timer) {
+    MetricsShard *shard = MetricsThreadShard();
+    if (shard == NULL || shard->countdown[timer]-- != 0) {
+        return 0;
+    }
+    shard->countdown[timer] = METRICS_SAMPLE_EVERY - 1;
+    return MetricsTicks();
+}
+
+static inline void MetricRecord(MetricTimer timer, uint64_t started) {
+    if (started == 0) {
+        return;
+    }
+    uint64_t ticks = MetricsTicks() - started;
+    MetricHistogram *h = &metricsShard->timers[timer];
+    MetricsBump(&h->count, 1);
+    MetricsBump(&h->sum, ticks);
+    MetricsBump(&h->buckets[MetricBucket(ticks)], 1);
+    if (ticks > atomic_load_explicit(&h->max, memory_order_relaxed)) {
+        atomic_store_explicit(&h->max, ticks, memory_order_relaxed);
+    }
+}
+
+#define METRIC_ADD(counter, value) MetricAdd((counter), (value))
+#define METRIC_START(timer, name) uint64_t name = MetricStart(timer)
+#define METRIC_STOP(timer, name) MetricRecord((timer), (name))
+
+#else
+
+/* sizeof не вычисляет выражение, но и не оставляет переменные неиспользованными */
+#define METRIC_ADD(counter, value) ((void)sizeof(value))
+#define METRIC_START(timer, name) ((void)0)
+#define METRIC_STOP(timer, name) ((void)0)
+
+#endif
+
+#endif
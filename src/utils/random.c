@@ -0,0 +1,43 @@
+#ifdef _WIN32
+#include <windows.h>
+#include <bcrypt.h>
+#else
+#include <errno.h>
+#include <stdio.h>
+#include <sys/random.h>
+#endif
+#include "random.h"
+
+/*
+ * @brief Криптографически стойкие случайные байты от ОС
+ * Для секретов (коды партий), а не для симуляций: медленнее xorshift.
+ *
+ * @return false если ОС не отдала байты; buffer тогда не годится
+ */
+bool SecureRandom(void *buffer, size_t size) {
+#ifdef _WIN32
+    return BCryptGenRandom(NULL, buffer, (ULONG)size, BCRYPT_USE_SYSTEM_PREFERRED_RNG) == 0;
+#else
+    unsigned char *bytes = buffer;
+    while (size > 0) {
+        ssize_t got = getrandom(bytes, size, 0);
+        if (got < 0 && errno == EINTR) {
+            continue;
+        }
+        if (got < 0) {
+            break;   // старое ядро без getrandom - читаем устройство
+        }
+        bytes += got;
+        size -= (size_t)got;
+    }
+    if (size == 0) {
+        return true;
+    }
+    FILE *device = fopen("/dev/urandom", "rb");
+    bool ok = device != NULL && fread(bytes, 1, size, device) == size;
+    if (device != NULL) {
+        fclose(device);
+    }
+    return ok;
+#endif
+}
@@ -0,0 +1,10 @@
+#ifndef RANDOM_H
+#define RANDOM_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/* [[ Случайные байты ОС ]] */
+bool SecureRandom(void *buffer, size_t size);
+
+#endif